@@ -104,12 +104,16 @@ class Server : public mkn::ram::tcp::SocketServer<uint8_t> {
 
   int accept(uint16_t const& fd) override {
     mkn::kul::ScopeLock lock(m_actex);
-    return ::accept(lisock, (struct sockaddr*)&cli_addr[fd], &clilen);
+    socklen_t len = sizeof(cli_addr[fd]);
+    return ::accept(lisock, (struct sockaddr*)&cli_addr[fd], &len);
   }
 
   void cycle(uint16_t const& size, std::map<int, uint8_t>* fds, int const& fd) {
+    if (_metrics) _metrics->queued.add(-1);
     auto& msg(*msgs[fd]);
+    auto const begun = metrics::Histogram::Clock::now();
     work(msg);
+    if (_metrics) _metrics->handler.since(begun);
     if (msg.done()) {
       uint8_t* out = getOrCreateBufferFor(fd);
       size_t size = FORM_RESPONSE(msg, out);
@@ -176,6 +180,17 @@ class Server : public mkn::ram::tcp::SocketServer<uint8_t> {
       KEXCEPTION("FCGI Server cannot have less than one threads for accepting");
     if (workerThreads < 1) KEXCEPTION("FCGI Server cannot have less than one threads for working");
   }
+  Server(std::string const& path, uint8_t const& acceptThreads = 1,
+         uint8_t const& workerThreads = 1, uint32_t const& mode = _MKN_RAM_TCP_UNIX_MODE_)
+      : mkn::ram::tcp::SocketServer<uint8_t>(path, mode),
+        m_acceptThreads(acceptThreads),
+        m_workerThreads(workerThreads),
+        m_acceptPool(acceptThreads),
+        m_workerPool(workerThreads) {
+    if (acceptThreads < 1)
+      KEXCEPTION("FCGI Server cannot have less than one threads for accepting");
+    if (workerThreads < 1) KEXCEPTION("FCGI Server cannot have less than one threads for working");
+  }
 
   virtual ~Server() {
     m_acceptPool.stop();
@@ -0,0 +1,360 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_DNS_HPP_
+#define _MKN_RAM_DNS_HPP_
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "mkn/kul/log.hpp"
+
+#ifndef _MKN_RAM_DNS_TTL_
+#define _MKN_RAM_DNS_TTL_ 60  // seconds, 0 disables caching
+#endif                        /* _MKN_RAM_DNS_TTL_ */
+
+#ifndef _MKN_RAM_DNS_NEGATIVE_TTL_
+#define _MKN_RAM_DNS_NEGATIVE_TTL_ 5  // seconds to remember failed lookups
+#endif                                /* _MKN_RAM_DNS_NEGATIVE_TTL_ */
+
+#ifndef _MKN_RAM_DNS_REFRESH_
+#define _MKN_RAM_DNS_REFRESH_ 10  // seconds before expiry a hit triggers a background refresh
+#endif                            /* _MKN_RAM_DNS_REFRESH_ */
+
+#ifndef _MKN_RAM_DNS_THREADS_
+#define _MKN_RAM_DNS_THREADS_ 1
+#endif /* _MKN_RAM_DNS_THREADS_ */
+
+#ifndef _MKN_RAM_DNS_MAX_
+#define _MKN_RAM_DNS_MAX_ 1024  // cached hosts before expired entries are swept
+#endif                          /* _MKN_RAM_DNS_MAX_ */
+
+namespace mkn {
+namespace ram {
+namespace dns {
+
+struct Address {
+  struct sockaddr_storage addr;
+  socklen_t len = 0;
+  void port(uint16_t const& p) {
+    if (addr.ss_family == AF_INET6)
+      reinterpret_cast<struct sockaddr_in6&>(addr).sin6_port = htons(p);
+    else
+      reinterpret_cast<struct sockaddr_in&>(addr).sin_port = htons(p);
+  }
+};
+using Addresses = std::vector<Address>;
+
+// blocking getaddrinfo, results interleaved by family per RFC 8305
+inline int RESOLVE(std::string const& host, Addresses& addrs) {
+  struct addrinfo hints, *servinfo, *next;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+  int e = getaddrinfo(host.c_str(), NULL, &hints, &servinfo);
+  if (e != 0) return e;
+  Addresses v4, v6;
+  for (next = servinfo; next != NULL; next = next->ai_next) {
+    if (next->ai_family != AF_INET && next->ai_family != AF_INET6) continue;
+    Address a;
+    memcpy(&a.addr, next->ai_addr, next->ai_addrlen);
+    a.len = next->ai_addrlen;
+    (next->ai_family == AF_INET6 ? v6 : v4).push_back(a);
+  }
+  bool const v6First = servinfo && servinfo->ai_family == AF_INET6;
+  freeaddrinfo(servinfo);
+  auto& first = v6First ? v6 : v4;
+  auto& second = v6First ? v4 : v6;
+  addrs.clear();
+  for (size_t i = 0; i < first.size() || i < second.size(); i++) {
+    if (i < first.size()) addrs.push_back(first[i]);
+    if (i < second.size()) addrs.push_back(second[i]);
+  }
+  return addrs.empty() ? EAI_NONAME : 0;
+}
+
+class Resolver {
+ public:
+  using Callback = std::function<void(int const& error, Addresses const& addrs)>;
+  using Lookup = std::function<int(std::string const& host, Addresses& addrs)>;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+  struct Entry {
+    int error = 0;
+    bool pending = 0;
+    size_t blocked = 0;  // get() calls waiting on the lookup, pins the entry like waiters
+    Addresses addrs;
+    Clock::time_point expires;
+    std::vector<std::pair<uint16_t, Callback>> waiters;
+  };
+
+  bool m_stop = 0;
+  std::chrono::seconds m_ttl{_MKN_RAM_DNS_TTL_}, m_negative{_MKN_RAM_DNS_NEGATIVE_TTL_},
+      m_refresh{_MKN_RAM_DNS_REFRESH_};
+  Lookup const m_lookup;
+  std::mutex m_mutex;
+  std::condition_variable m_queued, m_resolved;
+  std::deque<std::string> m_queue;
+  std::vector<std::thread> m_threads;
+  std::unordered_map<std::string, Entry> m_cache;
+
+  static bool LITERAL(std::string const& host) {
+    unsigned char buf[sizeof(struct in6_addr)];
+    return inet_pton(AF_INET, host.c_str(), buf) == 1 ||
+           inet_pton(AF_INET6, host.c_str(), buf) == 1;
+  }
+  static void WITH_PORT(Addresses& addrs, uint16_t const& port) {
+    for (auto& a : addrs) a.port(port);
+  }
+
+  // m_mutex must be held, expired entries go first then those closest to expiry
+  Entry& entry(std::string const& host) {
+    auto it = m_cache.find(host);
+    if (it != m_cache.end()) return it->second;
+    if (m_cache.size() >= _MKN_RAM_DNS_MAX_) {
+      auto const now = Clock::now();
+      auto const idle = [](Entry const& e) {
+        return !e.pending && !e.blocked && e.waiters.empty();
+      };
+      for (auto i = m_cache.begin(); i != m_cache.end();)
+        if (idle(i->second) && i->second.expires <= now)
+          i = m_cache.erase(i);
+        else
+          ++i;
+      while (m_cache.size() >= _MKN_RAM_DNS_MAX_) {
+        auto oldest = m_cache.end();
+        for (auto i = m_cache.begin(); i != m_cache.end(); ++i)
+          if (idle(i->second) &&
+              (oldest == m_cache.end() || i->second.expires < oldest->second.expires))
+            oldest = i;
+        if (oldest == m_cache.end()) break;
+        m_cache.erase(oldest);
+      }
+    }
+    return m_cache[host];
+  }
+  // m_mutex must be held
+  bool refresh(Entry const& e, Clock::time_point const& now) const {
+    return !e.error && e.expires - now < m_refresh;
+  }
+
+  // m_mutex must be held
+  void schedule(std::string const& host, Entry& e) {
+    if (e.pending) return;
+    e.pending = 1;
+    if (m_threads.empty())
+      for (size_t i = 0; i < _MKN_RAM_DNS_THREADS_; i++)
+        m_threads.emplace_back([this]() { work(); });
+    m_queue.push_back(host);
+    m_queued.notify_one();
+  }
+
+  // error and addrs become what is served, a last good answer if the lookup failed
+  void store(std::string const& host, int& error, Addresses& addrs) {
+    std::vector<std::pair<uint16_t, Callback>> waiters;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto& e = entry(host);
+      e.pending = 0;
+      bool const stale = error && !e.error && !e.addrs.empty();
+      if (stale) {  // serve the last good answer while the resolver is failing
+        error = 0;
+        addrs = e.addrs;
+      } else {
+        e.error = error;
+        e.addrs = addrs;
+      }
+      e.expires = Clock::now() + (error || stale ? m_negative : m_ttl);
+      waiters.swap(e.waiters);
+    }
+    m_resolved.notify_all();
+    for (auto& w : waiters) {
+      auto copy(addrs);
+      WITH_PORT(copy, w.first);
+      w.second(error, copy);
+    }
+  }
+
+  void work() {
+    while (true) {
+      std::string host;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_queued.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+        if (m_stop) return;
+        host = m_queue.front();
+        m_queue.pop_front();
+      }
+      Addresses addrs;
+      int error = m_lookup(host, addrs);
+      if (error) KLOG(DBG) << "DNS lookup failed: " << host << " - " << gai_strerror(error);
+      store(host, error, addrs);
+    }
+  }
+
+ public:
+  explicit Resolver(Lookup const& lookup = RESOLVE) : m_lookup(lookup) {}
+  ~Resolver() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = 1;
+    }
+    m_queued.notify_all();
+    for (auto& t : m_threads) t.join();
+  }
+  static Resolver& INSTANCE() {
+    static Resolver i;
+    return i;
+  }
+
+  Resolver& ttl(uint32_t const& positive, uint32_t const& negative,
+                uint32_t const& refresh = _MKN_RAM_DNS_REFRESH_) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ttl = std::chrono::seconds(positive);
+    m_negative = std::chrono::seconds(negative);
+    m_refresh = std::chrono::seconds(refresh);
+    return *this;
+  }
+  size_t size() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cache.size();
+  }
+  void clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_cache.begin(); it != m_cache.end();)
+      if (it->second.pending || it->second.blocked)
+        ++it;
+      else
+        it = m_cache.erase(it);
+  }
+
+  // blocking, concurrent misses on the same host share one lookup
+  int get(std::string const& host, uint16_t const& port, Addresses& addrs) {
+    addrs.clear();
+    if (m_ttl.count() == 0 || LITERAL(host)) {
+      int const error = m_lookup(host, addrs);
+      if (!error) WITH_PORT(addrs, port);
+      return error;
+    }
+    bool lookup = 0;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      auto now = Clock::now();
+      auto& e = entry(host);
+      if (e.expires > now) {
+        if (refresh(e, now)) schedule(host, e);
+        addrs = e.addrs;
+        WITH_PORT(addrs, port);
+        return e.error;
+      }
+      if (e.pending) {
+        e.blocked++;
+        m_resolved.wait(lock, [&]() { return !e.pending || m_stop; });
+        e.blocked--;
+        addrs = e.addrs;
+        WITH_PORT(addrs, port);
+        return e.pending ? EAI_AGAIN : e.error;
+      }
+      e.pending = lookup = 1;
+    }
+    int error = 0;
+    if (lookup) {
+      error = m_lookup(host, addrs);
+      store(host, error, addrs);
+      if (!error) WITH_PORT(addrs, port);
+    }
+    return error;
+  }
+
+  // non-blocking, cb is invoked inline on a fresh hit or from a resolver thread otherwise
+  void async(std::string const& host, uint16_t const& port, Callback const& cb) {
+    Addresses addrs;
+    int error = 0;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto now = Clock::now();
+      auto& e = entry(host);
+      if (e.expires <= now || m_ttl.count() == 0) {
+        e.waiters.emplace_back(port, cb);
+        schedule(host, e);
+        return;
+      }
+      if (refresh(e, now)) schedule(host, e);
+      error = e.error;
+      addrs = e.addrs;
+    }
+    WITH_PORT(addrs, port);
+    cb(error, addrs);
+  }
+
+  // non-blocking, true if a fresh answer is cached, otherwise a lookup is started
+  bool peek(std::string const& host, uint16_t const& port, Addresses& addrs) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& e = entry(host);
+    if (e.expires <= Clock::now() || e.error) {
+      if (e.expires <= Clock::now()) schedule(host, e);
+      return false;
+    }
+    addrs = e.addrs;
+    WITH_PORT(addrs, port);
+    return true;
+  }
+  void prefetch(std::string const& host) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& e = entry(host);
+    if (e.expires <= Clock::now()) schedule(host, e);
+  }
+};
+
+}  // namespace dns
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_DNS_HPP_ */
@@ -35,16 +35,24 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef _MKN_RAM_HTTP_HPP_
 #define _MKN_RAM_HTTP_HPP_
 
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
 #include "mkn/kul/map.hpp"
 #include "mkn/kul/string.hpp"
+#include "mkn/ram/http/date.hpp"
+#include "mkn/ram/http/headers.hpp"
+#include "mkn/ram/http/query.hpp"
 #include "mkn/ram/tcp.hpp"
 
 namespace mkn {
 namespace ram {
 namespace http {
 
-typedef std::unordered_map<std::string, std::string> Headers;
-
 class Exception : public mkn::kul::Exception {
  public:
   Exception(char const* f, uint16_t const& l, std::string const& s)
@@ -99,20 +107,24 @@ class Message {
   std::string _b = "";
 
  public:
-  void header(std::string const& k, std::string const& v) { this->_hs[k] = v; }
+  void header(std::string const& k, std::string const& v) { this->_hs.set(k, v); }
+  void header(HeaderID const& id, std::string_view const& v) { this->_hs.set(id, v); }
   Headers const& headers() const { return _hs; }
   void body(std::string const& b) { this->_b = b; }
   std::string const& body() const { return _b; }
-  bool header(std::string const& s) const { return _hs.count(s); }
+  bool header(std::string const& s) const { return _hs.has(s); }
+  bool header(HeaderID const& id) const { return _hs.has(id); }
 };
 
 class KUL_PUBLISH _1_1Response : public Message {
  protected:
+  bool _defaults = 0;
   uint16_t _s = 200;
   std::string r = "OK";
-  Headers hs;
   mkn::kul::hash::map::S2T<Cookie> cs;
 
+  void appendDefaultHeaders(std::string& s) const;
+
  public:
   _1_1Response() {}
   _1_1Response(std::string const& b) { body(b); }
@@ -128,7 +140,7 @@ class KUL_PUBLISH _1_1Response : public Message {
   friend std::ostream& operator<<(std::ostream&, _1_1Response const&);
 
   _1_1Response& withHeaders(Headers const& heads) {
-    for (auto const& p : heads) header(p.first, p.second);
+    for (auto const& p : heads) _hs.set(p.first, p.second);
     return *this;
   }
   _1_1Response& withCookies(Cookies const& cooks) {
@@ -139,13 +151,15 @@ class KUL_PUBLISH _1_1Response : public Message {
     body(b);
     return *this;
   }
+  // Date, Connection, Content-Type and Content-Length unless set
+  //  written by toString from a cached block, not visible in headers()
   virtual _1_1Response& withDefaultHeaders() {
-    if (!header("Date")) header("Date", mkn::kul::DateTime::NOW());
-    if (!header("Connection")) header("Connection", "close");
-    if (!header("Content-Type")) header("Content-Type", "text/html");
-    if (!header("Content-Length")) header("Content-Length", std::to_string(body().size()));
+    _defaults = 1;
     return *this;
   }
+  bool defaultHeaders() const { return _defaults; }
+  // appends the Set-Cookie value for cookie k
+  static void SET_COOKIE(std::string& s, std::string const& k, Cookie const& c);
 
   static _1_1Response FROM_STRING(std::string&);
 };
@@ -154,11 +168,28 @@ inline std::ostream& operator<<(std::ostream& s, _1_1Response const& r) {
   return s << r.toString();
 }
 
+}  // namespace http
+namespace https {
+class Http2Client;
+}  // namespace https
+namespace http {
+
 class KUL_PUBLISH A1_1Request : public Message {
  protected:
   uint16_t _port;
-  std::string _ip, _host, _path;
-  mkn::kul::hash::map::S2S cs, atts;
+  int64_t _connectTimeout = _MKN_RAM_TCP_CONNECT_TIMEOUT_,
+          _readTimeout = _MKN_RAM_TCP_READ_TIMEOUT_, _totalTimeout = _MKN_RAM_TCP_TOTAL_TIMEOUT_;
+  std::string _ip, _host, _path, _query, _cookie;
+  mutable mkn::kul::hash::map::S2S cs;
+  mkn::kul::hash::map::S2S atts;
+  // offsets of name, '=' and end of each pair in _cookie, scanned on first lookup
+  //  offsets rather than views so copies of the request stay valid
+  mutable std::vector<std::array<uint32_t, 3>> _cookies;
+  mutable bool _cookiesScanned = 0, _cookiesCopied = 0;
+
+  // raw value of a received Cookie header, repeated headers are joined with "; "
+  void cookieHeader(std::string_view const& v);
+  void scanCookies() const;
   std::function<void(_1_1Response const&)> m_func;
 
   virtual void handleResponse(_1_1Response const& s) {
@@ -176,15 +207,35 @@ class KUL_PUBLISH A1_1Request : public Message {
   virtual std::string method() const = 0;
   virtual std::string toString() const = 0;
   void cookie(std::string const& k, std::string const& v) { this->cs.insert(k, v); }
-  mkn::kul::hash::map::S2S const& cookies() const { return cs; }
+  // copies every received cookie on first call, prefer cookie(k) to read a few
+  mkn::kul::hash::map::S2S const& cookies() const;
+  // value of cookie k, empty if absent, valid while the request lives
+  std::string_view cookie(std::string_view const& k) const;
+  // true if any cookie was received or set, without parsing them
+  bool hasCookies() const { return !_cookie.empty() || !cs.empty(); }
   A1_1Request& attribute(std::string const& k, std::string const& v) {
     atts[k] = v;
     return *this;
   }
   mkn::kul::hash::map::S2S const& attributes() const { return atts; }
   virtual void send() KTHROW(mkn::ram::http::Exception);
+  // what COMPLETE has learned of a growing response, so each call scans only new bytes
+  struct Completion {
+    size_t scanned = 0, body = 0, length = 0;  // body is 0 until the headers end
+    bool sized = 0;
+  };
+  // true once data holds a full response with a Content-Length, otherwise read until close
+  static bool COMPLETE(char const* const data, size_t const& size, Completion& c);
+  static bool COMPLETE(char const* const data, size_t const& size) {
+    Completion c;
+    return COMPLETE(data, size, c);
+  }
   std::string const& host() const { return _host; }
   std::string const& path() const { return _path; }
+  // raw query string of a received request, without the '?'
+  std::string const& query() const { return _query; }
+  // lazily parsed view of query(), see mkn::ram::http::Query
+  Query queryView() const { return Query(_query); }
   std::string const& ip() const { return _ip; }
   uint16_t const& port() const { return _port; }
   virtual std::string version() const { return "HTTP/1.1"; }
@@ -193,17 +244,26 @@ class KUL_PUBLISH A1_1Request : public Message {
     return *this;
   }
   A1_1Request& withHeaders(Headers const& heads) {
-    for (auto const& p : heads) header(p.first, p.second);
+    for (auto const& p : heads) _hs.set(p.first, p.second);
     return *this;
   }
   A1_1Request& withCookies(Headers const& cooks) {
-    for (auto const& p : cooks) cookie(p.first, p.second);
+    for (auto const& p : cooks) cookie(std::string(p.first), std::string(p.second));
     return *this;
   }
   A1_1Request& withBody(std::string const& b) {
     body(b);
     return *this;
   }
+  // milliseconds, <= 0 for no limit, see mkn::ram::tcp::ASocket::timeouts
+  A1_1Request& withTimeouts(int64_t const& connect, int64_t const& read, int64_t const& total = 0) {
+    _connectTimeout = connect;
+    _readTimeout = read;
+    _totalTimeout = total;
+    return *this;
+  }
+  friend class AServer;
+  friend class mkn::ram::https::Http2Client;
 };
 
 class KUL_PUBLISH _1_1GetRequest : public A1_1Request {
@@ -227,23 +287,89 @@ class KUL_PUBLISH _1_1PostRequest : public A1_1Request {
 };
 using Post = _1_1PostRequest;
 
+// Content-Encoding codings, Identity is always available
+//  others need _MKN_RAM_INCLUDE_ZLIB_ or _MKN_RAM_INCLUDE_ZSTD_, see mkn/ram/http/compress.hpp
+enum class Encoding : uint8_t { Identity = 0, Deflate, Gzip, Zstd, MAX };
+
+class AccessLog;
+class Admission;
+class Cache;
+class Compressor;
+namespace co {
+class Driver;
+}  // namespace co
+namespace h2 {
+class Connection;
+struct Stream;
+}  // namespace h2
+namespace ws {
+class Connection;
+}  // namespace ws
+namespace sse {
+class Sink;
+}  // namespace sse
+namespace form {
+class Parser;
+struct Part;
+}  // namespace form
+
 class KUL_PUBLISH AServer : public mkn::ram::tcp::SocketServer<char> {
  protected:
+  struct Static {
+    struct Variant {
+      std::shared_ptr<std::string const> bytes;
+      size_t date = 0;  // offset of the Date value to refresh, 0 for none
+      size_t body = 0;  // body bytes, for the access log
+      uint16_t status = 0;
+    };
+    std::string method, path;
+    Variant variants[size_t(Encoding::MAX)];  // by Encoding, Identity always set
+    bool encoded = 0;
+  };
+  typedef std::vector<Static> Statics;  // sorted by path then method
+
   std::function<_1_1Response(A1_1Request const&)> m_func;
+  std::shared_ptr<Statics const> _statics;
+  std::mutex _staticsMutex;
+  std::shared_ptr<Cache> _cache;
+  std::shared_ptr<Compressor> _compressor;
+  std::shared_ptr<Admission> _admission;
+  std::shared_ptr<AccessLog> _accessLog;
+  std::string _metricsPath;
+  bool _http2 = 0;
+  std::unordered_map<int, std::shared_ptr<h2::Connection>> _h2;  // by fd
+  std::mutex _h2Mutex;
+  struct WebSocket {
+    std::function<void(ws::Connection&, std::string_view const&, bool const&)> onMessage;
+    std::function<void(std::shared_ptr<ws::Connection> const&, A1_1Request const&)> onOpen;
+  };
+  std::unordered_map<std::string, WebSocket> _webSockets;         // by path
+  std::unordered_map<int, std::shared_ptr<ws::Connection>> _ws;  // by fd
+  std::mutex _wsMutex;
+  std::unordered_map<std::string,
+                     std::function<void(std::shared_ptr<sse::Sink> const&, A1_1Request const&)>>
+      _events;                                               // by path
+  std::unordered_map<int, std::shared_ptr<sse::Sink>> _sse;  // by fd
+  std::vector<int> _sseReady;                                // fds with something to write
+  int64_t _sseScan = 0;
+  std::mutex _sseMutex;
+  typedef std::function<void(A1_1Request const&, form::Part const&, std::string_view const&,
+                             bool const&)>
+      FormFile;
+  struct Form {
+    std::shared_ptr<A1_1Request> req;
+    std::unique_ptr<form::Parser> parser;
+    size_t remaining;
+  };
+  std::unordered_map<std::string, FormFile> _forms;      // by path
+  std::unordered_map<int, std::shared_ptr<Form>> _form;  // by fd, bodies still arriving
+  std::mutex _formMutex;
+  std::shared_ptr<co::Driver> _tasks;
+  std::vector<int> _tasksDone;  // fds with the response of their handler written
+  std::mutex _tasksMutex;
 
-  void asAttributes(std::string a, mkn::kul::hash::map::S2S& atts) {
-    if (a.size() > 0) {
-      if (a[0] == '?') a = a.substr(1);
-      std::vector<std::string> bits;
-      mkn::kul::String::SPLIT(a, '&', bits);
-      for (std::string const& p : bits) {
-        if (p.find("=") != std::string::npos) {
-          std::vector<std::string> bits = mkn::kul::String::SPLIT(p, '=');
-          atts[bits[0]] = bits[1];
-        } else
-          atts[p] = "";
-      }
-    }
+  void asAttributes(std::string const& a, mkn::kul::hash::map::S2S& atts) {
+    for (auto const& p : Query(a)) atts[Query::DECODE(p.first)] = Query::DECODE(p.second);
   }
 
   virtual std::shared_ptr<A1_1Request> handleRequest(int const& fd, std::string const& b,
@@ -252,8 +378,84 @@ class KUL_PUBLISH AServer : public mkn::ram::tcp::SocketServer<char> {
   virtual void handleBuffer(std::map<int, uint8_t>& fds, int const& fd, char* in, int const& read,
                             int& e);
 
+  // matches the request line against registered static responses
+  //  out views the bytes to write in order, the head, the current date and the rest
+  //   v is set to the matched variant, its bytes keep them alive while writing
+  bool staticResponse(char const* in, size_t const& read, Static::Variant& v,
+                      std::string_view (&out)[3]) const;
+  // writes the parts from staticResponse without joining them
+  int writeStatic(int const& fd, std::string_view const (&parts)[3]);
+
+  // respond, through the cache if one is set, timed and counted when metrics are recorded
+  //  the metrics path is answered here with the registry's text
+  _1_1Response response(A1_1Request const& req);
+  _1_1Response produce(A1_1Request const& req);
+  // counts and logs a response that took so long to produce
+  void record(A1_1Request const& req, _1_1Response const& res,
+              std::chrono::nanoseconds const& took);
+  // access logs a response written without parsing the request, static or refused
+  //  method and path are taken from the request line in in
+  void record(int const& fd, char const* in, size_t const& read, uint16_t const& status,
+              size_t const& bytes, std::chrono::nanoseconds const& took);
+
+  // the HTTP/2 connection on fd, nullptr for HTTP/1.1
+  std::shared_ptr<h2::Connection> http2(int const& fd);
+  std::shared_ptr<h2::Connection> http2Start(int const& fd);
+  // feeds fd's HTTP/2 connection, starting one on a client preface, false for HTTP/1.1
+  //  out collects the bytes to write, e is set as for handleBuffer
+  bool handleHttp2(int const& fd, char const* in, size_t const& read, std::string& out, int& e);
+  // answers "Upgrade: h2c" with 101 then the response as stream 1, false if not asked for
+  bool upgradeHttp2(int const& fd, A1_1Request const& req, std::string& out);
+  void respondHttp2(int const& fd, h2::Connection& c, uint32_t const& id, A1_1Request const& req);
+
+  // the WebSocket on fd, nullptr if none
+  std::shared_ptr<ws::Connection> webSocket(int const& fd);
+  // feeds fd's WebSocket, false if fd has none, e is set as for handleBuffer
+  bool handleWebSocket(int const& fd, char const* in, size_t const& read, int& e);
+  // writes 101 for a WebSocket upgrade of a registered path, false if not asked for
+  bool upgradeWebSocket(int const& fd, A1_1Request const& req);
+
+  // true if fd is an event stream, anything the client sends on it is ignored
+  bool handleEvents(int const& fd, int& e);
+  // starts an event stream for a registered path, false if req is not for one
+  bool openEvents(int const& fd, A1_1Request const& req);
+  // writes pending events of fds' streams, and heartbeats about once a second
+  void flushEvents(std::map<int, uint8_t>& fds);
+
+  // feeds the rest of a form body on fd, false if none is arriving, e is set as for handleBuffer
+  bool handleForm(int const& fd, char const* in, size_t const& read, int& e);
+  // starts parsing a form POST to a registered path, true if more of the body is to come
+  //  out is set to the response if the whole body was in the first read
+  bool openForm(int const& fd, std::shared_ptr<A1_1Request> const& req, std::string& out);
+  // the response once a form body has been read, 400 if it was malformed
+  std::string formResponse(A1_1Request const& req, bool const& ok);
+
+  // true if fd's request is with a coroutine handler, anything the client sends on it is ignored
+  bool handleTask(int const& fd, int& e);
+  // starts the coroutine handler for req's path, false if there is none
+  bool openTask(int const& fd, std::shared_ptr<A1_1Request> const& req);
+  // resumes coroutine handlers, closing fds once their response is written
+  void flushTasks(std::map<int, uint8_t>& fds);
+
+  // true if reads on fd continue an HTTP/2 connection, WebSocket, form body or coroutine
+  //  handler rather than start a request, these are not subject to admission
+  bool streaming(int const& fd);
+  // for MultiServer, false if the request read on fd is refused, its 503 written
+  //  admitted is set if the request counts as in flight, see Admission::done
+  bool admit(int const& fd, char const* in, size_t const& read,
+             std::shared_ptr<Admission>& admitted);
+  // for MultiServer, true if an admitted request waited too long for a worker, its 503 written
+  bool late(int const& fd, char const* in, size_t const& read, Admission& admitted,
+            std::chrono::steady_clock::time_point const& queued);
+
+  virtual void loop(std::map<int, uint8_t>& fds) KTHROW(mkn::ram::tcp::Exception) override;
+
+  virtual void closeFDs(std::map<int, uint8_t>& fds, std::vector<int>& del) override;
+
  public:
   AServer(uint16_t const& p) : mkn::ram::tcp::SocketServer<char>(p) {}
+  AServer(std::string const& path, uint32_t const& mode = _MKN_RAM_TCP_UNIX_MODE_)
+      : mkn::ram::tcp::SocketServer<char>(path, mode) {}
   virtual ~AServer() {}
 
   AServer& withResponse(std::function<_1_1Response(A1_1Request const&)> const& func) {
@@ -261,6 +463,83 @@ class KUL_PUBLISH AServer : public mkn::ram::tcp::SocketServer<char> {
     return *this;
   }
 
+  // serialised once and written as is for matching requests, the query string is ignored
+  //  a Date header is refreshed on write, replacing an existing route swaps it atomically
+  //  with compression set, variants are compressed here once and chosen by Accept-Encoding
+  AServer& withStatic(std::string const& method, std::string const& path,
+                      _1_1Response const& res);
+  AServer& withoutStatic(std::string const& method, std::string const& path);
+
+  // HTTP/2 by ALPN on https::Server, otherwise by prior knowledge or "Upgrade: h2c"
+  AServer& withHttp2(bool const& on = 1) {
+    _http2 = on;
+    return *this;
+  }
+
+  // RFC 6455 upgrade of GET requests for path, as in the request line e.g. "/live"
+  //  onMessage gets each whole message, text or binary, on the connection's thread
+  //  onOpen may keep the connection to send from any thread, sends fail once it has closed
+  AServer& withWebSocket(
+      std::string const& path,
+      std::function<void(ws::Connection&, std::string_view const&, bool const&)> const& onMessage,
+      std::function<void(std::shared_ptr<ws::Connection> const&, A1_1Request const&)> const&
+          onOpen = nullptr) {
+    _webSockets[path] = WebSocket{onMessage, onOpen};
+    return *this;
+  }
+
+  // text/event-stream responses for GET requests to path, see mkn/ram/http/sse.hpp
+  //  onOpen gets the stream's sink to keep and send to from any thread
+  //  the server's loop writes queued events, so no thread is held per stream
+  AServer& withEvents(
+      std::string const& path,
+      std::function<void(std::shared_ptr<sse::Sink> const&, A1_1Request const&)> const& onOpen) {
+    _events[path] = onOpen;
+    return *this;
+  }
+
+  // multipart/form-data and x-www-form-urlencoded POSTs to path are parsed as they arrive
+  //  text fields become request attributes, file parts go to onFile in chunks as read
+  //  respond is called once the whole body has been parsed, see mkn/ram/http/form.hpp
+  AServer& withForm(std::string const& path, FormFile const& onFile = nullptr) {
+    _forms[path] = onFile;
+    return *this;
+  }
+
+  // see mkn/ram/http/cache.hpp, nullptr to disable
+  AServer& withCache(std::shared_ptr<Cache> const& cache) {
+    _cache = cache;
+    return *this;
+  }
+  // see mkn/ram/metrics.hpp, the registry is served as Prometheus text at path, empty for none
+  AServer& withMetrics(std::shared_ptr<metrics::Registry> const& registry,
+                       std::string const& path = "/metrics") {
+    mkn::ram::tcp::SocketServer<char>::withMetrics(registry);
+    _metricsPath = path;
+    return *this;
+  }
+  // see mkn/ram/http/admission.hpp, applied by MultiServer, nullptr to disable
+  AServer& withAdmission(std::shared_ptr<Admission> const& admission) {
+    _admission = admission;
+    return *this;
+  }
+  // see mkn/ram/http/access.hpp, a record per response, nullptr to disable
+  AServer& withAccessLog(std::shared_ptr<AccessLog> const& log) {
+    _accessLog = log;
+    return *this;
+  }
+  // coroutine handlers for HTTP/1.1 requests, see mkn/ram/http/co.hpp, nullptr to disable
+  AServer& withTasks(std::shared_ptr<co::Driver> const& tasks) {
+    _tasks = tasks;
+    return *this;
+  }
+  // see mkn/ram/http/compress.hpp, nullptr to disable
+  //  statics registered while set also store a precompressed variant per available coding
+  AServer& withCompression(std::shared_ptr<Compressor> const& compressor) {
+    _compressor = compressor;
+    return *this;
+  }
+
   virtual _1_1Response respond(A1_1Request const& req) {
     if (m_func) return m_func(req);
     KEXCEPTION("mkn::ram::http::AServer::respond - no response defined");
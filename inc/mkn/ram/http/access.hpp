@@ -0,0 +1,303 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_ACCESS_HPP_
+#define _MKN_RAM_HTTP_ACCESS_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "mkn/ram/http/def.hpp"
+
+namespace mkn {
+namespace ram {
+namespace http {
+
+// Access log off the request path, each thread pushes fixed size records to its own ring
+//  a writer thread formats them as JSON lines every _MKN_RAM_HTTP_ACCESS_FLUSH_ ms
+//  a full ring drops the record and counts it, the writer logs the count with the next batch
+//  path "-" writes to stdout, files rotate to path.1 .. path.keep past rotate bytes
+//  static responses and admission's 503s are logged too, method and path from the request line
+class AccessLog {
+ public:
+  typedef std::chrono::system_clock Clock;
+
+  struct Record {
+    int64_t time, took;  // nanoseconds since epoch, nanoseconds producing the response
+    uint64_t bytes;      // response body
+    uint16_t status, port, pathLen;
+    uint8_t methodLen, ipLen;
+    char method[8], ip[46], path[_MKN_RAM_HTTP_ACCESS_PATH_];
+  };
+
+ private:
+  static constexpr size_t RING = _MKN_RAM_HTTP_ACCESS_RING_;
+  static_assert(RING && !(RING & (RING - 1)), "_MKN_RAM_HTTP_ACCESS_RING_ must be a power of two");
+
+  // one producer thread, read by the writer
+  struct Ring {
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    std::array<Record, RING> records;
+  };
+
+  static uint64_t NEXT_ID() {
+    static std::atomic<uint64_t> id{0};
+    return ++id;
+  }
+
+  uint64_t const _id = NEXT_ID();
+  std::string const _path;
+  size_t const _rotate, _keep;
+  std::chrono::milliseconds const _flush;
+  std::FILE* _file = nullptr;
+  size_t _size = 0;
+  std::atomic<uint64_t> _written{0};
+  uint64_t _reported = 0;
+
+  std::mutex _mutex;
+  std::condition_variable _wake, _done;
+  uint64_t _requested = 0, _completed = 0;
+  bool _stop = 0;
+  std::unordered_map<std::thread::id, std::unique_ptr<Ring>> _rings;
+  std::thread _writer;
+
+  Ring& ring() {
+    thread_local struct {
+      uint64_t id = 0;
+      Ring* ring = nullptr;
+    } cache;
+    if (cache.id == _id) return *cache.ring;
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto& r = _rings[std::this_thread::get_id()];
+    if (!r) r = std::make_unique<Ring>();
+    cache.id = _id;
+    cache.ring = r.get();
+    return *r;
+  }
+
+  void open() {
+    if (_path == "-") return void(_file = stdout);
+    _file = std::fopen(_path.c_str(), "ab");
+    if (!_file) return;
+    std::fseek(_file, 0, SEEK_END);
+    _size = std::ftell(_file);
+  }
+  void rotate() {
+    if (_file == stdout || !_file) return;
+    std::fclose(_file);
+    _file = nullptr;
+    if (!_keep) std::remove(_path.c_str());
+    for (size_t i = _keep; i > 0; i--) {
+      auto const to = _path + "." + std::to_string(i);
+      std::remove(to.c_str());
+      auto const from = i > 1 ? _path + "." + std::to_string(i - 1) : _path;
+      std::rename(from.c_str(), to.c_str());
+    }
+    _size = 0;
+    open();
+  }
+
+  static void TIME(std::string& s, int64_t const& ns) {
+    thread_local std::time_t last = -1;
+    thread_local char stamp[24];  // 2024-01-31T23:59:59.
+    std::time_t const secs = ns / 1000000000;
+    if (secs != last) {
+      std::tm tm;
+#ifdef _WIN32
+      gmtime_s(&tm, &secs);
+#else
+      gmtime_r(&secs, &tm);
+#endif  // _WIN32
+      std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S.", &tm);
+      last = secs;
+    }
+    char ms[8];
+    std::snprintf(ms, sizeof(ms), "%03dZ", int(ns / 1000000 % 1000));
+    s.append(stamp).append(ms);
+  }
+  static void ESCAPE(std::string& s, char const* c, size_t const& n) {
+    for (size_t i = 0; i < n; i++) {
+      unsigned char const u = c[i];
+      if (u == '"' || u == '\\')
+        s.append(1, '\\').append(1, c[i]);
+      else if (u < 0x20) {
+        char hex[8];
+        std::snprintf(hex, sizeof(hex), "\\u%04x", u);
+        s.append(hex);
+      } else
+        s.append(1, c[i]);
+    }
+  }
+  static void FORMAT(std::string& s, Record const& r) {
+    char n[96];
+    s.append("{\"time\":\"");
+    TIME(s, r.time);
+    s.append("\",\"ip\":\"").append(r.ip, r.ipLen);
+    std::snprintf(n, sizeof(n), "\",\"port\":%u,\"method\":\"", unsigned(r.port));
+    s.append(n);
+    ESCAPE(s, r.method, r.methodLen);
+    s.append("\",\"path\":\"");
+    ESCAPE(s, r.path, r.pathLen);
+    std::snprintf(n, sizeof(n), "\",\"status\":%u,\"bytes\":%llu,\"us\":%.1f}\n",
+                  unsigned(r.status), (unsigned long long)r.bytes, double(r.took) / 1e3);
+    s.append(n);
+  }
+
+  void drain(std::vector<Ring*> const& rings, std::string& batch) {
+    uint64_t dropped = 0;
+    for (auto* r : rings) {
+      dropped += r->dropped.load(std::memory_order_relaxed);
+      auto const t = r->tail.load(std::memory_order_relaxed);
+      auto const h = r->head.load(std::memory_order_acquire);
+      for (auto i = t; i != h; i++) FORMAT(batch, r->records[i & (RING - 1)]);
+      r->tail.store(h, std::memory_order_release);
+      _written.fetch_add(h - t, std::memory_order_relaxed);
+    }
+    if (dropped != _reported) {
+      batch.append("{\"time\":\"");
+      TIME(batch, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      Clock::now().time_since_epoch())
+                      .count());
+      batch.append("\",\"dropped\":").append(std::to_string(dropped - _reported)).append("}\n");
+      _reported = dropped;
+    }
+    if (batch.empty() || !_file) return;
+    if (_size && _size + batch.size() > _rotate) rotate();
+    if (!_file) return;
+    std::fwrite(batch.data(), 1, batch.size(), _file);
+    std::fflush(_file);
+    _size += batch.size();
+  }
+
+  void operator()() {
+    std::string batch;
+    std::vector<Ring*> rings;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+      _wake.wait_for(lock, _flush, [&] { return _stop || _requested != _completed; });
+      auto const requested = _requested;
+      bool const stop = _stop;
+      rings.clear();
+      for (auto const& p : _rings) rings.push_back(p.second.get());
+      lock.unlock();
+      batch.clear();
+      drain(rings, batch);
+      lock.lock();
+      _completed = requested;
+      _done.notify_all();
+      if (stop) break;
+    }
+  }
+
+ public:
+  AccessLog(std::string const& path, size_t const& rotate = _MKN_RAM_HTTP_ACCESS_ROTATE_,
+            size_t const& keep = _MKN_RAM_HTTP_ACCESS_KEEP_,
+            int64_t const& flush = _MKN_RAM_HTTP_ACCESS_FLUSH_)
+      : _path(path), _rotate(rotate), _keep(keep), _flush(flush) {
+    open();
+    _writer = std::thread(&AccessLog::operator(), this);
+  }
+  ~AccessLog() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = 1;
+    }
+    _wake.notify_all();
+    _writer.join();
+    if (_file && _file != stdout) std::fclose(_file);
+  }
+  AccessLog(AccessLog const&) = delete;
+  AccessLog& operator=(AccessLog const&) = delete;
+
+  // false if this thread's ring is full and the record was dropped
+  bool push(std::string_view const& method, std::string_view const& path,
+            std::string_view const& ip, uint16_t const& port, uint16_t const& status,
+            uint64_t const& bytes, std::chrono::nanoseconds const& took) {
+    auto& r = ring();
+    auto const h = r.head.load(std::memory_order_relaxed);
+    if (h - r.tail.load(std::memory_order_acquire) >= RING) {
+      r.dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    auto& rec = r.records[h & (RING - 1)];
+    rec.time =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch())
+            .count();
+    rec.took = took.count();
+    rec.bytes = bytes;
+    rec.status = status;
+    rec.port = port;
+    rec.methodLen = uint8_t(std::min(method.size(), sizeof(rec.method)));
+    rec.ipLen = uint8_t(std::min(ip.size(), sizeof(rec.ip)));
+    rec.pathLen = uint16_t(std::min(path.size(), sizeof(rec.path)));
+    std::memcpy(rec.method, method.data(), rec.methodLen);
+    std::memcpy(rec.ip, ip.data(), rec.ipLen);
+    std::memcpy(rec.path, path.data(), rec.pathLen);
+    r.head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+  // blocks until records pushed before the call are written
+  void flush() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto const want = ++_requested;
+    _wake.notify_all();
+    _done.wait(lock, [&] { return _completed >= want; });
+  }
+  uint64_t dropped() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint64_t d = 0;
+    for (auto const& p : _rings) d += p.second->dropped.load(std::memory_order_relaxed);
+    return d;
+  }
+  uint64_t written() const { return _written.load(std::memory_order_relaxed); }
+  std::string const& path() const { return _path; }
+};
+
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_ACCESS_HPP_ */
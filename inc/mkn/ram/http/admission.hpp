@@ -0,0 +1,172 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_ADMISSION_HPP_
+#define _MKN_RAM_HTTP_ADMISSION_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "mkn/ram/http/def.hpp"
+
+namespace mkn {
+namespace ram {
+namespace http {
+
+// Load shedding for MultiServer, requests refused here get a prebuilt 503 with Retry-After
+//  admit on arrival: a limit on requests with workers, and optionally a token bucket per client
+//  late on leaving the queue: CoDel style, when the minimum queue delay over an interval is above
+//  target the queue is standing and requests waiting over twice target are shed
+//  regardless, requests waiting longer than the interval are shed
+class Admission {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+ private:
+  static constexpr size_t SHARDS = 16;
+  struct Bucket {
+    double tokens;
+    Clock::time_point last;
+  };
+  struct Shard {
+    std::mutex m;
+    std::unordered_map<std::string, Bucket> buckets;
+  };
+
+  size_t const _limit;
+  int64_t const _target, _interval;  // nanoseconds
+  std::string const _rejection;
+  double _rate = 0, _burst = 0;
+  std::atomic<size_t> _inFlight{0};
+  std::atomic<int64_t> _windowEnd{0}, _minDelay{0};
+  std::atomic<bool> _standing{0};
+  std::atomic<size_t> _shed{0};
+  Shard _shards[SHARDS];
+
+  static int64_t NANOS(Clock::time_point const& t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+  }
+
+  bool take(std::string const& ip) {
+    auto const now = Clock::now();
+    auto& sh = _shards[std::hash<std::string>()(ip) % SHARDS];
+    std::lock_guard<std::mutex> lock(sh.m);
+    auto it = sh.buckets.find(ip);
+    if (it == sh.buckets.end()) {
+      if (sh.buckets.size() >= _MKN_RAM_HTTP_ADMIT_IPS_ / SHARDS) {
+        for (auto b = sh.buckets.begin(); b != sh.buckets.end();)
+          if (refill(b->second, now) >= _burst)
+            b = sh.buckets.erase(b);
+          else
+            ++b;
+        if (sh.buckets.size() >= _MKN_RAM_HTTP_ADMIT_IPS_ / SHARDS) sh.buckets.clear();
+      }
+      it = sh.buckets.emplace(ip, Bucket{_burst, now}).first;
+    }
+    if (refill(it->second, now) < 1) return false;
+    it->second.tokens -= 1;
+    return true;
+  }
+  double refill(Bucket& b, Clock::time_point const& now) const {
+    double const elapsed = std::chrono::duration<double>(now - b.last).count();
+    b.tokens = std::min(_burst, b.tokens + elapsed * _rate);
+    b.last = now;
+    return b.tokens;
+  }
+
+ public:
+  Admission(size_t const& inFlight = _MKN_RAM_HTTP_ADMIT_IN_FLIGHT_,
+            int64_t const& target = _MKN_RAM_HTTP_ADMIT_TARGET_,
+            int64_t const& interval = _MKN_RAM_HTTP_ADMIT_INTERVAL_,
+            uint32_t const& retryAfter = _MKN_RAM_HTTP_ADMIT_RETRY_AFTER_)
+      : _limit(inFlight),
+        _target(target * 1000000),
+        _interval(interval * 1000000),
+        _rejection(
+            "HTTP/1.1 503 Service Unavailable\r\nRetry-After: " + std::to_string(retryAfter) +
+            "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n") {}
+  Admission(Admission const&) = delete;
+  Admission& operator=(Admission const&) = delete;
+
+  // requests per second a client address may make, with bursts of up to burst, 0 for no limit
+  Admission& perClient(double const& rate, double const& burst) {
+    _rate = rate;
+    _burst = std::max(burst, 1.0);
+    return *this;
+  }
+
+  // false to refuse the request, otherwise it counts as in flight until done
+  bool admit(std::string const& ip) {
+    size_t const n = _inFlight.fetch_add(1, std::memory_order_relaxed);
+    if ((_limit && n >= _limit) || (_rate > 0 && !take(ip))) {
+      _inFlight.fetch_sub(1, std::memory_order_relaxed);
+      ++_shed;
+      return false;
+    }
+    return true;
+  }
+
+  // true to shed an admitted request taken off the queue, done is still to be called
+  bool late(Clock::time_point const& queued) {
+    int64_t const now = NANOS(Clock::now()), delay = now - NANOS(queued);
+    int64_t end = _windowEnd.load(std::memory_order_relaxed);
+    if (now > end && _windowEnd.compare_exchange_strong(end, now + _interval)) {
+      _standing.store(_minDelay.exchange(delay) > _target, std::memory_order_relaxed);
+    } else {
+      int64_t min = _minDelay.load(std::memory_order_relaxed);
+      while (delay < min && !_minDelay.compare_exchange_weak(min, delay)) {
+      }
+    }
+    bool const shed =
+        delay > _interval || (_standing.load(std::memory_order_relaxed) && delay > 2 * _target);
+    if (shed) ++_shed;
+    return shed;
+  }
+
+  void done() { _inFlight.fetch_sub(1, std::memory_order_relaxed); }
+
+  size_t inFlight() const { return _inFlight.load(std::memory_order_relaxed); }
+  size_t shed() const { return _shed.load(std::memory_order_relaxed); }
+
+  // the whole 503 response, written as is and the connection closed
+  std::string_view rejection() const { return _rejection; }
+};
+
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_ADMISSION_HPP_ */
@@ -0,0 +1,286 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_CACHE_HPP_
+#define _MKN_RAM_HTTP_CACHE_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+#include "mkn/ram/http.hpp"
+#include "mkn/ram/http/def.hpp"
+
+namespace mkn {
+namespace ram {
+namespace http {
+
+// Response cache for GET/HEAD, keyed by method, path, query and the headers given to vary()
+//  freshness from the response Cache-Control s-maxage/max-age, or the default ttl
+//  no-store, no-cache, private and responses setting cookies are never stored
+//  requests with Authorization or cookies bypass the cache
+//  concurrent misses on one key share a single call to the response function, if what it
+//   returns may be stored, otherwise each waiter calls it for itself
+//  memory is split over independently locked shards, each evicting least recently used first
+class Cache {
+ public:
+  typedef std::function<_1_1Response(A1_1Request const&)> Responder;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+  struct Entry {
+    std::string key;
+    std::shared_ptr<_1_1Response const> res;
+    Clock::time_point expires;
+    size_t cost;
+  };
+  struct Flight {
+    std::mutex m;
+    std::condition_variable cv;
+    bool done = 0;
+    std::shared_ptr<_1_1Response const> res;
+    std::exception_ptr ex;
+  };
+  struct Shard {
+    std::mutex m;
+    std::list<Entry> lru;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> map;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+    size_t bytes = 0;
+  };
+
+  size_t const _budget;
+  int64_t const _ttl;
+  std::vector<std::unique_ptr<Shard>> _shards;
+  std::vector<std::string> _vary;
+
+  static bool HAS(std::string_view const& cc, std::string_view const& directive) {
+    for (size_t p = 0; (p = cc.find(directive, p)) != std::string_view::npos; p++) {
+      size_t const e = p + directive.size();
+      if ((p == 0 || cc[p - 1] == ',' || cc[p - 1] == ' ') &&
+          (e == cc.size() || cc[e] == ',' || cc[e] == ' ' || cc[e] == '='))
+        return true;
+    }
+    return false;
+  }
+  static int64_t SECONDS(std::string_view const& cc, std::string_view const& directive) {
+    for (size_t p = 0; (p = cc.find(directive, p)) != std::string_view::npos; p++) {
+      if (p && cc[p - 1] != ',' && cc[p - 1] != ' ') continue;
+      size_t i = p + directive.size();
+      if (i >= cc.size() || cc[i] != '=') continue;
+      int64_t v = 0;
+      for (i++; i < cc.size() && cc[i] >= '0' && cc[i] <= '9'; i++) v = v * 10 + (cc[i] - '0');
+      return v;
+    }
+    return -1;
+  }
+  static std::string LOWER(std::string_view const& s) {
+    std::string l(s);
+    for (auto& c : l)
+      if (c >= 'A' && c <= 'Z') c += 32;
+    return l;
+  }
+
+  // seconds to keep res, <= 0 to not store it
+  int64_t ttl(_1_1Response const& res) const {
+    if (!res.cookies().empty() || res.header(HeaderID::SetCookie)) return 0;
+    if (res.status() >= 500 || res.status() == 206) return 0;
+    auto const cc = LOWER(res.headers().get(HeaderID::CacheControl));
+    if (HAS(cc, "no-store") || HAS(cc, "no-cache") || HAS(cc, "private")) return 0;
+    int64_t age = SECONDS(cc, "s-maxage");
+    if (age < 0) age = SECONDS(cc, "max-age");
+    if (age >= 0) return age;
+    return res.status() == 200 ? _ttl : 0;
+  }
+
+  std::string key(A1_1Request const& req, std::string_view const& variant) const {
+    std::string k;
+    k.reserve(req.method().size() + req.path().size() + req.query().size() + variant.size() + 3);
+    k.append(req.method()).append(1, ' ').append(req.path()).append(1, '?').append(req.query());
+    k.append(1, '\0').append(variant);
+    for (auto const& v : _vary) k.append(1, '\0').append(req.headers().get(v));
+    return k;
+  }
+
+  Shard& shard(std::string const& k) const {
+    return *_shards[std::hash<std::string>()(k) % _shards.size()];
+  }
+
+  void store(Shard& sh, std::string const& k, std::shared_ptr<_1_1Response const> const& res,
+             int64_t const& ttl) {
+    size_t cost = sizeof(Entry) + sizeof(_1_1Response) + k.size() + res->body().size();
+    for (auto const& h : res->headers()) cost += h.first.size() + h.second.size();
+    size_t const budget = _budget / _shards.size();
+    if (cost > budget) return;
+    auto const it = sh.map.find(k);
+    if (it != sh.map.end()) {
+      sh.bytes -= it->second->cost;
+      sh.lru.erase(it->second);
+      sh.map.erase(it);
+    }
+    while (!sh.lru.empty() && sh.bytes + cost > budget) {
+      sh.bytes -= sh.lru.back().cost;
+      sh.map.erase(sh.lru.back().key);
+      sh.lru.pop_back();
+    }
+    sh.lru.push_front(Entry{k, res, Clock::now() + std::chrono::seconds(ttl), cost});
+    sh.map.emplace(sh.lru.front().key, sh.lru.begin());
+    sh.bytes += cost;
+  }
+
+ public:
+  Cache(size_t const& bytes = _MKN_RAM_HTTP_CACHE_BYTES_,
+        size_t const& shards = _MKN_RAM_HTTP_CACHE_SHARDS_,
+        int64_t const& ttl = _MKN_RAM_HTTP_CACHE_TTL_)
+      : _budget(bytes), _ttl(ttl) {
+    for (size_t i = 0; i < (shards ? shards : 1); i++) _shards.emplace_back(new Shard);
+  }
+  Cache(Cache const&) = delete;
+  Cache& operator=(Cache const&) = delete;
+
+  // request header to include in the key, e.g. Accept-Encoding
+  Cache& vary(std::string const& header) {
+    _vary.emplace_back(header);
+    return *this;
+  }
+
+  // variant is added to the key, e.g. the negotiated Content-Encoding
+  _1_1Response get(A1_1Request const& req, Responder const& respond,
+                   std::string_view const& variant = std::string_view()) {
+    auto const method = req.method();
+    if (method != "GET" && method != "HEAD") return respond(req);
+    if (req.header(HeaderID::Authorization) || req.header(HeaderID::Cookie) || req.hasCookies())
+      return respond(req);
+    auto const cc = LOWER(req.headers().get(HeaderID::CacheControl));
+    if (HAS(cc, "no-cache") || HAS(cc, "no-store")) return respond(req);
+
+    std::string const k(key(req, variant));
+    Shard& sh = shard(k);
+    std::shared_ptr<Flight> flight;
+    bool leader = 0;
+    {
+      std::lock_guard<std::mutex> lock(sh.m);
+      auto const it = sh.map.find(k);
+      if (it != sh.map.end()) {
+        if (it->second->expires > Clock::now()) {
+          sh.lru.splice(sh.lru.begin(), sh.lru, it->second);
+          return *sh.lru.front().res;
+        }
+        sh.bytes -= it->second->cost;
+        sh.lru.erase(it->second);
+        sh.map.erase(it);
+      }
+      auto& f = sh.flights[k];
+      if (!f) {
+        f = std::make_shared<Flight>();
+        leader = 1;
+      }
+      flight = f;
+    }
+    if (!leader) {
+      {
+        std::unique_lock<std::mutex> lock(flight->m);
+        flight->cv.wait(lock, [&] { return flight->done; });
+        if (flight->ex) std::rethrow_exception(flight->ex);
+        if (flight->res) return *flight->res;
+      }
+      return respond(req);
+    }
+
+    std::shared_ptr<_1_1Response const> res, shared;
+    std::exception_ptr ex;
+    try {
+      res = std::make_shared<_1_1Response const>(respond(req));
+    } catch (...) {
+      ex = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> lock(sh.m);
+      sh.flights.erase(k);
+      if (res) {
+        auto const t = ttl(*res);
+        if (t > 0) store(sh, k, shared = res, t);
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(flight->m);
+      flight->res = shared;
+      flight->ex = ex;
+      flight->done = 1;
+    }
+    flight->cv.notify_all();
+    if (ex) std::rethrow_exception(ex);
+    return *res;
+  }
+
+  // for AServer::withResponse when respond is not overridden
+  Responder wrap(Responder const& respond) {
+    return [this, respond](A1_1Request const& req) { return get(req, respond); };
+  }
+
+  void erase(A1_1Request const& req, std::string_view const& variant = std::string_view()) {
+    std::string const k(key(req, variant));
+    Shard& sh = shard(k);
+    std::lock_guard<std::mutex> lock(sh.m);
+    auto const it = sh.map.find(k);
+    if (it == sh.map.end()) return;
+    sh.bytes -= it->second->cost;
+    sh.lru.erase(it->second);
+    sh.map.erase(it);
+  }
+  void clear() {
+    for (auto& sh : _shards) {
+      std::lock_guard<std::mutex> lock(sh->m);
+      sh->map.clear();
+      sh->lru.clear();
+      sh->bytes = 0;
+    }
+  }
+  size_t bytes() const {
+    size_t b = 0;
+    for (auto const& sh : _shards) {
+      std::lock_guard<std::mutex> lock(sh->m);
+      b += sh->bytes;
+    }
+    return b;
+  }
+};
+
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_CACHE_HPP_ */
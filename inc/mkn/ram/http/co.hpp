@@ -0,0 +1,606 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_CO_HPP_
+#define _MKN_RAM_HTTP_CO_HPP_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "mkn/ram/http.hpp"
+
+#if defined(_MKN_RAM_HTTP_CO_)
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#endif  // _MKN_RAM_HTTP_CO_
+
+namespace mkn {
+namespace ram {
+namespace http {
+namespace co {
+
+// What AServer needs of a coroutine scheduler, so the server itself builds without C++20
+class Driver {
+ public:
+  // the handler's response to write, nullptr if it threw
+  typedef std::function<void(_1_1Response*)> Done;
+
+  virtual ~Driver() {}
+  // starts the handler for req's path on fd, false if there is none
+  virtual bool open(int const& fd, std::shared_ptr<A1_1Request> const& req, Done const& done) = 0;
+  // true from open until close for fd
+  virtual bool running(int const& fd) = 0;
+  // fd's connection is gone, an unfinished handler is destroyed on the next run
+  virtual void close(int const& fd) = 0;
+#ifndef _WIN32
+  // appends the fds handlers wait on, timeout is lowered to the next deadline
+  virtual void prepare(std::vector<struct pollfd>& pfds, int& timeout) = 0;
+  // the results of polling what prepare appended
+  virtual void polled(struct pollfd const* pfds, size_t const& n) = 0;
+#endif  // _WIN32
+  // resumes handlers that can continue, calling done for those that finish
+  virtual void run() = 0;
+};
+
+#if defined(_MKN_RAM_HTTP_CO_)
+
+namespace detail {
+
+template <class T>
+struct Result {
+  std::optional<T> value;
+  std::exception_ptr error;
+  void return_value(T v) { value.emplace(std::move(v)); }
+  T take() {
+    if (error) std::rethrow_exception(error);
+    return std::move(*value);
+  }
+};
+template <>
+struct Result<void> {
+  std::exception_ptr error;
+  void return_void() {}
+  void take() {
+    if (error) std::rethrow_exception(error);
+  }
+};
+
+// a finished task resumes whoever awaited it
+struct Final {
+  bool await_ready() const noexcept { return false; }
+  template <class P>
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+    auto const c = h.promise().continuation;
+    return c ? c : std::noop_coroutine();
+  }
+  void await_resume() const noexcept {}
+};
+
+}  // namespace detail
+
+// Lazy coroutine, runs once awaited or started by Tasks, destroying it destroys its frame
+template <class T = void>
+class Task {
+ public:
+  struct promise_type : detail::Result<T> {
+    std::coroutine_handle<> continuation;
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    detail::Final final_suspend() noexcept { return {}; }
+    void unhandled_exception() { this->error = std::current_exception(); }
+  };
+  typedef std::coroutine_handle<promise_type> Handle;
+
+  struct Awaiter {
+    Handle h;
+    bool await_ready() const noexcept { return !h || h.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> c) noexcept {
+      h.promise().continuation = c;
+      return h;
+    }
+    T await_resume() { return h.promise().take(); }
+  };
+
+ private:
+  Handle _h;
+  explicit Task(Handle const& h) : _h(h) {}
+
+ public:
+  Task(Task&& t) noexcept : _h(std::exchange(t._h, {})) {}
+  Task& operator=(Task&& t) noexcept {
+    if (this == &t) return *this;
+    if (_h) _h.destroy();
+    _h = std::exchange(t._h, {});
+    return *this;
+  }
+  Task(Task const&) = delete;
+  Task& operator=(Task const&) = delete;
+  ~Task() {
+    if (_h) _h.destroy();
+  }
+
+  Awaiter operator co_await() const noexcept { return Awaiter{_h}; }
+  bool done() const { return !_h || _h.done(); }
+  Handle const& handle() const { return _h; }
+};
+
+class Poll;
+class Resolve;
+template <class F>
+class Offload;
+
+// Coroutine handlers by path, resumed by the server's loop so none holds a thread while waiting
+//  handlers wait on fds and timers with the awaitables below, and run blocking work with
+//  OFFLOAD, which resumes them on the loop once done, see AServer::withTasks
+//  HTTP/1.1 only, HTTP/2 streams are answered by respond
+class Tasks : public Driver {
+  friend class Poll;
+  friend class Resolve;
+  template <class F>
+  friend class Offload;
+
+ public:
+  typedef std::chrono::steady_clock Clock;
+  typedef std::function<Task<_1_1Response>(A1_1Request const&)> Handler;
+
+ private:
+  struct Root {
+    int fd;
+    std::shared_ptr<A1_1Request> req;  // handlers may keep a reference to it
+    Done done;
+    Task<_1_1Response> task;
+  };
+  struct Wait {
+    uint64_t root;
+    std::coroutine_handle<> h;
+    int fd;  // -1 for a timer
+    short events, revents;
+    Clock::time_point deadline;
+    short* out;
+  };
+  struct Current {
+    Tasks* tasks = nullptr;
+    uint64_t root = 0;
+  };
+  typedef std::pair<uint64_t, std::coroutine_handle<>> Ready;  // by root
+  // handles to resume, posted from any thread, kept by work that may outlive the Tasks
+  struct Inbox {
+    std::mutex mutex;
+    std::vector<Ready> ready;
+    int wake[2] = {-1, -1};  // written to interrupt the loop's poll
+    ~Inbox() {
+      for (auto const& fd : wake)
+        if (fd >= 0) ::close(fd);
+    }
+    void post(uint64_t const& root, std::coroutine_handle<> const& h) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.emplace_back(root, h);
+      }
+      char const c = 0;
+      (void)!::write(wake[1], &c, 1);
+    }
+  };
+
+  std::unordered_map<std::string, Handler> _handlers;  // by path
+  size_t const _threads;
+  std::shared_ptr<Inbox> const _inbox = std::make_shared<Inbox>();
+
+  std::mutex _mutex;  // roots and fds, open and close come from any thread
+  uint64_t _next = 0;
+  std::unordered_map<uint64_t, std::unique_ptr<Root>> _roots;
+  std::unordered_map<int, uint64_t> _fds;
+  std::vector<uint64_t> _cancel;
+
+  std::mutex _loop;  // held by the loop for prepare, polled and run
+  std::vector<Wait> _waits;
+  std::vector<size_t> _polled;  // _waits appended by prepare
+
+  std::mutex _jobsMutex;
+  std::condition_variable _jobsCV;
+  std::deque<std::function<void()>> _jobs;
+  std::vector<std::thread> _workers;
+  bool _stop = 0;
+
+  static Current& CURRENT() {
+    thread_local Current c;
+    return c;
+  }
+  // the Tasks resuming the calling coroutine
+  static Current const& ACTIVE() {
+    auto const& c = CURRENT();
+    if (!c.tasks) KEXCEPTION("mkn::ram::http::co - awaited outside of a co::Tasks handler");
+    return c;
+  }
+
+  // _loop is held, called from an awaitable while run resumes
+  void wait(std::coroutine_handle<> const& h, int const& fd, short const& events,
+            Clock::time_point const& deadline, short* out) {
+    _waits.push_back(Wait{CURRENT().root, h, fd, events, 0, deadline, out});
+  }
+  void submit(std::function<void()>&& job) {
+    {
+      std::lock_guard<std::mutex> lock(_jobsMutex);
+      if (_workers.empty())
+        for (size_t i = 0; i < std::max(_threads, size_t(1)); i++)
+          _workers.emplace_back([this]() { work(); });
+      _jobs.push_back(std::move(job));
+    }
+    _jobsCV.notify_one();
+  }
+  void work() {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(_jobsMutex);
+        _jobsCV.wait(lock, [this]() { return _stop || !_jobs.empty(); });
+        if (_stop) return;
+        job = std::move(_jobs.front());
+        _jobs.pop_front();
+      }
+      job();
+    }
+  }
+
+  void resume(uint64_t const& id, std::coroutine_handle<> const& h) {
+    Root* root = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      auto const it = _roots.find(id);
+      if (it == _roots.end()) return;  // cancelled
+      root = it->second.get();
+    }
+    CURRENT() = Current{this, id};
+    h.resume();
+    CURRENT() = Current{};
+    if (!root->task.done()) return;
+    std::unique_ptr<Root> r;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      auto const it = _roots.find(id);
+      r = std::move(it->second);
+      _roots.erase(it);
+    }
+    try {
+      auto res = r->task.handle().promise().take();
+      r->done(&res);
+    } catch (mkn::kul::Exception const& e) {
+      KERR << e.stack();
+      r->done(nullptr);
+    } catch (std::exception const& e) {
+      KERR << e.what();
+      r->done(nullptr);
+    } catch (...) {
+      KERR << "mkn::ram::http::co - handler threw";
+      r->done(nullptr);
+    }
+  }
+  // _loop is held
+  void cancel(std::vector<uint64_t> const& ids) {
+    for (auto const& id : ids) {
+      _waits.erase(std::remove_if(_waits.begin(), _waits.end(),
+                                  [&](Wait const& w) { return w.root == id; }),
+                   _waits.end());
+      std::unique_ptr<Root> r;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto const it = _roots.find(id);
+        if (it == _roots.end()) continue;
+        r = std::move(it->second);
+        _roots.erase(it);
+      }
+    }
+  }
+
+ public:
+  Tasks(size_t const& threads = _MKN_RAM_HTTP_CO_THREADS_) : _threads(threads) {
+    if (::pipe(_inbox->wake) < 0) KEXCEPTION("mkn::ram::http::co::Tasks - pipe failed");
+    for (auto const& fd : _inbox->wake) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  }
+  ~Tasks() {
+    {
+      std::lock_guard<std::mutex> lock(_jobsMutex);
+      _stop = 1;
+    }
+    _jobsCV.notify_all();
+    for (auto& t : _workers) t.join();
+    _roots.clear();
+  }
+  Tasks(Tasks const&) = delete;
+  Tasks& operator=(Tasks const&) = delete;
+
+  // requests for path, as in the request line e.g. "/slow", are answered by handler
+  Tasks& route(std::string const& path, Handler const& handler) {
+    _handlers[path] = handler;
+    return *this;
+  }
+  // handlers started and not yet finished
+  size_t active() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _roots.size();
+  }
+
+  bool open(int const& fd, std::shared_ptr<A1_1Request> const& req, Done const& done) override {
+    auto const it = _handlers.find(req->path());
+    if (it == _handlers.end()) return false;
+    auto root = std::make_unique<Root>(Root{fd, req, done, it->second(*req)});
+    std::coroutine_handle<> const h = root->task.handle();
+    uint64_t id = 0;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      id = ++_next;
+      _roots.emplace(id, std::move(root));
+      _fds[fd] = id;
+    }
+    _inbox->post(id, h);
+    return true;
+  }
+  bool running(int const& fd) override {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _fds.count(fd);
+  }
+  void close(int const& fd) override {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto const it = _fds.find(fd);
+    if (it == _fds.end()) return;
+    if (_roots.count(it->second)) _cancel.push_back(it->second);
+    _fds.erase(it);
+  }
+  void prepare(std::vector<struct pollfd>& pfds, int& timeout) override {
+    std::lock_guard<std::mutex> lock(_loop);
+    pfds.push_back({_inbox->wake[0], POLLIN, 0});
+    _polled.clear();
+    auto const now = Clock::now();
+    auto next = Clock::time_point::max();
+    for (size_t i = 0; i < _waits.size(); i++) {
+      auto const& w = _waits[i];
+      next = std::min(next, w.deadline);
+      if (w.fd < 0) continue;
+      pfds.push_back({w.fd, w.events, 0});
+      _polled.push_back(i);
+    }
+    if (next == Clock::time_point::max()) return;
+    int64_t const ms =
+        next <= now ? 0 : std::chrono::ceil<std::chrono::milliseconds>(next - now).count();
+    if (timeout < 0 || ms < timeout) timeout = int(ms);
+  }
+  void polled(struct pollfd const* pfds, size_t const& n) override {
+    std::lock_guard<std::mutex> lock(_loop);
+    if (!n) return;
+    if (pfds[0].revents) {
+      char buf[64];
+      while (::read(_inbox->wake[0], buf, sizeof(buf)) > 0) {
+      }
+    }
+    for (size_t i = 1; i < n && i - 1 < _polled.size(); i++)
+      _waits[_polled[i - 1]].revents = pfds[i].revents;
+    _polled.clear();
+  }
+  void run() override {
+    std::lock_guard<std::mutex> lock(_loop);
+    std::vector<Ready> todo;
+    auto const now = Clock::now();
+    auto keep = _waits.begin();
+    for (auto const& w : _waits) {
+      if (w.revents || w.deadline <= now) {
+        *w.out = w.revents;
+        todo.emplace_back(w.root, w.h);
+      } else
+        *keep++ = w;
+    }
+    _waits.erase(keep, _waits.end());
+    while (true) {
+      std::vector<uint64_t> cancelled;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        cancelled.swap(_cancel);
+      }
+      {
+        std::lock_guard<std::mutex> lock(_inbox->mutex);
+        todo.insert(todo.end(), _inbox->ready.begin(), _inbox->ready.end());
+        _inbox->ready.clear();
+      }
+      cancel(cancelled);
+      if (todo.empty()) break;
+      for (auto const& r : todo) resume(r.first, r.second);
+      todo.clear();
+    }
+  }
+};
+
+// Waits for events on fd until deadline, a timer if fd is -1, yields the revents, 0 on timeout
+class Poll {
+  int const _fd;
+  short const _events;
+  Tasks::Clock::time_point const _deadline;
+  short _revents = 0;
+
+ public:
+  Poll(int const fd, short const events, Tasks::Clock::time_point const& deadline)
+      : _fd(fd), _events(events), _deadline(deadline) {}
+  bool await_ready() const noexcept { return _fd < 0 && _deadline <= Tasks::Clock::now(); }
+  void await_suspend(std::coroutine_handle<> h) {
+    Tasks::ACTIVE().tasks->wait(h, _fd, _events, _deadline, &_revents);
+  }
+  short await_resume() const noexcept { return _revents; }
+};
+
+// deadline for a timeout in milliseconds, < 0 for none
+inline Tasks::Clock::time_point DEADLINE(int64_t const& timeout) {
+  if (timeout < 0) return Tasks::Clock::time_point::max();
+  return Tasks::Clock::now() + std::chrono::milliseconds(timeout);
+}
+
+inline Poll SLEEP(std::chrono::milliseconds const& ms) {
+  return Poll(-1, 0, Tasks::Clock::now() + ms);
+}
+inline Poll READABLE(int const fd, int64_t const timeout = -1) {
+  return Poll(fd, POLLIN, DEADLINE(timeout));
+}
+inline Poll WRITABLE(int const fd, int64_t const timeout = -1) {
+  return Poll(fd, POLLOUT, DEADLINE(timeout));
+}
+
+// Runs f on one of the Tasks' threads, the handler resumes on the loop with its result
+template <class F>
+class Offload {
+  typedef std::invoke_result_t<F> R;
+  F _f;
+  std::shared_ptr<detail::Result<R>> _s = std::make_shared<detail::Result<R>>();
+
+ public:
+  Offload(F&& f) : _f(std::move(f)) {}
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> h) {
+    auto const& c = Tasks::ACTIVE();
+    c.tasks->submit([f = std::move(_f), s = _s, inbox = c.tasks->_inbox, root = c.root,
+                     h]() mutable {
+      try {
+        if constexpr (std::is_void_v<R>)
+          f();
+        else
+          s->value.emplace(f());
+      } catch (...) {
+        s->error = std::current_exception();
+      }
+      inbox->post(root, h);
+    });
+  }
+  R await_resume() { return _s->take(); }
+};
+template <class F>
+Offload<std::decay_t<F>> OFFLOAD(F&& f) {
+  return Offload<std::decay_t<F>>(std::decay_t<F>(std::forward<F>(f)));
+}
+
+// Addresses for host with port, through dns::Resolver without blocking, empty on failure
+class Resolve {
+  struct State {
+    mkn::ram::dns::Addresses addrs;
+  };
+  std::string const _host;
+  uint16_t const _port;
+  std::shared_ptr<State> _s = std::make_shared<State>();
+
+ public:
+  Resolve(std::string const& host, uint16_t const port) : _host(host), _port(port) {}
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> h) {
+    auto const& c = Tasks::ACTIVE();
+    mkn::ram::dns::Resolver::INSTANCE().async(
+        _host, _port,
+        [s = _s, inbox = c.tasks->_inbox, root = c.root, h](
+            int const& error, mkn::ram::dns::Addresses const& a) {
+          if (!error) s->addrs = a;
+          inbox->post(root, h);
+        });
+  }
+  mkn::ram::dns::Addresses await_resume() { return std::move(_s->addrs); }
+};
+
+// Coroutines take their arguments by value, references would not outlive a suspension
+
+// bytes read into data, 0 once the peer has closed, < 0 on error or timeout in milliseconds
+inline Task<int> READ(int const fd, char* const data, size_t const size,
+                      int64_t const timeout = -1) {
+  auto const deadline = DEADLINE(timeout);
+  while (true) {
+    auto const r = ::recv(fd, data, size, MSG_DONTWAIT);
+    if (r >= 0) co_return int(r);
+    if (errno == EINTR) continue;
+    if (errno != EAGAIN && errno != EWOULDBLOCK) co_return -1;
+    if (!co_await Poll(fd, POLLIN, deadline)) co_return -1;
+  }
+}
+
+// writes all of data, size or < 0 on error or timeout in milliseconds
+inline Task<int> WRITE(int const fd, char const* const data, size_t const size,
+                       int64_t const timeout = -1) {
+  auto const deadline = DEADLINE(timeout);
+  size_t sent = 0;
+  while (sent < size) {
+    auto const w = ::send(fd, data + sent, size - sent, MSG_DONTWAIT | _MKN_RAM_TCP_SEND_FLAGS_);
+    if (w > 0) {
+      sent += w;
+      continue;
+    }
+    if (w < 0 && errno == EINTR) continue;
+    if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK) co_return -1;
+    if (!co_await Poll(fd, POLLOUT, deadline)) co_return -1;
+  }
+  co_return int(size);
+}
+
+// a connected non-blocking socket for the caller to close, < 0 on failure
+//  addresses are tried in turn within timeout in milliseconds
+inline Task<int> CONNECT(std::string const host, uint16_t const port,
+                         int64_t const timeout = -1) {
+  auto const deadline = DEADLINE(timeout);
+  auto const addrs = co_await Resolve(host, port);
+  for (auto const& a : addrs) {
+    struct Socket {
+      int fd;
+      ~Socket() {
+        if (fd >= 0) ::close(fd);
+      }
+    } s{::socket(a.addr.ss_family, SOCK_STREAM, IPPROTO_TCP)};
+    if (s.fd < 0) continue;
+    fcntl(s.fd, F_SETFL, fcntl(s.fd, F_GETFL, 0) | O_NONBLOCK);
+    bool ok = ::connect(s.fd, (struct sockaddr const*)&a.addr, a.len) == 0;
+    if (!ok && errno == EINPROGRESS && co_await Poll(s.fd, POLLOUT, deadline)) {
+      int err = 0;
+      socklen_t len = sizeof(err);
+      ok = getsockopt(s.fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && !err;
+    }
+    if (ok) co_return std::exchange(s.fd, -1);
+    if (Tasks::Clock::now() >= deadline) break;
+  }
+  co_return -1;
+}
+
+#endif  // _MKN_RAM_HTTP_CO_
+
+}  // namespace co
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_CO_HPP_ */
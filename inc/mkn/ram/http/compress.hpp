@@ -0,0 +1,299 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_COMPRESS_HPP_
+#define _MKN_RAM_HTTP_COMPRESS_HPP_
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include "mkn/ram/http.hpp"
+#include "mkn/ram/http/def.hpp"
+
+#ifdef _MKN_RAM_INCLUDE_ZLIB_
+#include <zlib.h>
+#endif  //_MKN_RAM_INCLUDE_ZLIB_
+
+#ifdef _MKN_RAM_INCLUDE_ZSTD_
+#include <zstd.h>
+#endif  //_MKN_RAM_INCLUDE_ZSTD_
+
+namespace mkn {
+namespace ram {
+namespace http {
+
+// Streaming compressor, feed body pieces to update and end with finish
+//  update with flush emits everything buffered so far, e.g. once per chunk of chunked output
+class Encoder {
+ private:
+  Encoding const _e;
+#ifdef _MKN_RAM_INCLUDE_ZLIB_
+  z_stream zs{};
+#endif  //_MKN_RAM_INCLUDE_ZLIB_
+#ifdef _MKN_RAM_INCLUDE_ZSTD_
+  ZSTD_CCtx* zc = nullptr;
+#endif  //_MKN_RAM_INCLUDE_ZSTD_
+
+#ifdef _MKN_RAM_INCLUDE_ZLIB_
+  void zlib(std::string_view const& in, std::string& out, int const& flush) {
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = uInt(in.size());
+    int rc = Z_OK;
+    do {
+      size_t const had = out.size();
+      out.resize(had + (std::max)(size_t(256), size_t(deflateBound(&zs, zs.avail_in))));
+      zs.next_out = reinterpret_cast<Bytef*>(&out[had]);
+      zs.avail_out = uInt(out.size() - had);
+      rc = deflate(&zs, flush);
+      out.resize(out.size() - zs.avail_out);
+      if (rc == Z_STREAM_ERROR) KEXCEPTION("mkn::ram::http::Encoder deflate failed");
+    } while (zs.avail_out == 0 || zs.avail_in || (flush == Z_FINISH && rc != Z_STREAM_END));
+  }
+#endif  //_MKN_RAM_INCLUDE_ZLIB_
+
+#ifdef _MKN_RAM_INCLUDE_ZSTD_
+  void zstd(std::string_view const& in, std::string& out, ZSTD_EndDirective const& mode) {
+    ZSTD_inBuffer ib{in.data(), in.size(), 0};
+    size_t left = 0;
+    do {
+      size_t const had = out.size();
+      out.resize(had + (std::max)(ZSTD_CStreamOutSize(), ZSTD_compressBound(ib.size - ib.pos)));
+      ZSTD_outBuffer ob{&out[had], out.size() - had, 0};
+      left = ZSTD_compressStream2(zc, &ob, &ib, mode);
+      out.resize(had + ob.pos);
+      if (ZSTD_isError(left)) KEXCEPTION("mkn::ram::http::Encoder zstd failed");
+    } while (ib.pos < ib.size || (mode != ZSTD_e_continue && left));
+  }
+#endif  //_MKN_RAM_INCLUDE_ZSTD_
+
+ public:
+  Encoder(Encoding const& e, int const& level = _MKN_RAM_HTTP_COMPRESS_LEVEL_) : _e(e) {
+    if (!AVAILABLE(e)) KEXCEPTION("mkn::ram::http::Encoder unavailable: " + std::string(NAME(e)));
+#ifdef _MKN_RAM_INCLUDE_ZLIB_
+    if (e == Encoding::Gzip || e == Encoding::Deflate)
+      if (deflateInit2(&zs, level, Z_DEFLATED, e == Encoding::Gzip ? 31 : 15, 8,
+                       Z_DEFAULT_STRATEGY) != Z_OK)
+        KEXCEPTION("mkn::ram::http::Encoder deflateInit2 failed");
+#endif  //_MKN_RAM_INCLUDE_ZLIB_
+#ifdef _MKN_RAM_INCLUDE_ZSTD_
+    if (e == Encoding::Zstd) {
+      zc = ZSTD_createCCtx();
+      ZSTD_CCtx_setParameter(zc, ZSTD_c_compressionLevel, level);
+    }
+#endif  //_MKN_RAM_INCLUDE_ZSTD_
+    (void)level;
+  }
+  ~Encoder() {
+#ifdef _MKN_RAM_INCLUDE_ZLIB_
+    if (_e == Encoding::Gzip || _e == Encoding::Deflate) deflateEnd(&zs);
+#endif  //_MKN_RAM_INCLUDE_ZLIB_
+#ifdef _MKN_RAM_INCLUDE_ZSTD_
+    if (zc) ZSTD_freeCCtx(zc);
+#endif  //_MKN_RAM_INCLUDE_ZSTD_
+  }
+  Encoder(Encoder const&) = delete;
+  Encoder& operator=(Encoder const&) = delete;
+
+  Encoding const& encoding() const { return _e; }
+
+  // appends compressed output for in to out
+  void update(std::string_view const& in, std::string& out, bool const& flush = false) {
+#ifdef _MKN_RAM_INCLUDE_ZLIB_
+    if (_e == Encoding::Gzip || _e == Encoding::Deflate)
+      return zlib(in, out, flush ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+#endif  //_MKN_RAM_INCLUDE_ZLIB_
+#ifdef _MKN_RAM_INCLUDE_ZSTD_
+    if (_e == Encoding::Zstd) return zstd(in, out, flush ? ZSTD_e_flush : ZSTD_e_continue);
+#endif  //_MKN_RAM_INCLUDE_ZSTD_
+    (void)flush;
+    out.append(in);
+  }
+  void finish(std::string& out) {
+#ifdef _MKN_RAM_INCLUDE_ZLIB_
+    if (_e == Encoding::Gzip || _e == Encoding::Deflate) return zlib("", out, Z_FINISH);
+#endif  //_MKN_RAM_INCLUDE_ZLIB_
+#ifdef _MKN_RAM_INCLUDE_ZSTD_
+    if (_e == Encoding::Zstd) return zstd("", out, ZSTD_e_end);
+#endif  //_MKN_RAM_INCLUDE_ZSTD_
+    (void)out;
+  }
+
+  static std::string_view NAME(Encoding const& e) {
+    switch (e) {
+      case Encoding::Deflate:
+        return "deflate";
+      case Encoding::Gzip:
+        return "gzip";
+      case Encoding::Zstd:
+        return "zstd";
+      default:
+        return "identity";
+    }
+  }
+  static bool AVAILABLE(Encoding const& e) {
+#ifdef _MKN_RAM_INCLUDE_ZLIB_
+    if (e == Encoding::Gzip || e == Encoding::Deflate) return true;
+#endif  //_MKN_RAM_INCLUDE_ZLIB_
+#ifdef _MKN_RAM_INCLUDE_ZSTD_
+    if (e == Encoding::Zstd) return true;
+#endif  //_MKN_RAM_INCLUDE_ZSTD_
+    return e == Encoding::Identity;
+  }
+};
+
+// Negotiated response compression, see AServer::withCompression
+//  bodies below the minimum size, non textual types, already encoded responses and responses
+//   with Cache-Control no-transform are left as is
+//  any response that could be compressed gets Vary: Accept-Encoding, even if sent as is
+class Compressor {
+ private:
+  int const _level;
+  size_t const _min;
+
+  static bool IEQUAL(std::string_view const& a, std::string_view const& b) {
+    return HeaderIDs::EQUAL(a, b);
+  }
+  static std::string_view TRIM(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+  }
+  static bool HAS(std::string_view const& s, std::string_view const& token) {
+    for (size_t i = 0; i + token.size() <= s.size(); i++)
+      if (IEQUAL(s.substr(i, token.size()), token)) return true;
+    return false;
+  }
+
+ public:
+  Compressor(int const& level = _MKN_RAM_HTTP_COMPRESS_LEVEL_,
+             size_t const& min = _MKN_RAM_HTTP_COMPRESS_MIN_)
+      : _level(level), _min(min) {}
+
+  int const& level() const { return _level; }
+
+  // best available coding by q-value from an Accept-Encoding value, ties prefer zstd then gzip
+  //  identity if explicitly weighted above every coding, or if nothing else is acceptable
+  static Encoding NEGOTIATE(std::string_view accept) {
+    float q[size_t(Encoding::MAX)] = {0}, star = -1;
+    bool seen[size_t(Encoding::MAX)] = {0};
+    while (!accept.empty()) {
+      size_t const c = (std::min)(accept.find(','), accept.size());
+      std::string_view item(accept.substr(0, c));
+      accept.remove_prefix((std::min)(c + 1, accept.size()));
+      float w = 1;
+      size_t const semi = item.find(';');
+      if (semi != std::string_view::npos) {
+        auto const p = TRIM(item.substr(semi + 1));
+        if (p.size() > 2 && (p[0] == 'q' || p[0] == 'Q') && p[1] == '=')
+          w = std::strtof(std::string(p.substr(2)).c_str(), nullptr);
+        item = item.substr(0, semi);
+      }
+      item = TRIM(item);
+      if (item == "*") {
+        star = w;
+        continue;
+      }
+      if (IEQUAL(item, "x-gzip")) item = "gzip";
+      for (size_t e = 0; e < size_t(Encoding::MAX); e++)
+        if (IEQUAL(item, Encoder::NAME(Encoding(e)))) {
+          q[e] = w;
+          seen[e] = 1;
+        }
+    }
+    Encoding best = Encoding::Identity;
+    float bq = 0;
+    for (auto const e : {Encoding::Zstd, Encoding::Gzip, Encoding::Deflate}) {
+      float const w = seen[size_t(e)] ? q[size_t(e)] : (star > 0 ? star : 0);
+      if (Encoder::AVAILABLE(e) && w > bq) {
+        best = e;
+        bq = w;
+      }
+    }
+    float const identity = seen[size_t(Encoding::Identity)] ? q[size_t(Encoding::Identity)]
+                                                           : (star > 0 ? star : 0);
+    return bq < identity ? Encoding::Identity : best;
+  }
+
+  static bool COMPRESSIBLE(std::string_view const& type) {
+    for (std::string_view const t :
+         {"text/", "application/json", "application/javascript", "application/xml",
+          "application/xhtml", "image/svg", "application/wasm"})
+      if (type.size() >= t.size() && IEQUAL(type.substr(0, t.size()), t)) return true;
+    return false;
+  }
+
+  std::string compress(Encoding const& e, std::string_view const& in) const {
+    std::string out;
+    Encoder enc(e, _level);
+    enc.update(in, out);
+    enc.finish(out);
+    return out;
+  }
+
+  // true if res would be compressed for some available coding
+  bool negotiable(_1_1Response const& res) const {
+    if (!Encoder::AVAILABLE(Encoding::Zstd) && !Encoder::AVAILABLE(Encoding::Gzip) &&
+        !Encoder::AVAILABLE(Encoding::Deflate))
+      return false;
+    if (res.body().size() < _min || res.header(HeaderID::ContentEncoding)) return false;
+    if (res.status() < 200 || res.status() == 204 || res.status() == 206 || res.status() == 304)
+      return false;
+    if (HAS(res.headers().get(HeaderID::CacheControl), "no-transform")) return false;
+    auto const type = res.headers().get(HeaderID::ContentType);
+    return type.empty() ? res.defaultHeaders() : COMPRESSIBLE(type);
+  }
+
+  // compresses res.body() in place, true if it did
+  bool apply(Encoding const& e, _1_1Response& res) const {
+    if (!negotiable(res)) return false;
+    auto const vary = res.headers().get(HeaderID::Vary);
+    if (vary.empty())
+      res.header(HeaderID::Vary, "Accept-Encoding");
+    else if (!HAS(vary, "Accept-Encoding") && vary != "*")
+      res.header(HeaderID::Vary, std::string(vary) + ", Accept-Encoding");
+    if (e == Encoding::Identity || !Encoder::AVAILABLE(e)) return false;
+    res.body(compress(e, res.body()));
+    res.header(HeaderID::ContentEncoding, Encoder::NAME(e));
+    if (res.header(HeaderID::ContentLength))
+      res.header(HeaderID::ContentLength, std::to_string(res.body().size()));
+    return true;
+  }
+  bool apply(A1_1Request const& req, _1_1Response& res) const {
+    return apply(NEGOTIATE(req.headers().get(HeaderID::AcceptEncoding)), res);
+  }
+};
+
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_COMPRESS_HPP_ */
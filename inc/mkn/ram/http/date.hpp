@@ -0,0 +1,99 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_DATE_HPP_
+#define _MKN_RAM_HTTP_DATE_HPP_
+
+#include <ctime>
+#include <string_view>
+
+namespace mkn {
+namespace ram {
+namespace http {
+
+class Date {
+ public:
+  static constexpr size_t SIZE = 29;
+  static_assert(SIZE == sizeof("Sun, 06 Nov 1994 08:49:37 GMT") - 1, "IMF-fixdate length");
+
+  // IMF-fixdate "Sun, 06 Nov 1994 08:49:37 GMT", out must hold SIZE bytes
+  static void FORMAT(std::time_t const& t, char* const out) {
+    static constexpr char const DAYS[] = "SunMonTueWedThuFriSat";
+    static constexpr char const MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    std::tm tm;
+#ifdef _WIN32
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+    auto two = [](char* const o, int const v) {
+      o[0] = char('0' + v / 10);
+      o[1] = char('0' + v % 10);
+    };
+    int const y = tm.tm_year + 1900;
+    for (size_t i = 0; i < 3; i++) out[i] = DAYS[tm.tm_wday * 3 + i];
+    out[3] = ',';
+    out[4] = ' ';
+    two(out + 5, tm.tm_mday);
+    out[7] = ' ';
+    for (size_t i = 0; i < 3; i++) out[8 + i] = MONTHS[tm.tm_mon * 3 + i];
+    out[11] = ' ';
+    two(out + 12, y / 100);
+    two(out + 14, y % 100);
+    out[16] = ' ';
+    two(out + 17, tm.tm_hour);
+    out[19] = ':';
+    two(out + 20, tm.tm_min);
+    out[22] = ':';
+    two(out + 23, tm.tm_sec);
+    out[25] = ' ';
+    out[26] = 'G';
+    out[27] = 'M';
+    out[28] = 'T';
+  }
+
+  // formatted at most once per second per thread, valid until the thread's next call
+  static std::string_view NOW() {
+    thread_local std::time_t last = -1;
+    thread_local char buf[SIZE];
+    std::time_t const now = std::time(0);
+    if (now != last) {
+      FORMAT(now, buf);
+      last = now;
+    }
+    return std::string_view(buf, SIZE);
+  }
+};
+
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_DATE_HPP_ */
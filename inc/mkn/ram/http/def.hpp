@@ -39,4 +39,117 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define _MKN_RAM_HTTP_SESSION_CHECK_ 10000  // milliseconds to sleep between checks
 #endif                                      /* _MKN_RAM_HTTP_SESSION_CHECK_ */
 
+#ifndef _MKN_RAM_HTTP_CACHE_BYTES_
+#define _MKN_RAM_HTTP_CACHE_BYTES_ 67108864  // memory budget of an http::Cache
+#endif                                       /* _MKN_RAM_HTTP_CACHE_BYTES_ */
+
+#ifndef _MKN_RAM_HTTP_CACHE_SHARDS_
+#define _MKN_RAM_HTTP_CACHE_SHARDS_ 16  // independently locked partitions of an http::Cache
+#endif                                  /* _MKN_RAM_HTTP_CACHE_SHARDS_ */
+
+#ifndef _MKN_RAM_HTTP_CACHE_TTL_
+#define _MKN_RAM_HTTP_CACHE_TTL_ 0  // seconds for responses without max-age, 0 to not cache them
+#endif                              /* _MKN_RAM_HTTP_CACHE_TTL_ */
+
+#ifndef _MKN_RAM_HTTP_COMPRESS_LEVEL_
+#define _MKN_RAM_HTTP_COMPRESS_LEVEL_ 6  // zlib/zstd compression level
+#endif                                   /* _MKN_RAM_HTTP_COMPRESS_LEVEL_ */
+
+#ifndef _MKN_RAM_HTTP_COMPRESS_MIN_
+#define _MKN_RAM_HTTP_COMPRESS_MIN_ 1024  // bytes, smaller bodies are sent as is
+#endif                                    /* _MKN_RAM_HTTP_COMPRESS_MIN_ */
+
+#ifndef _MKN_RAM_HTTP2_MAX_STREAMS_
+#define _MKN_RAM_HTTP2_MAX_STREAMS_ 128  // concurrent streams a peer may open
+#endif                                   /* _MKN_RAM_HTTP2_MAX_STREAMS_ */
+
+#ifndef _MKN_RAM_HTTP2_WINDOW_
+#define _MKN_RAM_HTTP2_WINDOW_ 1048576  // bytes, receive window per stream and per connection
+#endif                                  /* _MKN_RAM_HTTP2_WINDOW_ */
+
+#ifndef _MKN_RAM_HTTP2_MAX_FRAME_
+#define _MKN_RAM_HTTP2_MAX_FRAME_ 16384  // bytes, largest frame payload accepted
+#endif                                   /* _MKN_RAM_HTTP2_MAX_FRAME_ */
+
+#ifndef _MKN_RAM_HTTP2_HEADER_TABLE_
+#define _MKN_RAM_HTTP2_HEADER_TABLE_ 4096  // bytes, HPACK dynamic table size
+#endif                                     /* _MKN_RAM_HTTP2_HEADER_TABLE_ */
+
+#ifndef _MKN_RAM_HTTP2_MAX_HEADER_LIST_
+#define _MKN_RAM_HTTP2_MAX_HEADER_LIST_ 65536  // bytes, largest header block accepted
+#endif                                         /* _MKN_RAM_HTTP2_MAX_HEADER_LIST_ */
+
+#ifndef _MKN_RAM_HTTP2_MAX_BODY_
+#define _MKN_RAM_HTTP2_MAX_BODY_ 8388608  // bytes, larger request bodies reset the stream
+#endif                                    /* _MKN_RAM_HTTP2_MAX_BODY_ */
+
+#ifndef _MKN_RAM_HTTP_WS_MAX_MESSAGE_
+#define _MKN_RAM_HTTP_WS_MAX_MESSAGE_ 1048576  // bytes, larger WebSocket messages close with 1009
+#endif                                         /* _MKN_RAM_HTTP_WS_MAX_MESSAGE_ */
+
+#ifndef _MKN_RAM_HTTP_SSE_QUEUE_
+#define _MKN_RAM_HTTP_SSE_QUEUE_ 1048576  // bytes queued per event stream before it is closed
+#endif                                    /* _MKN_RAM_HTTP_SSE_QUEUE_ */
+
+#ifndef _MKN_RAM_HTTP_SSE_HEARTBEAT_
+#define _MKN_RAM_HTTP_SSE_HEARTBEAT_ 15000  // milliseconds idle before a comment is sent
+#endif                                      /* _MKN_RAM_HTTP_SSE_HEARTBEAT_ */
+
+#ifndef _MKN_RAM_HTTP_SSE_HISTORY_
+#define _MKN_RAM_HTTP_SSE_HISTORY_ 1024  // events an sse::Channel keeps for Last-Event-ID
+#endif                                   /* _MKN_RAM_HTTP_SSE_HISTORY_ */
+
+#ifndef _MKN_RAM_HTTP_FORM_FIELD_MAX_
+#define _MKN_RAM_HTTP_FORM_FIELD_MAX_ 65536  // bytes, larger form fields or part headers fail
+#endif                                       /* _MKN_RAM_HTTP_FORM_FIELD_MAX_ */
+
+#ifndef _MKN_RAM_HTTP_ADMIT_IN_FLIGHT_
+#define _MKN_RAM_HTTP_ADMIT_IN_FLIGHT_ 1024  // requests with workers, 0 for no limit
+#endif                                       /* _MKN_RAM_HTTP_ADMIT_IN_FLIGHT_ */
+
+#ifndef _MKN_RAM_HTTP_ADMIT_TARGET_
+#define _MKN_RAM_HTTP_ADMIT_TARGET_ 5  // milliseconds of queue delay tolerated while overloaded
+#endif                                 /* _MKN_RAM_HTTP_ADMIT_TARGET_ */
+
+#ifndef _MKN_RAM_HTTP_ADMIT_INTERVAL_
+#define _MKN_RAM_HTTP_ADMIT_INTERVAL_ 100  // milliseconds, window of the minimum queue delay
+#endif                                     /* _MKN_RAM_HTTP_ADMIT_INTERVAL_ */
+
+#ifndef _MKN_RAM_HTTP_ADMIT_RETRY_AFTER_
+#define _MKN_RAM_HTTP_ADMIT_RETRY_AFTER_ 1  // seconds, Retry-After of shed requests
+#endif                                      /* _MKN_RAM_HTTP_ADMIT_RETRY_AFTER_ */
+
+#ifndef _MKN_RAM_HTTP_ADMIT_IPS_
+#define _MKN_RAM_HTTP_ADMIT_IPS_ 65536  // client addresses tracked by token bucket
+#endif                                  /* _MKN_RAM_HTTP_ADMIT_IPS_ */
+
+#ifndef _MKN_RAM_HTTP_ACCESS_RING_
+#define _MKN_RAM_HTTP_ACCESS_RING_ 1024  // access log records buffered per thread, power of two
+#endif                                   /* _MKN_RAM_HTTP_ACCESS_RING_ */
+
+#ifndef _MKN_RAM_HTTP_ACCESS_PATH_
+#define _MKN_RAM_HTTP_ACCESS_PATH_ 192  // bytes of the request path kept per record
+#endif                                  /* _MKN_RAM_HTTP_ACCESS_PATH_ */
+
+#ifndef _MKN_RAM_HTTP_ACCESS_FLUSH_
+#define _MKN_RAM_HTTP_ACCESS_FLUSH_ 100  // milliseconds between access log writes
+#endif                                   /* _MKN_RAM_HTTP_ACCESS_FLUSH_ */
+
+#ifndef _MKN_RAM_HTTP_ACCESS_ROTATE_
+#define _MKN_RAM_HTTP_ACCESS_ROTATE_ 67108864  // bytes per access log file before rotating
+#endif                                         /* _MKN_RAM_HTTP_ACCESS_ROTATE_ */
+
+#ifndef _MKN_RAM_HTTP_ACCESS_KEEP_
+#define _MKN_RAM_HTTP_ACCESS_KEEP_ 5  // rotated access log files kept
+#endif                                /* _MKN_RAM_HTTP_ACCESS_KEEP_ */
+
+#if !defined(_MKN_RAM_HTTP_CO_) && !defined(_WIN32) && defined(__cpp_impl_coroutine) && \
+    __has_include(<coroutine>)
+#define _MKN_RAM_HTTP_CO_  // coroutine handlers, see mkn/ram/http/co.hpp
+#endif                     /* _MKN_RAM_HTTP_CO_ */
+
+#ifndef _MKN_RAM_HTTP_CO_THREADS_
+#define _MKN_RAM_HTTP_CO_THREADS_ 2  // threads running co::OFFLOAD work
+#endif                               /* _MKN_RAM_HTTP_CO_THREADS_ */
+
 #endif /* _MKN_RAM_HTTP_DEF_HPP_ */
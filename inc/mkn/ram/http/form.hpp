@@ -0,0 +1,77 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_FORM_HPP_
+#define _MKN_RAM_HTTP_FORM_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "mkn/ram/http/def.hpp"
+
+namespace mkn {
+namespace ram {
+namespace http {
+namespace form {
+
+// headers of the multipart part being read, filename is empty for text fields
+struct Part {
+  std::string name, filename, type;
+};
+
+// Incremental parser for multipart/form-data and application/x-www-form-urlencoded bodies
+//  feed bytes as they arrive, text fields are collected and given whole to onField
+//  file parts are passed to onFile in chunks as found, last is set on the final one
+class Parser {
+ public:
+  typedef std::function<void(std::string_view const& name, std::string_view const& value)> Field;
+  typedef std::function<void(Part const& part, std::string_view const& chunk, bool const& last)>
+      File;
+
+  virtual ~Parser() {}
+  // false on malformed input or a field over _MKN_RAM_HTTP_FORM_FIELD_MAX_, stop feeding
+  virtual bool feed(char const* data, size_t const& size) = 0;
+  // true if the body ended where it should
+  virtual bool finish() = 0;
+
+  // parser for the Content-Type value, nullptr if it is neither form type
+  static std::unique_ptr<Parser> FROM(std::string_view const& contentType, Field const& onField,
+                                      File const& onFile = nullptr);
+};
+
+}  // namespace form
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_FORM_HPP_ */
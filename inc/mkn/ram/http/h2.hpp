@@ -0,0 +1,184 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_H2_HPP_
+#define _MKN_RAM_HTTP_H2_HPP_
+
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+
+#include "mkn/ram/http/def.hpp"
+#include "mkn/ram/http/hpack.hpp"
+
+namespace mkn {
+namespace ram {
+namespace http {
+namespace h2 {
+
+// sent by clients before their first frame, and by prior knowledge h2c
+constexpr std::string_view PREFACE("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", 24);
+
+enum class Type : uint8_t {
+  Data = 0,
+  Headers,
+  Priority,
+  RstStream,
+  Settings,
+  PushPromise,
+  Ping,
+  GoAway,
+  WindowUpdate,
+  Continuation
+};
+
+enum class Error : uint32_t {
+  NoError = 0,
+  Protocol,
+  Internal,
+  FlowControl,
+  SettingsTimeout,
+  StreamClosed,
+  FrameSize,
+  RefusedStream,
+  Cancel,
+  Compression,
+  Connect,
+  EnhanceYourCalm,
+  InadequateSecurity,
+  Http11Required
+};
+
+struct Flags {
+  static constexpr uint8_t END_STREAM = 0x1, ACK = 0x1, END_HEADERS = 0x4, PADDED = 0x8,
+                           PRIORITY = 0x20;
+};
+
+struct Settings {
+  enum ID : uint16_t {
+    HEADER_TABLE_SIZE = 1,
+    ENABLE_PUSH,
+    MAX_CONCURRENT_STREAMS,
+    INITIAL_WINDOW_SIZE,
+    MAX_FRAME_SIZE,
+    MAX_HEADER_LIST_SIZE
+  };
+  uint32_t headerTableSize = 4096, enablePush = 1, maxConcurrentStreams = UINT32_MAX,
+           initialWindowSize = 65535, maxFrameSize = 16384, maxHeaderListSize = UINT32_MAX;
+};
+
+struct Stream {
+  uint32_t id;
+  hpack::Fields headers;  // received, request fields on a server and response fields on a client
+  std::string body;       // received
+  int64_t send, recv;     // flow control windows
+  std::string out;        // DATA held back by flow control
+  size_t sent = 0;
+  bool end = 0, remoteEnd = 0, localEnd = 0, submitted = 0;
+
+  Stream(uint32_t const& id, int64_t const& send, int64_t const& recv)
+      : id(id), send(send), recv(recv) {}
+  // first value of a field, empty if absent
+  std::string_view header(std::string_view const& name) const {
+    for (auto const& f : headers)
+      if (f.first == name) return f.second;
+    return std::string_view();
+  }
+};
+
+// One HTTP/2 connection, framing, HPACK and flow control without any transport
+//  bytes read are given to receive, bytes to write collect in output()
+//  the handler gets each stream once the peer ends it, a server answers with submit
+//  streams are released once both sides have ended, after the handler returns
+class Connection {
+ public:
+  enum class Role : uint8_t { Client, Server };
+  typedef std::function<void(Connection&, Stream&)> Handler;
+
+ private:
+  Role const _role;
+  Handler _handler;
+  Settings _local, _remote;
+  hpack::Decoder _decoder;
+  hpack::Encoder _encoder;
+  std::map<uint32_t, Stream> _streams;
+  std::string _in, _out, _block;
+  uint32_t _lastPeer = 0, _nextLocal, _blockStream = 0;
+  uint8_t _blockFlags = 0;
+  int64_t _send = 65535, _recv = 65535;
+  bool _preface, _settled = 0, _away = 0, _closed = 0, _dispatching = 0;
+
+  void frame(Type const& type, uint8_t const& flags, uint32_t const& id, std::string_view p = {});
+  Error settings(std::string_view const& p);
+  Error onFrame(Type const& type, uint8_t const& flags, uint32_t const& id, std::string_view p);
+  Error onData(uint8_t const& flags, uint32_t const& id, std::string_view p);
+  Error onHeaders();
+  Error onWindowUpdate(uint32_t const& id, std::string_view const& p);
+  Stream& open(uint32_t const& id);
+  void complete(Stream& s);
+  void flush();
+  void sweep();
+
+ public:
+  Connection(Role const& role, Handler const& handler);
+
+  // false once the connection is finished, write output() then close
+  bool receive(char const* data, size_t const& size);
+
+  // server side of "Upgrade: h2c", settings is the HTTP2-Settings value
+  //  the upgraded request becomes stream 1, answered with submit
+  bool upgrade(std::string_view const& settings);
+
+  // HEADERS then body as DATA, as much as the peer's windows allow, the rest follows updates
+  void submit(uint32_t const& id, hpack::Fields const& fields, std::string_view const& body,
+              bool const& end = 1);
+  // client, opens a stream for a request, 0 while the peer allows no more streams
+  uint32_t request(hpack::Fields const& fields, std::string_view const& body);
+
+  void reset(uint32_t const& id, Error const& e);
+  void goAway(Error const& e = Error::NoError);
+
+  std::string& output() { return _out; }
+  bool closed() const { return _closed || (_away && _streams.empty()); }
+  size_t streams() const { return _streams.size(); }
+  Stream* stream(uint32_t const& id) {
+    auto const it = _streams.find(id);
+    return it == _streams.end() ? nullptr : &it->second;
+  }
+  Settings const& remote() const { return _remote; }
+};
+
+}  // namespace h2
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_H2_HPP_ */
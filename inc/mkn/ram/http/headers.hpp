@@ -0,0 +1,494 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_HEADERS_HPP_
+#define _MKN_RAM_HTTP_HEADERS_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#ifndef _MKN_RAM_HTTP_HEADERS_INLINE_
+#define _MKN_RAM_HTTP_HEADERS_INLINE_ 16  // header entries before heap allocation
+#endif                                    /* _MKN_RAM_HTTP_HEADERS_INLINE_ */
+
+#ifndef _MKN_RAM_HTTP_HEADERS_ARENA_
+#define _MKN_RAM_HTTP_HEADERS_ARENA_ 512  // bytes of names/values before heap allocation
+#endif                                    /* _MKN_RAM_HTTP_HEADERS_ARENA_ */
+
+namespace mkn {
+namespace ram {
+namespace http {
+
+// alphabetical, detail::HEADER_FIRST relies on it
+enum class HeaderID : uint8_t {
+  Other = 0,
+  Accept,
+  AcceptEncoding,
+  AcceptLanguage,
+  AcceptRanges,
+  AccessControlAllowOrigin,
+  Age,
+  Allow,
+  Authorization,
+  CacheControl,
+  Connection,
+  ContentDisposition,
+  ContentEncoding,
+  ContentLanguage,
+  ContentLength,
+  ContentLocation,
+  ContentRange,
+  ContentType,
+  Cookie,
+  Date,
+  ETag,
+  Expect,
+  Expires,
+  Host,
+  IfMatch,
+  IfModifiedSince,
+  IfNoneMatch,
+  IfRange,
+  IfUnmodifiedSince,
+  KeepAlive,
+  LastModified,
+  Link,
+  Location,
+  Origin,
+  Pragma,
+  Range,
+  Referer,
+  RetryAfter,
+  Server,
+  SetCookie,
+  TE,
+  TransferEncoding,
+  Upgrade,
+  UserAgent,
+  Vary,
+  Via,
+  WWWAuthenticate,
+  XForwardedFor,
+  MAX
+};
+
+namespace detail {
+inline constexpr std::string_view HEADER_NAMES[] = {"",
+                                                    "Accept",
+                                                    "Accept-Encoding",
+                                                    "Accept-Language",
+                                                    "Accept-Ranges",
+                                                    "Access-Control-Allow-Origin",
+                                                    "Age",
+                                                    "Allow",
+                                                    "Authorization",
+                                                    "Cache-Control",
+                                                    "Connection",
+                                                    "Content-Disposition",
+                                                    "Content-Encoding",
+                                                    "Content-Language",
+                                                    "Content-Length",
+                                                    "Content-Location",
+                                                    "Content-Range",
+                                                    "Content-Type",
+                                                    "Cookie",
+                                                    "Date",
+                                                    "ETag",
+                                                    "Expect",
+                                                    "Expires",
+                                                    "Host",
+                                                    "If-Match",
+                                                    "If-Modified-Since",
+                                                    "If-None-Match",
+                                                    "If-Range",
+                                                    "If-Unmodified-Since",
+                                                    "Keep-Alive",
+                                                    "Last-Modified",
+                                                    "Link",
+                                                    "Location",
+                                                    "Origin",
+                                                    "Pragma",
+                                                    "Range",
+                                                    "Referer",
+                                                    "Retry-After",
+                                                    "Server",
+                                                    "Set-Cookie",
+                                                    "TE",
+                                                    "Transfer-Encoding",
+                                                    "Upgrade",
+                                                    "User-Agent",
+                                                    "Vary",
+                                                    "Via",
+                                                    "WWW-Authenticate",
+                                                    "X-Forwarded-For"};
+static_assert(std::size(HEADER_NAMES) == size_t(HeaderID::MAX), "HeaderID/NAMES mismatch");
+
+constexpr char HEADER_LOWER(char const c) { return (c >= 'A' && c <= 'Z') ? c + 32 : c; }
+
+// index of the first name per initial letter, names are alphabetical
+struct HeaderFirst {
+  uint8_t b[27] = {0};
+  constexpr HeaderFirst() {
+    size_t i = 1;
+    for (size_t c = 0; c < 26; c++) {
+      b[c] = uint8_t(i);
+      while (i < std::size(HEADER_NAMES) && size_t(HEADER_LOWER(HEADER_NAMES[i][0])) == 'a' + c)
+        i++;
+    }
+    b[26] = uint8_t(i);
+  }
+};
+inline constexpr HeaderFirst HEADER_FIRST{};
+}  // namespace detail
+
+class HeaderIDs {
+ public:
+  static bool EQUAL(std::string_view const& a, std::string_view const& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++)
+      if (detail::HEADER_LOWER(a[i]) != detail::HEADER_LOWER(b[i])) return false;
+    return true;
+  }
+  static constexpr std::string_view NAME(HeaderID const& id) {
+    return detail::HEADER_NAMES[size_t(id)];
+  }
+  // case insensitive, HeaderID::Other for unknown names
+  static HeaderID ID(std::string_view const& name) {
+    if (name.empty()) return HeaderID::Other;
+    char const c = detail::HEADER_LOWER(name[0]);
+    if (c < 'a' || c > 'z') return HeaderID::Other;
+    auto const& first = detail::HEADER_FIRST.b;
+    for (size_t i = first[c - 'a']; i < first[c - 'a' + 1]; i++)
+      if (EQUAL(detail::HEADER_NAMES[i], name)) return HeaderID(i);
+    return HeaderID::Other;
+  }
+};
+
+namespace detail {
+// growable buffer for trivially copyable T, the first N elements live inline
+template <class T, size_t N>
+class InlineBuffer {
+  static_assert(std::is_trivially_copyable<T>::value, "InlineBuffer requires trivial types");
+
+ private:
+  T _inl[N];
+  std::unique_ptr<T[]> _heap;
+  uint32_t _size = 0, _cap = N;
+
+ public:
+  InlineBuffer() {}
+  InlineBuffer(InlineBuffer const& that) { *this = that; }
+  InlineBuffer& operator=(InlineBuffer const& that) {
+    if (this == &that) return *this;
+    _size = 0;
+    append(that.data(), that.size());
+    return *this;
+  }
+  InlineBuffer(InlineBuffer&& that) { *this = std::move(that); }
+  InlineBuffer& operator=(InlineBuffer&& that) {
+    if (this == &that) return *this;
+    if (that._heap) {
+      _heap = std::move(that._heap);
+      _size = that._size;
+      _cap = that._cap;
+      that._cap = N;
+    } else {
+      _heap.reset();
+      _cap = N;
+      _size = 0;
+      append(that.data(), that.size());
+    }
+    that._size = 0;
+    return *this;
+  }
+  T* data() { return _heap ? _heap.get() : _inl; }
+  T const* data() const { return _heap ? _heap.get() : _inl; }
+  uint32_t size() const { return _size; }
+  void reserve(size_t const& cap) {
+    if (cap <= _cap) return;
+    size_t c = size_t(_cap) * 2;
+    if (c < cap) c = cap;
+    std::unique_ptr<T[]> heap(new T[c]);
+    std::memcpy(heap.get(), data(), _size * sizeof(T));
+    _heap = std::move(heap);
+    _cap = uint32_t(c);
+  }
+  void append(T const* const t, size_t const& n) {
+    reserve(_size + n);
+    if (n) std::memcpy(data() + _size, t, n * sizeof(T));
+    _size += uint32_t(n);
+  }
+  void push_back(T const& t) { append(&t, 1); }
+  void erase(size_t const& i) {
+    std::memmove(data() + i, data() + i + 1, (_size - i - 1) * sizeof(T));
+    _size--;
+  }
+  void clear() { _size = 0; }
+};
+}  // namespace detail
+
+// Insertion ordered header list with case insensitive lookup
+//  well known names are stored as a HeaderID, other names and all values live in one arena
+//  views handed out are invalidated by the next modification, but may be passed back in
+//  bytes left behind by overwritten and erased entries are compacted once they outweigh the rest
+//  formerly std::unordered_map<std::string, std::string>, operator[], insert(pair), emplace, find
+//  and at are kept for that, iteration yields pairs of std::string_view
+class Headers {
+ private:
+  struct Entry {
+    uint32_t k, v, vlen;
+    uint16_t klen;
+    HeaderID id;
+  };
+  detail::InlineBuffer<Entry, _MKN_RAM_HTTP_HEADERS_INLINE_> _es;
+  detail::InlineBuffer<char, _MKN_RAM_HTTP_HEADERS_ARENA_> _arena;
+  uint32_t _dead = 0;  // arena bytes no entry views
+
+  uint32_t store(std::string_view const& s) {
+    uint32_t const off = _arena.size();
+    _arena.append(s.data(), s.size());
+    return off;
+  }
+  // true if s views the arena, which growing it would free
+  bool within(std::string_view const& s) const {
+    char const* const b = _arena.data();
+    return !s.empty() && std::less_equal<char const*>()(b, s.data()) &&
+           std::less<char const*>()(s.data(), b + _arena.size());
+  }
+  std::string_view name(Entry const& e) const {
+    if (e.id != HeaderID::Other) return HeaderIDs::NAME(e.id);
+    return std::string_view(_arena.data() + e.k, e.klen);
+  }
+  std::string_view value(Entry const& e) const {
+    return std::string_view(_arena.data() + e.v, e.vlen);
+  }
+  // rewrites the arena with only the bytes entries view
+  void compact() {
+    detail::InlineBuffer<char, _MKN_RAM_HTTP_HEADERS_ARENA_> arena;
+    arena.reserve(_arena.size() - _dead);
+    Entry* es = _es.data();
+    for (size_t i = 0; i < _es.size(); i++) {
+      if (es[i].id == HeaderID::Other) {
+        uint32_t const k = arena.size();
+        arena.append(_arena.data() + es[i].k, es[i].klen);
+        es[i].k = k;
+      }
+      uint32_t const v = arena.size();
+      arena.append(_arena.data() + es[i].v, es[i].vlen);
+      es[i].v = v;
+    }
+    _arena = std::move(arena);
+    _dead = 0;
+  }
+  void reclaim(uint32_t const& dead) {
+    _dead += dead;
+    if (_dead > _arena.size() - _dead) compact();
+  }
+  Entry const* find(HeaderID const& id, std::string_view const& k) const {
+    Entry const* es = _es.data();
+    for (size_t i = 0; i < _es.size(); i++)
+      if (es[i].id == id && (id != HeaderID::Other || HeaderIDs::EQUAL(name(es[i]), k)))
+        return &es[i];
+    return nullptr;
+  }
+  void add(HeaderID const& id, std::string_view const& k, std::string_view const& v) {
+    if (id == HeaderID::Other && k.size() > UINT16_MAX)
+      throw std::length_error("mkn::ram::http::Headers name too long: " +
+                              std::to_string(k.size()));
+    if (within(k) || within(v)) {
+      std::string const copy = std::string(k).append(v);
+      std::string_view const c(copy);
+      return add(id, c.substr(0, k.size()), c.substr(k.size()));
+    }
+    Entry e;
+    e.id = id;
+    e.k = 0;
+    e.klen = 0;
+    if (id == HeaderID::Other) {
+      e.k = store(k);
+      e.klen = uint16_t(k.size());
+    }
+    e.v = store(v);
+    e.vlen = uint32_t(v.size());
+    _es.push_back(e);
+  }
+  void set(Entry const* const c, HeaderID const& id, std::string_view const& k,
+           std::string_view const& v) {
+    if (!c) return add(id, k, v);
+    Entry& e = _es.data()[c - _es.data()];
+    uint32_t dead = e.vlen;
+    if (v.size() <= e.vlen) {
+      std::memmove(_arena.data() + e.v, v.data(), v.size());
+      dead -= uint32_t(v.size());
+    } else if (within(v)) {
+      std::string const copy(v);
+      e.v = store(copy);
+    } else
+      e.v = store(v);
+    e.vlen = uint32_t(v.size());
+    reclaim(dead);
+  }
+  bool erase(Entry const* const e) {
+    if (!e) return false;
+    uint32_t const dead = e->vlen + (e->id == HeaderID::Other ? e->klen : 0);
+    _es.erase(e - _es.data());
+    reclaim(dead);
+    return true;
+  }
+
+ public:
+  class const_iterator {
+   private:
+    Headers const* hs;
+    size_t i;
+
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef std::pair<std::string_view, std::string_view> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef value_type const* pointer;
+    typedef value_type reference;
+    struct arrow {
+      value_type p;
+      value_type const* operator->() const { return &p; }
+    };
+    const_iterator(Headers const* hs, size_t const& i) : hs(hs), i(i) {}
+    value_type operator*() const {
+      Entry const& e = hs->_es.data()[i];
+      return value_type(hs->name(e), hs->value(e));
+    }
+    arrow operator->() const { return arrow{**this}; }
+    HeaderID id() const { return hs->_es.data()[i].id; }
+    const_iterator& operator++() {
+      i++;
+      return *this;
+    }
+    const_iterator operator++(int) { return const_iterator(hs, i++); }
+    bool operator==(const_iterator const& that) const { return i == that.i; }
+    bool operator!=(const_iterator const& that) const { return i != that.i; }
+  };
+
+  Headers() {}
+  Headers(std::initializer_list<std::pair<std::string_view, std::string_view>> const& hs) {
+    for (auto const& p : hs) set(p.first, p.second);
+  }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, _es.size()); }
+  size_t size() const { return _es.size(); }
+  bool empty() const { return _es.size() == 0; }
+  void clear() {
+    _es.clear();
+    _arena.clear();
+    _dead = 0;
+  }
+  // arena bytes held, including those awaiting compaction
+  size_t bytes() const { return _arena.size(); }
+
+  // replaces any existing value
+  void set(HeaderID const& id, std::string_view const& v) {
+    set(find(id, std::string_view()), id, HeaderIDs::NAME(id), v);
+  }
+  void set(std::string_view const& k, std::string_view const& v) {
+    auto const id = HeaderIDs::ID(k);
+    set(find(id, k), id, k, v);
+  }
+  // keeps any existing value, false if already present
+  bool insert(std::string_view const& k, std::string_view const& v) {
+    auto const id = HeaderIDs::ID(k);
+    if (find(id, k)) return false;
+    add(id, k, v);
+    return true;
+  }
+  // always appends, for repeatable headers like Set-Cookie
+  void append(std::string_view const& k, std::string_view const& v) { add(HeaderIDs::ID(k), k, v); }
+
+  bool has(HeaderID const& id) const { return find(id, std::string_view()); }
+  bool has(std::string_view const& k) const { return find(HeaderIDs::ID(k), k); }
+  size_t count(std::string_view const& k) const { return has(k); }
+
+  // empty view if missing
+  std::string_view get(HeaderID const& id) const {
+    auto const* e = find(id, std::string_view());
+    return e ? value(*e) : std::string_view();
+  }
+  std::string_view get(std::string_view const& k) const {
+    auto const* e = find(HeaderIDs::ID(k), k);
+    return e ? value(*e) : std::string_view();
+  }
+
+  bool erase(HeaderID const& id) { return erase(find(id, std::string_view())); }
+  bool erase(std::string_view const& k) { return erase(find(HeaderIDs::ID(k), k)); }
+
+  // map style access, prefer get/set
+  class Slot {
+   private:
+    Headers& _hs;
+    std::string const _k;
+
+   public:
+    Slot(Headers& hs, std::string_view const& k) : _hs(hs), _k(k) {}
+    Slot& operator=(std::string_view const& v) {
+      _hs.set(_k, v);
+      return *this;
+    }
+    operator std::string_view() const { return _hs.get(_k); }
+    operator std::string() const { return std::string(_hs.get(_k)); }
+  };
+  Slot operator[](std::string_view const& k) { return Slot(*this, k); }
+  bool insert(std::pair<std::string_view, std::string_view> const& p) {
+    return insert(p.first, p.second);
+  }
+  bool emplace(std::string_view const& k, std::string_view const& v) { return insert(k, v); }
+  const_iterator find(std::string_view const& k) const {
+    auto const* e = find(HeaderIDs::ID(k), k);
+    return e ? const_iterator(this, size_t(e - _es.data())) : end();
+  }
+  std::string_view at(std::string_view const& k) const {
+    auto const* e = find(HeaderIDs::ID(k), k);
+    if (!e) throw std::out_of_range("mkn::ram::http::Headers::at " + std::string(k));
+    return value(*e);
+  }
+};
+
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_HEADERS_HPP_ */
@@ -0,0 +1,144 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_HPACK_HPP_
+#define _MKN_RAM_HTTP_HPACK_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "mkn/ram/http.hpp"
+
+namespace mkn {
+namespace ram {
+namespace http {
+namespace hpack {
+
+// RFC 7541 header compression for HTTP/2, names are lowercase on the wire
+typedef std::pair<std::string, std::string> Field;
+typedef std::vector<Field> Fields;
+
+// dynamic table, newest entry first, sized as name + value + 32 per entry
+class Table {
+ private:
+  std::deque<Field> _entries;
+  size_t _size = 0, _max;
+
+  void evict(size_t const& want) {
+    while (!_entries.empty() && _size + want > _max) {
+      auto const& f = _entries.back();
+      _size -= f.first.size() + f.second.size() + OVERHEAD;
+      _entries.pop_back();
+    }
+  }
+
+ public:
+  static constexpr size_t OVERHEAD = 32;
+  static constexpr size_t STATIC = 61;
+
+  Table(size_t const& max = 4096) : _max(max) {}
+
+  size_t count() const { return _entries.size(); }
+  size_t size() const { return _size; }
+  size_t max() const { return _max; }
+  void max(size_t const& m) {
+    _max = m;
+    evict(0);
+  }
+  // an entry larger than the table empties it and is not stored
+  void insert(std::string_view const& name, std::string_view const& value) {
+    size_t const want = name.size() + value.size() + OVERHEAD;
+    evict(want);
+    if (want > _max) return;
+    _entries.emplace_front(std::string(name), std::string(value));
+    _size += want;
+  }
+  // 1 based, static entries first, nullptr when out of range
+  Field const* at(size_t const& i) const;
+  // 1 based index of name and value, or of name only with full false, 0 if absent
+  size_t find(std::string_view const& name, std::string_view const& value, bool& full) const;
+};
+
+class Decoder {
+ private:
+  Table _table;
+  size_t _limit;
+
+ public:
+  Decoder(size_t const& limit = 4096) : _table(limit), _limit(limit) {}
+  // upper bound for table size updates, the SETTINGS_HEADER_TABLE_SIZE sent to the peer
+  void limit(size_t const& l) { _limit = l; }
+  // decodes one complete header block, throws http::Exception on malformed input
+  //  max bounds the decoded list size, as name + value + 32 per field
+  void decode(std::string_view const& block, Fields& out, size_t const& max = SIZE_MAX)
+      KTHROW(Exception);
+};
+
+class Encoder {
+ private:
+  Table _table;
+  size_t _update = SIZE_MAX;
+
+ public:
+  // peer's SETTINGS_HEADER_TABLE_SIZE, signalled at the start of the next block
+  void limit(size_t const& l) {
+    if (l == _table.max()) return;
+    _table.max(l);
+    _update = l;
+  }
+  // appends one field, the first field of a block carries any pending table size update
+  //  sensitive fields (authorization, cookies) are never indexed
+  void encode(std::string_view const& name, std::string_view const& value, std::string& out);
+  void encode(Fields const& fields, std::string& out) {
+    for (auto const& f : fields) encode(f.first, f.second, out);
+  }
+};
+
+// RFC 7541 5.1 and 5.2 primitives
+void INTEGER(std::string& out, uint64_t v, uint8_t const& prefix, uint8_t const& flags);
+uint64_t INTEGER(char const*& p, char const* const e, uint8_t const& prefix) KTHROW(Exception);
+void STRING(std::string& out, std::string_view const& s);
+std::string STRING(char const*& p, char const* const e) KTHROW(Exception);
+
+// RFC 7541 Appendix B
+size_t HUFFMAN_SIZE(std::string_view const& s);
+void HUFFMAN_ENCODE(std::string& out, std::string_view const& s);
+void HUFFMAN_DECODE(std::string& out, std::string_view const& s) KTHROW(Exception);
+
+}  // namespace hpack
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_HPACK_HPP_ */
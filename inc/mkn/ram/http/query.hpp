@@ -0,0 +1,212 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_QUERY_HPP_
+#define _MKN_RAM_HTTP_QUERY_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace mkn {
+namespace ram {
+namespace http {
+
+namespace detail {
+inline int QUERY_HEX(char const c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// any of the 8 bytes at p is '%' or '+'
+inline bool QUERY_ESCAPED(char const* const p) {
+  constexpr uint64_t ones = 0x0101010101010101ull;
+  uint64_t v;
+  std::memcpy(&v, p, 8);
+  uint64_t const a = v ^ (ones * '%'), b = v ^ (ones * '+');
+  return (((a - ones) & ~a) | ((b - ones) & ~b)) & (ones * 0x80);
+}
+
+// offset of the first '%' or '+', or size
+inline size_t QUERY_FIRST_ESCAPE(char const* const data, size_t const& size) {
+  size_t i = 0;
+  for (; i + 8 <= size && !QUERY_ESCAPED(data + i); i += 8) {
+  }
+  for (; i < size && data[i] != '%' && data[i] != '+'; i++) {
+  }
+  return i;
+}
+
+// raw, still encoded, equals plain once decoded
+inline bool QUERY_EQUAL(std::string_view const& raw, std::string_view const& plain) {
+  size_t i = 0, j = 0;
+  for (; i < raw.size() && j < plain.size(); j++) {
+    char c = raw[i++];
+    if (c == '+')
+      c = ' ';
+    else if (c == '%' && i + 1 < raw.size()) {
+      int const h = QUERY_HEX(raw[i]), l = QUERY_HEX(raw[i + 1]);
+      if (h >= 0 && l >= 0) c = char(h << 4 | l), i += 2;
+    }
+    if (c != plain[j]) return false;
+  }
+  return i == raw.size() && j == plain.size();
+}
+}  // namespace detail
+
+// Lazily parsed view of "a=1&b=2", iterates raw (still encoded) key/value views
+//  nothing is parsed or allocated until asked, views are valid while the query string lives
+class Query {
+ public:
+  using value_type = std::pair<std::string_view, std::string_view>;
+
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::pair<std::string_view, std::string_view>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = value_type const*;
+    using reference = value_type const&;
+
+   private:
+    std::string_view _rest;
+    value_type _v;
+    bool _end = 1;
+
+    void next() {
+      while (!_rest.empty()) {
+        auto const amp = _rest.find('&');
+        auto const pair = _rest.substr(0, amp);
+        _rest = amp == std::string_view::npos ? std::string_view() : _rest.substr(amp + 1);
+        if (pair.empty()) continue;
+        auto const eq = pair.find('=');
+        _v.first = pair.substr(0, eq);
+        _v.second = eq == std::string_view::npos ? std::string_view() : pair.substr(eq + 1);
+        _end = 0;
+        return;
+      }
+      _end = 1;
+    }
+
+   public:
+    iterator() = default;
+    explicit iterator(std::string_view const& q) : _rest(q) { next(); }
+    reference operator*() const { return _v; }
+    pointer operator->() const { return &_v; }
+    iterator& operator++() {
+      next();
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator i(*this);
+      next();
+      return i;
+    }
+    bool operator==(iterator const& that) const {
+      return _end == that._end && (_end || _rest.data() == that._rest.data());
+    }
+    bool operator!=(iterator const& that) const { return !(*this == that); }
+  };
+
+  Query(std::string_view const& q = {}) : _q(q.size() && q[0] == '?' ? q.substr(1) : q) {}
+
+  iterator begin() const { return iterator(_q); }
+  iterator end() const { return iterator(); }
+  bool empty() const { return begin() == end(); }
+  std::string_view const& str() const { return _q; }
+
+  // raw value of the first pair whose decoded key is k, empty if absent
+  std::string_view operator[](std::string_view const& k) const {
+    std::string_view v;
+    find(k, v);
+    return v;
+  }
+  bool has(std::string_view const& k) const {
+    std::string_view v;
+    return find(k, v);
+  }
+  bool find(std::string_view const& k, std::string_view& v) const {
+    for (auto const& p : *this)
+      if (detail::QUERY_EQUAL(p.first, k)) {
+        v = p.second;
+        return true;
+      }
+    return false;
+  }
+  // decoded value of k, or fallback if absent
+  std::string get(std::string_view const& k, std::string_view const& fallback = {}) const {
+    std::string_view v;
+    return find(k, v) ? DECODE(v) : std::string(fallback);
+  }
+
+  // percent-decodes in place with '+' as space, malformed escapes are kept
+  //  returns the decoded size, which is never larger
+  static size_t DECODE(char* const data, size_t const& size) {
+    size_t i = detail::QUERY_FIRST_ESCAPE(data, size), o = i;
+    while (i < size) {
+      char const c = data[i];
+      if (c == '+') {
+        data[o++] = ' ', i++;
+        continue;
+      }
+      if (c == '%' && i + 2 < size) {
+        int const h = detail::QUERY_HEX(data[i + 1]), l = detail::QUERY_HEX(data[i + 2]);
+        if (h >= 0 && l >= 0) {
+          data[o++] = char(h << 4 | l), i += 3;
+          continue;
+        }
+      }
+      auto const n = c == '%' ? 1 : detail::QUERY_FIRST_ESCAPE(data + i, size - i);
+      std::memmove(data + o, data + i, n);
+      o += n, i += n;
+    }
+    return o;
+  }
+  static std::string DECODE(std::string_view const& s) {
+    std::string d(s);
+    if (detail::QUERY_FIRST_ESCAPE(s.data(), s.size()) < s.size())
+      d.resize(DECODE(&d[0], d.size()));
+    return d;
+  }
+
+ private:
+  std::string_view _q;
+};
+
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_QUERY_HPP_ */
@@ -0,0 +1,262 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_ROUTER_HPP_
+#define _MKN_RAM_HTTP_ROUTER_HPP_
+
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "mkn/ram/http.hpp"
+
+namespace mkn {
+namespace ram {
+namespace http {
+
+// Values of ":name" and "*name" segments for the matched route
+//  views into the router and the request path, valid for the duration of the handler
+class Params {
+ private:
+  std::vector<std::pair<std::string_view, std::string_view>> ps;
+
+ public:
+  Params() { ps.reserve(4); }
+  std::string_view operator[](std::string_view const& k) const {
+    for (auto const& p : ps)
+      if (p.first == k) return p.second;
+    return std::string_view();
+  }
+  bool has(std::string_view const& k) const {
+    for (auto const& p : ps)
+      if (p.first == k) return true;
+    return false;
+  }
+  size_t size() const { return ps.size(); }
+  auto begin() const { return ps.begin(); }
+  auto end() const { return ps.end(); }
+  friend class Router;
+};
+
+// Compressed prefix tree of routes, matching is linear in the path length
+//  "/user/:id"      -> params["id"]
+//  "/static/*file"  -> params["file"], wildcard must be last
+//  static segments win over parameters, parameters over wildcards
+// usable directly as a server response, keep the router alive for the server lifetime
+//  server.withResponse(std::ref(router));
+class Router {
+ public:
+  typedef std::function<_1_1Response(A1_1Request const&, Params const&)> Handler;
+
+ private:
+  struct Node {
+    std::string prefix, name;
+    std::vector<std::unique_ptr<Node>> kids;
+    std::unique_ptr<Node> param, wild;
+    std::vector<std::pair<std::string, Handler>> handlers;
+
+    Handler const* handler(std::string const& method) const {
+      for (auto const& p : handlers)
+        if (p.first == method) return &p.second;
+      return nullptr;
+    }
+  };
+  Node root;
+  Handler notFound, notAllowed;
+
+  static size_t COMMON(std::string_view const& a, std::string_view const& b) {
+    size_t i = 0, max = (std::min)(a.size(), b.size());
+    while (i < max && a[i] == b[i]) i++;
+    return i;
+  }
+
+  static Node* STATIC(Node* n, std::string_view s) {
+    while (!s.empty()) {
+      std::unique_ptr<Node>* kid = nullptr;
+      for (auto& k : n->kids)
+        if (k->prefix[0] == s[0]) kid = &k;
+      if (!kid) {
+        n->kids.emplace_back(std::make_unique<Node>());
+        n->kids.back()->prefix = std::string(s);
+        return n->kids.back().get();
+      }
+      size_t const l = COMMON((*kid)->prefix, s);
+      if (l < (*kid)->prefix.size()) {
+        auto split = std::make_unique<Node>();
+        split->prefix = (*kid)->prefix.substr(0, l);
+        (*kid)->prefix.erase(0, l);
+        split->kids.emplace_back(std::move(*kid));
+        *kid = std::move(split);
+      }
+      n = kid->get();
+      s.remove_prefix(l);
+    }
+    return n;
+  }
+
+  // before the tree is touched, so a bad pattern leaves no nodes behind
+  static void VALIDATE(std::string const& pattern) {
+    if (pattern.empty() || pattern[0] != '/')
+      KEXCEPT(Exception, "Route must start with '/': " + pattern);
+    for (size_t s = pattern.find_first_of(":*"); s != std::string::npos;) {
+      size_t const e = (std::min)(pattern.find('/', s), pattern.size());
+      if (e == s + 1) KEXCEPT(Exception, "Unnamed route parameter: " + pattern);
+      if (pattern[s] == '*') {
+        if (e != pattern.size())
+          KEXCEPT(Exception, "Route wildcard must be the last segment: " + pattern);
+        break;
+      }
+      s = pattern.find_first_of(":*", e);
+    }
+  }
+
+  static Node* NAMED(std::unique_ptr<Node>& slot, std::string_view const& name,
+                     std::string const& pattern) {
+    if (!slot) {
+      slot = std::make_unique<Node>();
+      slot->name = std::string(name);
+    } else if (slot->name != name)
+      KEXCEPT(Exception, "Route parameter conflicts with :" + slot->name + " in " + pattern);
+    return slot.get();
+  }
+
+  static bool MATCH(Node const* n, std::string_view const& path, std::string const& method,
+                    Params& ps, Handler const*& h, bool& allow) {
+    if (path.empty()) {
+      if (!n->handlers.empty()) {
+        if ((h = n->handler(method))) return true;
+        allow = true;
+      }
+    } else {
+      for (auto const& k : n->kids)
+        if (k->prefix[0] == path[0]) {
+          if (path.compare(0, k->prefix.size(), k->prefix) == 0 &&
+              MATCH(k.get(), path.substr(k->prefix.size()), method, ps, h, allow))
+            return true;
+          break;
+        }
+      if (n->param) {
+        size_t const e = (std::min)(path.find('/'), path.size());
+        if (e) {
+          ps.ps.emplace_back(n->param->name, path.substr(0, e));
+          if (MATCH(n->param.get(), path.substr(e), method, ps, h, allow)) return true;
+          ps.ps.pop_back();
+        }
+      }
+    }
+    if (n->wild && !n->wild->handlers.empty()) {
+      if ((h = n->wild->handler(method))) {
+        ps.ps.emplace_back(n->wild->name, path);
+        return true;
+      }
+      allow = true;
+    }
+    return false;
+  }
+
+ public:
+  Router() {
+    notFound = [](A1_1Request const&, Params const&) {
+      _1_1Response r;
+      r.status(404);
+      r.reason("Not Found");
+      return r.withBody("Not Found").withDefaultHeaders();
+    };
+    notAllowed = [](A1_1Request const&, Params const&) {
+      _1_1Response r;
+      r.status(405);
+      r.reason("Method Not Allowed");
+      return r.withBody("Method Not Allowed").withDefaultHeaders();
+    };
+  }
+  Router(Router const&) = delete;
+  Router& operator=(Router const&) = delete;
+
+  Router& add(std::string const& method, std::string const& pattern, Handler const& handler) {
+    VALIDATE(pattern);
+    Node* n = &root;
+    std::string_view p(pattern);
+    while (!p.empty()) {
+      size_t const s = p.find_first_of(":*");
+      n = STATIC(n, p.substr(0, s));
+      if (s == std::string_view::npos) break;
+      p.remove_prefix(s);
+      if (p[0] == '*') {
+        n = NAMED(n->wild, p.substr(1), pattern);
+        break;
+      }
+      size_t const e = (std::min)(p.find('/'), p.size());
+      n = NAMED(n->param, p.substr(1, e - 1), pattern);
+      p.remove_prefix(e);
+    }
+    if (n->handler(method)) KEXCEPT(Exception, "Route already defined: " + method + " " + pattern);
+    n->handlers.emplace_back(method, handler);
+    return *this;
+  }
+  Router& get(std::string const& pattern, Handler const& handler) {
+    return add("GET", pattern, handler);
+  }
+  Router& post(std::string const& pattern, Handler const& handler) {
+    return add("POST", pattern, handler);
+  }
+  Router& withNotFound(Handler const& handler) {
+    notFound = handler;
+    return *this;
+  }
+  Router& withNotAllowed(Handler const& handler) {
+    notAllowed = handler;
+    return *this;
+  }
+
+  // nullptr when nothing matches, allow is set if the path exists for another method
+  Handler const* find(std::string const& method, std::string_view path, Params& ps,
+                      bool& allow) const {
+    Handler const* h = nullptr;
+    allow = false;
+    path = path.substr(0, path.find('?'));
+    if (path.empty()) path = "/";
+    if (!MATCH(&root, path, method, ps, h, allow)) return nullptr;
+    return h;
+  }
+
+  _1_1Response operator()(A1_1Request const& req) const {
+    Params ps;
+    bool allow = false;
+    if (Handler const* h = find(req.method(), req.path(), ps, allow)) return (*h)(req, ps);
+    return allow ? notAllowed(req, ps) : notFound(req, ps);
+  }
+};
+
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_ROUTER_HPP_ */
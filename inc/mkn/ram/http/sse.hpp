@@ -0,0 +1,130 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_SSE_HPP_
+#define _MKN_RAM_HTTP_SSE_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mkn/ram/http/def.hpp"
+
+namespace mkn {
+namespace ram {
+namespace http {
+namespace sse {
+
+// appends one text/event-stream event, data over several lines is sent as several data: fields
+void EVENT(std::string& out, std::string_view const& data, std::string_view const& event = {},
+           std::string_view const& id = {});
+
+class Channel;
+
+// One open event stream, sends may come from any thread
+//  events are queued and written by the server's loop, a stream that falls more than
+//  _MKN_RAM_HTTP_SSE_QUEUE_ bytes behind is closed
+class Sink {
+  friend class Channel;
+
+ public:
+  // bytes the transport took, 0 if none right now, < 0 once it has failed
+  typedef std::function<int(char const*, size_t const&)> Writer;
+
+ private:
+  Writer _writer;
+  std::function<void()> _ready;  // there is something to write
+  std::string const _lastEventID;
+  std::string _queue;
+  size_t _sent = 0;
+  int64_t _written;
+  mutable std::mutex _mutex;
+  bool _closed = 0;
+
+  bool enqueue(std::string_view const& bytes);
+
+ public:
+  Sink(std::string const& lastEventID, Writer const& writer, std::function<void()> const& ready);
+
+  // false once closed
+  bool send(std::string_view const& data, std::string_view const& event = {},
+            std::string_view const& id = {});
+  bool comment(std::string_view const& text = {});
+  // milliseconds the client waits before reconnecting
+  bool retry(uint32_t const& ms);
+  void close();
+  bool closed() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _closed;
+  }
+  // Last-Event-ID of the request that opened the stream, empty for a first connection
+  std::string const& lastEventID() const { return _lastEventID; }
+
+  // writes what the transport takes, with a heartbeat comment once idle
+  //  -1 once closed, 1 while bytes remain, else 0
+  int flush(int64_t const& now);
+  // the transport is gone, later sends fail
+  void detach();
+};
+
+// Fans events out to subscribed sinks, numbering them and keeping the last few
+//  for sinks that reconnect with a Last-Event-ID
+class Channel {
+ private:
+  std::deque<std::pair<uint64_t, std::string>> _history;  // id, framed event
+  std::vector<std::shared_ptr<Sink>> _sinks;
+  size_t const _max;
+  uint64_t _next = 1;
+  mutable std::mutex _mutex;
+
+ public:
+  Channel(size_t const& history = _MKN_RAM_HTTP_SSE_HISTORY_) : _max(history) {}
+
+  // the event's id
+  uint64_t publish(std::string_view const& data, std::string_view const& event = {});
+  // replays kept events after the sink's Last-Event-ID, then adds it
+  void subscribe(std::shared_ptr<Sink> const& sink);
+  size_t subscribers() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _sinks.size();
+  }
+};
+
+}  // namespace sse
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_SSE_HPP_ */
@@ -0,0 +1,104 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_HTTP_WS_HPP_
+#define _MKN_RAM_HTTP_WS_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "mkn/ram/http/def.hpp"
+
+namespace mkn {
+namespace ram {
+namespace http {
+namespace ws {
+
+enum class Opcode : uint8_t {
+  Continuation = 0x0,
+  Text = 0x1,
+  Binary = 0x2,
+  Close = 0x8,
+  Ping = 0x9,
+  Pong = 0xA
+};
+
+// Sec-WebSocket-Accept for a Sec-WebSocket-Key
+std::string ACCEPT(std::string_view const& key);
+
+// XOR with the masking key as from payload offset off, eight bytes at a time
+void MASK(char* data, size_t const& size, uint8_t const (&key)[4], size_t const& off = 0);
+
+// Server side of one WebSocket, RFC 6455 framing without any transport
+//  bytes read are given to receive, the handler gets each whole message
+//  frames are written through the writer, send may be called from any thread
+class Connection {
+ public:
+  typedef std::function<void(Connection&, std::string_view const&, bool const&)> Handler;
+  typedef std::function<bool(char const*, size_t const&)> Writer;
+
+ private:
+  Handler _handler;
+  Writer _writer;
+  std::string _in, _message;
+  mutable std::mutex _mutex;
+  bool _binary = 0, _fragmented = 0, _closeSent = 0, _closed = 0;
+
+  bool write(Opcode const& op, std::string_view const& payload);
+  bool fail(uint16_t const& code);
+
+ public:
+  Connection(Handler const& handler, Writer const& writer) : _handler(handler), _writer(writer) {}
+
+  // false once closed, by either side or on a protocol error
+  bool receive(char const* data, size_t const& size);
+
+  // false once closed
+  bool send(std::string_view const& message, bool const& binary = 0);
+  bool ping(std::string_view const& payload = {});
+  void close(uint16_t const& code = 1000, std::string_view const& reason = {});
+
+  // the transport is gone, later sends fail
+  void detach();
+  bool closed() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _closed;
+  }
+};
+
+}  // namespace ws
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_HTTP_WS_HPP_ */
@@ -0,0 +1,287 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_METRICS_HPP_
+#define _MKN_RAM_METRICS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "mkn/ram/tcp/def.hpp"
+
+namespace mkn {
+namespace ram {
+namespace metrics {
+
+// the cell of a metric the calling thread records to, threads are spread round robin
+inline size_t SHARD() {
+  static std::atomic<size_t> next{0};
+  thread_local size_t const i =
+      next.fetch_add(1, std::memory_order_relaxed) % _MKN_RAM_METRICS_SHARDS_;
+  return i;
+}
+
+// summed over per thread cells on read, a gauge is a Counter also given negative values
+class Counter {
+ private:
+  struct alignas(64) Cell {
+    std::atomic<int64_t> v{0};
+  };
+  Cell _cells[_MKN_RAM_METRICS_SHARDS_];
+
+ public:
+  void add(int64_t const& n = 1) { _cells[SHARD()].v.fetch_add(n, std::memory_order_relaxed); }
+  int64_t value() const {
+    int64_t v = 0;
+    for (auto const& c : _cells) v += c.v.load(std::memory_order_relaxed);
+    return v;
+  }
+};
+
+// durations in log-linear nanosecond buckets, 8 per power of two so within 12.5%
+//  values from 2^41ns, about 36 minutes, share the last bucket
+class Histogram {
+ public:
+  typedef std::chrono::steady_clock Clock;
+  static constexpr size_t SUB = 8, BUCKETS = SUB + 38 * SUB;
+
+  static size_t INDEX(uint64_t const& ns) {
+    if (ns < SUB) return ns;
+#if defined(_MSC_VER)
+    unsigned long e;
+    _BitScanReverse64(&e, ns);
+#else
+    int const e = 63 - __builtin_clzll(ns);
+#endif
+    size_t const i = (e - 2) * SUB + ((ns >> (e - 3)) & (SUB - 1));
+    return i < BUCKETS ? i : BUCKETS - 1;
+  }
+  // exclusive upper bound of bucket i in nanoseconds
+  static uint64_t UPPER(size_t const& i) {
+    if (i < SUB) return i + 1;
+    return uint64_t(SUB + i % SUB + 1) << (i / SUB - 1);
+  }
+
+  struct Snapshot {
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(BUCKETS);
+    uint64_t count = 0, sum = 0;  // sum in nanoseconds
+
+    // nanoseconds below which a fraction q of values fall, to bucket precision
+    uint64_t quantile(double const& q) const {
+      if (!count) return 0;
+      uint64_t const rank = uint64_t(q * double(count - 1)) + 1;
+      uint64_t seen = 0;
+      for (size_t i = 0; i < BUCKETS; i++)
+        if ((seen += buckets[i]) >= rank) return UPPER(i);
+      return UPPER(BUCKETS - 1);
+    }
+  };
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<uint64_t> sum;
+  };
+  std::unique_ptr<Shard[]> _shards{new Shard[_MKN_RAM_METRICS_SHARDS_]()};
+
+ public:
+  void record(uint64_t const& ns) {
+    auto& s = _shards[SHARD()];
+    s.buckets[INDEX(ns)].fetch_add(1, std::memory_order_relaxed);
+    s.sum.fetch_add(ns, std::memory_order_relaxed);
+  }
+  template <class Rep, class Period>
+  void record(std::chrono::duration<Rep, Period> const& d) {
+    auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    record(uint64_t(ns > 0 ? ns : 0));
+  }
+  void since(Clock::time_point const& start) { record(Clock::now() - start); }
+
+  Snapshot snapshot() const {
+    Snapshot snap;
+    for (size_t s = 0; s < _MKN_RAM_METRICS_SHARDS_; s++) {
+      auto const& sh = _shards[s];
+      for (size_t i = 0; i < BUCKETS; i++) {
+        auto const n = sh.buckets[i].load(std::memory_order_relaxed);
+        snap.buckets[i] += n;
+        snap.count += n;
+      }
+      snap.sum += sh.sum.load(std::memory_order_relaxed);
+    }
+    return snap;
+  }
+};
+
+// named metrics rendered as Prometheus text, asking again for a name and labels returns the same
+//  labels are as written between braces, e.g. code="2xx"
+class Registry {
+ public:
+  enum class Type : uint8_t { Counter = 0, Gauge, Histogram };
+
+ private:
+  struct Entry {
+    std::string name, help, labels;
+    Type type;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Histogram> histogram;
+  };
+  mutable std::mutex _mutex;
+  std::vector<std::unique_ptr<Entry>> _entries;
+
+  Entry& entry(std::string const& name, std::string const& help, std::string const& labels,
+               Type const& type) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto const& e : _entries)
+      if (e->name == name && e->labels == labels && e->type == type) return *e;
+    _entries.emplace_back(new Entry{name, help, labels, type, nullptr, nullptr});
+    auto& e = *_entries.back();
+    if (type == Type::Histogram)
+      e.histogram.reset(new Histogram);
+    else
+      e.counter.reset(new Counter);
+    return e;
+  }
+
+  static void SERIES(std::ostream& o, std::string const& name, std::string const& labels,
+                     std::string const& extra = "") {
+    o << name;
+    if (labels.size() || extra.size())
+      o << '{' << labels << (labels.size() && extra.size() ? "," : "") << extra << '}';
+    o << ' ';
+  }
+  static void WRITE(std::ostream& o, Entry const& e) {
+    if (e.counter) {
+      SERIES(o, e.name, e.labels);
+      o << e.counter->value() << '\n';
+      return;
+    }
+    auto const snap = e.histogram->snapshot();
+    uint64_t below = 0;
+    size_t i = 0;
+    for (size_t p = 10; p <= 35; p++) {  // le from about 1us to 34s at powers of two
+      for (size_t const end = Histogram::INDEX(uint64_t(1) << p); i < end; i++)
+        below += snap.buckets[i];
+      std::ostringstream le;
+      le << "le=\"" << double(uint64_t(1) << p) / 1e9 << '"';
+      SERIES(o, e.name + "_bucket", e.labels, le.str());
+      o << below << '\n';
+    }
+    SERIES(o, e.name + "_bucket", e.labels, "le=\"+Inf\"");
+    o << snap.count << '\n';
+    SERIES(o, e.name + "_sum", e.labels);
+    o << double(snap.sum) / 1e9 << '\n';
+    SERIES(o, e.name + "_count", e.labels);
+    o << snap.count << '\n';
+  }
+
+ public:
+  Registry() {}
+  Registry(Registry const&) = delete;
+  Registry& operator=(Registry const&) = delete;
+
+  Counter& counter(std::string const& name, std::string const& help,
+                   std::string const& labels = "") {
+    return *entry(name, help, labels, Type::Counter).counter;
+  }
+  Counter& gauge(std::string const& name, std::string const& help,
+                 std::string const& labels = "") {
+    return *entry(name, help, labels, Type::Gauge).counter;
+  }
+  // in seconds when rendered
+  Histogram& histogram(std::string const& name, std::string const& help,
+                       std::string const& labels = "") {
+    return *entry(name, help, labels, Type::Histogram).histogram;
+  }
+
+  // text exposition format 0.0.4, series of one name are grouped under its first HELP
+  std::string text() const {
+    static char const* const TYPES[] = {"counter", "gauge", "histogram"};
+    std::ostringstream o;
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<bool> done(_entries.size());
+    for (size_t i = 0; i < _entries.size(); i++) {
+      if (done[i]) continue;
+      auto const& e = *_entries[i];
+      o << "# HELP " << e.name << ' ' << e.help << '\n';
+      o << "# TYPE " << e.name << ' ' << TYPES[size_t(e.type)] << '\n';
+      for (size_t j = i; j < _entries.size(); j++)
+        if (!done[j] && _entries[j]->name == e.name) {
+          WRITE(o, *_entries[j]);
+          done[j] = 1;
+        }
+    }
+    return o.str();
+  }
+};
+
+// what servers record once given a Registry, see ASocketServer::withMetrics
+//  connections and bytes by the socket layer, handshake by https::Server, queue by worker pools
+//  requests, parse, handler and write by http::AServer, HTTP/2 requests are not timed for parse
+struct Server {
+  Counter &accepted, &active, &received, &sent, &queued;
+  Counter* requests[5];  // by status class
+  Histogram &handshake, &parse, &handler, &write;
+
+  explicit Server(Registry& r)
+      : accepted(r.counter("mkn_ram_connections_accepted_total", "Connections accepted")),
+        active(r.gauge("mkn_ram_connections_active", "Connections open")),
+        received(r.counter("mkn_ram_received_bytes_total", "Bytes read from clients")),
+        sent(r.counter("mkn_ram_sent_bytes_total", "Bytes written to clients")),
+        queued(r.gauge("mkn_ram_queue_depth", "Reads waiting for a worker")),
+        requests{&r.counter("mkn_ram_requests_total", "Responses by status", "code=\"1xx\""),
+                 &r.counter("mkn_ram_requests_total", "Responses by status", "code=\"2xx\""),
+                 &r.counter("mkn_ram_requests_total", "Responses by status", "code=\"3xx\""),
+                 &r.counter("mkn_ram_requests_total", "Responses by status", "code=\"4xx\""),
+                 &r.counter("mkn_ram_requests_total", "Responses by status", "code=\"5xx\"")},
+        handshake(r.histogram("mkn_ram_handshake_seconds", "TLS handshake time")),
+        parse(r.histogram("mkn_ram_parse_seconds", "Request parse time")),
+        handler(r.histogram("mkn_ram_handler_seconds", "Response function time")),
+        write(r.histogram("mkn_ram_write_seconds", "Time to write or queue a response")) {}
+
+  void status(uint16_t const& code) {
+    if (code >= 100 && code < 600) requests[code / 100 - 1]->add();
+  }
+};
+
+}  // namespace metrics
+}  // namespace ram
+}  // namespace mkn
+
+#endif /* _MKN_RAM_METRICS_HPP_ */
@@ -34,6 +34,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <unordered_map>
 
 #include "mkn/kul/threads.hpp"
+#include "mkn/ram/http/admission.hpp"
 #include "mkn/ram/http/def.hpp"
 #include "mkn/ram/tcp.hpp"
 
@@ -45,6 +46,7 @@ class Server : public mkn::ram::http::AServer {
  private:
   int fdSize = _MKN_RAM_TCP_READ_BUFFER_;
   std::unordered_map<int, std::unique_ptr<char[]>> inBuffers;
+  std::vector<struct pollfd> _pollfds;
 
  protected:
   virtual char* getOrCreateBufferFor(int const& fd) {
@@ -54,9 +56,13 @@ class Server : public mkn::ram::http::AServer {
   }
 
   virtual bool receive(std::map<int, uint8_t>& fds, int const& fd) override;
+  // also polls what coroutine handlers wait on, see withTasks
+  virtual int poll(int timeout = 10) override;
 
  public:
   Server(short const& p = 80) : AServer(p) {}
+  Server(std::string const& path, uint32_t const& mode = _MKN_RAM_TCP_UNIX_MODE_)
+      : AServer(path, mode) {}
   virtual ~Server() {}
 };
 
@@ -69,16 +75,36 @@ class MultiServer : public mkn::ram::http::Server {
 
   virtual void handleBuffer(std::map<int, uint8_t>& fds, int const& fd, char* in, int const& read,
                             int& e) override {
-    _workerPool.async(
-        std::bind(&MultiServer::operateBuffer, std::ref(*this), &fds, fd, in, read, e),
-        std::bind(&MultiServer::errorBuffer, std::ref(*this), std::placeholders::_1));
+    std::shared_ptr<Admission> admitted;
+    if (!admit(fd, in, read, admitted)) {
+      e = 0;
+      return;
+    }
+    if (_metrics) _metrics->queued.add();
+    _workerPool.async(std::bind(&MultiServer::operateBuffer, std::ref(*this), &fds, fd, in, read,
+                                e, admitted, Admission::Clock::now()),
+                      std::bind(&MultiServer::errorBuffer, std::ref(*this), std::placeholders::_1));
     e = 1;
   }
 
   void operateBuffer(std::map<int, uint8_t>* fds, int const& fd, char* in, int const& read,
-                     int& e) {
-    mkn::ram::http::Server::handleBuffer(*fds, fd, in, read, e);
-    if (e <= 0) {
+                     int& e, std::shared_ptr<Admission> const& admitted,
+                     Admission::Clock::time_point const& queued) {
+    struct Done {
+      Admission* a;
+      ~Done() {
+        if (a) a->done();
+      }
+    } const done{admitted.get()};
+    if (_metrics) _metrics->queued.add(-1);
+    std::map<int, uint8_t> busy{{fd, 2}};  // the loop must not read the slot until it's closed
+    if (admitted && late(fd, in, read, *admitted, queued))
+      e = 0;
+    else
+      mkn::ram::http::Server::handleBuffer(busy, fd, in, read, e);
+    if (e > 0)
+      (*fds)[fd] = busy[fd];
+    else {
       std::vector<int> del{fd};
       closeFDs(*fds, del);
     }
@@ -111,6 +137,9 @@ class MultiServer : public mkn::ram::http::Server {
   MultiServer(short const& p = 80, uint8_t const& acceptThreads = 1,
               uint8_t const& workerThreads = 1)
       : Server(p), _acceptThreads(acceptThreads), _workerThreads(workerThreads) {}
+  MultiServer(std::string const& path, uint8_t const& acceptThreads = 1,
+              uint8_t const& workerThreads = 1, uint32_t const& mode = _MKN_RAM_TCP_UNIX_MODE_)
+      : Server(path, mode), _acceptThreads(acceptThreads), _workerThreads(workerThreads) {}
   ~MultiServer() { KUL_DBG_FUNC_ENTER }
 
   virtual void start() KTHROW(mkn::ram::tcp::Exception) override;
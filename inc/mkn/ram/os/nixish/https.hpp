@@ -38,7 +38,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <openssl/ssl.h>
 #include <openssl/x509.h>
 
+#include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
 
 #include "mkn/ram/http.hpp"
 
@@ -83,19 +87,35 @@ class Server : public mkn::ram::http::Server {
   mkn::kul::File crt, key;
   std::string const cs;
 
-  virtual void loop(std::map<int, uint8_t>& fds) KTHROW(mkn::ram::tcp::Exception) override;
+  // completes the TLS handshake before the slot is used, dropping clients that fail it
+  virtual void validAccept(std::map<int, uint8_t>& fds, int const& newlisock,
+                           int const& nfd) override;
 
   virtual bool receive(std::map<int, uint8_t>& fds, int const& fd) override;
 
+  // SSL_write with partial writes, 0 on SSL_ERROR_WANT_WRITE to retry once writable
+  virtual int transmit(int const& fd, char const* const out, size_t const& size) override;
+  // SSL has no gather write, parts go out one SSL_write each until one is short
+  virtual int transmit(int const& fd, struct iovec const* const parts, size_t const& n) override;
+  virtual bool pending(int const& fd) override;
+  virtual void closed(int const& fd) override;
+
   virtual void handleBuffer(std::map<int, uint8_t>& fds, int const& fd, char* in, int const& read,
                             int& e) override;
 
+  // ALPN selection, "h2" when withHttp2 is set and offered, else "http/1.1"
+  static int ALPN(SSL* ssl, unsigned char const** out, unsigned char* outlen,
+                  unsigned char const* in, unsigned int inlen, void* arg);
+
  public:
   Server(short const& p, mkn::kul::File const& c, mkn::kul::File const& k,
          std::string const& cs = "")
       : mkn::ram::http::Server(p), crt(c), key(k), cs(cs) {}
   Server(mkn::kul::File const& c, mkn::kul::File const& k, std::string const& cs = "")
       : mkn::ram::https::Server(443, c, k, cs) {}
+  Server(std::string const& path, mkn::kul::File const& c, mkn::kul::File const& k,
+         std::string const& cs = "", uint32_t const& mode = _MKN_RAM_TCP_UNIX_MODE_)
+      : mkn::ram::http::Server(path, mode), crt(c), key(k), cs(cs) {}
   virtual ~Server() {
     if (s) stop();
   }
@@ -135,22 +155,40 @@ class MultiServer : public mkn::ram::https::Server {
   virtual void handleBuffer(std::map<int, uint8_t>& fds, int const& fd, char* in, int const& read,
                             int& e) override {
     KUL_DBG_FUNC_ENTER
-    _workerPool.async(
-        std::bind(&MultiServer::operateBuffer, std::ref(*this), &fds, fd, in, read, e),
-        std::bind(&MultiServer::errorBuffer, std::ref(*this), std::placeholders::_1));
+    std::shared_ptr<http::Admission> admitted;
+    if (!admit(fd, in, read, admitted)) {
+      e = 0;
+      return;
+    }
+    if (_metrics) _metrics->queued.add();
+    _workerPool.async(std::bind(&MultiServer::operateBuffer, std::ref(*this), &fds, fd, in, read,
+                                e, admitted, http::Admission::Clock::now()),
+                      std::bind(&MultiServer::errorBuffer, std::ref(*this), std::placeholders::_1));
     e = 1;
   }
 
   void operateBuffer(std::map<int, uint8_t>* fds, int const& fd, char* in, int const& read,
-                     int& e) {
+                     int& e, std::shared_ptr<http::Admission> const& admitted,
+                     http::Admission::Clock::time_point const& queued) {
     KUL_DBG_FUNC_ENTER
-    mkn::ram::https::Server::handleBuffer(*fds, fd, in, read, e);
-    if (e <= 0) {
-      getpeername(m_fds[fd].fd, (struct sockaddr*)&cli_addr, (socklen_t*)&clilen);
-      KOUT(DBG) << "DISCO "
-                << ", is : " << inet_ntoa(cli_addr[fd].sin_addr)
-                << ", port : " << ntohs(cli_addr[fd].sin_port);
-      onDisconnect(inet_ntoa(cli_addr[fd].sin_addr), ntohs(cli_addr[fd].sin_port));
+    struct Done {
+      http::Admission* a;
+      ~Done() {
+        if (a) a->done();
+      }
+    } const done{admitted.get()};
+    if (_metrics) _metrics->queued.add(-1);
+    std::map<int, uint8_t> busy{{fd, 2}};  // the loop must not read the slot until it's closed
+    if (admitted && late(fd, in, read, *admitted, queued))
+      e = 0;
+    else
+      mkn::ram::https::Server::handleBuffer(busy, fd, in, read, e);
+    if (e > 0)
+      (*fds)[fd] = busy[fd];
+    else {
+      auto const ip(clientIP(fd));
+      KOUT(DBG) << "DISCO , is : " << ip << ", port : " << clientPort(fd);
+      onDisconnect(ip.c_str(), clientPort(fd));
       std::vector<int> del{fd};
       closeFDs(*fds, del);
     }
@@ -172,6 +210,18 @@ class MultiServer : public mkn::ram::https::Server {
   MultiServer(uint8_t const& acceptThreads, uint8_t const& workerThreads, mkn::kul::File const& c,
               mkn::kul::File const& k, std::string const& cs = "")
       : MultiServer(443, acceptThreads, workerThreads, c, k, cs) {}
+  MultiServer(std::string const& path, uint8_t const& acceptThreads,
+              uint8_t const& workerThreads, mkn::kul::File const& c, mkn::kul::File const& k,
+              std::string const& cs = "", uint32_t const& mode = _MKN_RAM_TCP_UNIX_MODE_)
+      : mkn::ram::https::Server(path, c, k, cs, mode),
+        _acceptThreads(acceptThreads),
+        _workerThreads(workerThreads),
+        _acceptPool(acceptThreads),
+        _workerPool(workerThreads) {
+    if (acceptThreads < 1)
+      KEXCEPTION("MultiServer cannot have less than one threads for accepting");
+    if (workerThreads < 1) KEXCEPTION("MultiServer cannot have less than one threads for working");
+  }
 
   virtual ~MultiServer() {
     _acceptPool.stop();
@@ -201,6 +251,7 @@ class Requester;
 class SSLReqHelper {
   friend class A1_1Request;
   friend class Requester;
+  friend class Http2Client;
 
  private:
   SSL_CTX* ctx;
@@ -231,8 +282,58 @@ class A1_1Request {
 
 class Requester {
  public:
+  // timeouts in milliseconds, <= 0 for no limit
   static void send(std::string const& h, std::string const& req, uint16_t const& p,
-                   std::stringstream& ss, SSL* ssl);
+                   std::stringstream& ss, SSL* ssl,
+                   int64_t const& connectTimeout = _MKN_RAM_TCP_CONNECT_TIMEOUT_,
+                   int64_t const& readTimeout = _MKN_RAM_TCP_READ_TIMEOUT_,
+                   int64_t const& totalTimeout = _MKN_RAM_TCP_TOTAL_TIMEOUT_);
+};
+
+// HTTP/2 over one TLS connection to host:port, requests from any thread share it as streams
+//  connects on first use and again after the peer closes, the connection's I/O has its own thread
+//  requests keep their timeouts, handlers run on the sending thread
+class Http2Client {
+ private:
+  struct Pending {
+    http::_1_1Response res;
+    int64_t started;
+    bool done = 0, failed = 0;
+  };
+  std::string const _host;
+  uint16_t const _port;
+  int _sck = -1, _wake[2] = {-1, -1};
+  SSL* _ssl = {0};
+  std::unique_ptr<http::h2::Connection> _c;
+  std::unordered_map<uint32_t, Pending*> _pending;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::thread _io;
+  int64_t _active = 0;
+  bool _stop = 0;
+
+  void connect(http::A1_1Request const& r);
+  void disconnect();
+  void run();
+  bool write();
+  void wake();
+  uint32_t submit(std::unique_lock<std::mutex>& l, http::A1_1Request const& r, Pending& p);
+  bool wait(std::unique_lock<std::mutex>& l, http::A1_1Request const& r, uint32_t const& id,
+            Pending& p);
+
+ public:
+  Http2Client(std::string const& host, uint16_t const& port = 443);
+  ~Http2Client();
+  Http2Client(Http2Client const&) = delete;
+  Http2Client& operator=(Http2Client const&) = delete;
+
+  void send(http::A1_1Request& r) KTHROW(mkn::ram::http::Exception);
+  // all requests are in flight together, responses are handled in order once all have ended
+  //  throws after handling the rest if any failed
+  void send(std::vector<http::A1_1Request*> const& rs) KTHROW(mkn::ram::http::Exception);
+
+  // one shared client per host and port
+  static std::shared_ptr<Http2Client> POOLED(std::string const& host, uint16_t const& port = 443);
 };
 
 class _1_1GetRequest : public http::_1_1GetRequest, https::A1_1Request {
@@ -35,21 +35,36 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <fcntl.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <sys/ioctl.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_set>
+#include <vector>
 
 #include "mkn/kul/byte.hpp"
 #include "mkn/kul/log.hpp"
 #include "mkn/kul/time.hpp"
+#include "mkn/ram/dns.hpp"
 #include "mkn/ram/tcp/def.hpp"
 
+#if defined(MSG_NOSIGNAL)
+#define _MKN_RAM_TCP_SEND_FLAGS_ MSG_NOSIGNAL
+#else
+#define _MKN_RAM_TCP_SEND_FLAGS_ 0
+#endif  // MSG_NOSIGNAL
+
 #ifndef __MKN_RAM_TCP_BIND_SOCKTOPTS__
 #define __MKN_RAM_TCP_BIND_SOCKTOPTS__ SO_REUSEADDR
 #endif  //__MKN_RAM_TCP_BIND_SOCKTOPTS__
@@ -69,7 +84,17 @@ class Socket : public ASocket<T> {
   }
   virtual bool connect(std::string const& host, int16_t const& port) override {
     KUL_DBG_FUNC_ENTER
-    if (!SOCKET(sck) || !CONNECT(sck, host, port)) return false;
+    this->start();
+    if (!CONNECT(sck, host, port, this->bounded(this->_connectTimeout), true)) return false;
+    this->open = true;
+    return true;
+  }
+  bool connect(std::string const& path) {
+    KUL_DBG_FUNC_ENTER
+    this->start();
+    if (!SOCKET(sck, AF_UNIX, SOCK_STREAM, 0) || !CONNECT(sck, path)) return false;
+    int const iof = fcntl(sck, F_GETFL, 0);
+    fcntl(sck, F_SETFL, (iof == -1 ? 0 : iof) | O_NONBLOCK);
     this->open = true;
     return true;
   }
@@ -86,73 +111,54 @@ class Socket : public ASocket<T> {
     bool more = false;
     return read(data, len, more);
   }
+  // sck is non-blocking once connected, returns 0 if the peer has closed
   virtual size_t read(T* data, size_t const& len, bool& more)
       KTHROW(mkn::ram::tcp::Exception) override {
     KUL_DBG_FUNC_ENTER
-    struct timeval tv;
-    fd_set fds;
-    int64_t ret = 0, iof = -1;
-    bool r = 0;
-    FD_ZERO(&fds);
-    FD_SET(sck, &fds);
-    tv.tv_sec = 1;
-    tv.tv_usec = 500;
-    ret = select(sck + 1, &fds, NULL, NULL, &tv);
-    std::function<bool(int64_t&, bool)> check_error;
-    check_error = [&](int64_t& ret, bool peek = false) -> bool {
-      ret = 0;
-      int error = 0;  // or WSAGetLastError()
-      if (peek) {
-        ret = recv(sck, data, len, MSG_PEEK);
-        error = errno;  // or WSAGetLastError()
-      } else {
-        ret = recv(sck, data, len, 0);
-        error = errno;  // or WSAGetLastError()
-      }
-      if (ret > 0) {
-        return false;
-      } else if (ret == 0) {
-        // skip
-      } else {
-        // there is an error, let's see what it is
-        // error = errno; // or WSAGetLastError()
-        switch (error) {
-          // case EAGAIN:
-          case EWOULDBLOCK:
-          // Socket is O_NONBLOCK and there is no data available
-          case EINTR:
-            // an interrupt (signal) has been catched
-            // should be ingore in most cases
-            break;
-          default:
-            // socket has an error, no valid anymore
-            break;
-        }
-      }
-      return false;
-    };
-
-    if (ret < 0)
-      KEXCEPTION("Failed to read from Server socket " + std::string(strerror(errno)));
-    else if (ret > 0 && FD_ISSET(sck, &fds)) {
-      if ((iof = fcntl(sck, F_GETFL, 0)) != -1) fcntl(sck, F_SETFL, iof | O_NONBLOCK);
-      int64_t size = 0;
-      while (check_error(ret, false)) {
-      }
-      if (ret > 0) ret += read(data + ret, len - ret, more);
-      ioctl(sck, FIONREAD, &size);
-      more = size > 0;
-      if (iof != -1) fcntl(sck, F_SETFL, iof);
-    } else if (ret == 0 && !FD_ISSET(sck, &fds)) {
-      while (check_error(ret, false)) {
-      }
-      if (ret > 0) ret += read(data + ret, len - ret, more);
-      if (!r && !ret) KEXCEPTION("Failed to read from Server socket");
+    more = false;
+    if (!len) return 0;
+    auto ret = wait(POLLIN, this->_readTimeout);
+    if (ret < 0) KEXCEPTION("Failed to read from Server socket " + std::string(strerror(errno)));
+    if (ret == 0) KEXCEPTION("Timed out reading from Server socket");
+    size_t got = 0;
+    while (got < len) {
+      auto const r = ::recv(sck, data + got, len - got, 0);
+      if (r > 0)
+        got += r;
+      else if (r == 0 || errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      else if (errno != EINTR)
+        KEXCEPTION("Failed to read from Server socket " + std::string(strerror(errno)));
     }
-    return ret;
+    more = got == len;
+    return got;
   }
   virtual size_t write(T const* data, size_t const& len) override {
-    return ::send(sck, data, len, 0);
+    size_t sent = 0;
+    while (sent < len) {
+      auto const w = ::send(sck, data + sent, len - sent, _MKN_RAM_TCP_SEND_FLAGS_);
+      if (w > 0)
+        sent += w;
+      else if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        return w;
+      else if (w < 0 && errno != EINTR && wait(POLLOUT, this->_readTimeout) <= 0)
+        return -1;
+    }
+    return sent;
+  }
+  // poll sck bounded by timeout and the total deadline, 0 on timeout
+  int wait(short const& events, int64_t const& timeout) {
+    while (true) {
+      int64_t ms = timeout > 0 ? timeout : -1;
+      if (this->_deadline > 0) {
+        int64_t const left = this->_deadline - ASocket<T>::NOW();
+        if (left <= 0) return 0;
+        ms = ms < 0 ? left : std::min(ms, left);
+      }
+      struct pollfd pfd = {sck, events, 0};
+      int const ret = ::poll(&pfd, 1, ms);
+      if (ret >= 0 || errno != EINTR) return ret;
+    }
   }
 
   static bool SOCKET(int& sck, int16_t const& domain = AF_INET, int16_t const& type = SOCK_STREAM,
@@ -162,53 +168,130 @@ class Socket : public ASocket<T> {
     if (sck < 0) KLOG(ERR) << "SOCKET ERROR CODE: " << sck;
     return sck >= 0;
   }
-  static bool CONNECT(int const& sck, std::string const& host, int16_t const& port) {
+  // sck is replaced by the first socket to connect, see CONNECT(int&, dns::Addresses const&)
+  static bool CONNECT(int& sck, std::string const& host, int16_t const& port,
+                      int64_t const& timeout = -1, bool const& nonBlocking = false) {
     KUL_DBG_FUNC_ENTER
-    struct sockaddr_in servAddr;
-    memset(&servAddr, 0, sizeof(servAddr));
-    servAddr.sin_family = AF_INET;
-    int16_t e = 0;
-    servAddr.sin_port =
-        !kul::byte::isBigEndian() ? htons(port) : mkn::kul::byte::LittleEndian::UINT32(port);
-    if (host == "localhost" || host == "127.0.0.1") {
-      servAddr.sin_addr.s_addr = INADDR_ANY;
-      e = ::connect(sck, (struct sockaddr*)&servAddr, sizeof(servAddr));
-      if (e < 0) KLOG(ERR) << "SOCKET CONNECT ERROR CODE: " << e << " errno: " << errno;
-    } else if (inet_pton(AF_INET, &host[0], &(servAddr.sin_addr))) {
-      e = ::connect(sck, (struct sockaddr*)&servAddr, sizeof(servAddr));
-      if (e < 0) KLOG(ERR) << "SOCKET CONNECT ERROR CODE: " << e << " errno: " << errno;
-    } else {
-      std::string ip;
-      struct addrinfo hints, *servinfo, *next;
-      struct sockaddr_in* in;
-      memset(&hints, 0, sizeof(hints));
-      hints.ai_family = AF_UNSPEC;  // use AF_INET6 to force IPv6
-      hints.ai_socktype = SOCK_STREAM;
-      if ((e = getaddrinfo(host.c_str(), 0, &hints, &servinfo)) != 0)
-        KEXCEPTION("getaddrinfo failed for host: " + host);
-      for (next = servinfo; next != NULL; next = next->ai_next) {
-        in = (struct sockaddr_in*)next->ai_addr;
-        ip = inet_ntoa(in->sin_addr);
-        servAddr.sin_addr.s_addr = inet_addr(&ip[0]);
-        if (ip == "0.0.0.0") continue;
-        if ((e = ::connect(sck, (struct sockaddr*)&servAddr, sizeof(servAddr))) == 0) break;
+    mkn::ram::dns::Addresses addrs;
+    int const e = mkn::ram::dns::Resolver::INSTANCE().get(host, port, addrs);
+    if (e) {
+      KLOG(ERR) << "getaddrinfo failed for host: " << host << " - " << gai_strerror(e);
+      return false;
+    }
+    return CONNECT(sck, addrs, timeout, nonBlocking);
+  }
+  // Happy Eyeballs, a new attempt is started every _MKN_RAM_TCP_CONNECT_ATTEMPT_DELAY_
+  //  milliseconds or as soon as one fails, the first to complete wins
+  //  timeout in milliseconds bounds all attempts, <= 0 waits on the OS
+  static bool CONNECT(int& sck, mkn::ram::dns::Addresses const& addrs, int64_t const& timeout = -1,
+                      bool const& nonBlocking = false) {
+    KUL_DBG_FUNC_ENTER
+    std::vector<struct pollfd> pfds;
+    int winner = -1, error = ETIMEDOUT;
+    size_t next = 0;
+    auto const deadline = timeout > 0 ? ASocket<T>::NOW() + timeout : 0;
+    while (winner < 0 && (next < addrs.size() || !pfds.empty())) {
+      if (next < addrs.size()) {
+        auto const& a = addrs[next++];
+        int const fd = socket(a.addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+        if (fd < 0) continue;
+        int const iof = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, (iof == -1 ? 0 : iof) | O_NONBLOCK);
+        if (::connect(fd, (struct sockaddr*)&a.addr, a.len) == 0) {
+          winner = fd;
+          break;
+        }
+        if (errno != EINPROGRESS) {
+          error = errno;
+          ::close(fd);
+          continue;
+        }
+        pfds.push_back({fd, POLLOUT, 0});
+      }
+      if (pfds.empty()) continue;
+      int64_t wait = next < addrs.size() ? _MKN_RAM_TCP_CONNECT_ATTEMPT_DELAY_ : -1;
+      if (deadline) {
+        int64_t const left = deadline - ASocket<T>::NOW();
+        if (left <= 0) {
+          error = ETIMEDOUT;
+          break;
+        }
+        wait = wait < 0 ? left : std::min(wait, left);
+      }
+      if (::poll(pfds.data(), pfds.size(), wait) < 0 && errno != EINTR) break;
+      for (auto it = pfds.begin(); it != pfds.end();) {
+        if (!it->revents) {
+          ++it;
+          continue;
+        }
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(it->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) err = errno;
+        if (!err && winner < 0)
+          winner = it->fd;
+        else {
+          if (err) error = err;
+          ::close(it->fd);
+        }
+        it = pfds.erase(it);
       }
-      freeaddrinfo(servinfo);
-      if (e < 0) KLOG(ERR) << "SOCKET CONNECT ERROR CODE: " << e << " errno: " << errno;
     }
+    for (auto const& p : pfds) ::close(p.fd);
+    if (winner < 0) {
+      KLOG(ERR) << "SOCKET CONNECT ERROR errno: " << error << " - " << strerror(error);
+      return false;
+    }
+    int const iof = fcntl(winner, F_GETFL, 0);
+    if (iof != -1 && !nonBlocking) fcntl(winner, F_SETFL, iof & ~O_NONBLOCK);
+    if (sck > 0) ::close(sck);
+    sck = winner;
+    return true;
+  }
+  static bool CONNECT(int const& sck, std::string const& path) {
+    KUL_DBG_FUNC_ENTER
+    struct sockaddr_un addr;
+    socklen_t len = 0;
+    if (!UNIX_ADDRESS(path, addr, len)) return false;
+    int e = ::connect(sck, (struct sockaddr*)&addr, len);
+    if (e < 0) KLOG(ERR) << "SOCKET CONNECT ERROR CODE: " << e << " errno: " << errno;
     return e >= 0;
   }
+
+  // paths starting with '@' are placed in the linux abstract namespace
+  static bool UNIX_ADDRESS(std::string const& path, struct sockaddr_un& addr, socklen_t& len) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+      KLOG(ERR) << "Invalid AF_UNIX socket path: " << path;
+      return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    if (path[0] == '@') addr.sun_path[0] = '\0';
+    len = offsetof(struct sockaddr_un, sun_path) + path.size() + (path[0] == '@' ? 0 : 1);
+    return true;
+  }
 };
 
 template <class T = uint8_t>
 class SocketServer : public ASocketServer<T> {
  protected:
+  // bytes for a client the socket has not taken yet, drained by the loop on POLLOUT
+  struct Output {
+    std::mutex mutex;
+    std::vector<T> queue;
+    size_t sent = 0;
+    bool paused = 0;  // over _MKN_RAM_TCP_OUT_HIGH_ until below _MKN_RAM_TCP_OUT_LOW_
+  };
+
   bool s = 0;
-  int lisock = 0, nfds = 12;
+  int lisock = 0, nfds = 1;  // nfds is one past the highest slot in use
+  std::unique_ptr<Output[]> _out{new Output[_MKN_RAM_TCP_MAX_CLIENT_]};
   int64_t _started;
+  std::string const _socketPath;
+  uint32_t const _socketMode = _MKN_RAM_TCP_UNIX_MODE_;
   struct pollfd m_fds[_MKN_RAM_TCP_MAX_CLIENT_];
   socklen_t clilen;
-  struct sockaddr_in serv_addr, cli_addr[_MKN_RAM_TCP_MAX_CLIENT_];
+  struct sockaddr_storage serv_addr, cli_addr[_MKN_RAM_TCP_MAX_CLIENT_];
 
   virtual bool handle(T* const in, size_t const& inLen, T* const out, size_t& outLen) {
     // default overridable function
@@ -219,34 +302,141 @@ class SocketServer : public ASocketServer<T> {
     return true;
   }
 
+  // bytes read, 0 once the peer has closed, -1 with errno EAGAIN when nothing is waiting
   virtual int readFrom(int const& fd, T* in, int opts = 0) {
     size_t size = 0;
-    int64_t val = 0;
-    while (1) {
-      val = ::recv(m_fds[fd].fd, in + size, _MKN_RAM_TCP_READ_BUFFER_ - (size + 1),
-                   MSG_PEEK | MSG_DONTWAIT);
-      if (val < 0) break;
-      size += ::recv(m_fds[fd].fd, in + size, _MKN_RAM_TCP_READ_BUFFER_ - (size + 1), opts);
+    while (size + 1 < _MKN_RAM_TCP_READ_BUFFER_) {
+      auto const val = ::recv(m_fds[fd].fd, in + size, _MKN_RAM_TCP_READ_BUFFER_ - (size + 1),
+                              MSG_DONTWAIT | opts);
+      if (val > 0) {
+        size += val;
+        continue;
+      }
+      if (val < 0 && errno == EINTR) continue;
+      if (size) break;
+      return val;
     }
+    if (this->_metrics) this->_metrics->received.add(size);
     return size;
   }
+  // true if fd has bytes or a close waiting, does not block
+  bool readable(int const& fd) const {
+    struct pollfd p = {m_fds[fd].fd, POLLIN, 0};
+    return ::poll(&p, 1, 0) > 0;
+  }
+  // what the socket takes without blocking, 0 while it is full, < 0 on error
+  virtual int transmit(int const& fd, T const* const out, size_t const& size) {
+    auto const w = ::send(m_fds[fd].fd, out, size, MSG_DONTWAIT | _MKN_RAM_TCP_SEND_FLAGS_);
+    if (w > 0 && this->_metrics) this->_metrics->sent.add(w);
+    return w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : int(w);
+  }
+  // transmit for n parts in order, one sendmsg so they need not be joined first
+  virtual int transmit(int const& fd, struct iovec const* const parts, size_t const& n) {
+    struct msghdr m;
+    bzero(&m, sizeof(m));
+    m.msg_iov = const_cast<struct iovec*>(parts);
+    m.msg_iovlen = n;
+    auto const w = ::sendmsg(m_fds[fd].fd, &m, MSG_DONTWAIT | _MKN_RAM_TCP_SEND_FLAGS_);
+    if (w > 0 && this->_metrics) this->_metrics->sent.add(w);
+    return w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : int(w);
+  }
+  // writeTo for n parts in order, only what the socket does not take is copied
+  int writeTo(int const& fd, struct iovec const* const parts, size_t const& n) {
+    auto& o = _out[fd];
+    std::lock_guard<std::mutex> lock(o.mutex);
+    size_t size = 0, w = 0;
+    for (size_t i = 0; i < n; i++) size += parts[i].iov_len;
+    if (o.queue.empty() && size) {
+      auto const t = transmit(fd, parts, n);
+      if (t < 0) return t;
+      w = t;
+    }
+    for (size_t i = 0; i < n; i++) {
+      auto const len = parts[i].iov_len;
+      if (w >= len) {
+        w -= len;
+        continue;
+      }
+      auto const* const p = static_cast<T const*>(parts[i].iov_base);
+      o.queue.insert(o.queue.end(), p + w, p + len);
+      w = 0;
+    }
+    if (o.queue.size() - o.sent > _MKN_RAM_TCP_OUT_HIGH_) o.paused = 1;
+    return size;
+  }
+  // writes what the socket takes now and queues the rest for the loop, size or < 0 on error
+  //  reads from fd pause while more than _MKN_RAM_TCP_OUT_HIGH_ bytes are queued
   virtual int writeTo(int const& fd, T const* const out, size_t size) {
-    return ::send(m_fds[fd].fd, out, size, 0);
+    auto& o = _out[fd];
+    std::lock_guard<std::mutex> lock(o.mutex);
+    size_t w = 0;
+    if (o.queue.empty() && size) {
+      auto const n = transmit(fd, out, size);
+      if (n < 0) return n;
+      w = n;
+    }
+    if (w < size) {
+      o.queue.insert(o.queue.end(), out + w, out + size);
+      if (o.queue.size() - o.sent > _MKN_RAM_TCP_OUT_HIGH_) o.paused = 1;
+    }
+    return size;
+  }
+  // what the socket takes without blocking, 0 while it is full or output is still queued
+  virtual int writeSome(int const& fd, T const* const out, size_t size) {
+    auto& o = _out[fd];
+    std::lock_guard<std::mutex> lock(o.mutex);
+    return o.queue.empty() ? transmit(fd, out, size) : 0;
+  }
+  // writes queued output, returns the bytes still queued or < 0 on error
+  int flush(int const& fd) {
+    auto& o = _out[fd];
+    std::lock_guard<std::mutex> lock(o.mutex);
+    while (o.sent < o.queue.size()) {
+      auto const w = transmit(fd, o.queue.data() + o.sent, o.queue.size() - o.sent);
+      if (w < 0) return w;
+      if (w == 0) break;
+      o.sent += w;
+    }
+    size_t const left = o.queue.size() - o.sent;
+    if (!left) {
+      o.queue.clear();
+      o.sent = 0;
+    } else if (o.sent > _MKN_RAM_TCP_OUT_LOW_) {
+      o.queue.erase(o.queue.begin(), o.queue.begin() + o.sent);
+      o.sent = 0;
+    }
+    if (left < _MKN_RAM_TCP_OUT_LOW_) o.paused = 0;
+    return int(std::min(left, size_t(INT32_MAX)));
   }
+  // poll events for a slot in state st, see loop
+  int16_t events(int const& fd, uint8_t const& st) {
+    auto& o = _out[fd];
+    std::lock_guard<std::mutex> lock(o.mutex);
+    int16_t ev = o.queue.empty() ? 0 : POLLOUT;
+    if (st == 1 && !o.paused) ev |= POLLIN;
+    return ev;
+  }
+  // true if fd has input buffered above the socket, e.g. by TLS
+  virtual bool pending(int const& fd) {
+    (void)fd;
+    return false;
+  }
+  // called once a slot's socket is closing for good
+  virtual void closed(int const& fd) { (void)fd; }
   virtual bool receive(std::map<int, uint8_t>& fds, int const& fd) {
     (void)fds;
     KUL_DBG_FUNC_ENTER
     T in[_MKN_RAM_TCP_READ_BUFFER_];
     bzero(in, _MKN_RAM_TCP_READ_BUFFER_);
-    int16_t e = 0, read = readFrom(fd, in);
+    int e = 0, read = readFrom(fd, in);
     if (read < 0 && errno != EWOULDBLOCK)
       KEXCEPTION("Socket Server error on recv - fd(" + std::to_string(fd) +
                  ") : " + std::to_string(errno) + " - " + std::string(strerror(errno)));
+    if (read < 0) return false;
     if (read == 0) {
-      getpeername(m_fds[fd].fd, (struct sockaddr*)&cli_addr[fd], (socklen_t*)&clilen);
-      KOUT(DBG) << "Host disconnected , ip: " << inet_ntoa(serv_addr.sin_addr) << ", port "
-                << ntohs(serv_addr.sin_port);
-      this->onDisconnect(inet_ntoa(cli_addr[fd].sin_addr), ntohs(cli_addr[fd].sin_port));
+      auto const ip(clientIP(fd));
+      KOUT(DBG) << "Host disconnected , ip: " << ip << ", port " << clientPort(fd);
+      this->onDisconnect(ip.c_str(), clientPort(fd));
       return true;
     } else {
       bool cl = 1;
@@ -266,99 +456,183 @@ class SocketServer : public ASocketServer<T> {
     }
     return false;
   }
+  // workers close slots too, whoever takes the socket under the slot's lock closes it
+  void closeSlot(std::map<int, uint8_t>& fds, int const& fd) {
+    int sck = -1;
+    {
+      auto& o = _out[fd];
+      std::lock_guard<std::mutex> lock(o.mutex);
+      if (m_fds[fd].fd < 0) return;
+      MKN_RAM_TRACE(Close, fd);
+      closed(fd);
+      sck = m_fds[fd].fd;
+      m_fds[fd] = {-1, 0, 0};
+      o.queue.clear();
+      o.sent = 0;
+      o.paused = 0;
+    }
+    ::close(sck);
+    if (this->_metrics) this->_metrics->active.add(-1);
+    fds[fd] = 0;
+  }
+  // slots with output still queued linger in state 3 until it is written
   void closeFDsNoCompress(std::map<int, uint8_t>& fds, std::vector<int>& del) {
     KUL_DBG_FUNC_ENTER;
     for (auto const& fd : del) {
-      ::close(m_fds[fd].fd);
-      m_fds[fd].fd = -1;
-      fds[fd] = 0;
-      nfds--;
+      if (flush(fd) > 0) {
+        fds[fd] = 3;
+        continue;
+      }
+      closeSlot(fds, fd);
     }
   }
   virtual void closeFDs(std::map<int, uint8_t>& fds, std::vector<int>& del) {
     closeFDsNoCompress(fds, del);
   }
+  // slot states, 0 free, 1 idle, 2 busy in a handler, 3 closing once its output is written
+  //  idle slots are read when poll says so, any slot with queued output is written on POLLOUT
   virtual void loop(std::map<int, uint8_t>& fds) KTHROW(mkn::ram::tcp::Exception) {
     // KUL_DBG_FUNC_ENTER
+    while (nfds > 1 && m_fds[nfds - 1].fd < 0) nfds--;  // only here, accept grows it on this thread
+    for (auto const& pair : fds)
+      if (pair.second && m_fds[pair.first].fd >= 0)
+        m_fds[pair.first].events = events(pair.first, pair.second);
     auto ret = poll();
     if (!s) return;
     if (ret < 0)
-      KEXCEPTION("Socket Server error on select: " + std::to_string(errno) + " - " +
+      KEXCEPTION("Socket Server error on poll: " + std::to_string(errno) + " - " +
                  std::string(strerror(errno)));
-    // if(ret == 0) return;
-    int newlisock = -1;
+    std::vector<int> del;
     for (auto const& pair : fds) {
-      auto& i = pair.first;
-      if (pair.second == 1) continue;
-      if (m_fds[i].revents == 0) continue;
-      if (m_fds[i].revents != POLLIN)
-        KEXCEPTION("HTTP Server error on pollin " + std::to_string(m_fds[i].revents));
-
+      auto const& i = pair.first;
+      auto const re = m_fds[i].revents;
+      if (re == 0) continue;
       if (m_fds[i].fd == lisock) {
-        do {
-          int newFD = nfds;
-          while (1) {
-            newFD++;
-            if (fds.count(newFD) && !fds[newFD]) break;
-          }
-          newlisock = accept(newFD);
-          if (newlisock < 0) {
-            if (errno != EWOULDBLOCK) KEXCEPTION("SockerServer error on accept");
-            break;
-          }
-          validAccept(fds, newlisock, newFD);
-        } while (newlisock != -1);
+        acceptAll(fds);
+        continue;
       }
+      if (!pair.second || !(re & (POLLOUT | POLLERR | POLLHUP | POLLNVAL))) continue;
+      auto const left = flush(i);
+      if (left < 0 || (pair.second == 3 && (left == 0 || !(re & POLLOUT)))) closeSlot(fds, i);
+    }
+    for (auto const& pair : fds) {
+      auto const& i = pair.first;
+      if (pair.second != 1 || m_fds[i].fd < 0 || m_fds[i].fd == lisock) continue;
+      if (!(m_fds[i].revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL)) && !pending(i)) continue;
+      if (receive(fds, i)) del.push_back(i);
     }
-    std::vector<int> del;
-    for (auto const& pair : fds)
-      if (pair.second == 1 && receive(fds, pair.first)) del.push_back(pair.first);
     if (del.size()) closeFDs(fds, del);
   }
-  virtual int poll(int timeout = 10) {
-    auto p = ::poll(m_fds, nfds, timeout);
-    if (errno == 11) {
-      mkn::kul::this_thread::sleep(timeout);
-      return 0;
-    } else if (errno == 2 || errno == 17 || errno == 32) {
-      // skip
-    } else if (errno) {
-      KLOG(ERR) << std::to_string(errno) << " - " << std::string(strerror(errno));
-      return -1;
+  void acceptAll(std::map<int, uint8_t>& fds) {
+    int newFD = 0;
+    while (1) {
+      while (++newFD < _MKN_RAM_TCP_MAX_CLIENT_ && (!fds.count(newFD) || fds[newFD])) {
+      }
+      if (newFD >= _MKN_RAM_TCP_MAX_CLIENT_) {
+        struct sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+        auto const full = ::accept(lisock, (struct sockaddr*)&addr, &len);
+        if (full < 0) return;
+        KLOG(ERR) << "Socket Server has no free slot, closing new connection";
+        ::close(full);
+        continue;
+      }
+      auto const newlisock = accept(newFD);
+      if (newlisock < 0) {
+        if (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR)
+          KLOG(ERR) << "Socket Server error on accept: " << strerror(errno);
+        return;
+      }
+      validAccept(fds, newlisock, newFD);
     }
+  }
+  virtual int poll(int timeout = 10) {
+    auto const p = ::poll(m_fds, nfds, timeout);
+    if (p < 0 && errno == EINTR) return 0;
+    if (p < 0) KLOG(ERR) << std::to_string(errno) << " - " << std::string(strerror(errno));
     return p;
   }
   virtual int accept(int const& fd) {
-    return ::accept(lisock, (struct sockaddr*)&cli_addr[fd], &clilen);
+    socklen_t len = sizeof(cli_addr[fd]);
+    return ::accept(lisock, (struct sockaddr*)&cli_addr[fd], &len);
   }
   virtual void validAccept(std::map<int, uint8_t>& fds, int const& newlisock, int const& nfd) {
     KUL_DBG_FUNC_ENTER;
-    KOUT(DBG) << "New connection , socket fd is " << newlisock
-              << ", is : " << inet_ntoa(cli_addr[nfd].sin_addr)
-              << ", port : " << ntohs(cli_addr[nfd].sin_port);
-    this->onConnect(inet_ntoa(cli_addr[nfd].sin_addr), ntohs(cli_addr[nfd].sin_port));
-    m_fds[nfd].fd = newlisock;
-    m_fds[nfd].events = POLLIN;
+    auto const ip(clientIP(nfd));
+    KOUT(DBG) << "New connection , socket fd is " << newlisock << ", is : " << ip
+              << ", port : " << clientPort(nfd);
+    this->onConnect(ip.c_str(), clientPort(nfd));
+    int const iof = fcntl(newlisock, F_GETFL, 0);
+    if (iof != -1) fcntl(newlisock, F_SETFL, iof | O_NONBLOCK);
+    m_fds[nfd] = {newlisock, POLLIN, 0};
     fds[nfd] = 1;
-    nfds++;
+    nfds = std::max(nfds, nfd + 1);
+    if (this->_metrics) {
+      this->_metrics->accepted.add();
+      this->_metrics->active.add();
+    }
+    MKN_RAM_TRACE(Accept, nfd);
   }
 
  public:
   SocketServer(uint16_t const& p, bool _bind = 1) : mkn::ram::tcp::ASocketServer<T>(p) {
     if (_bind) bind(__MKN_RAM_TCP_BIND_SOCKTOPTS__);
-    memset(m_fds, 0, sizeof(m_fds));
+    for (auto& p : m_fds) p = {-1, 0, 0};
+  }
+  SocketServer(std::string const& path, uint32_t const& mode = _MKN_RAM_TCP_UNIX_MODE_,
+               bool _bind = 1)
+      : mkn::ram::tcp::ASocketServer<T>(0), _socketPath(path), _socketMode(mode) {
+    if (_bind) bind(__MKN_RAM_TCP_BIND_SOCKTOPTS__);
+    for (auto& p : m_fds) p = {-1, 0, 0};
   }
   ~SocketServer() {
-    for (int i = 0; i < _MKN_RAM_TCP_MAX_CLIENT_; i++) ::close(m_fds[i].fd);
+    for (int i = 1; i < _MKN_RAM_TCP_MAX_CLIENT_; i++)
+      if (m_fds[i].fd >= 0) ::close(m_fds[i].fd);
+  }
+  std::string const& socketPath() const { return _socketPath; }
+  std::string clientIP(int const& fd) const {
+    if (!_socketPath.empty()) return _socketPath;
+    char ip[INET6_ADDRSTRLEN] = {0};
+    auto const& addr(cli_addr[fd]);
+    if (addr.ss_family == AF_INET6) {
+      auto const& in6(reinterpret_cast<struct sockaddr_in6 const&>(addr));
+      if (IN6_IS_ADDR_V4MAPPED(&in6.sin6_addr))
+        inet_ntop(AF_INET, &in6.sin6_addr.s6_addr[12], ip, sizeof(ip));
+      else
+        inet_ntop(AF_INET6, &in6.sin6_addr, ip, sizeof(ip));
+    } else if (addr.ss_family == AF_INET)
+      inet_ntop(AF_INET, &reinterpret_cast<struct sockaddr_in const&>(addr).sin_addr, ip,
+                sizeof(ip));
+    return ip;
+  }
+  uint16_t clientPort(int const& fd) const {
+    if (!_socketPath.empty()) return 0;
+    auto const& addr(cli_addr[fd]);
+    if (addr.ss_family == AF_INET6)
+      return ntohs(reinterpret_cast<struct sockaddr_in6 const&>(addr).sin6_port);
+    return ntohs(reinterpret_cast<struct sockaddr_in const&>(addr).sin_port);
   }
   virtual void bind(int sockOpt = __MKN_RAM_TCP_BIND_SOCKTOPTS__) KTHROW(kul::Exception) {
-    lisock = socket(AF_INET, SOCK_STREAM, 0);
+    if (!_socketPath.empty()) return bindUnix();
+    int family = AF_INET;
+#ifndef _MKN_RAM_TCP_IPV4_
+    family = AF_INET6;
+    lisock = socket(AF_INET6, SOCK_STREAM, 0);
+    if (lisock < 0) family = AF_INET;
+#endif  // _MKN_RAM_TCP_IPV4_
+    if (family == AF_INET) lisock = socket(AF_INET, SOCK_STREAM, 0);
+    if (lisock < 0) KEXCEPTION("Socket Server error on socket");
     int iso = 1;
     int rc = setsockopt(lisock, SOL_SOCKET, sockOpt, (char*)&iso, sizeof(iso));
     if (rc < 0) {
       KERR << std::to_string(errno) << " - " << std::string(strerror(errno));
       KEXCEPTION("Socket Server error on setsockopt");
     }
+    if (family == AF_INET6) {
+      int v6only = 0;
+      if (setsockopt(lisock, IPPROTO_IPV6, IPV6_V6ONLY, (char*)&v6only, sizeof(v6only)) < 0)
+        KEXCEPTION("Socket Server error on setsockopt IPV6_V6ONLY");
+    }
 
 #if defined(O_NONBLOCK)
     if (-1 == (iso = fcntl(lisock, F_GETFL, 0))) iso = 0;
@@ -368,17 +642,51 @@ class SocketServer : public ASocketServer<T> {
 #endif
     if (rc < 0) KEXCEPTION("Socket Server error on ioctl");
     bzero((char*)&serv_addr, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_addr.s_addr = INADDR_ANY;
-    serv_addr.sin_port = !kul::byte::isBigEndian()
-                             ? htons(this->port())
-                             : mkn::kul::byte::LittleEndian::UINT32(this->port());
-    int16_t e = 0;
-    if ((e = ::bind(lisock, (struct sockaddr*)&serv_addr, sizeof(serv_addr))) < 0) {
+    socklen_t len = 0;
+    if (family == AF_INET6) {
+      auto& in6(reinterpret_cast<struct sockaddr_in6&>(serv_addr));
+      in6.sin6_family = AF_INET6;
+      in6.sin6_addr = in6addr_any;
+      in6.sin6_port = htons(this->port());
+      len = sizeof(in6);
+    } else {
+      auto& in(reinterpret_cast<struct sockaddr_in&>(serv_addr));
+      in.sin_family = AF_INET;
+      in.sin_addr.s_addr = INADDR_ANY;
+      in.sin_port = htons(this->port());
+      len = sizeof(in);
+    }
+    int e = 0;
+    if ((e = ::bind(lisock, (struct sockaddr*)&serv_addr, len)) < 0) {
       KERR << std::to_string(errno) << " - " << std::string(strerror(errno));
       KEXCEPTION("Socket Server error on binding, errno: " + std::to_string(errno));
     }
   }
+  virtual void bindUnix() KTHROW(kul::Exception) {
+    struct sockaddr_un addr;
+    socklen_t len = 0;
+    if (!Socket<T>::UNIX_ADDRESS(_socketPath, addr, len))
+      KEXCEPTION("Socket Server invalid AF_UNIX path: " + _socketPath);
+    bool const abstract = _socketPath[0] == '@';
+    if (!abstract) {
+      struct stat st;
+      if (::stat(_socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        ::unlink(_socketPath.c_str());
+    }
+    lisock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lisock < 0) KEXCEPTION("Socket Server error on AF_UNIX socket");
+    int iso = 0;
+    if (-1 == (iso = fcntl(lisock, F_GETFL, 0))) iso = 0;
+    if (fcntl(lisock, F_SETFL, iso | O_NONBLOCK) < 0) KEXCEPTION("Socket Server error on fcntl");
+    if (::bind(lisock, (struct sockaddr*)&addr, len) < 0) {
+      KERR << std::to_string(errno) << " - " << std::string(strerror(errno));
+      KEXCEPTION("Socket Server error on binding " + _socketPath + ", errno: " +
+                 std::to_string(errno));
+    }
+    if (!abstract && ::chmod(_socketPath.c_str(), _socketMode) < 0)
+      KEXCEPTION("Socket Server error on chmod " + _socketPath + ", errno: " +
+                 std::to_string(errno));
+  }
   virtual void start() KTHROW(mkn::ram::tcp::Exception) {
     KUL_DBG_FUNC_ENTER
     _started = mkn::kul::Now::MILLIS();
@@ -388,7 +696,7 @@ class SocketServer : public ASocketServer<T> {
     s = true;
     m_fds[0].fd = lisock;
     m_fds[0].events = POLLIN;  //|POLLPRI;
-    nfds = lisock + 1;
+    nfds = 1;
     std::map<int, uint8_t> fds;
     for (size_t i = 0; i < _MKN_RAM_TCP_MAX_CLIENT_; i++) fds.insert(std::make_pair(i, 0));
     try {
@@ -405,8 +713,9 @@ class SocketServer : public ASocketServer<T> {
     KUL_DBG_FUNC_ENTER
     s = 0;
     ::close(lisock);
-    for (int i = 0; i < _MKN_RAM_TCP_MAX_CLIENT_; i++)
-      if (i != lisock) shutdown(i, SHUT_RDWR);
+    if (!_socketPath.empty() && _socketPath[0] != '@') ::unlink(_socketPath.c_str());
+    for (int i = 1; i < _MKN_RAM_TCP_MAX_CLIENT_; i++)
+      if (m_fds[i].fd >= 0) shutdown(m_fds[i].fd, SHUT_RDWR);
   }
 };
 
@@ -85,6 +85,10 @@ class Server : public mkn::ram::http::Server {
   virtual KUL_PUBLISH void handleBuffer(std::map<int, uint8_t>& fds, int const& fd, char* in,
                                         int const& read, int& e);
 
+  // ALPN selection, "h2" when withHttp2 is set and offered, else "http/1.1"
+  static int ALPN(SSL* ssl, unsigned char const** out, unsigned char* outlen,
+                  unsigned char const* in, unsigned int inlen, void* arg);
+
  public:
   Server(short const& p, mkn::kul::File const& c, mkn::kul::File const& k,
          std::string const& cs = "")
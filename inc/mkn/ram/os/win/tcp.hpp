@@ -68,7 +68,12 @@ class Socket : public ASocket<T> {
   }
   virtual bool connect(std::string const& host, int16_t const& port) override {
     KUL_DBG_FUNC_ENTER
+    this->start();
     if (!CONNECT(*this, host, port)) return false;
+    if (this->_readTimeout > 0) {
+      DWORD tv = static_cast<DWORD>(this->_readTimeout);
+      setsockopt(ConnectSocket, SOL_SOCKET, SO_RCVTIMEO, (char const*)&tv, sizeof(tv));
+    }
     this->open = true;
     return true;
   }
@@ -181,6 +186,15 @@ class SocketServer : public ASocketServer<T> {
   virtual int writeTo(int const& fd, T const* const out, size_t size) {
     return ::send(m_fds[fd].fd, out, size, 0);
   }
+  // client sockets block here, so this writes everything or fails
+  virtual int writeSome(int const& fd, T const* const out, size_t size) {
+    return writeTo(fd, out, size);
+  }
+  // true if fd has bytes or a close waiting, does not block
+  bool readable(int const& fd) const {
+    WSAPOLLFD p = {m_fds[fd].fd, POLLRDNORM, 0};
+    return WSAPoll(&p, 1, 0) > 0;
+  }
 
   virtual bool receive(std::map<int, uint8_t>& fds, int const& fd) {
     KUL_DBG_FUNC_ENTER
@@ -265,10 +279,10 @@ class SocketServer : public ASocketServer<T> {
   }
   virtual void validAccept(std::map<int, uint8_t>& fds, int const& newlisock, int const& nfd) {
     KUL_DBG_FUNC_ENTER;
-    KOUT(DBG) << "New connection , socket fd is " << newlisock
-              << ", is : " << inet_ntoa(cli_addr[nfd].sin_addr)
-              << ", port : " << ntohs(cli_addr[nfd].sin_port);
-    this->onConnect(inet_ntoa(cli_addr[nfd].sin_addr), ntohs(cli_addr[nfd].sin_port));
+    auto const ip(clientIP(nfd));
+    KOUT(DBG) << "New connection , socket fd is " << newlisock << ", is : " << ip
+              << ", port : " << clientPort(nfd);
+    this->onConnect(ip.c_str(), clientPort(nfd));
     m_fds[nfd].fd = newlisock;
     m_fds[nfd].events = POLLIN;
     fds[nfd] = 1;
@@ -285,6 +299,18 @@ class SocketServer : public ASocketServer<T> {
   SocketServer(uint16_t const& p, bool _bind = 1) : mkn::ram::tcp::ASocketServer<T>(p) {
     // if(_bind) bind(__MKN_RAM_TCP_BIND_SOCKTOPTS__);
   }
+  SocketServer(std::string const& path, uint32_t const& mode = _MKN_RAM_TCP_UNIX_MODE_,
+               bool _bind = 1)
+      : mkn::ram::tcp::ASocketServer<T>(0) {
+    KEXCEPTION("SocketServer AF_UNIX listeners are not supported on this platform: " + path);
+  }
+  // inet_ntop rather than inet_ntoa, which returns a buffer shared between threads
+  std::string clientIP(int const& fd) const {
+    char ip[INET_ADDRSTRLEN] = {0};
+    inet_ntop(AF_INET, &cli_addr[fd].sin_addr, ip, sizeof(ip));
+    return ip;
+  }
+  uint16_t clientPort(int const& fd) const { return ntohs(cli_addr[fd].sin_port); }
   void freeaddrinfo() {
     if (!result) return;
     ::freeaddrinfo(result);
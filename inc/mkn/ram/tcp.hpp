@@ -31,7 +31,14 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef _MKN_RAM_TCP_HPP_
 #define _MKN_RAM_TCP_HPP_
 
+#include <chrono>
+#include <cstring>
+#include <memory>
+
 #include "mkn/kul/dbg.hpp"
+#include "mkn/ram/metrics.hpp"
+#include "mkn/ram/trace.hpp"
+#include "mkn/ram/tcp/def.hpp"
 
 namespace mkn {
 namespace ram {
@@ -52,8 +59,64 @@ class ASocket {
   virtual size_t read(T* data, size_t const& len, bool& more) KTHROW(mkn::ram::tcp::Exception) = 0;
   virtual size_t write(T const* data, size_t const& len) = 0;
 
+  // milliseconds, <= 0 for no limit, total applies from connect until close
+  ASocket& timeouts(int64_t const& connect, int64_t const& read, int64_t const& total = 0) {
+    _connectTimeout = connect;
+    _readTimeout = read;
+    _totalTimeout = total;
+    return *this;
+  }
+
+  // appends up to chunk readable bytes to the reusable buffer, 0 if the peer has closed
+  size_t fill(size_t const& chunk = _MKN_RAM_TCP_READ_CHUNK_) KTHROW(mkn::ram::tcp::Exception) {
+    if (_cap - _len < chunk) {
+      size_t cap = _cap ? _cap : chunk;
+      while (cap - _len < chunk) cap *= 2;
+      std::unique_ptr<T[]> buf(new T[cap]);
+      if (_len) std::memcpy(buf.get(), _buf.get(), _len * sizeof(T));
+      _buf = std::move(buf);
+      _cap = cap;
+    }
+    bool more = false;
+    size_t const got = read(_buf.get() + _len, chunk, more);
+    _len += got;
+    return got;
+  }
+  T const* data() const { return _buf.get(); }
+  size_t size() const { return _len; }
+  void consume(size_t const& n) {
+    if (n >= _len) {
+      _len = 0;
+      return;
+    }
+    std::memmove(_buf.get(), _buf.get() + n, (_len - n) * sizeof(T));
+    _len -= n;
+  }
+
  protected:
   bool open = 0;
+  int64_t _connectTimeout = _MKN_RAM_TCP_CONNECT_TIMEOUT_, _readTimeout = _MKN_RAM_TCP_READ_TIMEOUT_,
+          _totalTimeout = _MKN_RAM_TCP_TOTAL_TIMEOUT_, _deadline = 0;
+  size_t _cap = 0, _len = 0;
+  std::unique_ptr<T[]> _buf;
+
+  void start() {
+    _len = 0;
+    _deadline = _totalTimeout > 0 ? NOW() + _totalTimeout : 0;
+  }
+  // timeout cut to what is left of the total deadline
+  int64_t bounded(int64_t const& timeout) const {
+    if (!_deadline) return timeout;
+    int64_t const left = std::max<int64_t>(_deadline - NOW(), 1);
+    return timeout > 0 ? std::min(timeout, left) : left;
+  }
+
+ public:
+  static int64_t NOW() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
 };
 
 template <class T = uint8_t>
@@ -65,6 +128,15 @@ class ASocketServer {
   uint16_t const& port() const { return p; }
   bool started() const { return s; }
 
+  // records connections, bytes and what derived servers measure, see mkn/ram/metrics.hpp
+  //  set before start, one registry may be given to several servers, nullptr to disable
+  ASocketServer& withMetrics(std::shared_ptr<metrics::Registry> const& registry) {
+    _metrics.reset(registry ? new metrics::Server(*registry) : nullptr);
+    _registry = registry;
+    return *this;
+  }
+  std::shared_ptr<metrics::Registry> const& registry() const { return _registry; }
+
  protected:
   ASocketServer(uint16_t const& p) : p(p) {}
 
@@ -74,6 +146,8 @@ class ASocketServer {
  protected:
   uint16_t p;
   uint64_t s;
+  std::shared_ptr<metrics::Registry> _registry;
+  std::unique_ptr<metrics::Server> _metrics;
 };
 
 }  // namespace tcp
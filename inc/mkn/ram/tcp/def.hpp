@@ -51,6 +51,42 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define _MKN_RAM_TCP_REQUEST_BUFFER_ 963210
 #endif /* _MKN_RAM_TCP_REQUEST_BUFFER_ */
 
+#ifndef _MKN_RAM_TCP_UNIX_MODE_
+#define _MKN_RAM_TCP_UNIX_MODE_ 0660  // permissions for filesystem AF_UNIX listeners
+#endif                                /* _MKN_RAM_TCP_UNIX_MODE_ */
+
+#ifndef _MKN_RAM_TCP_CONNECT_ATTEMPT_DELAY_
+#define _MKN_RAM_TCP_CONNECT_ATTEMPT_DELAY_ 250  // ms between happy eyeballs attempts
+#endif                                           /* _MKN_RAM_TCP_CONNECT_ATTEMPT_DELAY_ */
+
+#ifndef _MKN_RAM_TCP_CONNECT_TIMEOUT_
+#define _MKN_RAM_TCP_CONNECT_TIMEOUT_ 10000  // milliseconds, <= 0 for OS default
+#endif                                       /* _MKN_RAM_TCP_CONNECT_TIMEOUT_ */
+
+#ifndef _MKN_RAM_TCP_READ_TIMEOUT_
+#define _MKN_RAM_TCP_READ_TIMEOUT_ 1500  // milliseconds of inactivity, <= 0 for none
+#endif                                   /* _MKN_RAM_TCP_READ_TIMEOUT_ */
+
+#ifndef _MKN_RAM_TCP_TOTAL_TIMEOUT_
+#define _MKN_RAM_TCP_TOTAL_TIMEOUT_ 0  // milliseconds from connect, <= 0 for none
+#endif                                 /* _MKN_RAM_TCP_TOTAL_TIMEOUT_ */
+
+#ifndef _MKN_RAM_TCP_OUT_HIGH_
+#define _MKN_RAM_TCP_OUT_HIGH_ 1048576  // bytes queued for a client before reads from it pause
+#endif                                  /* _MKN_RAM_TCP_OUT_HIGH_ */
+
+#ifndef _MKN_RAM_TCP_OUT_LOW_
+#define _MKN_RAM_TCP_OUT_LOW_ 262144  // bytes queued for a paused client before reads resume
+#endif                                /* _MKN_RAM_TCP_OUT_LOW_ */
+
+#ifndef _MKN_RAM_TCP_READ_CHUNK_
+#define _MKN_RAM_TCP_READ_CHUNK_ 16384
+#endif /* _MKN_RAM_TCP_READ_CHUNK_ */
+
+#ifndef _MKN_RAM_METRICS_SHARDS_
+#define _MKN_RAM_METRICS_SHARDS_ 16  // cache line padded cells per metric, threads spread over them
+#endif                               /* _MKN_RAM_METRICS_SHARDS_ */
+
 #ifdef _WIN32
 #define bzero ZeroMemory
 #endif
@@ -0,0 +1,91 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef _MKN_RAM_TRACE_HPP_
+#define _MKN_RAM_TRACE_HPP_
+
+#include <atomic>
+#include <cstdint>
+
+#if defined(_MKN_RAM_TRACE_) && defined(_MKN_RAM_TRACE_SDT_)
+#include <sys/sdt.h>
+#endif
+
+namespace mkn {
+namespace ram {
+namespace trace {
+
+// points in a request's life, fd is the server's slot for the connection
+//  FirstByte is each read that starts or continues a request, FirstWrite once a response is
+//  written or queued, Headers, HandlerStart and HandlerEnd are per request or HTTP/2 stream
+enum class Phase : uint8_t {
+  Accept = 0,
+  Handshake,
+  FirstByte,
+  Headers,
+  HandlerStart,
+  HandlerEnd,
+  FirstWrite,
+  Close
+};
+
+typedef void (*Hook)(Phase const& phase, int const& fd);
+
+inline std::atomic<Hook>& HOOK() {
+  static std::atomic<Hook> h{nullptr};
+  return h;
+}
+
+// called from every probe on the thread reaching it, nullptr to stop
+//  probes only exist when built with _MKN_RAM_TRACE_, otherwise this has no effect
+inline void hook(Hook const& h) { HOOK().store(h, std::memory_order_release); }
+
+inline void PROBE(Phase const& phase, int const& fd) {
+  if (auto const h = HOOK().load(std::memory_order_acquire)) h(phase, fd);
+}
+
+}  // namespace trace
+}  // namespace ram
+}  // namespace mkn
+
+#if defined(_MKN_RAM_TRACE_) && defined(_MKN_RAM_TRACE_SDT_)
+// also a USDT probe, e.g. bpftrace -e 'usdt:./server:mkn_ram:HandlerStart { ... }'
+#define MKN_RAM_TRACE(phase, fd)                               \
+  do {                                                         \
+    DTRACE_PROBE1(mkn_ram, phase, fd);                         \
+    mkn::ram::trace::PROBE(mkn::ram::trace::Phase::phase, fd); \
+  } while (0)
+#elif defined(_MKN_RAM_TRACE_)
+#define MKN_RAM_TRACE(phase, fd) mkn::ram::trace::PROBE(mkn::ram::trace::Phase::phase, fd)
+#else
+#define MKN_RAM_TRACE(phase, fd) (void)(fd)
+#endif
+
+#endif /* _MKN_RAM_TRACE_HPP_ */
@@ -38,7 +38,7 @@ void mkn::ram::http::MultiServer::start() KTHROW(kul::tcp::Exception) {
   s = true;
   m_fds[0].fd = lisock;
   m_fds[0].events = POLLIN;  //|POLLPRI;
-  nfds = lisock + 1;
+  nfds = 1;
 
   for (size_t i = 0; i < _acceptThreads; i++)
     _acceptPool.async(std::bind(&MultiServer::operateAccept, std::ref(*this), i));
@@ -29,23 +29,39 @@ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include "mkn/ram/http.hpp"
+#include "mkn/ram/http/co.hpp"
+
+int mkn::ram::http::Server::poll(int timeout) {
+  auto const tasks = _tasks;
+  if (!tasks) return AServer::poll(timeout);
+  _pollfds.assign(m_fds, m_fds + nfds);
+  tasks->prepare(_pollfds, timeout);
+  auto const p = ::poll(_pollfds.data(), _pollfds.size(), timeout);
+  if (p < 0 && errno == EINTR) return 0;
+  if (p < 0) KLOG(ERR) << std::to_string(errno) << " - " << std::string(strerror(errno));
+  if (p < 0) return p;
+  for (int i = 0; i < nfds; i++) m_fds[i].revents = _pollfds[i].revents;
+  tasks->polled(_pollfds.data() + nfds, _pollfds.size() - nfds);
+  return p;
+}
 
 bool mkn::ram::http::Server::receive(std::map<int, uint8_t>& fds, int const& fd) {
   KUL_DBG_FUNC_ENTER;
   char* in = getOrCreateBufferFor(fd);
   bzero(in, _MKN_RAM_TCP_READ_BUFFER_);
   int e = 0, read = readFrom(fd, in);
-  if (read < 0)
+  if (read < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return false;  // nothing yet
     e = -1;
-  else if (read > 0) {
+  } else if (read > 0) {
+    MKN_RAM_TRACE(FirstByte, fd);
     fds[fd] = 2;
     handleBuffer(fds, fd, in, read, e);
     if (e) return false;
   } else {
-    getpeername(m_fds[fd].fd, (struct sockaddr*)&cli_addr[fd], (socklen_t*)&clilen);
-    onDisconnect(inet_ntoa(cli_addr[fd].sin_addr), ntohs(cli_addr[fd].sin_port));
-    KOUT(DBG) << "DISCO,  " << inet_ntoa(cli_addr[fd].sin_addr)
-              << ", port : " << ntohs(cli_addr[fd].sin_port);
+    auto const ip(clientIP(fd));
+    onDisconnect(ip.c_str(), clientPort(fd));
+    KOUT(DBG) << "DISCO,  " << ip << ", port : " << clientPort(fd);
   }
   if (e < 0) KLOG(ERR) << "Error on receive: " << strerror(errno);
   return true;
@@ -0,0 +1,316 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifdef _MKN_RAM_INCLUDE_HTTPS_
+#include <fcntl.h>
+#include <poll.h>
+
+#include "mkn/ram/http/h2.hpp"
+#include "mkn/ram/https.hpp"
+
+namespace {
+using mkn::ram::http::hpack::Fields;
+
+int64_t NOW() { return mkn::ram::tcp::ASocket<char>::NOW(); }
+
+bool HOP_BY_HOP(std::string_view const& n) {
+  return n == "connection" || n == "keep-alive" || n == "proxy-connection" ||
+         n == "transfer-encoding" || n == "upgrade" || n == "host";
+}
+
+void TIMEOUT(int const& sck, int64_t const& ms) {
+  if (ms <= 0) return;
+  struct timeval tv;
+  tv.tv_sec = ms / 1000;
+  tv.tv_usec = (ms % 1000) * 1000;
+  setsockopt(sck, SOL_SOCKET, SO_RCVTIMEO, (char const*)&tv, sizeof(tv));
+  setsockopt(sck, SOL_SOCKET, SO_SNDTIMEO, (char const*)&tv, sizeof(tv));
+}
+
+bool NON_BLOCKING(int const& fd) {
+  return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != -1;
+}
+
+Fields FIELDS(mkn::ram::http::A1_1Request const& r) {
+  std::string path("/" + r.path()), authority(r.host());
+  if (r.method() == "GET") {
+    char sep = '?';
+    for (auto const& p : r.attributes()) {
+      path += sep + p.first + "=" + p.second;
+      sep = '&';
+    }
+  }
+  if (r.port() != 443) authority += ":" + std::to_string(r.port());
+  Fields fs{
+      {":method", r.method()}, {":scheme", "https"}, {":authority", authority}, {":path", path}};
+  for (auto const& h : r.headers()) {
+    std::string n(h.first);
+    std::transform(n.begin(), n.end(), n.begin(), ::tolower);
+    if (HOP_BY_HOP(n) || (n == "te" && h.second != "trailers")) continue;
+    fs.emplace_back(std::move(n), std::string(h.second));
+  }
+  if (r.cookies().size()) {
+    std::string c;
+    for (auto const& p : r.cookies()) c += (c.empty() ? "" : "; ") + p.first + "=" + p.second;
+    fs.emplace_back("cookie", std::move(c));
+  }
+  if (r.body().size() && !r.header(mkn::ram::http::HeaderID::ContentLength))
+    fs.emplace_back("content-length", std::to_string(r.body().size()));
+  return fs;
+}
+
+mkn::ram::http::_1_1Response RESPONSE(mkn::ram::http::h2::Stream const& s) {
+  mkn::ram::http::_1_1Response res;
+  res.reason("");
+  for (auto const& f : s.headers) {
+    if (f.first == ":status")
+      res.status(uint16_t(std::strtoul(f.second.c_str(), nullptr, 10)));
+    else if (f.first == "set-cookie") {
+      auto const eq = f.second.find('=');
+      if (eq == std::string::npos)
+        res.cookie(f.second, std::string());
+      else
+        res.cookie(f.second.substr(0, eq), f.second.substr(eq + 1));
+    } else if (f.first[0] != ':')
+      res.header(f.first, f.second);
+  }
+  res.body(s.body);
+  return res;
+}
+}  // namespace
+
+mkn::ram::https::Http2Client::Http2Client(std::string const& host, uint16_t const& port)
+    : _host(host), _port(port) {}
+
+mkn::ram::https::Http2Client::~Http2Client() {
+  {
+    std::lock_guard<std::mutex> l(_mutex);
+    _stop = 1;
+    wake();
+  }
+  if (_io.joinable()) _io.join();
+}
+
+void mkn::ram::https::Http2Client::connect(http::A1_1Request const& r) {
+  KUL_DBG_FUNC_ENTER
+  if (_io.joinable()) _io.join();  // finished with the previous connection
+  int sck = -1;
+  if (!mkn::ram::tcp::Socket<char>::CONNECT(sck, _host, _port, r._connectTimeout))
+    KEXCEPT(mkn::ram::http::Exception, "Failed to connect to host: " + _host);
+  _sck = sck;
+  TIMEOUT(_sck, r._readTimeout);
+  _ssl = SSL_new(SSLReqHelper::INSTANCE().ctx);
+  SSL_set_tlsext_host_name(_ssl, _host.c_str());
+  SSL_set_alpn_protos(_ssl, (unsigned char const*)"\x02h2", 3);
+  SSL_set_fd(_ssl, _sck);
+  unsigned char const* alpn = nullptr;
+  unsigned int len = 0;
+  if (SSL_connect(_ssl) == 1) SSL_get0_alpn_selected(_ssl, &alpn, &len);
+  if (len != 2 || std::memcmp(alpn, "h2", 2) || !NON_BLOCKING(_sck) ||
+      socketpair(AF_UNIX, SOCK_STREAM, 0, _wake) != 0 || !NON_BLOCKING(_wake[0]) ||
+      !NON_BLOCKING(_wake[1])) {
+    disconnect();
+    KEXCEPT(mkn::ram::http::Exception, "HTTP/2 over TLS not negotiated with host: " + _host);
+  }
+  _c = std::make_unique<http::h2::Connection>(
+      http::h2::Connection::Role::Client, [this](http::h2::Connection&, http::h2::Stream& s) {
+        auto const it = _pending.find(s.id);
+        if (it == _pending.end()) return;
+        it->second->res = RESPONSE(s);
+        it->second->done = 1;
+      });
+  _active = NOW();
+  _stop = 0;
+  _io = std::thread(&Http2Client::run, this);
+}
+
+void mkn::ram::https::Http2Client::disconnect() {
+  _c.reset();
+  if (_ssl) SSL_free(_ssl);
+  _ssl = nullptr;
+  for (auto* fd : {&_sck, &_wake[0], &_wake[1]}) {
+    if (*fd >= 0) ::close(*fd);
+    *fd = -1;
+  }
+}
+
+void mkn::ram::https::Http2Client::wake() {
+  if (_wake[1] < 0) return;
+  ssize_t const w = ::write(_wake[1], "", 1);  // a full pipe already wakes the I/O thread
+  (void)w;
+}
+
+bool mkn::ram::https::Http2Client::write() {
+  auto& out = _c->output();
+  while (out.size()) {
+    int const n = SSL_write(_ssl, out.data(), int(out.size()));
+    if (n > 0) {
+      out.erase(0, n);
+      continue;
+    }
+    int const e = SSL_get_error(_ssl, n);
+    if (e != SSL_ERROR_WANT_WRITE && e != SSL_ERROR_WANT_READ) return false;
+    pollfd p{_sck, short(e == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT), 0};
+    if (::poll(&p, 1, _MKN_RAM_TCP_READ_TIMEOUT_) <= 0) return false;
+  }
+  return true;
+}
+
+void mkn::ram::https::Http2Client::run() {
+  KUL_DBG_FUNC_ENTER
+  std::unique_lock<std::mutex> l(_mutex);
+  char buf[_MKN_RAM_TCP_REQUEST_BUFFER_];
+  bool ok = 1;
+  while (ok && !_stop && !_c->closed() && write()) {
+    if (!SSL_pending(_ssl)) {
+      pollfd fds[2] = {{_sck, POLLIN, 0}, {_wake[0], POLLIN, 0}};
+      l.unlock();
+      int const n = ::poll(fds, 2, -1);
+      l.lock();
+      if (n < 0 && errno != EINTR) break;
+      if (fds[1].revents)
+        while (::read(_wake[0], buf, sizeof(buf)) > 0) {
+        }
+      if (!fds[0].revents) continue;
+    }
+    while (ok) {
+      int const d = SSL_read(_ssl, buf, sizeof(buf));
+      if (d <= 0) {
+        int const e = SSL_get_error(_ssl, d);
+        ok = e == SSL_ERROR_WANT_READ || e == SSL_ERROR_WANT_WRITE;
+        break;
+      }
+      _active = NOW();
+      ok = _c->receive(buf, d);
+    }
+    for (auto const& p : _pending)  // reset by the peer or beyond its GOAWAY
+      if (!p.second->done && !_c->stream(p.first)) p.second->failed = 1;
+    _cv.notify_all();
+  }
+  write();
+  for (auto const& p : _pending)
+    if (!p.second->done) p.second->failed = 1;
+  disconnect();
+  _cv.notify_all();
+}
+
+uint32_t mkn::ram::https::Http2Client::submit(std::unique_lock<std::mutex>& l,
+                                               http::A1_1Request const& r, Pending& p) {
+  auto const fields = FIELDS(r);
+  int64_t const deadline = r._totalTimeout > 0 ? NOW() + r._totalTimeout : 0;
+  uint32_t id = 0;
+  while (!(id = _c ? _c->request(fields, r.body()) : 0)) {
+    if (!_c) {
+      connect(r);
+      continue;
+    }
+    // at the peer's stream limit, or going away, wait for streams to end or a new connection
+    if (!_c->streams()) {
+      _c->goAway();
+      wake();
+    }
+    if (deadline && NOW() >= deadline)
+      KEXCEPT(mkn::ram::http::Exception, "Timed out waiting for a stream to host: " + _host);
+    _cv.wait_for(l, std::chrono::milliseconds(100));
+  }
+  p.started = NOW();
+  _pending[id] = &p;
+  wake();
+  return id;
+}
+
+bool mkn::ram::https::Http2Client::wait(std::unique_lock<std::mutex>& l,
+                                        http::A1_1Request const& r, uint32_t const& id,
+                                        Pending& p) {
+  int64_t const total = r._totalTimeout > 0 ? p.started + r._totalTimeout : 0;
+  while (!p.done && !p.failed) {
+    int64_t const now = NOW();
+    int64_t until = total;
+    if (r._readTimeout > 0) {
+      int64_t const idle = std::max(_active, p.started) + r._readTimeout;
+      until = until ? std::min(until, idle) : idle;
+    }
+    if (until && now >= until) {
+      if (_c && _c->stream(id)) {
+        _c->reset(id, http::h2::Error::Cancel);
+        wake();
+      }
+      p.failed = 1;
+    } else if (until)
+      _cv.wait_for(l, std::chrono::milliseconds(until - now));
+    else
+      _cv.wait(l);
+  }
+  _pending.erase(id);
+  return p.done;
+}
+
+void mkn::ram::https::Http2Client::send(http::A1_1Request& r) KTHROW(mkn::ram::http::Exception) {
+  send(std::vector<http::A1_1Request*>{&r});
+}
+
+void mkn::ram::https::Http2Client::send(std::vector<http::A1_1Request*> const& rs)
+    KTHROW(mkn::ram::http::Exception) {
+  KUL_DBG_FUNC_ENTER
+  std::vector<Pending> ps(rs.size());
+  std::vector<uint32_t> ids(rs.size(), 0);
+  {
+    std::unique_lock<std::mutex> l(_mutex);
+    try {
+      for (size_t i = 0; i < rs.size(); i++) ids[i] = submit(l, *rs[i], ps[i]);
+    } catch (mkn::kul::Exception const& e) {
+      KLOG(ERR) << e.debug();
+    }
+    for (size_t i = 0; i < rs.size(); i++)
+      if (ids[i]) wait(l, *rs[i], ids[i], ps[i]);
+  }
+  size_t failed = 0;
+  for (size_t i = 0; i < rs.size(); i++)
+    if (ps[i].done)
+      rs[i]->handleResponse(ps[i].res);
+    else
+      failed++;
+  if (failed)
+    KEXCEPT(mkn::ram::http::Exception,
+            std::to_string(failed) + " HTTP/2 request(s) failed with host: " + _host);
+}
+
+std::shared_ptr<mkn::ram::https::Http2Client> mkn::ram::https::Http2Client::POOLED(
+    std::string const& host, uint16_t const& port) {
+  SSLReqHelper::INSTANCE();  // constructed first so OpenSSL outlives the pool at exit
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::shared_ptr<Http2Client>> pool;
+  std::lock_guard<std::mutex> l(mutex);
+  auto& c = pool[host + ":" + std::to_string(port)];
+  if (!c) c = std::make_shared<Http2Client>(host, port);
+  return c;
+}
+
+#endif  //_MKN_RAM_INCLUDE_HTTPS_
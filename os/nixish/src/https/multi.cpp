@@ -39,7 +39,7 @@ void mkn::ram::https::MultiServer::start() KTHROW(kul::tcp::Exception) {
   s = true;
   m_fds[0].fd = lisock;
   m_fds[0].events = POLLIN;  //|POLLPRI;
-  nfds = lisock + 1;
+  nfds = 1;
 
   for (size_t i = 0; i < _acceptThreads; i++)
     _acceptPool.async(std::bind(&MultiServer::operateAccept, std::ref(*this), i));
@@ -31,39 +31,71 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifdef _MKN_RAM_INCLUDE_HTTPS_
 #include "mkn/ram/https.hpp"
 
+namespace {
+// blocking socket timeouts for OpenSSL, bounded by the remaining total deadline
+bool SOCKET_TIMEOUT(int const& sck, int64_t const& timeout, int64_t const& deadline) {
+  int64_t ms = timeout > 0 ? timeout : 0;
+  if (deadline) {
+    int64_t const left = deadline - mkn::ram::tcp::ASocket<char>::NOW();
+    if (left <= 0) return false;
+    ms = ms ? std::min(ms, left) : left;
+  }
+  struct timeval tv;
+  tv.tv_sec = ms / 1000;
+  tv.tv_usec = (ms % 1000) * 1000;
+  setsockopt(sck, SOL_SOCKET, SO_RCVTIMEO, (char const*)&tv, sizeof(tv));
+  setsockopt(sck, SOL_SOCKET, SO_SNDTIMEO, (char const*)&tv, sizeof(tv));
+  return true;
+}
+}  // namespace
+
 void mkn::ram::https::Requester::send(std::string const& h, std::string const& req,
-                                      uint16_t const& p, std::stringstream& ss, SSL* ssl) {
+                                      uint16_t const& p, std::stringstream& ss, SSL* ssl,
+                                      int64_t const& connectTimeout, int64_t const& readTimeout,
+                                      int64_t const& totalTimeout) {
   KUL_DBG_FUNC_ENTER
+  int64_t const deadline =
+      totalTimeout > 0 ? mkn::ram::tcp::ASocket<char>::NOW() + totalTimeout : 0;
+  int64_t connect = connectTimeout;
+  if (totalTimeout > 0 && (connect <= 0 || connect > totalTimeout)) connect = totalTimeout;
   int sck = 0;
-  if (!mkn::ram::tcp::Socket<char>::SOCKET(sck, PF_INET, SOCK_STREAM, 0))
-    KEXCEPT(mkn::ram::http::Exception, "Error opening socket");
-  if (!mkn::ram::tcp::Socket<char>::CONNECT(sck, h, p))
+  if (!mkn::ram::tcp::Socket<char>::CONNECT(sck, h, p, connect))
     KEXCEPT(mkn::ram::http::Exception, "Failed to connect to host: " + h);
+  std::unique_ptr<int, void (*)(int*)> closer(&sck, [](int* s) { ::close(*s); });
+  if (!SOCKET_TIMEOUT(sck, readTimeout, deadline))
+    KEXCEPT(mkn::ram::http::Exception, "Timed out connecting to host: " + h);
   SSL_set_fd(ssl, sck);
   if (SSL_connect(ssl) == -1) KEXCEPTION("HTTPS REQUEST INIT FAILED");
   SSL_write(ssl, req.c_str(), req.size());
   char buffer[_MKN_RAM_TCP_REQUEST_BUFFER_];
-  int64_t d = 0, i = 0;
+  std::string rec;
+  mkn::ram::http::A1_1Request::Completion c;
   do {
-    bzero(buffer, _MKN_RAM_TCP_REQUEST_BUFFER_);
-    d = SSL_read(ssl, buffer, _MKN_RAM_TCP_REQUEST_BUFFER_ - 1);
-    if (d == 0) break;
-    if (d < 0) {
-      short se = 0;
-      SSL_get_error(ssl, se);
-      if (se) KLOG(ERR) << "SSL_get_error: " << se;
-      break;
+    if (!SOCKET_TIMEOUT(sck, readTimeout, deadline))
+      KEXCEPT(mkn::ram::http::Exception, "Timed out reading from host: " + h);
+    int const d = SSL_read(ssl, buffer, _MKN_RAM_TCP_REQUEST_BUFFER_ - 1);
+    if (d > 0) {
+      rec.append(buffer, d);
+      continue;
     }
-    for (i = 0; i < d; i++) ss << buffer[i];
-  } while (true);
-  ::close(sck);
+    auto const en = errno;
+    auto const se = SSL_get_error(ssl, d);
+    // SO_RCVTIMEO expiring surfaces as EAGAIN under the read
+    if (se == SSL_ERROR_WANT_READ ||
+        (se == SSL_ERROR_SYSCALL && (en == EAGAIN || en == EWOULDBLOCK)))
+      KEXCEPT(mkn::ram::http::Exception, "Timed out reading from host: " + h);
+    if (se != SSL_ERROR_ZERO_RETURN) KLOG(DBG) << "SSL_get_error: " << se;
+    break;
+  } while (!mkn::ram::http::A1_1Request::COMPLETE(rec.data(), rec.size(), c));
+  ss << rec;
 }
 
 void mkn::ram::https::_1_1GetRequest::send() KTHROW(mkn::ram::http::Exception) {
   KUL_DBG_FUNC_ENTER
   try {
     std::stringstream ss;
-    Requester::send(_host, toString(), _port, ss, ssl);
+    Requester::send(_host, toString(), _port, ss, ssl, _connectTimeout, _readTimeout,
+                    _totalTimeout);
 
     auto rec(ss.str());
     mkn::ram::http::_1_1Response res(mkn::ram::http::_1_1Response::FROM_STRING(rec));
@@ -78,7 +110,8 @@ void mkn::ram::https::_1_1PostRequest::send() KTHROW(mkn::ram::http::Exception)
   KUL_DBG_FUNC_ENTER
   try {
     std::stringstream ss;
-    Requester::send(_host, toString(), _port, ss, ssl);
+    Requester::send(_host, toString(), _port, ss, ssl, _connectTimeout, _readTimeout,
+                    _totalTimeout);
 
     auto rec(ss.str());
     mkn::ram::http::_1_1Response res(mkn::ram::http::_1_1Response::FROM_STRING(rec));
@@ -31,70 +31,77 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifdef _MKN_RAM_INCLUDE_HTTPS_
 #include "mkn/ram/https.hpp"
 
-void mkn::ram::https::Server::loop(std::map<int, uint8_t>& fds) KTHROW(kul::tcp::Exception) {
+void mkn::ram::https::Server::validAccept(std::map<int, uint8_t>& fds, int const& newlisock,
+                                          int const& nfd) {
   KUL_DBG_FUNC_ENTER
-
-  auto ret = poll(100);
-
-  if (!s) return;
-  if (ret < 0) {
-    KLOG(ERR) << "HTTPS Server error on poll: " << std::to_string(errno) + " - "
-              << std::string(strerror(errno));
+  auto ssl = SSL_new(ctx);
+  if (!ssl) {
+    ::close(newlisock);
+    KLOG(ERR) << "HTTPS Server ssl failed to initialise";
+    return;
+  }
+  SSL_set_fd(ssl, newlisock);
+  auto const begun = metrics::Histogram::Clock::now();
+  int const ssl_err = SSL_accept(ssl);
+  if (_metrics) _metrics->handshake.since(begun);
+  if (ssl_err <= 0) {
+    KERR << "HTTPS Server SSL ERROR on SSL_ACCEPT error: " << ssl_err << " :"
+         << SSL_get_error(ssl, ssl_err);
+    SSL_free(ssl);
+    ::close(newlisock);
     return;
   }
-  if (ret == 0) return;
-  int newlisock = -1;
+  MKN_RAM_TRACE(Handshake, nfd);
+  X509* cc = SSL_get_peer_certificate(ssl);
+  if (cc != NULL) {
+    KLOG(DBG) << "Client certificate:";
+    KLOG(DBG) << "\t subject: " << X509_NAME_oneline(X509_get_subject_name(cc), 0, 0);
+    KLOG(DBG) << "\t issuer: %s\n" << X509_NAME_oneline(X509_get_issuer_name(cc), 0, 0);
+    X509_free(cc);
+  }  // else KLOG(ERR) << "Client does not have certificate.";
+  ssl_clients[newlisock] = ssl;
+  mkn::ram::http::Server::validAccept(fds, newlisock, nfd);
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+  unsigned char const* alpn = 0;
+  unsigned int alpnLen = 0;
+  SSL_get0_alpn_selected(ssl, &alpn, &alpnLen);
+  if (alpnLen == 2 && !memcmp(alpn, "h2", 2)) http2Start(nfd);
+#endif
+}
 
-  for (auto const& pair : fds) {
-    auto& i = pair.first;
-    if (pair.second == 1) continue;
-    if (m_fds[i].revents == 0) continue;
-    if (m_fds[i].revents != POLLIN) {
-      KLOG(ERR) << "HTTPS Server error on pollin " << std::to_string(m_fds[i].revents);
-    }
+int mkn::ram::https::Server::transmit(int const& fd, struct iovec const* const parts,
+                                      size_t const& n) {
+  int w = 0;
+  for (size_t i = 0; i < n; i++) {
+    auto const t = transmit(fd, static_cast<char const*>(parts[i].iov_base), parts[i].iov_len);
+    if (t < 0) return w ? w : t;
+    w += t;
+    if (size_t(t) < parts[i].iov_len) break;
+  }
+  return w;
+}
 
-    if (m_fds[i].fd == lisock) {
-      do {
-        int newFD = nfds;
-        while (1) {
-          newFD++;
-          if (fds.count(newFD) && !fds[newFD]) break;
-        }
-        newlisock = accept(newFD);
-        KLOG(DBG) << "lisock: " << lisock << ", newlisock: " << newlisock;
-        if (newlisock < 0) {
-          if (errno != EWOULDBLOCK) KEXCEPTION("HTTPS Server error on accept");
-          break;
-        }
-        ssl_clients[newlisock] = SSL_new(ctx);
-        if (!ssl_clients[newlisock]) KEXCEPTION("HTTPS Server ssl failed to initialise");
-        SSL_set_fd(ssl_clients[newlisock], newlisock);
-        int16_t ssl_err = SSL_accept(ssl_clients[newlisock]);
-        if (ssl_err <= 0) {
-          short se = 0;
-          SSL_get_error(ssl_clients[newlisock], se);
-          SSL_shutdown(ssl_clients[newlisock]);
-          SSL_free(ssl_clients[newlisock]);
-          ::close(newlisock);
-          KERR << "HTTPS Server SSL ERROR on SSL_ACCEPT error: " << ssl_err << " :" << se;
-          KEXCEPTION("HTTPS Server SSL ERROR on SSL_ACCEPT error");
-        }
-        X509* cc = SSL_get_peer_certificate(ssl_clients[newlisock]);
-        if (cc != NULL) {
-          KLOG(DBG) << "Client certificate:";
-          KLOG(DBG) << "\t subject: " << X509_NAME_oneline(X509_get_subject_name(cc), 0, 0);
-          KLOG(DBG) << "\t issuer: %s\n" << X509_NAME_oneline(X509_get_issuer_name(cc), 0, 0);
-          X509_free(cc);
-        }  // else KLOG(ERR) << "Client does not have certificate.";
+int mkn::ram::https::Server::transmit(int const& fd, char const* const out, size_t const& size) {
+  auto const ssl = ssl_clients[m_fds[fd].fd];
+  if (!ssl) return -1;
+  auto const w = ::SSL_write(ssl, out, size);
+  if (w > 0 && _metrics) _metrics->sent.add(w);
+  if (w > 0) return w;
+  auto const err = SSL_get_error(ssl, w);
+  return err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ ? 0 : -1;
+}
 
-        validAccept(fds, newlisock, newFD);
-      } while (newlisock != -1);
-    }
-  }
-  std::vector<int> del;
-  for (auto const& pair : fds)
-    if (pair.second == 1 && receive(fds, pair.first)) del.push_back(pair.first);
-  if (del.size()) closeFDs(fds, del);
+bool mkn::ram::https::Server::pending(int const& fd) {
+  auto const ssl = ssl_clients[m_fds[fd].fd];
+  return ssl && SSL_pending(ssl) > 0;
+}
+
+void mkn::ram::https::Server::closed(int const& fd) {
+  auto& ssl = ssl_clients[m_fds[fd].fd];
+  if (!ssl) return;
+  SSL_shutdown(ssl);
+  SSL_free(ssl);
+  ssl = 0;
 }
 
 void mkn::ram::https::Server::setChain(mkn::kul::File const& f) {
@@ -119,19 +126,39 @@ mkn::ram::https::Server& mkn::ram::https::Server::init() {
   if (!SSL_CTX_check_private_key(ctx)) KEXCEPTION("HTTPS Server SSL_CTX_check_private_key failed");
   if (!cs.empty() && !SSL_CTX_set_cipher_list(ctx, cs.c_str()))
     KEXCEPTION("HTTPS Server SSL_CTX_set_cipher_listctx failed");
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+  SSL_CTX_set_alpn_select_cb(ctx, ALPN, this);
+#endif
+  SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
   return *this;
 }
 
+int mkn::ram::https::Server::ALPN(SSL* ssl, unsigned char const** out, unsigned char* outlen,
+                                  unsigned char const* in, unsigned int inlen, void* arg) {
+  (void)ssl;
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+  static constexpr unsigned char PROTOS[] = "\x02h2\x08http/1.1";
+  bool const h2 = static_cast<Server*>(arg)->_http2;
+  if (SSL_select_next_proto(const_cast<unsigned char**>(out), outlen, h2 ? PROTOS : PROTOS + 3,
+                            h2 ? 12 : 9, in, inlen) == OPENSSL_NPN_NEGOTIATED)
+    return SSL_TLSEXT_ERR_OK;
+#else
+  (void)out, (void)outlen, (void)in, (void)inlen, (void)arg;
+#endif
+  return SSL_TLSEXT_ERR_NOACK;
+}
+
 void mkn::ram::https::Server::stop() {
   KUL_DBG_FUNC_ENTER
   s = 0;
   ERR_free_strings();
   EVP_cleanup();
   for (size_t i = 0; i < _MKN_RAM_TCP_MAX_CLIENT_; i++) {
-    auto ssl = ssl_clients[i];
+    auto& ssl = ssl_clients[i];
     if (ssl) {
       SSL_shutdown(ssl);
       SSL_free(ssl);
+      ssl = 0;
     }
   }
   if (ctx) SSL_CTX_free(ctx);
@@ -142,9 +169,40 @@ void mkn::ram::https::Server::handleBuffer(std::map<int, uint8_t>& fds, int cons
                                            int const& read, int& e) {
   KUL_DBG_FUNC_ENTER
   in[read] = '\0';
+  {
+    std::string out;
+    if (handleHttp2(fd, in, read, out, e)) {
+      auto const begun = metrics::Histogram::Clock::now();
+      if (out.size()) writeTo(fd, out.data(), out.size());
+      if (out.size()) MKN_RAM_TRACE(FirstWrite, fd);
+      if (_metrics && out.size()) _metrics->write.since(begun);
+      fds[fd] = 1;
+      return;
+    }
+  }
+  if (handleForm(fd, in, read, e) || handleTask(fd, e)) {
+    fds[fd] = 1;
+    return;
+  }
+  auto const m = _metrics.get();
+  Static::Variant v;
+  std::string_view st[3];
+  if (staticResponse(in, read, v, st)) {
+    record(fd, in, read, v.status, v.body, {});
+    auto const begun = metrics::Histogram::Clock::now();
+    writeStatic(fd, st);
+    MKN_RAM_TRACE(FirstWrite, fd);
+    if (m) {
+      m->write.since(begun);
+      m->status(v.status);
+    }
+    e = 0;
+    fds[fd] = 1;
+    return;
+  }
   std::string res;
   try {
-    std::string s(in);
+    std::string s(in, read);
     std::string c(s.substr(0, (s.size() > 9) ? 10 : s.size()));
     std::vector<char> allowed = {'D', 'G', 'P', '/', 'H'};
     bool f = 0;
@@ -153,10 +211,25 @@ void mkn::ram::https::Server::handleBuffer(std::map<int, uint8_t>& fds, int cons
       if (f) break;
     }
     if (!f) KEXCEPTION("Logic error encountered, probably https attempt on http port");
+    auto begun = metrics::Histogram::Clock::now();
     std::shared_ptr<mkn::ram::http::A1_1Request> req = handleRequest(fd, s, res);
-    mkn::ram::http::_1_1Response const& rs(respond(*req.get()));
-    std::string ret(rs.toString());
-    ::SSL_write(ssl_clients[m_fds[fd].fd], ret.c_str(), ret.length());
+    if (m) m->parse.since(begun);
+    MKN_RAM_TRACE(Headers, fd);
+    std::string ret;
+    if (openTask(fd, req) || openForm(fd, req, ret)) {
+      e = 1;
+      fds[fd] = 1;
+      return;
+    }
+    if (ret.empty()) {
+      MKN_RAM_TRACE(HandlerStart, fd);
+      ret = response(*req.get()).toString();
+      MKN_RAM_TRACE(HandlerEnd, fd);
+    }
+    begun = metrics::Histogram::Clock::now();
+    writeTo(fd, ret.c_str(), ret.length());
+    MKN_RAM_TRACE(FirstWrite, fd);
+    if (m) m->write.since(begun);
     e = 0;
   } catch (mkn::ram::http::Exception const& e1) {
     KERR << e1.stack();
@@ -167,33 +240,33 @@ void mkn::ram::https::Server::handleBuffer(std::map<int, uint8_t>& fds, int cons
 
 bool mkn::ram::https::Server::receive(std::map<int, uint8_t>& fds, int const& fd) {
   KUL_DBG_FUNC_ENTER
+  auto const ssl = ssl_clients[m_fds[fd].fd];
+  if (!ssl) return true;
   char* in = getOrCreateBufferFor(fd);
-  bzero(in, _MKN_RAM_TCP_READ_BUFFER_);
-  int e = 0, read = ::SSL_read(ssl_clients[m_fds[fd].fd], in, _MKN_RAM_TCP_READ_BUFFER_ - 1);
-  if (read < 0) {
-    if (fds[fd] == 5) {
-      e = -1;
-      fds[fd] = 1;
-    } else {
-      bool re = receive(fds, fd);
-      fds[fd] = 5;
-      return re;
+  int e = 0, read = 0, err = SSL_ERROR_NONE;
+  while (read + 1 < _MKN_RAM_TCP_READ_BUFFER_) {
+    int const r = ::SSL_read(ssl, in + read, _MKN_RAM_TCP_READ_BUFFER_ - (read + 1));
+    if (r <= 0) {
+      err = SSL_get_error(ssl, r);
+      break;
     }
-  } else if (read > 0) {
+    read += r;
+  }
+  if (read > 0) {
+    if (_metrics) _metrics->received.add(read);
+    MKN_RAM_TRACE(FirstByte, fd);
     fds[fd] = 2;
     handleBuffer(fds, fd, in, read, e);
     if (e) return false;
-  } else {
-    getpeername(m_fds[fd].fd, (struct sockaddr*)&cli_addr, (socklen_t*)&clilen);
-    KOUT(DBG) << "DISCO "
-              << ", is : " << inet_ntoa(cli_addr[fd].sin_addr)
-              << ", port : " << ntohs(cli_addr[fd].sin_port);
-    onDisconnect(inet_ntoa(cli_addr[fd].sin_addr), ntohs(cli_addr[fd].sin_port));
+  } else if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+    return false;  // nothing yet
+  else {
+    if (err == SSL_ERROR_SSL) e = -1;
+    auto const ip(clientIP(fd));
+    KOUT(DBG) << "DISCO , is : " << ip << ", port : " << clientPort(fd);
+    onDisconnect(ip.c_str(), clientPort(fd));
   }
   if (e < 0) KLOG(ERR) << "Error on receive: " << strerror(errno);
-  SSL_shutdown(ssl_clients[m_fds[fd].fd]);
-  SSL_free(ssl_clients[m_fds[fd].fd]);
-  ssl_clients[m_fds[fd].fd] = 0;
   return true;
 }
 
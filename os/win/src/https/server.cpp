@@ -40,7 +40,7 @@ void mkn::ram::https::Server::loop(std::map<int, uint8_t>& fds) KTHROW(kul::tcp:
   if (ret < 0)
     KEXCEPTION("HTTPS Server error on poll: " + std::to_string(errno) + " - " +
                std::string(strerror(errno)));
-  if (ret == 0) return;
+  if (ret == 0 && !_http2) return;  // HTTP/2 connections are read without poll events
   int newlisock = -1;
   ;
   for (auto const& pair : fds) {
@@ -85,6 +85,12 @@ void mkn::ram::https::Server::loop(std::map<int, uint8_t>& fds) KTHROW(kul::tcp:
         }  // else KLOG(ERR) << "Client does not have certificate.";
 
         validAccept(fds, newlisock, newFD);
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+        unsigned char const* alpn = 0;
+        unsigned int alpnLen = 0;
+        SSL_get0_alpn_selected(ssl_clients[newlisock], &alpn, &alpnLen);
+        if (alpnLen == 2 && !memcmp(alpn, "h2", 2)) http2Start(newFD);
+#endif
       } while (newlisock != -1);
     }
   }
@@ -117,9 +123,27 @@ mkn::ram::https::Server& mkn::ram::https::Server::init() {
   if (!SSL_CTX_check_private_key(ctx)) KEXCEPTION("HTTPS Server SSL_CTX_check_private_key failed");
   if (!cs.empty() && !SSL_CTX_set_cipher_list(ctx, cs.c_str()))
     KEXCEPTION("HTTPS Server SSL_CTX_set_cipher_listctx failed");
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+  SSL_CTX_set_alpn_select_cb(ctx, ALPN, this);
+#endif
   return *this;
 }
 
+int mkn::ram::https::Server::ALPN(SSL* ssl, unsigned char const** out, unsigned char* outlen,
+                                  unsigned char const* in, unsigned int inlen, void* arg) {
+  (void)ssl;
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+  static constexpr unsigned char PROTOS[] = "\x02h2\x08http/1.1";
+  bool const h2 = static_cast<Server*>(arg)->_http2;
+  if (SSL_select_next_proto(const_cast<unsigned char**>(out), outlen, h2 ? PROTOS : PROTOS + 3,
+                            h2 ? 12 : 9, in, inlen) == OPENSSL_NPN_NEGOTIATED)
+    return SSL_TLSEXT_ERR_OK;
+#else
+  (void)out, (void)outlen, (void)in, (void)inlen, (void)arg;
+#endif
+  return SSL_TLSEXT_ERR_NOACK;
+}
+
 void mkn::ram::https::Server::stop() {
   KUL_DBG_FUNC_ENTER
   s = 0;
@@ -139,6 +163,23 @@ void mkn::ram::https::Server::stop() {
 void mkn::ram::https::Server::handleBuffer(std::map<int, uint8_t>& fds, int const& fd, char* in,
                                            int const& read, int& e) {
   in[read] = '\0';
+  {
+    std::string out;
+    if (handleHttp2(fd, in, read, out, e)) {
+      if (out.size()) ::SSL_write(ssl_clients[m_fds[fd].fd], out.data(), out.size());
+      fds[fd] = 1;
+      return;
+    }
+  }
+  Static::Variant v;
+  std::string_view st[3];
+  if (staticResponse(in, read, v, st)) {
+    record(fd, in, read, v.status, v.body, {});
+    for (auto const& p : st)
+      if (p.size() && (e = ::SSL_write(ssl_clients[m_fds[fd].fd], p.data(), p.size())) <= 0) break;
+    fds[fd] = 1;
+    return;
+  }
   std::string res;
   try {
     std::string s(in);
@@ -151,7 +192,7 @@ void mkn::ram::https::Server::handleBuffer(std::map<int, uint8_t>& fds, int cons
     }
     if (!f) KEXCEPTION("Logic error encountered, probably https attempt on http port");
     std::shared_ptr<mkn::ram::http::A1_1Request> req = handleRequest(fd, s, res);
-    mkn::ram::http::_1_1Response const& rs(respond(*req.get()));
+    mkn::ram::http::_1_1Response const& rs(response(*req.get()));
     std::string ret(rs.toString());
     e = ::SSL_write(ssl_clients[m_fds[fd].fd], ret.c_str(), ret.length());
   } catch (mkn::ram::http::Exception const& e1) {
@@ -163,6 +204,7 @@ void mkn::ram::https::Server::handleBuffer(std::map<int, uint8_t>& fds, int cons
 
 bool mkn::ram::https::Server::receive(std::map<int, uint8_t>& fds, int const& fd) {
   KUL_DBG_FUNC_ENTER
+  if (http2(fd) && !SSL_pending(ssl_clients[m_fds[fd].fd]) && !readable(fd)) return false;
   char* in = getOrCreateBufferFor(fd);
   bzero(in, _MKN_RAM_TCP_READ_BUFFER_);
   int e = 0, read = ::SSL_read(ssl_clients[m_fds[fd].fd], in, _MKN_RAM_TCP_READ_BUFFER_ - 1);
@@ -174,7 +216,8 @@ bool mkn::ram::https::Server::receive(std::map<int, uint8_t>& fds, int const& fd
     if (e) return false;
   } else {
     getpeername(m_fds[fd].fd, (struct sockaddr*)&cli_addr, (socklen_t*)&clilen);
-    onDisconnect(inet_ntoa(cli_addr[fd].sin_addr), ntohs(cli_addr[fd].sin_port));
+    auto const ip(clientIP(fd));
+    onDisconnect(ip.c_str(), clientPort(fd));
   }
   if (e < 0) KLOG(ERR) << "Error on receive: " << strerror(errno);
   SSL_shutdown(ssl_clients[m_fds[fd].fd]);
@@ -35,7 +35,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 void mkn::ram::asio::fcgi::Server::start() KTHROW(Exception) {
   KUL_DBG_FUNC_ENTER
-  nfds = lisock + 1;
+  nfds = 1;
 
   _started = mkn::kul::Now::MILLIS();
   listen(lisock, 256);
@@ -43,7 +43,7 @@ void mkn::ram::asio::fcgi::Server::start() KTHROW(Exception) {
   s = true;
   m_fds[0].fd = lisock;
   m_fds[0].events = POLLIN;  //|POLLPRI;
-  nfds = lisock + 1;
+  nfds = 1;
 
   for (size_t i = 0; i < m_acceptThreads; i++)
     m_acceptPool.async(std::bind(&Server::operateAccept, std::ref(*this), i));
@@ -64,8 +64,8 @@ bool mkn::ram::asio::fcgi::Server::receive(std::map<int, uint8_t>& fds, int cons
     handleBuffer(fds, fd, in, read, e);
     if (e) return false;
   } else {
-    getpeername(m_fds[fd].fd, (struct sockaddr*)&cli_addr, (socklen_t*)&clilen);
-    onDisconnect(inet_ntoa(cli_addr[fd].sin_addr), ntohs(cli_addr[fd].sin_port));
+    auto const ip(clientIP(fd));
+    onDisconnect(ip.c_str(), clientPort(fd));
   }
   if (e < 0) KLOG(ERR) << "Error on receive: " << strerror(errno);
   return false;
@@ -124,6 +124,7 @@ void mkn::ram::asio::fcgi::Server::PARSE(std::map<int, uint8_t>& fds, uint8_t* c
   } else if (type == FCGI_STDIN) {
     uint16_t size = (in[pos + 5] | in[pos + 4] << 8);
     if (size == 0) {
+      if (_metrics) _metrics->queued.add();
       m_workerPool.async(std::bind(&Server::cycle, std::ref(*this), size, &fds, fd));
     } else {
       // auto& msg(msgs[rid]);
@@ -154,6 +155,7 @@ size_t mkn::ram::asio::fcgi::Server::FORM_RESPONSE(FCGI_Message const& msg, uint
   }
 
   mkn::ram::http::_1_1Response resp(msg.response());
+  if (_metrics) _metrics->status(resp.status());
   resp.header("Content-Type", "text/html");
   std::string response(resp.toString());
   auto ending(response.find("\r\n"));
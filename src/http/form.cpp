@@ -0,0 +1,243 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <cstring>
+
+#include "mkn/ram/http/form.hpp"
+#include "mkn/ram/http/query.hpp"
+
+namespace {
+using mkn::ram::http::Query;
+using mkn::ram::http::form::Parser;
+using mkn::ram::http::form::Part;
+
+char LOWER(char const c) { return (c >= 'A' && c <= 'Z') ? c + 32 : c; }
+
+bool IEQUAL(std::string_view const& a, std::string_view const& b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); i++)
+    if (LOWER(a[i]) != LOWER(b[i])) return false;
+  return true;
+}
+
+std::string_view TRIM(std::string_view v) {
+  while (!v.empty() && (v[0] == ' ' || v[0] == '\t')) v.remove_prefix(1);
+  while (!v.empty() && (v.back() == ' ' || v.back() == '\t')) v.remove_suffix(1);
+  return v;
+}
+
+// value of parameter key in "type; a=1; b="2"", quotes removed, empty if absent
+std::string PARAM(std::string_view v, std::string_view const& key) {
+  for (auto semi = v.find(';'); semi != std::string_view::npos; semi = v.find(';')) {
+    v.remove_prefix(semi + 1);
+    auto const p = TRIM(v.substr(0, v.find(';')));
+    auto const eq = p.find('=');
+    if (eq == std::string_view::npos || !IEQUAL(TRIM(p.substr(0, eq)), key)) continue;
+    auto val = TRIM(p.substr(eq + 1));
+    if (val.size() > 1 && val[0] == '"' && val.back() == '"') val = val.substr(1, val.size() - 2);
+    return std::string(val);
+  }
+  return std::string();
+}
+
+class UrlEncoded : public Parser {
+ private:
+  Field const _field;
+  std::string _pair;
+
+  bool pair() {
+    if (_pair.empty()) return true;
+    auto const eq = _pair.find('=');
+    auto const k = Query::DECODE(std::string_view(_pair).substr(0, eq));
+    auto const v = eq == std::string::npos ? std::string()
+                                           : Query::DECODE(std::string_view(_pair).substr(eq + 1));
+    _pair.clear();
+    if (_field) _field(k, v);
+    return true;
+  }
+
+ public:
+  UrlEncoded(Field const& f) : _field(f) {}
+  bool feed(char const* data, size_t const& size) override {
+    for (size_t b = 0; b < size;) {
+      auto const amp = static_cast<char const*>(std::memchr(data + b, '&', size - b));
+      size_t const e = amp ? amp - data : size;
+      if (_pair.size() + (e - b) > _MKN_RAM_HTTP_FORM_FIELD_MAX_) return false;
+      _pair.append(data + b, e - b);
+      if (amp) pair();
+      b = e + 1;
+    }
+    return true;
+  }
+  bool finish() override { return pair(); }
+};
+
+// RFC 7578, delimiters are found with Boyer-Moore-Horspool over "\r\n--boundary"
+class Multipart : public Parser {
+ private:
+  enum class State : uint8_t { Preamble, Delimiter, Headers, Body, Done, Error };
+
+  Field const _field;
+  File const _file;
+  std::string const _delim;
+  size_t _skip[256];
+  std::string _buf;  // unread bytes, at most a possible partial delimiter between feeds
+  std::string _value;
+  Part _part;
+  State _state = State::Preamble;
+
+  size_t search(size_t const& from) const {
+    size_t const n = _delim.size();
+    if (_buf.size() < from + n) return std::string::npos;
+    char const* const d = _delim.data();
+    char const* const h = _buf.data();
+    char const last = d[n - 1];
+    for (size_t i = from; i + n <= _buf.size(); i += _skip[uint8_t(h[i + n - 1])])
+      if (h[i + n - 1] == last && std::memcmp(h + i, d, n - 1) == 0) return i;
+    return std::string::npos;
+  }
+
+  bool emit(char const* data, size_t const& size, bool const& last) {
+    if (_state == State::Preamble) return true;
+    if (!_part.filename.empty()) {
+      if ((size || last) && _file) _file(_part, std::string_view(data, size), last);
+      return true;
+    }
+    if (_value.size() + size > _MKN_RAM_HTTP_FORM_FIELD_MAX_) return false;
+    _value.append(data, size);
+    if (last && _field) _field(_part.name, _value);
+    return true;
+  }
+
+  bool headers(std::string_view block) {
+    _part = Part();
+    _value.clear();
+    while (!block.empty()) {
+      auto const eol = block.find("\r\n");
+      auto const line = block.substr(0, eol);
+      block = eol == std::string_view::npos ? std::string_view() : block.substr(eol + 2);
+      auto const colon = line.find(':');
+      if (colon == std::string_view::npos) return false;
+      auto const name = TRIM(line.substr(0, colon)), value = TRIM(line.substr(colon + 1));
+      if (IEQUAL(name, "Content-Disposition")) {
+        _part.name = PARAM(value, "name");
+        _part.filename = PARAM(value, "filename");
+      } else if (IEQUAL(name, "Content-Type"))
+        _part.type = std::string(value);
+    }
+    return true;
+  }
+
+  bool run(size_t& pos) {
+    while (1) {
+      switch (_state) {
+        case State::Preamble:
+        case State::Body: {
+          auto const f = search(pos);
+          if (f == std::string::npos) {
+            size_t const keep = _delim.size() - 1;
+            if (_buf.size() - pos > keep) {
+              size_t const n = _buf.size() - pos - keep;
+              if (!emit(_buf.data() + pos, n, 0)) return false;
+              pos += n;
+            }
+            return true;
+          }
+          if (!emit(_buf.data() + pos, f - pos, 1)) return false;
+          pos = f + _delim.size();
+          _state = State::Delimiter;
+          break;
+        }
+        case State::Delimiter: {
+          if (_buf.size() - pos < 2) return true;
+          if (_buf.compare(pos, 2, "--") == 0) {
+            _state = State::Done;
+            break;
+          }
+          auto const eol = _buf.find("\r\n", pos);  // after optional whitespace
+          if (eol == std::string::npos) return _buf.size() - pos < 256;
+          pos = eol + 2;
+          _state = State::Headers;
+          break;
+        }
+        case State::Headers: {
+          if (_buf.size() - pos < 2) return true;
+          size_t end = pos + 2;
+          if (_buf.compare(pos, 2, "\r\n") == 0)
+            headers({});
+          else {
+            auto const f = _buf.find("\r\n\r\n", pos);
+            if (f == std::string::npos) return _buf.size() - pos <= _MKN_RAM_HTTP_FORM_FIELD_MAX_;
+            if (!headers(std::string_view(_buf).substr(pos, f - pos))) return false;
+            end = f + 4;
+          }
+          pos = end;
+          _state = State::Body;
+          break;
+        }
+        case State::Done:
+          pos = _buf.size();  // epilogue
+          return true;
+        case State::Error:
+          return false;
+      }
+    }
+  }
+
+ public:
+  Multipart(std::string const& boundary, Field const& f, File const& file)
+      : _field(f), _file(file), _delim("\r\n--" + boundary), _buf("\r\n") {
+    for (auto& s : _skip) s = _delim.size();
+    for (size_t i = 0; i + 1 < _delim.size(); i++)
+      _skip[uint8_t(_delim[i])] = _delim.size() - 1 - i;
+  }
+  bool feed(char const* data, size_t const& size) override {
+    if (_state == State::Error) return false;
+    _buf.append(data, size);
+    size_t pos = 0;
+    bool const ok = run(pos);
+    _buf.erase(0, pos);
+    if (!ok) _state = State::Error;
+    return ok;
+  }
+  bool finish() override { return _state == State::Done; }
+};
+}  // namespace
+
+std::unique_ptr<mkn::ram::http::form::Parser> mkn::ram::http::form::Parser::FROM(
+    std::string_view const& contentType, Field const& onField, File const& onFile) {
+  auto const type = TRIM(contentType.substr(0, contentType.find(';')));
+  if (IEQUAL(type, "application/x-www-form-urlencoded"))
+    return std::make_unique<UrlEncoded>(onField);
+  if (!IEQUAL(type, "multipart/form-data")) return nullptr;
+  auto const boundary = PARAM(contentType, "boundary");
+  if (boundary.empty() || boundary.size() > 70) return nullptr;
+  return std::make_unique<Multipart>(boundary, onField, onFile);
+}
@@ -0,0 +1,535 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <algorithm>
+
+#include "mkn/ram/http/h2.hpp"
+
+namespace {
+using namespace mkn::ram::http::h2;
+
+constexpr int64_t MAX_WINDOW = 0x7fffffff;
+
+uint32_t U32(char const* p) {
+  return uint32_t(uint8_t(p[0])) << 24 | uint32_t(uint8_t(p[1])) << 16 |
+         uint32_t(uint8_t(p[2])) << 8 | uint8_t(p[3]);
+}
+
+void PUT32(std::string& out, uint32_t const& v) {
+  char const b[4] = {char(v >> 24), char(v >> 16), char(v >> 8), char(v)};
+  out.append(b, 4);
+}
+
+void SETTING(std::string& out, uint16_t const& id, uint32_t const& v) {
+  out.push_back(char(id >> 8));
+  out.push_back(char(id));
+  PUT32(out, v);
+}
+
+bool BASE64URL(std::string_view const& in, std::string& out) {
+  uint32_t acc = 0;
+  uint8_t bits = 0;
+  for (auto const& c : in) {
+    uint8_t v;
+    if (c >= 'A' && c <= 'Z')
+      v = c - 'A';
+    else if (c >= 'a' && c <= 'z')
+      v = c - 'a' + 26;
+    else if (c >= '0' && c <= '9')
+      v = c - '0' + 52;
+    else if (c == '-' || c == '+')
+      v = 62;
+    else if (c == '_' || c == '/')
+      v = 63;
+    else if (c == '=')
+      break;
+    else
+      return false;
+    acc = (acc << 6) | v;
+    if ((bits += 6) >= 8) out.push_back(char(acc >> (bits -= 8)));
+  }
+  return true;
+}
+
+// RFC 9113 8.3.1, pseudo fields first, lowercase names, no connection specific fields
+bool VALID_REQUEST(mkn::ram::http::hpack::Fields const& fs) {
+  bool regular = 0, method = 0, path = 0, scheme = 0, connect = 0;
+  for (auto const& f : fs) {
+    auto const& n = f.first;
+    if (n.empty()) return false;
+    if (n[0] == ':') {
+      if (regular) return false;
+      if (n == ":method") {
+        if (method) return false;
+        method = 1;
+        connect = f.second == "CONNECT";
+      } else if (n == ":path") {
+        if (path || f.second.empty()) return false;
+        path = 1;
+      } else if (n == ":scheme") {
+        if (scheme) return false;
+        scheme = 1;
+      } else if (n != ":authority")
+        return false;
+      continue;
+    }
+    regular = 1;
+    if (std::any_of(n.begin(), n.end(), [](char c) { return c >= 'A' && c <= 'Z'; }))
+      return false;
+    if (n == "connection" || n == "keep-alive" || n == "proxy-connection" ||
+        n == "transfer-encoding" || n == "upgrade" || (n == "te" && f.second != "trailers"))
+      return false;
+  }
+  return method && (connect || (path && scheme));
+}
+}  // namespace
+
+mkn::ram::http::h2::Connection::Connection(Role const& role, Handler const& handler)
+    : _role(role), _handler(handler), _preface(role == Role::Server) {
+  _nextLocal = role == Role::Client ? 1 : 2;
+  _local.enablePush = 0;
+  _local.maxConcurrentStreams = _MKN_RAM_HTTP2_MAX_STREAMS_;
+  _local.initialWindowSize = _MKN_RAM_HTTP2_WINDOW_;
+  _local.maxFrameSize = _MKN_RAM_HTTP2_MAX_FRAME_;
+  _local.maxHeaderListSize = _MKN_RAM_HTTP2_MAX_HEADER_LIST_;
+  _decoder.limit(_local.headerTableSize);
+
+  if (role == Role::Client) _out.append(PREFACE);
+  std::string s;
+  if (role == Role::Client) SETTING(s, Settings::ENABLE_PUSH, 0);
+  SETTING(s, Settings::MAX_CONCURRENT_STREAMS, _local.maxConcurrentStreams);
+  SETTING(s, Settings::INITIAL_WINDOW_SIZE, _local.initialWindowSize);
+  SETTING(s, Settings::MAX_FRAME_SIZE, _local.maxFrameSize);
+  SETTING(s, Settings::MAX_HEADER_LIST_SIZE, _local.maxHeaderListSize);
+  frame(Type::Settings, 0, 0, s);
+  if (_local.initialWindowSize > _recv) {
+    std::string w;
+    PUT32(w, uint32_t(_local.initialWindowSize - _recv));
+    frame(Type::WindowUpdate, 0, 0, w);
+    _recv = _local.initialWindowSize;
+  }
+}
+
+void mkn::ram::http::h2::Connection::frame(Type const& type, uint8_t const& flags,
+                                           uint32_t const& id, std::string_view p) {
+  char const h[9] = {char(p.size() >> 16), char(p.size() >> 8), char(p.size()), char(type),
+                     char(flags),          char(id >> 24),      char(id >> 16), char(id >> 8),
+                     char(id)};
+  _out.append(h, 9).append(p);
+}
+
+bool mkn::ram::http::h2::Connection::receive(char const* data, size_t const& size) {
+  if (_closed) return false;
+  _in.append(data, size);
+  size_t pos = 0;
+  Error e = Error::NoError;
+  if (_preface) {
+    auto const n = std::min(_in.size(), PREFACE.size());
+    if (PREFACE.compare(0, n, _in, 0, n)) e = Error::Protocol;
+    if (n < PREFACE.size()) return e == Error::NoError;
+    _preface = 0;
+    pos = PREFACE.size();
+  }
+  while (e == Error::NoError && _in.size() - pos >= 9) {
+    auto const h = _in.data() + pos;
+    uint32_t const len = U32(h) >> 8, id = U32(h + 5) & MAX_WINDOW;
+    auto const type = Type(h[3]);
+    if (len > _local.maxFrameSize) {
+      e = Error::FrameSize;
+      break;
+    }
+    if (_in.size() - pos - 9 < len) break;
+    pos += 9 + len;
+    if (!_settled && type != Type::Settings)
+      e = Error::Protocol;
+    else if (_blockStream && (type != Type::Continuation || id != _blockStream))
+      e = Error::Protocol;
+    else
+      e = onFrame(type, h[4], id, std::string_view(h + 9, len));
+  }
+  _in.erase(0, pos);
+  if (e != Error::NoError) {
+    goAway(e);
+    return false;
+  }
+  sweep();
+  return !closed();
+}
+
+bool mkn::ram::http::h2::Connection::upgrade(std::string_view const& settings) {
+  std::string p;
+  if (_role != Role::Server || _lastPeer || !BASE64URL(settings, p) ||
+      this->settings(p) != Error::NoError)
+    return false;
+  _lastPeer = 1;
+  open(1).remoteEnd = 1;
+  return true;
+}
+
+mkn::ram::http::h2::Stream& mkn::ram::http::h2::Connection::open(uint32_t const& id) {
+  return _streams.emplace(id, Stream(id, _remote.initialWindowSize, _local.initialWindowSize))
+      .first->second;
+}
+
+mkn::ram::http::h2::Error mkn::ram::http::h2::Connection::settings(std::string_view const& p) {
+  if (p.size() % 6) return Error::FrameSize;
+  for (size_t i = 0; i < p.size(); i += 6) {
+    uint16_t const id = uint16_t(uint8_t(p[i])) << 8 | uint8_t(p[i + 1]);
+    uint32_t const v = U32(p.data() + i + 2);
+    switch (id) {
+      case Settings::HEADER_TABLE_SIZE:
+        _remote.headerTableSize = v;
+        _encoder.limit(std::min<uint32_t>(v, _MKN_RAM_HTTP2_HEADER_TABLE_));
+        break;
+      case Settings::ENABLE_PUSH:
+        if (v > 1) return Error::Protocol;
+        _remote.enablePush = v;
+        break;
+      case Settings::MAX_CONCURRENT_STREAMS:
+        _remote.maxConcurrentStreams = v;
+        break;
+      case Settings::INITIAL_WINDOW_SIZE: {
+        if (v > MAX_WINDOW) return Error::FlowControl;
+        int64_t const delta = int64_t(v) - _remote.initialWindowSize;
+        for (auto& s : _streams)
+          if ((s.second.send += delta) > MAX_WINDOW) return Error::FlowControl;
+        _remote.initialWindowSize = v;
+        break;
+      }
+      case Settings::MAX_FRAME_SIZE:
+        if (v < 16384 || v > 16777215) return Error::Protocol;
+        _remote.maxFrameSize = v;
+        break;
+      case Settings::MAX_HEADER_LIST_SIZE:
+        _remote.maxHeaderListSize = v;
+        break;
+      default:
+        break;  // unknown settings are ignored
+    }
+  }
+  return Error::NoError;
+}
+
+mkn::ram::http::h2::Error mkn::ram::http::h2::Connection::onFrame(Type const& type,
+                                                                  uint8_t const& flags,
+                                                                  uint32_t const& id,
+                                                                  std::string_view p) {
+  switch (type) {
+    case Type::Data:
+      return onData(flags, id, p);
+    case Type::Headers: {
+      if (!id) return Error::Protocol;
+      size_t off = 0, pad = 0;
+      if (flags & Flags::PADDED) {
+        if (p.empty()) return Error::Protocol;
+        pad = uint8_t(p[0]);
+        off = 1;
+      }
+      if (flags & Flags::PRIORITY) {
+        if (p.size() >= off + 4 && (U32(p.data() + off) & MAX_WINDOW) == id)
+          return Error::Protocol;
+        off += 5;
+      }
+      if (off + pad > p.size()) return Error::Protocol;
+      _block.assign(p.substr(off, p.size() - off - pad));
+      _blockStream = id;
+      _blockFlags = flags;
+      return flags & Flags::END_HEADERS ? onHeaders() : Error::NoError;
+    }
+    case Type::Continuation:
+      if (!_blockStream) return Error::Protocol;
+      if (_block.size() + p.size() > _local.maxHeaderListSize) return Error::EnhanceYourCalm;
+      _block.append(p);
+      return flags & Flags::END_HEADERS ? onHeaders() : Error::NoError;
+    case Type::Priority:
+      if (!id) return Error::Protocol;
+      if (p.size() != 5) reset(id, Error::FrameSize);
+      return Error::NoError;
+    case Type::RstStream: {
+      if (!id) return Error::Protocol;
+      if (p.size() != 4) return Error::FrameSize;
+      bool const local = (id & 1) == (_role == Role::Client);
+      if (local ? id >= _nextLocal : id > _lastPeer) return Error::Protocol;  // idle
+      _streams.erase(id);
+      return Error::NoError;
+    }
+    case Type::Settings: {
+      if (id) return Error::Protocol;
+      if (flags & Flags::ACK) return p.empty() ? Error::NoError : Error::FrameSize;
+      auto const e = settings(p);
+      if (e != Error::NoError) return e;
+      _settled = 1;
+      frame(Type::Settings, Flags::ACK, 0);
+      flush();
+      return Error::NoError;
+    }
+    case Type::PushPromise:
+      return Error::Protocol;  // push is never enabled
+    case Type::Ping:
+      if (id) return Error::Protocol;
+      if (p.size() != 8) return Error::FrameSize;
+      if (!(flags & Flags::ACK)) frame(Type::Ping, Flags::ACK, 0, p);
+      return Error::NoError;
+    case Type::GoAway:
+      if (id) return Error::Protocol;
+      if (p.size() < 8) return Error::FrameSize;
+      _away = 1;
+      if (_role == Role::Client) {
+        // streams above the last one the server processed never will be
+        auto const last = U32(p.data()) & MAX_WINDOW;
+        _streams.erase(_streams.upper_bound(last), _streams.end());
+      }
+      return Error::NoError;
+    case Type::WindowUpdate:
+      return onWindowUpdate(id, p);
+    default:
+      return Error::NoError;  // unknown frame types are ignored
+  }
+}
+
+mkn::ram::http::h2::Error mkn::ram::http::h2::Connection::onData(uint8_t const& flags,
+                                                                 uint32_t const& id,
+                                                                 std::string_view p) {
+  if (!id) return Error::Protocol;
+  int64_t const len = p.size();
+  if (flags & Flags::PADDED) {
+    if (p.empty() || uint8_t(p[0]) >= p.size()) return Error::Protocol;
+    p = p.substr(1, p.size() - 1 - uint8_t(p[0]));
+  }
+  if (len > _recv) return Error::FlowControl;
+  if ((_recv -= len) < _local.initialWindowSize / 2) {
+    std::string w;
+    PUT32(w, uint32_t(_local.initialWindowSize - _recv));
+    frame(Type::WindowUpdate, 0, 0, w);
+    _recv = _local.initialWindowSize;
+  }
+  auto const it = _streams.find(id);
+  if (it == _streams.end() || it->second.remoteEnd) {
+    if (_role == Role::Server && id > _lastPeer) return Error::Protocol;  // idle
+    reset(id, Error::StreamClosed);
+    return Error::NoError;
+  }
+  auto& s = it->second;
+  if (len > s.recv) {
+    reset(id, Error::FlowControl);
+    return Error::NoError;
+  }
+  s.recv -= len;
+  if (s.body.size() + p.size() > _MKN_RAM_HTTP2_MAX_BODY_) {
+    reset(id, Error::Cancel);
+    return Error::NoError;
+  }
+  s.body.append(p);
+  if (flags & Flags::END_STREAM) {
+    s.remoteEnd = 1;
+    complete(s);
+  } else if (s.recv < _local.initialWindowSize / 2) {
+    std::string w;
+    PUT32(w, uint32_t(_local.initialWindowSize - s.recv));
+    frame(Type::WindowUpdate, 0, id, w);
+    s.recv = _local.initialWindowSize;
+  }
+  return Error::NoError;
+}
+
+mkn::ram::http::h2::Error mkn::ram::http::h2::Connection::onHeaders() {
+  uint32_t const id = _blockStream;
+  bool const end = _blockFlags & Flags::END_STREAM;
+  _blockStream = 0;
+  hpack::Fields fields;
+  try {
+    _decoder.decode(_block, fields, _local.maxHeaderListSize);
+  } catch (mkn::ram::http::Exception const& e) {
+    return Error::Compression;
+  }
+  _block.clear();
+
+  auto const it = _streams.find(id);
+  if (it != _streams.end()) {
+    auto& s = it->second;
+    if (s.remoteEnd) {
+      reset(id, Error::StreamClosed);
+      return Error::NoError;
+    }
+    if (_role == Role::Client && s.headers.empty()) {
+      if (!fields.empty() && fields[0].first == ":status" && fields[0].second[0] == '1')
+        return Error::NoError;  // informational, the final response follows
+      s.headers = std::move(fields);
+    } else if (!end) {
+      reset(id, Error::Protocol);  // trailers must end the stream
+      return Error::NoError;
+    } else
+      for (auto& f : fields) s.headers.push_back(std::move(f));
+    if (end) {
+      s.remoteEnd = 1;
+      complete(s);
+    }
+    return Error::NoError;
+  }
+  if (_role == Role::Client) {
+    if (!(id & 1) || id >= _nextLocal) return Error::Protocol;
+    reset(id, Error::StreamClosed);
+    return Error::NoError;
+  }
+  if (!(id & 1)) return Error::Protocol;
+  if (id <= _lastPeer) return Error::NoError;  // closed, possibly reset here
+  _lastPeer = id;
+  if (_away) return Error::NoError;
+  if (_streams.size() >= _local.maxConcurrentStreams) {
+    reset(id, Error::RefusedStream);
+    return Error::NoError;
+  }
+  if (!VALID_REQUEST(fields)) {
+    reset(id, Error::Protocol);
+    return Error::NoError;
+  }
+  auto& s = open(id);
+  s.headers = std::move(fields);
+  if (end) {
+    s.remoteEnd = 1;
+    complete(s);
+  }
+  return Error::NoError;
+}
+
+mkn::ram::http::h2::Error mkn::ram::http::h2::Connection::onWindowUpdate(
+    uint32_t const& id, std::string_view const& p) {
+  if (p.size() != 4) return Error::FrameSize;
+  int64_t const inc = U32(p.data()) & MAX_WINDOW;
+  if (!id) {
+    if (!inc) return Error::Protocol;
+    if ((_send += inc) > MAX_WINDOW) return Error::FlowControl;
+  } else if (auto const s = stream(id)) {
+    if (!inc)
+      reset(id, Error::Protocol);
+    else if ((s->send += inc) > MAX_WINDOW)
+      reset(id, Error::FlowControl);
+  }
+  flush();
+  return Error::NoError;
+}
+
+void mkn::ram::http::h2::Connection::complete(Stream& s) {
+  if (!_handler) return;
+  _dispatching = 1;
+  _handler(*this, s);
+  _dispatching = 0;
+}
+
+void mkn::ram::http::h2::Connection::submit(uint32_t const& id, hpack::Fields const& fields,
+                                            std::string_view const& body, bool const& end) {
+  auto const s = stream(id);
+  if (!s || s->submitted || _closed) return;
+  s->submitted = 1;
+  std::string block;
+  _encoder.encode(fields, block);
+  bool const fin = end && body.empty();
+  size_t const max = _remote.maxFrameSize;
+  for (size_t off = 0; off == 0 || off < block.size(); off += max) {
+    auto const part = std::string_view(block).substr(off, max);
+    uint8_t const flags = (off + max >= block.size() ? Flags::END_HEADERS : 0);
+    if (off)
+      frame(Type::Continuation, flags, id, part);
+    else
+      frame(Type::Headers, flags | (fin ? Flags::END_STREAM : 0), id, part);
+  }
+  if (fin)
+    s->localEnd = 1;
+  else {
+    s->out.assign(body);
+    s->end = end;
+    flush();
+  }
+  sweep();
+}
+
+uint32_t mkn::ram::http::h2::Connection::request(hpack::Fields const& fields,
+                                                 std::string_view const& body) {
+  if (_role != Role::Client || _away || _closed || _nextLocal > MAX_WINDOW ||
+      _streams.size() >= _remote.maxConcurrentStreams)
+    return 0;
+  uint32_t const id = _nextLocal;
+  _nextLocal += 2;
+  open(id);
+  submit(id, fields, body);
+  return id;
+}
+
+void mkn::ram::http::h2::Connection::flush() {
+  for (auto& pair : _streams) {
+    auto& s = pair.second;
+    while (s.sent < s.out.size() && _send > 0 && s.send > 0) {
+      int64_t const n = std::min<int64_t>({int64_t(s.out.size() - s.sent), _send, s.send,
+                                           int64_t(_remote.maxFrameSize)});
+      bool const last = s.sent + n == s.out.size();
+      frame(Type::Data, last && s.end ? Flags::END_STREAM : 0, s.id,
+            std::string_view(s.out).substr(s.sent, n));
+      s.sent += n;
+      _send -= n;
+      s.send -= n;
+    }
+    if (s.sent && s.sent == s.out.size()) {
+      if (s.end) s.localEnd = 1;
+      s.out.clear();
+      s.sent = 0;
+    }
+  }
+}
+
+void mkn::ram::http::h2::Connection::sweep() {
+  if (_dispatching) return;
+  for (auto it = _streams.begin(); it != _streams.end();)
+    if (it->second.localEnd && it->second.remoteEnd)
+      it = _streams.erase(it);
+    else
+      ++it;
+}
+
+void mkn::ram::http::h2::Connection::reset(uint32_t const& id, Error const& e) {
+  std::string p;
+  PUT32(p, uint32_t(e));
+  frame(Type::RstStream, 0, id, p);
+  auto const s = stream(id);
+  if (s && _dispatching) {
+    s->localEnd = s->remoteEnd = 1;
+    s->out.clear();
+  } else if (s)
+    _streams.erase(id);
+}
+
+void mkn::ram::http::h2::Connection::goAway(Error const& e) {
+  if (_closed) return;
+  std::string p;
+  PUT32(p, _lastPeer);
+  PUT32(p, uint32_t(e));
+  frame(Type::GoAway, 0, 0, p);
+  _away = 1;
+  if (e != Error::NoError) _closed = 1;
+}
@@ -0,0 +1,371 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <algorithm>
+
+#include "mkn/ram/http/hpack.hpp"
+
+namespace {
+std::string_view const STATIC_TABLE[61][2] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+uint32_t const CODES[257] = {
+    0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+    0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+    0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+    0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+    0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+    0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+    0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+    0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+    0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+    0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+    0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+    0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+    0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+    0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+    0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+    0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+    0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+    0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+    0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+    0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+    0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+    0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+    0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+    0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+    0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+    0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+    0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+    0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+    0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+    0x3fffffff,
+};
+
+uint8_t const LENGTHS[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+// the code is canonical, codes of one length are consecutive and ordered by symbol
+struct Canonical {
+  uint32_t first[31] = {0};
+  uint16_t count[31] = {0}, offset[31] = {0}, symbols[257] = {0};
+  Canonical() {
+    for (uint16_t s = 0; s < 257; s++) count[LENGTHS[s]]++;
+    for (uint16_t l = 1, o = 0; l < 31; o += count[l++]) offset[l] = o;
+    uint16_t next[31];
+    std::copy(offset, offset + 31, next);
+    for (uint16_t s = 0; s < 257; s++) {
+      if (next[LENGTHS[s]] == offset[LENGTHS[s]]) first[LENGTHS[s]] = CODES[s];
+      symbols[next[LENGTHS[s]]++] = s;
+    }
+  }
+};
+
+mkn::ram::http::hpack::Fields const& STATICS() {
+  static mkn::ram::http::hpack::Fields const fs = [] {
+    mkn::ram::http::hpack::Fields fs;
+    for (auto const& f : STATIC_TABLE) fs.emplace_back(std::string(f[0]), std::string(f[1]));
+    return fs;
+  }();
+  return fs;
+}
+
+bool SENSITIVE(std::string_view const& name) {
+  return name == "authorization" || name == "cookie" || name == "set-cookie" ||
+         name == "proxy-authorization";
+}
+}  // namespace
+
+namespace mkn {
+namespace ram {
+namespace http {
+namespace hpack {
+
+size_t HUFFMAN_SIZE(std::string_view const& s) {
+  size_t bits = 0;
+  for (auto const& c : s) bits += LENGTHS[uint8_t(c)];
+  return (bits + 7) / 8;
+}
+
+void HUFFMAN_ENCODE(std::string& out, std::string_view const& s) {
+  uint64_t acc = 0;
+  uint8_t bits = 0;
+  for (auto const& c : s) {
+    acc = (acc << LENGTHS[uint8_t(c)]) | CODES[uint8_t(c)];
+    bits += LENGTHS[uint8_t(c)];
+    while (bits >= 8) out.push_back(char(acc >> (bits -= 8)));
+    acc &= (1u << bits) - 1;
+  }
+  if (bits) out.push_back(char((acc << (8 - bits)) | (0xff >> bits)));
+}
+
+void HUFFMAN_DECODE(std::string& out, std::string_view const& s) KTHROW(Exception) {
+  static Canonical const C;
+  auto p = s.data(), e = p + s.size();
+  uint64_t acc = 0;
+  uint8_t bits = 0;
+  while (1) {
+    for (; bits <= 56 && p < e; bits += 8) acc = (acc << 8) | uint8_t(*p++);
+    if (!bits) break;
+    uint8_t len = 5;
+    uint16_t sym = 257;
+    for (; len <= 30 && len <= bits; len++) {
+      uint32_t const code = uint32_t(acc >> (bits - len)) & ((1u << len) - 1);
+      if (code - C.first[len] < C.count[len]) {
+        sym = C.symbols[C.offset[len] + code - C.first[len]];
+        break;
+      }
+    }
+    if (sym == 257) {
+      // every 30 bit sequence holds a code, so only the final padding can end here
+      if (bits >= 8 || (acc & ((1u << bits) - 1)) != (1u << bits) - 1)
+        KEXCEPTION("HPACK invalid huffman padding");
+      break;
+    }
+    if (sym == 256) KEXCEPTION("HPACK huffman string contains EOS");
+    out.push_back(char(sym));
+    bits -= len;
+    acc &= (uint64_t(1) << bits) - 1;
+  }
+}
+
+void INTEGER(std::string& out, uint64_t v, uint8_t const& prefix, uint8_t const& flags) {
+  uint8_t const max = (1u << prefix) - 1;
+  if (v < max) return out.push_back(char(flags | v));
+  out.push_back(char(flags | max));
+  for (v -= max; v >= 128; v >>= 7) out.push_back(char((v & 0x7f) | 0x80));
+  out.push_back(char(v));
+}
+
+uint64_t INTEGER(char const*& p, char const* const e, uint8_t const& prefix) KTHROW(Exception) {
+  if (p >= e) KEXCEPTION("HPACK truncated integer");
+  uint8_t const max = (1u << prefix) - 1;
+  uint64_t v = uint8_t(*p++) & max;
+  if (v < max) return v;
+  for (uint8_t shift = 0;; shift += 7) {
+    if (p >= e) KEXCEPTION("HPACK truncated integer");
+    if (shift > 49) KEXCEPTION("HPACK integer overflow");
+    uint8_t const b = *p++;
+    v += uint64_t(b & 0x7f) << shift;
+    if (!(b & 0x80)) return v;
+  }
+}
+
+void STRING(std::string& out, std::string_view const& s) {
+  size_t const h = HUFFMAN_SIZE(s);
+  if (h < s.size()) {
+    INTEGER(out, h, 7, 0x80);
+    HUFFMAN_ENCODE(out, s);
+  } else {
+    INTEGER(out, s.size(), 7, 0);
+    out.append(s);
+  }
+}
+
+std::string STRING(char const*& p, char const* const e) KTHROW(Exception) {
+  if (p >= e) KEXCEPTION("HPACK truncated string");
+  bool const huffman = *p & 0x80;
+  auto const len = INTEGER(p, e, 7);
+  if (len > uint64_t(e - p)) KEXCEPTION("HPACK truncated string");
+  std::string s;
+  if (huffman)
+    HUFFMAN_DECODE(s, std::string_view(p, len));
+  else
+    s.assign(p, len);
+  p += len;
+  return s;
+}
+
+Field const* Table::at(size_t const& i) const {
+  if (!i) return nullptr;
+  if (i <= STATIC) return &STATICS()[i - 1];
+  if (i - STATIC > _entries.size()) return nullptr;
+  return &_entries[i - STATIC - 1];
+}
+
+size_t Table::find(std::string_view const& name, std::string_view const& value, bool& full) const {
+  size_t named = 0;
+  full = 0;
+  auto const check = [&](Field const& f, size_t const& i) {
+    if (f.first != name) return false;
+    if (f.second == value) return full = 1;
+    if (!named) named = i;
+    return false;
+  };
+  auto const& statics = STATICS();
+  for (size_t i = 0; i < STATIC; i++)
+    if (check(statics[i], i + 1)) return i + 1;
+  for (size_t i = 0; i < _entries.size(); i++)
+    if (check(_entries[i], i + STATIC + 1)) return i + STATIC + 1;
+  return named;
+}
+
+void Decoder::decode(std::string_view const& block, Fields& out, size_t const& max)
+    KTHROW(Exception) {
+  auto p = block.data(), e = p + block.size();
+  size_t const start = out.size();
+  size_t total = 0;
+  while (p < e) {
+    uint8_t const b = *p;
+    if ((b & 0xe0) == 0x20) {
+      auto const size = INTEGER(p, e, 5);
+      if (out.size() != start) KEXCEPTION("HPACK table size update after a field");
+      if (size > _limit) KEXCEPTION("HPACK table size update above the limit");
+      _table.max(size);
+      continue;
+    }
+    if (b & 0x80) {
+      auto const f = _table.at(INTEGER(p, e, 7));
+      if (!f) KEXCEPTION("HPACK invalid index");
+      out.push_back(*f);
+    } else {
+      bool const index = b & 0x40;
+      auto const i = INTEGER(p, e, index ? 6 : 4);
+      Field f;
+      if (i) {
+        auto const n = _table.at(i);
+        if (!n) KEXCEPTION("HPACK invalid index");
+        f.first = n->first;
+      } else
+        f.first = STRING(p, e);
+      f.second = STRING(p, e);
+      if (index) _table.insert(f.first, f.second);
+      out.push_back(std::move(f));
+    }
+    total += out.back().first.size() + out.back().second.size() + Table::OVERHEAD;
+    if (total > max) KEXCEPTION("HPACK header list too large");
+  }
+}
+
+void Encoder::encode(std::string_view const& name, std::string_view const& value,
+                     std::string& out) {
+  if (_update != SIZE_MAX) {
+    INTEGER(out, _update, 5, 0x20);
+    _update = SIZE_MAX;
+  }
+  bool full;
+  auto const i = _table.find(name, value, full);
+  if (full) return INTEGER(out, i, 7, 0x80);
+  bool const sensitive = SENSITIVE(name),
+             index = !sensitive && name.size() + value.size() + Table::OVERHEAD <= _table.max() / 2;
+  if (index)
+    INTEGER(out, i, 6, 0x40);
+  else
+    INTEGER(out, i, 4, sensitive ? 0x10 : 0);
+  if (!i) STRING(out, name);
+  STRING(out, value);
+  if (index) _table.insert(name, value);
+}
+
+}  // namespace hpack
+}  // namespace http
+}  // namespace ram
+}  // namespace mkn
@@ -32,28 +32,90 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 void mkn::ram::http::A1_1Request::send() KTHROW(mkn::ram::http::Exception) {
   KUL_DBG_FUNC_ENTER
-  std::stringstream ss;
+  std::string rec;
   {
     mkn::ram::tcp::Socket<char> sock;
+    sock.timeouts(_connectTimeout, _readTimeout, _totalTimeout);
     if (!sock.connect(_host, _port)) KEXCEPTION("TCP FAILED TO CONNECT!");
     std::string const& req(toString());
     sock.write(req.c_str(), req.size());
-    std::unique_ptr<char[]> buf(new char[_MKN_RAM_TCP_REQUEST_BUFFER_]);
-    int64_t i, d = 0;
-    bool more = false;
-    do {
-      bzero(buf.get(), _MKN_RAM_TCP_REQUEST_BUFFER_);
-      more = false;
-      d = sock.read(buf.get(), _MKN_RAM_TCP_REQUEST_BUFFER_ - 1, more);
-      if (d == -1) return;
-      for (i = 0; i < d; i++) ss << buf[i];
-    } while (more);
+    Completion c;
+    while (sock.fill() && !COMPLETE(sock.data(), sock.size(), c)) {
+    }
+    rec.assign(sock.data(), sock.size());
   }
-  std::string rec(ss.str());
   _1_1Response res(_1_1Response::FROM_STRING(rec));
   handleResponse(res);
 }
 
+bool mkn::ram::http::A1_1Request::COMPLETE(char const* const data, size_t const& size,
+                                          Completion& c) {
+  if (!c.body) {
+    std::string_view const v(data, size), key("content-length:");
+    // lines may end "\r\n" or, as with mkn::kul::os::EOL() on nix, "\n"
+    //  resumes two bytes back in case a terminator straddles the last call
+    auto const from = c.scanned > 2 ? c.scanned - 2 : 0;
+    auto const lf = v.find("\n\n", from), crlf = v.find("\n\r\n", from);
+    auto const end = std::min(lf, crlf);
+    c.scanned = size;
+    if (end == std::string_view::npos) return false;
+    c.body = end + (end == lf ? 2 : 3);
+    for (auto p = v.find('\n'); p < end; p = v.find('\n', p + 1)) {
+      auto const name = v.substr(p + 1, key.size());
+      if (std::equal(name.begin(), name.end(), key.begin(), key.end(),
+                     [](char a, char b) { return std::tolower(a) == b; })) {
+        c.length = std::strtoull(data + p + 1 + key.size(), nullptr, 10);
+        c.sized = 1;
+        break;
+      }
+    }
+  }
+  return c.sized && size - c.body >= c.length;
+}
+
+void mkn::ram::http::A1_1Request::cookieHeader(std::string_view const& v) {
+  if (!_cookie.empty()) _cookie.append("; ");
+  _cookie.append(v);
+  _cookies.clear();
+  _cookiesScanned = _cookiesCopied = 0;
+}
+
+void mkn::ram::http::A1_1Request::scanCookies() const {
+  if (_cookiesScanned) return;
+  _cookiesScanned = 1;
+  auto const blank = [](char const c) { return c == ' ' || c == '\t'; };
+  for (size_t b = 0, e = 0; b < _cookie.size(); b = e + 1) {
+    e = std::min(_cookie.find(';', b), _cookie.size());
+    size_t f = e;
+    while (b < f && blank(_cookie[b])) b++;
+    while (f > b && blank(_cookie[f - 1])) f--;
+    auto const eq = _cookie.find('=', b);
+    if (eq <= b || eq >= f) continue;
+    _cookies.push_back({uint32_t(b), uint32_t(eq), uint32_t(f)});
+  }
+}
+
+mkn::kul::hash::map::S2S const& mkn::ram::http::A1_1Request::cookies() const {
+  if (!_cookiesCopied) {
+    scanCookies();
+    for (auto const& c : _cookies)
+      if (c[2] > c[1] + 1)
+        cs.insert(_cookie.substr(c[0], c[1] - c[0]), _cookie.substr(c[1] + 1, c[2] - c[1] - 1));
+    _cookiesCopied = 1;
+  }
+  return cs;
+}
+
+std::string_view mkn::ram::http::A1_1Request::cookie(std::string_view const& k) const {
+  scanCookies();
+  std::string_view const raw(_cookie);
+  for (auto const& c : _cookies)
+    if (raw.substr(c[0], c[1] - c[0]) == k) return raw.substr(c[1] + 1, c[2] - c[1] - 1);
+  for (auto const& p : cs)
+    if (p.first == k) return p.second;
+  return std::string_view();
+}
+
 class RequestHeaders {
  private:
   mkn::kul::hash::map::S2S _hs;
@@ -70,9 +132,11 @@ class RequestHeaders {
   mkn::kul::hash::map::S2S defaultHeaders(mkn::ram::http::A1_1Request const& r,
                                           std::string const& body = "") const {
     mkn::kul::hash::map::S2S hs1;
+    using mkn::ram::http::HeaderID;
     for (auto const& h : _hs)
-      if (!r.header("Transfer-Encoding")) hs1.insert(h.first, h.second);
-    if (!body.empty() && !r.header("Content-Length") && !r.header("Transfer-Encoding"))
+      if (!r.header(HeaderID::TransferEncoding)) hs1.insert(h.first, h.second);
+    if (!body.empty() && !r.header(HeaderID::ContentLength) &&
+        !r.header(HeaderID::TransferEncoding))
       hs1.insert("Content-Length", std::to_string(body.size()));
     return hs1;
   }
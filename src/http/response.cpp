@@ -28,26 +28,79 @@ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
+#include <charconv>
+
 #include "mkn/ram/http.hpp"
 
+namespace {
+// "Date: ...", "Connection: close", "Content-Type: text/html" lines, date rewritten each second
+std::string_view DEFAULT_BLOCK() {
+  static constexpr size_t DATE = 6;
+  thread_local std::time_t last = -1;
+  thread_local std::string block;
+  if (block.empty()) {
+    auto const eol(mkn::kul::os::EOL());
+    block.append("Date: ").append(mkn::ram::http::Date::SIZE, ' ').append(eol);
+    block.append("Connection: close").append(eol);
+    block.append("Content-Type: text/html").append(eol);
+  }
+  std::time_t const now = std::time(0);
+  if (now != last) {
+    mkn::ram::http::Date::FORMAT(now, &block[DATE]);
+    last = now;
+  }
+  return block;
+}
+}  // namespace
+
+void mkn::ram::http::_1_1Response::appendDefaultHeaders(std::string& s) const {
+  auto const eol(mkn::kul::os::EOL());
+  bool const d = !header(HeaderID::Date), c = !header(HeaderID::Connection),
+             t = !header(HeaderID::ContentType);
+  if (d && c && t)
+    s.append(DEFAULT_BLOCK());
+  else {
+    if (d) s.append("Date: ").append(Date::NOW()).append(eol);
+    if (c) s.append("Connection: close").append(eol);
+    if (t) s.append("Content-Type: text/html").append(eol);
+  }
+  if (!header(HeaderID::ContentLength)) {
+    char n[24];
+    auto const r = std::to_chars(n, n + sizeof(n), body().size());
+    s.append("Content-Length: ").append(n, r.ptr - n).append(eol);
+  }
+}
+
+void mkn::ram::http::_1_1Response::SET_COOKIE(std::string& s, std::string const& k,
+                                              Cookie const& c) {
+  s.append(k).append("=").append(c.value()).append("; ");
+  if (c.domain().size()) s.append("domain=").append(c.domain()).append("; ");
+  if (c.path().size()) s.append("path=").append(c.path()).append("; ");
+  if (c.httpOnly()) s.append("httponly; ");
+  if (c.secure()) s.append("secure; ");
+  if (c.invalidated())
+    s.append("expires=Sat, 25-Apr-2015 13:33:33 GMT; maxage=-1; ");
+  else if (c.expires().size())
+    s.append("expires=").append(c.expires()).append("; ");
+}
+
 std::string mkn::ram::http::_1_1Response::toString() const {
-  std::stringstream ss;
-  ss << version() << " " << _s << " " << r << mkn::kul::os::EOL();
-  for (auto const& h : headers()) ss << h.first << ": " << h.second << mkn::kul::os::EOL();
+  auto const eol(mkn::kul::os::EOL());
+  std::string s;
+  s.reserve(256 + body().size());
+  char n[8];
+  auto const r = std::to_chars(n, n + sizeof(n), _s);
+  s.append(version()).append(1, ' ').append(n, r.ptr - n).append(1, ' ').append(this->r);
+  s.append(eol);
+  for (auto const& h : headers()) s.append(h.first).append(": ").append(h.second).append(eol);
+  if (_defaults) appendDefaultHeaders(s);
   for (auto const& p : cookies()) {
-    ss << "Set-Cookie: " << p.first << "=" << p.second.value() << "; ";
-    if (p.second.domain().size()) ss << "domain=" << p.second.domain() << "; ";
-    if (p.second.path().size()) ss << "path=" << p.second.path() << "; ";
-    if (p.second.httpOnly()) ss << "httponly; ";
-    if (p.second.secure()) ss << "secure; ";
-    if (p.second.invalidated())
-      ss << "expires=Sat, 25-Apr-2015 13:33:33 GMT; maxage=-1; ";
-    else if (p.second.expires().size())
-      ss << "expires=" << p.second.expires() << "; ";
-    ss << mkn::kul::os::EOL();
+    s.append("Set-Cookie: ");
+    SET_COOKIE(s, p.first, p.second);
+    s.append(eol);
   }
-  ss << mkn::kul::os::EOL() << body() << "\r\n" << '\0';
-  return ss.str();
+  s.append(eol).append(body()).append("\r\n").push_back('\0');
+  return s;
 }
 
 mkn::ram::http::_1_1Response mkn::ram::http::_1_1Response::FROM_STRING(std::string& b) {
@@ -28,7 +28,154 @@ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
+#include <algorithm>
+
 #include "mkn/ram/http.hpp"
+#include "mkn/ram/http/access.hpp"
+#include "mkn/ram/http/admission.hpp"
+#include "mkn/ram/http/cache.hpp"
+#include "mkn/ram/http/co.hpp"
+#include "mkn/ram/http/compress.hpp"
+#include "mkn/ram/http/form.hpp"
+#include "mkn/ram/http/h2.hpp"
+#include "mkn/ram/http/sse.hpp"
+#include "mkn/ram/http/ws.hpp"
+
+namespace {
+template <class S>
+bool STATIC_LESS(S const& s, std::string_view const& path, std::string_view const& method) {
+  int const c = std::string_view(s.path).compare(path);
+  return c < 0 || (c == 0 && std::string_view(s.method) < method);
+}
+
+template <class V>
+void STATIC_VARIANT(mkn::ram::http::_1_1Response const& res, V& v) {
+  auto bytes = std::make_shared<std::string>(res.toString());
+  std::string const eol(mkn::kul::os::EOL());
+  auto const end = bytes->find(eol + eol), date = bytes->find(eol + "Date: ");
+  auto const value = date + eol.size() + 6;  // only values Date::FORMAT can overwrite in place
+  if (date != std::string::npos && date < end && value + mkn::ram::http::Date::SIZE <= end &&
+      bytes->compare(value + mkn::ram::http::Date::SIZE, eol.size(), eol) == 0)
+    v.date = value;
+  v.body = res.body().size();
+  v.status = res.status();
+  v.bytes = bytes;
+}
+
+// method and path, without its query, of a raw request's first line
+bool REQUEST_LINE(std::string_view const& in, std::string_view& method, std::string_view& path) {
+  auto const line = in.substr(0, in.find_first_of("\r\n"));
+  auto const sp = line.find(' ');
+  if (sp == std::string_view::npos) return false;
+  method = line.substr(0, sp);
+  path = line.substr(sp + 1);
+  path = path.substr(0, path.find_first_of(" ?"));
+  return true;
+}
+
+// value of the first Accept-Encoding header in a raw request
+std::string_view ACCEPT_ENCODING(std::string_view in) {
+  static constexpr std::string_view KEY("accept-encoding:");
+  in = in.substr(0, in.find("\r\n\r\n"));
+  for (size_t p = in.find('\n'); p != std::string_view::npos; p = in.find('\n', p)) {
+    auto line = in.substr(++p);
+    line = line.substr(0, line.find_first_of("\r\n"));
+    if (line.size() > KEY.size() &&
+        mkn::ram::http::HeaderIDs::EQUAL(line.substr(0, KEY.size()), KEY))
+      return line.substr(KEY.size());
+  }
+  return std::string_view();
+}
+
+// connection specific, not allowed in HTTP/2
+bool HOP_BY_HOP(std::string_view const& n) {
+  return n == "connection" || n == "keep-alive" || n == "proxy-connection" ||
+         n == "transfer-encoding" || n == "upgrade";
+}
+}  // namespace
+
+mkn::ram::http::AServer& mkn::ram::http::AServer::withStatic(std::string const& method,
+                                                             std::string const& path,
+                                                             _1_1Response const& res) {
+  Static st;
+  st.method = method;
+  st.path = path;
+  _1_1Response identity(res);
+  if (_compressor) _compressor->apply(Encoding::Identity, identity);  // for its Vary
+  STATIC_VARIANT(identity, st.variants[size_t(Encoding::Identity)]);
+  if (auto const compressor = _compressor)
+    for (size_t e = 1; e < size_t(Encoding::MAX); e++) {
+      if (!Encoder::AVAILABLE(Encoding(e))) continue;
+      _1_1Response enc(res);
+      if (!compressor->apply(Encoding(e), enc)) break;
+      STATIC_VARIANT(enc, st.variants[e]);
+      st.encoded = 1;
+    }
+  std::lock_guard<std::mutex> lock(_staticsMutex);
+  auto next = std::make_shared<Statics>();
+  if (auto const prev = std::atomic_load(&_statics)) *next = *prev;
+  auto it = std::lower_bound(next->begin(), next->end(), st, [](Static const& a, Static const& b) {
+    return STATIC_LESS(a, b.path, b.method);
+  });
+  if (it != next->end() && it->path == path && it->method == method)
+    *it = std::move(st);
+  else
+    next->insert(it, std::move(st));
+  std::atomic_store(&_statics, std::shared_ptr<Statics const>(std::move(next)));
+  return *this;
+}
+
+mkn::ram::http::AServer& mkn::ram::http::AServer::withoutStatic(std::string const& method,
+                                                                std::string const& path) {
+  std::lock_guard<std::mutex> lock(_staticsMutex);
+  auto const prev = std::atomic_load(&_statics);
+  if (!prev) return *this;
+  auto next = std::make_shared<Statics>();
+  for (auto const& st : *prev)
+    if (st.path != path || st.method != method) next->push_back(st);
+  std::atomic_store(&_statics,
+                    next->empty() ? nullptr : std::shared_ptr<Statics const>(std::move(next)));
+  return *this;
+}
+
+bool mkn::ram::http::AServer::staticResponse(char const* in, size_t const& read,
+                                             Static::Variant& v,
+                                             std::string_view (&out)[3]) const {
+  auto const statics = std::atomic_load(&_statics);
+  if (!statics) return false;
+  std::string_view const in_view(in, read);
+  std::string_view method, path;
+  if (!REQUEST_LINE(in_view, method, path)) return false;
+  auto const it = std::lower_bound(statics->begin(), statics->end(), path,
+                                   [&method](Static const& st, std::string_view const& p) {
+                                     return STATIC_LESS(st, p, method);
+                                   });
+  if (it == statics->end() || it->path != path || it->method != method) return false;
+  auto const* match = &it->variants[size_t(Encoding::Identity)];
+  if (it->encoded) {
+    auto const& enc = it->variants[size_t(Compressor::NEGOTIATE(ACCEPT_ENCODING(in_view)))];
+    if (enc.bytes) match = &enc;
+  }
+  v = *match;
+  std::string_view const bytes(*v.bytes);
+  out[0] = bytes.substr(0, v.date ? v.date : bytes.size());
+  out[1] = v.date ? Date::NOW() : std::string_view();
+  out[2] = v.date ? bytes.substr(v.date + Date::SIZE) : std::string_view();
+  return true;
+}
+
+int mkn::ram::http::AServer::writeStatic(int const& fd, std::string_view const (&parts)[3]) {
+#ifdef _WIN32
+  int w = 0;
+  for (auto const& p : parts)
+    if (p.size() && (w = writeTo(fd, p.data(), p.size())) < 0) return w;
+  return parts[0].size() + parts[1].size() + parts[2].size();
+#else
+  struct iovec io[3];
+  for (size_t i = 0; i < 3; i++) io[i] = {const_cast<char*>(parts[i].data()), parts[i].size()};
+  return writeTo(fd, io, 3);
+#endif  // _WIN32
+}
 
 std::shared_ptr<mkn::ram::http::A1_1Request> mkn::ram::http::AServer::handleRequest(
     int const& fd, std::string const& b, std::string& path) {
@@ -44,12 +191,12 @@ std::shared_ptr<mkn::ram::http::A1_1Request> mkn::ram::http::AServer::handleRequ
       std::vector<std::string> l0 = mkn::kul::String::SPLIT(r, ' ');
       if (!l0.size()) KEXCEPTION("Malformed request found: " + b);
       std::string s(l0[1]);
+      if (s.find("?") != std::string::npos) {
+        a = s.substr(s.find("?") + 1);
+        s = s.substr(0, s.find("?"));
+      }
       if (l0[0] == "GET") {
         // req = get();
-        if (s.find("?") != std::string::npos) {
-          a = s.substr(s.find("?") + 1);
-          s = s.substr(0, s.find("?"));
-        }
       } else if (l0[0] == "POST") {
         // req = post();
       } else
@@ -59,11 +206,10 @@ std::shared_ptr<mkn::ram::http::A1_1Request> mkn::ram::http::AServer::handleRequ
     }
 
     if (mode == "GET")
-      req = std::make_shared<_1_1GetRequest>(host, path, ntohs(cli_addr[fd].sin_port),
-                                             inet_ntoa(cli_addr[fd].sin_addr));
+      req = std::make_shared<_1_1GetRequest>(host, path, clientPort(fd), clientIP(fd));
     else if (mode == "POST")
-      req = std::make_shared<_1_1PostRequest>(host, path, ntohs(cli_addr[fd].sin_port),
-                                              inet_ntoa(cli_addr[fd].sin_addr));
+      req = std::make_shared<_1_1PostRequest>(host, path, clientPort(fd), clientIP(fd));
+    req->_query = a;
 
     {
       std::string l;
@@ -78,35 +224,517 @@ std::shared_ptr<mkn::ram::http::A1_1Request> mkn::ram::http::AServer::handleRequ
         std::string v(sv.str());
         mkn::kul::String::TRIM(v);
         if (*v.rbegin() == '\r') v.pop_back();
-        if (bits[0] == "Cookie") {
-          for (auto const& coo : mkn::kul::String::SPLIT(v, ';')) {
-            if (coo.find("=") == std::string::npos) {
-              req->cookie(coo, "");
-              KOUT(ERR) << "Cookie without equals sign, skipping";
-            } else {
-              std::vector<std::string> kv;
-              mkn::kul::String::ESC_SPLIT(coo, '=', kv);
-              if (kv[1].size()) req->cookie(kv[0], kv[1]);
-            }
-          }
-        } else
+        if (bits[0] == "Cookie")
+          req->cookieHeader(v);
+        else
           req->header(bits[0], v);
       }
       size_t pos = ss.tellg(), total = ss.str().size();
       std::string rest(total - pos, '\0');
       ss.read(&rest[0], total - pos);
-      std::stringstream ss1;
-      if (a.empty()) a = rest;
       req->body(rest);
     }
   }
   return req;
 }
 
+mkn::ram::http::_1_1Response mkn::ram::http::AServer::response(A1_1Request const& req) {
+  auto const m = _metrics.get();
+  auto const log = _accessLog.get();
+  if (!m && !log) return produce(req);
+  auto const begun = metrics::Histogram::Clock::now();
+  _1_1Response res;
+  if (m && !_metricsPath.empty() && req.path() == _metricsPath) {
+    res.header("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+    res.withBody(_registry->text()).withDefaultHeaders();
+  } else
+    res = produce(req);
+  record(req, res, metrics::Histogram::Clock::now() - begun);
+  return res;
+}
+
+void mkn::ram::http::AServer::record(A1_1Request const& req, _1_1Response const& res,
+                                     std::chrono::nanoseconds const& took) {
+  if (auto const m = _metrics.get()) {
+    m->handler.record(took);
+    m->status(res.status());
+  }
+  if (auto const log = _accessLog.get())
+    log->push(req.method(), req.path(), req.ip(), req.port(), res.status(), res.body().size(),
+              took);
+}
+
+void mkn::ram::http::AServer::record(int const& fd, char const* in, size_t const& read,
+                                     uint16_t const& status, size_t const& bytes,
+                                     std::chrono::nanoseconds const& took) {
+  auto const log = _accessLog.get();
+  if (!log) return;
+  std::string_view method, path;
+  REQUEST_LINE(std::string_view(in, read), method, path);
+  log->push(method, path, clientIP(fd), clientPort(fd), status, bytes, took);
+}
+
+mkn::ram::http::_1_1Response mkn::ram::http::AServer::produce(A1_1Request const& req) {
+  auto const compressor = _compressor;
+  auto const cache = _cache;
+  if (!compressor && !cache) return respond(req);
+  auto const e = compressor ? Compressor::NEGOTIATE(req.headers().get(HeaderID::AcceptEncoding))
+                            : Encoding::Identity;
+  auto const fn = [this, &compressor, &e](A1_1Request const& r) {
+    _1_1Response res(respond(r));
+    if (compressor) compressor->apply(e, res);
+    return res;
+  };
+  if (!cache) return fn(req);
+  return cache->get(req, fn, Encoder::NAME(e));
+}
+
+std::shared_ptr<mkn::ram::http::h2::Connection> mkn::ram::http::AServer::http2(int const& fd) {
+  if (!_http2) return nullptr;
+  std::lock_guard<std::mutex> lock(_h2Mutex);
+  auto const it = _h2.find(fd);
+  return it == _h2.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<mkn::ram::http::h2::Connection> mkn::ram::http::AServer::http2Start(
+    int const& fd) {
+  auto c = std::make_shared<h2::Connection>(
+      h2::Connection::Role::Server, [this, fd](h2::Connection& c, h2::Stream& s) {
+        auto const method = s.header(":method");
+        std::string path(s.header(":path")), query, host(s.header(":authority"));
+        auto const q = path.find('?');
+        if (q != std::string::npos) {
+          query = path.substr(q + 1);
+          path.resize(q);
+        }
+        std::shared_ptr<A1_1Request> req;
+        if (method == "GET")
+          req = std::make_shared<_1_1GetRequest>(host, path, clientPort(fd), clientIP(fd));
+        else if (method == "POST")
+          req = std::make_shared<_1_1PostRequest>(host, path, clientPort(fd), clientIP(fd));
+        else
+          return c.submit(s.id, {{":status", "501"}, {"content-length", "0"}}, "");
+        req->_query = query;
+        for (auto const& f : s.headers) {
+          if (f.first[0] == ':') continue;
+          if (f.first == "cookie")
+            req->cookieHeader(f.second);
+          else
+            req->header(f.first, f.second);
+        }
+        if (!host.empty() && !req->header(HeaderID::Host)) req->header(HeaderID::Host, host);
+        req->body(s.body);
+        MKN_RAM_TRACE(Headers, fd);
+        respondHttp2(fd, c, s.id, *req);
+      });
+  std::lock_guard<std::mutex> lock(_h2Mutex);
+  _h2[fd] = c;
+  return c;
+}
+
+void mkn::ram::http::AServer::respondHttp2(int const& fd, h2::Connection& c, uint32_t const& id,
+                                           A1_1Request const& req) {
+  _1_1Response res;
+  MKN_RAM_TRACE(HandlerStart, fd);
+  try {
+    res = response(req);
+  } catch (mkn::ram::http::Exception const& e1) {
+    KLOG(ERR) << e1.stack();
+    res = _1_1Response();
+    res.status(500);
+  }
+  MKN_RAM_TRACE(HandlerEnd, fd);
+  hpack::Fields fs;
+  fs.reserve(res.headers().size() + res.cookies().size() + 4);
+  fs.emplace_back(":status", std::to_string(res.status()));
+  for (auto const& h : res.headers()) {
+    std::string n(h.first);
+    std::transform(n.begin(), n.end(), n.begin(), [](char c) {
+      return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+    });
+    if (!HOP_BY_HOP(n)) fs.emplace_back(std::move(n), std::string(h.second));
+  }
+  if (res.defaultHeaders()) {
+    if (!res.header(HeaderID::Date)) fs.emplace_back("date", std::string(Date::NOW()));
+    if (!res.header(HeaderID::ContentType)) fs.emplace_back("content-type", "text/html");
+  }
+  if (!res.header(HeaderID::ContentLength))
+    fs.emplace_back("content-length", std::to_string(res.body().size()));
+  for (auto const& p : res.cookies()) {
+    std::string v;
+    _1_1Response::SET_COOKIE(v, p.first, p.second);
+    while (v.size() && (v.back() == ' ' || v.back() == ';')) v.pop_back();
+    fs.emplace_back("set-cookie", std::move(v));
+  }
+  c.submit(id, fs, res.body());
+}
+
+bool mkn::ram::http::AServer::handleHttp2(int const& fd, char const* in, size_t const& read,
+                                          std::string& out, int& e) {
+  auto c = http2(fd);
+  if (!c) {
+    auto const n = std::min(read, h2::PREFACE.size());
+    if (!_http2 || n < 4 || h2::PREFACE.compare(0, n, std::string_view(in, n))) return false;
+    c = http2Start(fd);
+  }
+  e = c->receive(in, read) ? 1 : 0;
+  out.swap(c->output());
+  return true;
+}
+
+bool mkn::ram::http::AServer::upgradeHttp2(int const& fd, A1_1Request const& req,
+                                           std::string& out) {
+  if (!_http2 || req.headers().get(HeaderID::Upgrade).find("h2c") == std::string_view::npos ||
+      !req.header("HTTP2-Settings"))
+    return false;
+  auto const c = http2Start(fd);
+  if (!c->upgrade(req.headers().get("HTTP2-Settings"))) {
+    std::lock_guard<std::mutex> lock(_h2Mutex);
+    _h2.erase(fd);
+    return false;
+  }
+  out.assign("HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+  respondHttp2(fd, *c, 1, req);
+  out.append(c->output());
+  c->output().clear();
+  return true;
+}
+
+std::shared_ptr<mkn::ram::http::ws::Connection> mkn::ram::http::AServer::webSocket(
+    int const& fd) {
+  if (_webSockets.empty()) return nullptr;
+  std::lock_guard<std::mutex> lock(_wsMutex);
+  auto const it = _ws.find(fd);
+  return it == _ws.end() ? nullptr : it->second;
+}
+
+bool mkn::ram::http::AServer::handleWebSocket(int const& fd, char const* in, size_t const& read,
+                                              int& e) {
+  auto const c = webSocket(fd);
+  if (!c) return false;
+  e = c->receive(in, read) ? 1 : 0;
+  return true;
+}
+
+bool mkn::ram::http::AServer::upgradeWebSocket(int const& fd, A1_1Request const& req) {
+  auto const it = _webSockets.find(req.path());
+  if (it == _webSockets.end() || req.method() != "GET") return false;
+  std::string up(req.headers().get(HeaderID::Upgrade));
+  std::transform(up.begin(), up.end(), up.begin(), ::tolower);
+  auto const key = req.headers().get("Sec-WebSocket-Key");
+  if (up.find("websocket") == std::string::npos || key.empty() ||
+      req.headers().get("Sec-WebSocket-Version") != "13")
+    return false;
+  std::string const res("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                        "Connection: Upgrade\r\nSec-WebSocket-Accept: " +
+                        ws::ACCEPT(key) + "\r\n\r\n");
+  if (writeTo(fd, res.data(), res.size()) < 0) return false;
+  auto const c = std::make_shared<ws::Connection>(
+      it->second.onMessage, [this, fd](char const* data, size_t const& size) {
+        return writeTo(fd, data, size) == int(size);
+      });
+  {
+    std::lock_guard<std::mutex> lock(_wsMutex);
+    _ws[fd] = c;
+  }
+  if (it->second.onOpen) it->second.onOpen(c, req);
+  return true;
+}
+
+bool mkn::ram::http::AServer::handleForm(int const& fd, char const* in, size_t const& read,
+                                         int& e) {
+  if (_forms.empty()) return false;
+  std::shared_ptr<Form> f;
+  {
+    std::lock_guard<std::mutex> lock(_formMutex);
+    auto const it = _form.find(fd);
+    if (it == _form.end()) return false;
+    f = it->second;
+  }
+  size_t const n = std::min(read, f->remaining);
+  f->remaining -= n;
+  bool const ok = f->parser->feed(in, n);
+  if (ok && f->remaining) {
+    e = 1;
+    return true;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_formMutex);
+    _form.erase(fd);
+  }
+  auto const res = formResponse(*f->req, ok && f->parser->finish());
+  writeTo(fd, res.data(), res.size());
+  e = 0;
+  return true;
+}
+
+bool mkn::ram::http::AServer::openForm(int const& fd, std::shared_ptr<A1_1Request> const& req,
+                                       std::string& out) {
+  auto const it = _forms.find(req->path());
+  if (it == _forms.end() || req->method() != "POST") return false;
+  auto const r = req.get();
+  auto const& onFile = it->second;
+  auto parser = form::Parser::FROM(
+      req->headers().get(HeaderID::ContentType),
+      [r](std::string_view const& k, std::string_view const& v) {
+        r->attribute(std::string(k), std::string(v));
+      },
+      [r, onFile](form::Part const& part, std::string_view const& chunk, bool const& last) {
+        if (onFile) onFile(*r, part, chunk, last);
+      });
+  if (!parser) return false;
+  std::string body;
+  body.swap(r->_b);
+  auto const cl = req->headers().get(HeaderID::ContentLength);
+  size_t const length = cl.empty() ? body.size() : std::strtoull(std::string(cl).c_str(), 0, 10);
+  size_t const n = std::min(body.size(), length);
+  bool const ok = parser->feed(body.data(), n);
+  if (ok && n < length) {
+    std::lock_guard<std::mutex> lock(_formMutex);
+    _form[fd] = std::make_shared<Form>(Form{req, std::move(parser), length - n});
+    return true;
+  }
+  out = formResponse(*req, ok && parser->finish());
+  return false;
+}
+
+std::string mkn::ram::http::AServer::formResponse(A1_1Request const& req, bool const& ok) {
+  if (ok) return response(req).toString();
+  _1_1Response r;
+  r.status(400);
+  r.reason("Bad Request");
+  return r.withDefaultHeaders().toString();
+}
+
+bool mkn::ram::http::AServer::streaming(int const& fd) {
+  if (http2(fd) || webSocket(fd)) return true;
+  if (auto const tasks = _tasks)
+    if (tasks->running(fd)) return true;
+  if (_forms.empty()) return false;
+  std::lock_guard<std::mutex> lock(_formMutex);
+  return _form.count(fd);
+}
+
+bool mkn::ram::http::AServer::admit(int const& fd, char const* in, size_t const& read,
+                                    std::shared_ptr<Admission>& admitted) {
+  auto const admission = _admission;
+  if (!admission || streaming(fd)) return true;
+  if (!admission->admit(clientIP(fd))) {
+    record(fd, in, read, 503, 0, {});
+    auto const r = admission->rejection();
+    writeTo(fd, r.data(), r.size());
+    return false;
+  }
+  admitted = admission;
+  return true;
+}
+
+bool mkn::ram::http::AServer::late(int const& fd, char const* in, size_t const& read,
+                                   Admission& admitted,
+                                   std::chrono::steady_clock::time_point const& queued) {
+  if (!admitted.late(queued)) return false;
+  record(fd, in, read, 503, 0, std::chrono::steady_clock::now() - queued);
+  auto const r = admitted.rejection();
+  writeTo(fd, r.data(), r.size());
+  return true;
+}
+
+bool mkn::ram::http::AServer::handleEvents(int const& fd, int& e) {
+  if (_events.empty()) return false;
+  std::lock_guard<std::mutex> lock(_sseMutex);
+  if (!_sse.count(fd)) return false;
+  e = 1;
+  return true;
+}
+
+bool mkn::ram::http::AServer::openEvents(int const& fd, A1_1Request const& req) {
+  auto const it = _events.find(req.path());
+  if (it == _events.end() || req.method() != "GET") return false;
+  std::string const res(
+      "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+      "Connection: keep-alive\r\n\r\n");
+  if (writeTo(fd, res.data(), res.size()) < 0) return false;
+  auto const sink = std::make_shared<sse::Sink>(
+      std::string(req.headers().get("Last-Event-ID")),
+      [this, fd](char const* data, size_t const& size) { return writeSome(fd, data, size); },
+      [this, fd]() {
+        std::lock_guard<std::mutex> lock(_sseMutex);
+        _sseReady.push_back(fd);
+      });
+  {
+    std::lock_guard<std::mutex> lock(_sseMutex);
+    _sse[fd] = sink;
+  }
+  if (it->second) it->second(sink, req);
+  return true;
+}
+
+void mkn::ram::http::AServer::flushEvents(std::map<int, uint8_t>& fds) {
+  auto const now = mkn::ram::tcp::ASocket<char>::NOW();
+  std::vector<std::pair<int, std::shared_ptr<sse::Sink>>> todo;
+  {
+    std::lock_guard<std::mutex> lock(_sseMutex);
+    bool const scan = now >= _sseScan;
+    if (scan) {
+      _sseScan = now + 1000;
+      for (auto const& p : _sse)
+        if (fds.count(p.first)) todo.emplace_back(p);
+    }
+    auto keep = _sseReady.begin();
+    for (auto const& fd : _sseReady) {
+      if (!fds.count(fd)) {
+        *keep++ = fd;  // another loop's
+        continue;
+      }
+      auto const it = scan ? _sse.end() : _sse.find(fd);
+      if (it != _sse.end()) todo.emplace_back(*it);
+    }
+    _sseReady.erase(keep, _sseReady.end());
+  }
+  std::sort(todo.begin(), todo.end(),
+            [](auto const& a, auto const& b) { return a.first < b.first; });
+  todo.erase(std::unique(todo.begin(), todo.end(),
+                         [](auto const& a, auto const& b) { return a.first == b.first; }),
+             todo.end());
+  std::vector<int> del, again;
+  for (auto const& p : todo) {
+    auto const r = p.second->flush(now);
+    if (r < 0)
+      del.push_back(p.first);
+    else if (r > 0)
+      again.push_back(p.first);
+  }
+  if (again.size()) {
+    std::lock_guard<std::mutex> lock(_sseMutex);
+    _sseReady.insert(_sseReady.end(), again.begin(), again.end());
+  }
+  if (del.size()) closeFDs(fds, del);
+}
+
+bool mkn::ram::http::AServer::handleTask(int const& fd, int& e) {
+  auto const tasks = _tasks;
+  if (!tasks || !tasks->running(fd)) return false;
+  e = 1;
+  return true;
+}
+
+bool mkn::ram::http::AServer::openTask(int const& fd, std::shared_ptr<A1_1Request> const& req) {
+  auto const tasks = _tasks;
+  if (!tasks) return false;
+  auto const begun = metrics::Histogram::Clock::now();
+  bool const open = tasks->open(fd, req, [this, fd, req, begun](_1_1Response* res) {
+    if (res) {
+      MKN_RAM_TRACE(HandlerEnd, fd);
+      if (auto const compressor = _compressor)
+        compressor->apply(
+            Compressor::NEGOTIATE(req->headers().get(HeaderID::AcceptEncoding)), *res);
+      record(*req, *res, metrics::Histogram::Clock::now() - begun);
+      auto const out = res->toString();
+      auto const written = metrics::Histogram::Clock::now();
+      writeTo(fd, out.data(), out.size());
+      MKN_RAM_TRACE(FirstWrite, fd);
+      if (_metrics) _metrics->write.since(written);
+    }
+    std::lock_guard<std::mutex> lock(_tasksMutex);
+    _tasksDone.push_back(fd);
+  });
+  if (open) MKN_RAM_TRACE(HandlerStart, fd);
+  return open;
+}
+
+void mkn::ram::http::AServer::flushTasks(std::map<int, uint8_t>& fds) {
+  if (auto const tasks = _tasks) tasks->run();
+  std::vector<int> del;
+  {
+    std::lock_guard<std::mutex> lock(_tasksMutex);
+    auto keep = _tasksDone.begin();
+    for (auto const& fd : _tasksDone) {
+      auto const it = fds.find(fd);
+      if (it == fds.end() || it->second == 2)
+        *keep++ = fd;  // another loop's, or its worker has not yet handed the slot back
+      else if (it->second == 1)
+        del.push_back(fd);
+    }
+    _tasksDone.erase(keep, _tasksDone.end());
+  }
+  if (del.size()) closeFDs(fds, del);
+}
+
+void mkn::ram::http::AServer::loop(std::map<int, uint8_t>& fds)
+    KTHROW(mkn::ram::tcp::Exception) {
+  mkn::ram::tcp::SocketServer<char>::loop(fds);
+  if (!_events.empty()) flushEvents(fds);
+  if (_tasks) flushTasks(fds);
+}
+
+void mkn::ram::http::AServer::closeFDs(std::map<int, uint8_t>& fds, std::vector<int>& del) {
+  if (_http2) {
+    std::lock_guard<std::mutex> lock(_h2Mutex);
+    for (auto const& fd : del) _h2.erase(fd);
+  }
+  if (!_webSockets.empty()) {
+    std::lock_guard<std::mutex> lock(_wsMutex);
+    for (auto const& fd : del) {
+      auto const it = _ws.find(fd);
+      if (it == _ws.end()) continue;
+      it->second->detach();
+      _ws.erase(it);
+    }
+  }
+  if (!_forms.empty()) {
+    std::lock_guard<std::mutex> lock(_formMutex);
+    for (auto const& fd : del) _form.erase(fd);
+  }
+  if (!_events.empty()) {
+    std::lock_guard<std::mutex> lock(_sseMutex);
+    for (auto const& fd : del) {
+      auto const it = _sse.find(fd);
+      if (it == _sse.end()) continue;
+      it->second->detach();
+      _sse.erase(it);
+    }
+  }
+  if (auto const tasks = _tasks)
+    for (auto const& fd : del) tasks->close(fd);
+  mkn::ram::tcp::SocketServer<char>::closeFDs(fds, del);
+}
+
 void mkn::ram::http::AServer::handleBuffer(std::map<int, uint8_t>& fds, int const& fd, char* in,
                                            int const& read, int& e) {
   KUL_DBG_FUNC_ENTER;
   in[read] = '\0';
+  {
+    std::string out;
+    if (handleHttp2(fd, in, read, out, e)) {
+      auto const begun = metrics::Histogram::Clock::now();
+      if (out.size()) writeTo(fd, out.data(), out.size());
+      if (out.size()) MKN_RAM_TRACE(FirstWrite, fd);
+      if (_metrics && out.size()) _metrics->write.since(begun);
+      fds[fd] = 1;
+      return;
+    }
+  }
+  if (handleForm(fd, in, read, e) || handleWebSocket(fd, in, read, e) || handleEvents(fd, e) ||
+      handleTask(fd, e)) {
+    fds[fd] = 1;
+    return;
+  }
+  auto const m = _metrics.get();
+  Static::Variant v;
+  std::string_view st[3];
+  if (staticResponse(in, read, v, st)) {
+    record(fd, in, read, v.status, v.body, {});
+    auto const begun = metrics::Histogram::Clock::now();
+    writeStatic(fd, st);
+    MKN_RAM_TRACE(FirstWrite, fd);
+    if (m) {
+      m->write.since(begun);
+      m->status(v.status);
+    }
+    e = 0;
+    fds[fd] = 1;
+    return;
+  }
   std::string res;
   try {
     std::string s(in, read);
@@ -118,11 +746,22 @@ void mkn::ram::http::AServer::handleBuffer(std::map<int, uint8_t>& fds, int cons
       if (f) break;
     }
     if (!f) KEXCEPTION("Logic error encountered, probably https attempt on http port");
+    auto begun = metrics::Histogram::Clock::now();
     std::shared_ptr<A1_1Request> req = handleRequest(fd, s, res);
-    _1_1Response const& rs(respond(*req.get()));
-    std::string ret(rs.toString());
-    writeTo(fd, ret.c_str(), ret.length());
-    e = 0;
+    if (m) m->parse.since(begun);
+    MKN_RAM_TRACE(Headers, fd);
+    std::string ret;
+    e = upgradeHttp2(fd, *req, ret) || upgradeWebSocket(fd, *req) || openEvents(fd, *req) ||
+        openTask(fd, req) || openForm(fd, req, ret);
+    if (!e && ret.empty()) {
+      MKN_RAM_TRACE(HandlerStart, fd);
+      ret = response(*req.get()).toString();
+      MKN_RAM_TRACE(HandlerEnd, fd);
+    }
+    begun = metrics::Histogram::Clock::now();
+    if (ret.size()) writeTo(fd, ret.c_str(), ret.length());
+    if (ret.size()) MKN_RAM_TRACE(FirstWrite, fd);
+    if (m && ret.size()) m->write.since(begun);
   } catch (mkn::ram::http::Exception const& e1) {
     KLOG(ERR) << e1.stack();
     e = -1;
@@ -0,0 +1,167 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <chrono>
+
+#include "mkn/ram/http/sse.hpp"
+
+namespace {
+int64_t NOW() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// a field value ends at the first line break
+std::string_view LINE(std::string_view const& v) { return v.substr(0, v.find_first_of("\r\n")); }
+}  // namespace
+
+void mkn::ram::http::sse::EVENT(std::string& out, std::string_view const& data,
+                                std::string_view const& event, std::string_view const& id) {
+  if (!event.empty()) out.append("event: ").append(LINE(event)).push_back('\n');
+  if (!id.empty()) out.append("id: ").append(LINE(id)).push_back('\n');
+  size_t b = 0;
+  for (auto e = data.find('\n'); b <= data.size(); e = data.find('\n', b)) {
+    auto line = data.substr(b, e == std::string_view::npos ? e : e - b);
+    if (line.size() && line.back() == '\r') line.remove_suffix(1);
+    out.append("data: ").append(line).push_back('\n');
+    if (e == std::string_view::npos) break;
+    b = e + 1;
+  }
+  out.push_back('\n');
+}
+
+mkn::ram::http::sse::Sink::Sink(std::string const& lastEventID, Writer const& writer,
+                                std::function<void()> const& ready)
+    : _writer(writer), _ready(ready), _lastEventID(lastEventID), _written(NOW()) {}
+
+bool mkn::ram::http::sse::Sink::enqueue(std::string_view const& bytes) {
+  bool ready = 0;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_closed) return false;
+    if (_queue.size() - _sent + bytes.size() > _MKN_RAM_HTTP_SSE_QUEUE_) {
+      _closed = 1;  // too slow, dropped without what is queued
+      _queue.clear();
+      _sent = 0;
+      ready = 1;
+    } else {
+      ready = _sent == _queue.size();
+      if (ready || _sent > _queue.size() / 2) {
+        _queue.erase(0, _sent);
+        _sent = 0;
+      }
+      _queue.append(bytes);
+    }
+  }
+  if (ready && _ready) _ready();
+  return !closed();
+}
+
+bool mkn::ram::http::sse::Sink::send(std::string_view const& data, std::string_view const& event,
+                                     std::string_view const& id) {
+  std::string f;
+  EVENT(f, data, event, id);
+  return enqueue(f);
+}
+
+bool mkn::ram::http::sse::Sink::comment(std::string_view const& text) {
+  return enqueue(":" + std::string(LINE(text)) + "\n\n");
+}
+
+bool mkn::ram::http::sse::Sink::retry(uint32_t const& ms) {
+  return enqueue("retry: " + std::to_string(ms) + "\n\n");
+}
+
+void mkn::ram::http::sse::Sink::close() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_closed) return;
+    _closed = 1;  // what is queued is still written
+  }
+  if (_ready) _ready();
+}
+
+int mkn::ram::http::sse::Sink::flush(int64_t const& now) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (!_writer) return -1;
+  if (!_closed && _sent == _queue.size() && now - _written >= _MKN_RAM_HTTP_SSE_HEARTBEAT_) {
+    _queue.assign(":\n\n");
+    _sent = 0;
+  }
+  while (_sent < _queue.size()) {
+    int const w = _writer(_queue.data() + _sent, _queue.size() - _sent);
+    if (w < 0) {
+      _closed = 1;
+      return -1;
+    }
+    if (w == 0) return 1;
+    _sent += w;
+    _written = now;
+  }
+  _queue.clear();
+  _sent = 0;
+  return _closed ? -1 : 0;
+}
+
+void mkn::ram::http::sse::Sink::detach() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _closed = 1;
+  _writer = nullptr;
+}
+
+uint64_t mkn::ram::http::sse::Channel::publish(std::string_view const& data,
+                                               std::string_view const& event) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  uint64_t const id = _next++;
+  std::string f;
+  EVENT(f, data, event, std::to_string(id));
+  for (auto it = _sinks.begin(); it != _sinks.end();)
+    if ((*it)->enqueue(f))
+      ++it;
+    else
+      it = _sinks.erase(it);
+  if (_max) {
+    _history.emplace_back(id, std::move(f));
+    if (_history.size() > _max) _history.pop_front();
+  }
+  return id;
+}
+
+void mkn::ram::http::sse::Channel::subscribe(std::shared_ptr<Sink> const& sink) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto const& last = sink->lastEventID();
+  if (!last.empty()) {
+    auto const after = std::strtoull(last.c_str(), nullptr, 10);
+    for (auto const& h : _history)
+      if (h.first > after && !sink->enqueue(h.second)) return;
+  }
+  _sinks.push_back(sink);
+}
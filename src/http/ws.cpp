@@ -0,0 +1,286 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <cstring>
+
+#include "mkn/ram/http/ws.hpp"
+
+namespace {
+
+uint32_t ROL(uint32_t const& v, int const& n) { return (v << n) | (v >> (32 - n)); }
+
+// 20 byte digest, only for Sec-WebSocket-Accept
+std::string SHA1(std::string const& in) {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  std::string m(in);
+  uint64_t const bits = uint64_t(in.size()) * 8;
+  m.push_back(char(0x80));
+  while (m.size() % 64 != 56) m.push_back(0);
+  for (int i = 7; i >= 0; i--) m.push_back(char(bits >> (i * 8)));
+  for (size_t c = 0; c < m.size(); c += 64) {
+    uint32_t w[80];
+    for (size_t i = 0; i < 16; i++) {
+      auto const* p = reinterpret_cast<uint8_t const*>(m.data() + c + i * 4);
+      w[i] = uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+    }
+    for (size_t i = 16; i < 80; i++) w[i] = ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    uint32_t a = h[0], b = h[1], x = h[2], d = h[3], e = h[4];
+    for (size_t i = 0; i < 80; i++) {
+      uint32_t f, k;
+      if (i < 20)
+        f = (b & x) | (~b & d), k = 0x5A827999;
+      else if (i < 40)
+        f = b ^ x ^ d, k = 0x6ED9EBA1;
+      else if (i < 60)
+        f = (b & x) | (b & d) | (x & d), k = 0x8F1BBCDC;
+      else
+        f = b ^ x ^ d, k = 0xCA62C1D6;
+      uint32_t const t = ROL(a, 5) + f + e + k + w[i];
+      e = d;
+      d = x;
+      x = ROL(b, 30);
+      b = a;
+      a = t;
+    }
+    h[0] += a, h[1] += b, h[2] += x, h[3] += d, h[4] += e;
+  }
+  std::string out;
+  for (auto const& v : h)
+    for (int i = 3; i >= 0; i--) out.push_back(char(v >> (i * 8)));
+  return out;
+}
+
+std::string BASE64(std::string const& in) {
+  static constexpr char T[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  uint32_t acc = 0;
+  int bits = 0;
+  for (auto const& c : in) {
+    acc = (acc << 8) | uint8_t(c);
+    for (bits += 8; bits >= 6; bits -= 6) out.push_back(T[(acc >> (bits - 6)) & 0x3F]);
+  }
+  if (bits) out.push_back(T[(acc << (6 - bits)) & 0x3F]);
+  while (out.size() % 4) out.push_back('=');
+  return out;
+}
+
+// RFC 3629, no overlongs or surrogates, ASCII runs are skipped eight bytes at a time
+bool UTF8(std::string_view const& s) {
+  size_t i = 0, n = s.size();
+  while (i < n) {
+    uint64_t v;
+    if (i + 8 <= n && (std::memcpy(&v, s.data() + i, 8), !(v & 0x8080808080808080ULL))) {
+      i += 8;
+      continue;
+    }
+    uint8_t const c = s[i];
+    if (c < 0x80) {
+      i++;
+      continue;
+    }
+    size_t len;
+    uint32_t cp;
+    if ((c & 0xE0) == 0xC0)
+      len = 2, cp = c & 0x1F;
+    else if ((c & 0xF0) == 0xE0)
+      len = 3, cp = c & 0x0F;
+    else if ((c & 0xF8) == 0xF0)
+      len = 4, cp = c & 0x07;
+    else
+      return false;
+    if (i + len > n) return false;
+    for (size_t j = 1; j < len; j++) {
+      uint8_t const b = s[i + j];
+      if ((b & 0xC0) != 0x80) return false;
+      cp = cp << 6 | (b & 0x3F);
+    }
+    if ((len == 2 && cp < 0x80) || (len == 3 && cp < 0x800) || (len == 4 && cp < 0x10000) ||
+        cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+      return false;
+    i += len;
+  }
+  return true;
+}
+
+// RFC 6455 7.4, codes a peer may send
+bool VALID_CLOSE(uint16_t const& code) {
+  return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1014) ||
+         (code >= 3000 && code <= 4999);
+}
+}  // namespace
+
+std::string mkn::ram::http::ws::ACCEPT(std::string_view const& key) {
+  return BASE64(SHA1(std::string(key) + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+}
+
+void mkn::ram::http::ws::MASK(char* data, size_t const& size, uint8_t const (&key)[4],
+                              size_t const& off) {
+  uint8_t k[8];
+  for (size_t i = 0; i < 8; i++) k[i] = key[(off + i) & 3];
+  uint64_t w, v;
+  std::memcpy(&w, k, 8);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    std::memcpy(&v, data + i, 8);
+    v ^= w;
+    std::memcpy(data + i, &v, 8);
+  }
+  for (; i < size; i++) data[i] ^= k[i & 7];
+}
+
+bool mkn::ram::http::ws::Connection::write(Opcode const& op, std::string_view const& payload) {
+  auto const size = payload.size();
+  std::string f;
+  f.reserve(size + 10);
+  f.push_back(char(0x80 | uint8_t(op)));
+  if (size < 126)
+    f.push_back(char(size));
+  else if (size <= 0xFFFF) {
+    f.push_back(char(126));
+    f.push_back(char(size >> 8));
+    f.push_back(char(size));
+  } else {
+    f.push_back(char(127));
+    for (int i = 7; i >= 0; i--) f.push_back(char(uint64_t(size) >> (i * 8)));
+  }
+  f.append(payload);
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_closed || _closeSent) return false;
+  if (op == Opcode::Close) _closeSent = 1;
+  if (!_writer(f.data(), f.size())) _closed = 1;
+  return !_closed;
+}
+
+bool mkn::ram::http::ws::Connection::fail(uint16_t const& code) {
+  close(code);
+  return false;
+}
+
+bool mkn::ram::http::ws::Connection::receive(char const* data, size_t const& size) {
+  if (closed()) return false;
+  _in.append(data, size);
+  size_t pos = 0;
+  bool open = 1;
+  while (open && _in.size() - pos >= 2) {
+    auto const* p = reinterpret_cast<uint8_t const*>(_in.data() + pos);
+    auto const avail = _in.size() - pos;
+    bool const fin = p[0] & 0x80, control = p[0] & 0x8;
+    auto const op = Opcode(p[0] & 0x0F);
+    uint64_t len = p[1] & 0x7F;
+    if ((p[0] & 0x70) || !(p[1] & 0x80) || (control && (!fin || len > 125)) ||
+        (control && op != Opcode::Close && op != Opcode::Ping && op != Opcode::Pong) ||
+        (!control && uint8_t(op) > uint8_t(Opcode::Binary)) ||
+        (!control && (op == Opcode::Continuation) != _fragmented)) {
+      open = fail(1002);
+      break;
+    }
+    size_t const head = 2 + (len == 126 ? 2 : len == 127 ? 8 : 0) + 4;
+    if (avail < head) break;
+    if (len == 126)
+      len = uint16_t(p[2]) << 8 | p[3];
+    else if (len == 127) {
+      len = 0;
+      for (size_t i = 0; i < 8; i++) len = len << 8 | p[2 + i];
+    }
+    if (!control && (len > _MKN_RAM_HTTP_WS_MAX_MESSAGE_ ||
+                     _message.size() + len > _MKN_RAM_HTTP_WS_MAX_MESSAGE_)) {
+      open = fail(1009);
+      break;
+    }
+    if (avail - head < len) break;
+    uint8_t key[4];
+    std::memcpy(key, p + head - 4, 4);
+    char* payload = &_in[pos + head];
+    MASK(payload, len, key);
+    std::string_view const pl(payload, len);
+    pos += head + len;
+
+    if (op == Opcode::Ping)
+      write(Opcode::Pong, pl);
+    else if (op == Opcode::Close) {
+      uint16_t const code = len >= 2 ? uint16_t(uint8_t(pl[0])) << 8 | uint8_t(pl[1]) : 1000;
+      if (len == 1 || !VALID_CLOSE(code))
+        fail(1002);
+      else if (!UTF8(pl.substr(2 < len ? 2 : len)))
+        fail(1007);
+      else
+        close(code);
+      open = 0;
+    } else if (op == Opcode::Pong)
+      continue;
+    else if (fin && !_fragmented) {  // whole message in one frame, no copy
+      bool const binary = op == Opcode::Binary;
+      if (!binary && !UTF8(pl))
+        open = fail(1007);
+      else if (_handler)
+        _handler(*this, pl, binary);
+    } else {
+      if (op != Opcode::Continuation) {
+        _binary = op == Opcode::Binary;
+        _fragmented = 1;
+      }
+      _message.append(pl);
+      if (!fin) continue;
+      _fragmented = 0;
+      if (!_binary && !UTF8(_message))
+        open = fail(1007);
+      else if (_handler)
+        _handler(*this, _message, _binary);
+      _message.clear();
+    }
+    open = open && !closed();
+  }
+  _in.erase(0, pos);
+  return open && !closed();
+}
+
+bool mkn::ram::http::ws::Connection::send(std::string_view const& message, bool const& binary) {
+  return write(binary ? Opcode::Binary : Opcode::Text, message);
+}
+
+bool mkn::ram::http::ws::Connection::ping(std::string_view const& payload) {
+  return write(Opcode::Ping, payload.substr(0, 125));
+}
+
+void mkn::ram::http::ws::Connection::close(uint16_t const& code, std::string_view const& reason) {
+  std::string p;
+  p.push_back(char(code >> 8));
+  p.push_back(char(code));
+  p.append(reason.substr(0, 123));
+  write(Opcode::Close, p);
+  std::lock_guard<std::mutex> lock(_mutex);
+  _closed = 1;
+}
+
+void mkn::ram::http::ws::Connection::detach() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _closed = 1;
+  _writer = nullptr;
+}
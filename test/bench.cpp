@@ -0,0 +1,473 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// load generator for the usage.cpp test servers, or any host with --server=none
+//  closed loop by default, each connection keeps --pipeline requests in flight
+//  with --rate requests are scheduled at fixed intervals and latency is measured from when each
+//  was due rather than when it went out, so a stalled server can't hide its queueing delay
+//  results are printed as one JSON object
+//
+//  --server=single|multi|https|multi-https|none  --host=localhost  --port=8888  --tls
+//  --connections=8  --pipeline=1  --keep-alive=1  --rate=0  --duration=5000  --timeout=2000
+//  --threads=3  --mix=GET:/:4,POST:/upload:1  --body=0  --out=file
+#define __MKN_RAM_NOMAIN__
+#include "usage.cpp"
+
+#ifndef _WIN32
+
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+
+#include <algorithm>
+#include <csignal>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace mkn {
+namespace ram {
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string server = "multi", host = "localhost", out;
+  uint16_t port = _MKN_RAM_HTTP_TEST_PORT_;
+  size_t connections = 8, pipeline = 1, body = 0, threads = 3;
+  double rate = 0;                          // requests per second over all connections
+  int64_t duration = 5000, timeout = 2000;  // milliseconds
+  bool keepAlive = 1, tls = 0;
+  std::vector<std::string> mix;  // METHOD:PATH[:WEIGHT]
+
+  static Options PARSE(int argc, char* argv[]) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+      std::string const a(argv[i]);
+      auto const eq = a.find('=');
+      std::string const k(a.substr(0, eq)), v(eq == std::string::npos ? "1" : a.substr(eq + 1));
+      if (k == "--server")
+        o.server = v;
+      else if (k == "--host")
+        o.host = v;
+      else if (k == "--port")
+        o.port = std::stoi(v);
+      else if (k == "--tls")
+        o.tls = std::stoi(v);
+      else if (k == "--connections")
+        o.connections = std::stoul(v);
+      else if (k == "--pipeline")
+        o.pipeline = std::stoul(v);
+      else if (k == "--keep-alive")
+        o.keepAlive = std::stoi(v);
+      else if (k == "--rate")
+        o.rate = std::stod(v);
+      else if (k == "--duration")
+        o.duration = std::stoll(v);
+      else if (k == "--timeout")
+        o.timeout = std::stoll(v);
+      else if (k == "--threads")
+        o.threads = std::stoul(v);
+      else if (k == "--body")
+        o.body = std::stoul(v);
+      else if (k == "--out")
+        o.out = v;
+      else if (k == "--mix")
+        for (size_t b = 0, e = 0; b < v.size(); b = e + 1) {
+          e = v.find(',', b);
+          if (e == std::string::npos) e = v.size();
+          o.mix.emplace_back(v.substr(b, e - b));
+        }
+      else
+        KEXCEPT(mkn::kul::Exception, "Unknown argument: " + a);
+    }
+    if (!o.connections || !o.pipeline) KEXCEPT(mkn::kul::Exception, "Nothing to send");
+    if (o.mix.empty()) o.mix.emplace_back("GET:/");
+    if (o.server == "https" || o.server == "multi-https") o.tls = 1;
+    return o;
+  }
+
+  // raw requests, repeated by weight so a connection can cycle through them in order
+  std::vector<std::string> requests() const {
+    std::vector<std::string> rs;
+    for (auto const& m : mix) {
+      auto const c1 = m.find(':'), c2 = m.find(':', c1 + 1);
+      if (c1 == std::string::npos) KEXCEPT(mkn::kul::Exception, "Mix entry needs METHOD:PATH");
+      std::string const method(m.substr(0, c1)), path(m.substr(c1 + 1, c2 - c1 - 1));
+      size_t const weight = c2 == std::string::npos ? 1 : std::stoul(m.substr(c2 + 1));
+      std::string r(method + " " + path + " HTTP/1.1\r\nHost: " + host + ":" +
+                    std::to_string(port) + "\r\n");
+      if (!keepAlive) r += "Connection: close\r\n";
+      bool const hasBody = method == "POST" || method == "PUT" || method == "PATCH";
+      if (hasBody) r += "Content-Length: " + std::to_string(body) + "\r\n";
+      r += "\r\n";
+      if (hasBody) r.append(body, 'x');
+      for (size_t i = 0; i < weight; i++) rs.emplace_back(r);
+    }
+    return rs;
+  }
+};
+
+struct Totals {
+  metrics::Histogram latency;
+  std::atomic<uint64_t> requests{0}, errors{0}, timeouts{0}, unsent{0}, connects{0}, bytes{0},
+      max{0};
+  std::atomic<uint64_t> status[5] = {};
+};
+
+class Wire {
+ private:
+  int _fd = -1;
+#ifdef _MKN_RAM_INCLUDE_HTTPS_
+  SSL* _ssl = nullptr;
+#endif  //_MKN_RAM_INCLUDE_HTTPS_
+
+ public:
+  ~Wire() { close(); }
+  bool open() const { return _fd >= 0; }
+  int fd() const { return _fd; }
+  bool connect(addrinfo const* ai, void* ctx, std::string const& host) {
+    _fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (_fd < 0) return false;
+    int one = 1;
+    ::setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (::connect(_fd, ai->ai_addr, ai->ai_addrlen)) return close(), false;
+#ifdef _MKN_RAM_INCLUDE_HTTPS_
+    if (ctx) {
+      _ssl = SSL_new(static_cast<SSL_CTX*>(ctx));
+      SSL_set_fd(_ssl, _fd);
+      SSL_set_tlsext_host_name(_ssl, host.c_str());
+      if (SSL_connect(_ssl) <= 0) return close(), false;
+    }
+#endif  //_MKN_RAM_INCLUDE_HTTPS_
+    // TLS 1.3 tickets can wake poll without any response data
+    ::fcntl(_fd, F_SETFL, ::fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+    return true;
+  }
+  bool send(std::string const& s, int const& timeout) {
+    for (size_t sent = 0; sent < s.size();) {
+      auto const w = write(s.data() + sent, s.size() - sent);
+      if (w == 0) return false;
+      if (w > 0) sent += w;
+      struct pollfd pfd = {_fd, POLLOUT, 0};
+      if (w < 0 && ::poll(&pfd, 1, timeout) <= 0) return false;
+    }
+    return true;
+  }
+  // bytes moved, 0 once the peer has closed or on error, -1 if it would block
+  long read(char* buf, size_t const& len) {
+#ifdef _MKN_RAM_INCLUDE_HTTPS_
+    if (_ssl) return result(SSL_read(_ssl, buf, len));
+#endif  //_MKN_RAM_INCLUDE_HTTPS_
+    return result(::recv(_fd, buf, len, 0));
+  }
+  long write(char const* buf, size_t const& len) {
+#ifdef _MKN_RAM_INCLUDE_HTTPS_
+    if (_ssl) return result(SSL_write(_ssl, buf, len));
+#endif  //_MKN_RAM_INCLUDE_HTTPS_
+    return result(::send(_fd, buf, len, _MKN_RAM_TCP_SEND_FLAGS_));
+  }
+  long result(long const& r) const {
+    if (r > 0) return r;
+#ifdef _MKN_RAM_INCLUDE_HTTPS_
+    if (_ssl) {
+      auto const e = SSL_get_error(_ssl, r);
+      return e == SSL_ERROR_WANT_READ || e == SSL_ERROR_WANT_WRITE ? -1 : 0;
+    }
+#endif  //_MKN_RAM_INCLUDE_HTTPS_
+    return r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? -1 : 0;
+  }
+  bool pending() const {
+#ifdef _MKN_RAM_INCLUDE_HTTPS_
+    return _ssl && SSL_pending(_ssl);
+#else
+    return false;
+#endif  //_MKN_RAM_INCLUDE_HTTPS_
+  }
+  void close() {
+#ifdef _MKN_RAM_INCLUDE_HTTPS_
+    if (_ssl) SSL_free(_ssl);
+    _ssl = nullptr;
+#endif  //_MKN_RAM_INCLUDE_HTTPS_
+    if (_fd >= 0) ::close(_fd);
+    _fd = -1;
+  }
+};
+
+class Connection {
+ private:
+  struct Pending {
+    Clock::time_point due, sent;
+    size_t request;
+  };
+  size_t const _id;
+  Options const& _o;
+  std::vector<std::string> const& _requests;
+  addrinfo const* _ai;
+  void* _ctx;
+  Totals& _totals;
+  Wire _wire;
+  std::string _in;
+  std::deque<Pending> _due, _sent;
+  size_t _answered = 0;  // responses on the current wire
+  uint64_t _max = 0;
+
+  void record(int const& status) {
+    auto const ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 Clock::now() - _sent.front().due)
+                                 .count());
+    _totals.latency.record(ns);
+    _max = std::max(_max, ns);
+    _totals.requests++;
+    if (status >= 100 && status < 600) _totals.status[status / 100 - 1]++;
+    _sent.pop_front();
+    _answered++;
+  }
+  // resend what the closed wire didn't answer, unless it answered nothing at all
+  void reset() {
+    _wire.close();
+    _in.clear();
+    if (!_sent.empty() && !_answered) {
+      _totals.errors++;
+      _sent.pop_front();
+    }
+    while (!_sent.empty()) _due.push_front(_sent.back()), _sent.pop_back();
+    _answered = 0;
+  }
+  // consume complete responses from _in, false if the server will close the wire
+  bool parse(bool const& eof) {
+    while (!_sent.empty()) {
+      // the servers end lines with os::EOL so accept bare \n as well
+      auto const lf = _in.find("\n\n"), crlf = _in.find("\n\r\n");
+      auto const end = std::min(lf, crlf);
+      if (end == std::string::npos || _in.size() < 12) return !eof;
+      std::string head(_in, 0, end);
+      std::transform(head.begin(), head.end(), head.begin(), ::tolower);
+      int const status = std::atoi(_in.c_str() + 9);
+      bool const close = head.find("\nconnection: close") != std::string::npos;
+      auto const cl = head.find("\ncontent-length:");
+      if (cl == std::string::npos) {
+        if (!eof) return 1;
+        record(status);
+        return _in.clear(), 0;
+      }
+      size_t const size =
+          end + (end == lf ? 2 : 3) + std::strtoull(head.c_str() + cl + 16, nullptr, 10);
+      if (_in.size() < size) return !eof;
+      record(status);
+      _in.erase(0, size);
+      if (close) return 0;
+    }
+    return !eof;
+  }
+
+ public:
+  Connection(size_t const& id, Options const& o, std::vector<std::string> const& requests,
+             addrinfo const* ai, void* ctx, Totals& totals)
+      : _id(id), _o(o), _requests(requests), _ai(ai), _ctx(ctx), _totals(totals) {}
+
+  void operator()(Clock::time_point const& start) {
+    auto const end = start + std::chrono::milliseconds(_o.duration);
+    auto const timeout = std::chrono::milliseconds(_o.timeout);
+    auto const gap = std::chrono::nanoseconds(
+        _o.rate > 0 ? int64_t(1e9 * double(_o.connections) / _o.rate) : 0);
+    Clock::time_point next = start + gap * int64_t(_id) / int64_t(_o.connections);  // staggered
+    size_t index = _id;
+    char buf[16384];
+    while (true) {
+      auto const now = Clock::now();
+      bool const running = now < end;
+      if (running && gap.count())
+        for (; next <= now; next += gap) _due.push_back({next, {}, index++ % _requests.size()});
+      else if (running)
+        while (_due.size() + _sent.size() < _o.pipeline)
+          _due.push_back({now, {}, index++ % _requests.size()});
+      if (!running && _sent.empty()) break;
+      if (!_sent.empty() && now - _sent.front().sent > timeout) {
+        _totals.timeouts++;
+        _sent.pop_front();
+        _answered = 1;  // already counted, resend the rest
+        reset();
+        continue;
+      }
+      if (!_wire.open()) {
+        _totals.connects++;
+        if (!_wire.connect(_ai, _ctx, _o.host)) {
+          _totals.errors++;
+          if (!_due.empty()) _due.pop_front();
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+          continue;
+        }
+      }
+      while (running && !_due.empty() && _sent.size() < _o.pipeline) {
+        auto p = _due.front();
+        _due.pop_front();
+        p.sent = Clock::now();
+        _sent.push_back(p);
+        if (!_wire.send(_requests[p.request], _o.timeout)) break;
+      }
+      // wake for the next due request or the oldest one's timeout
+      auto wake = _sent.empty() ? now + std::chrono::milliseconds(1) : _sent.front().sent + timeout;
+      if (running && gap.count()) wake = _sent.empty() ? next : std::min(wake, next);
+      auto const ms = std::chrono::ceil<std::chrono::milliseconds>(wake - Clock::now()).count();
+      struct pollfd pfd = {_wire.fd(), POLLIN, 0};
+      if (!_wire.pending() && ::poll(&pfd, 1, std::max<int>(ms, 0)) <= 0) continue;
+      auto const r = _wire.read(buf, sizeof(buf));
+      if (r < 0) continue;
+      _totals.bytes += r;
+      _in.append(buf, r);
+      if (!parse(!r)) reset();
+    }
+    _totals.unsent += _due.size();
+    for (auto m = _totals.max.load(); m < _max && !_totals.max.compare_exchange_weak(m, _max);) {
+    }
+  }
+};
+
+std::string RUN(Options const& o) {
+  addrinfo hints = {}, *ai = nullptr;
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(o.host.c_str(), std::to_string(o.port).c_str(), &hints, &ai) || !ai)
+    KEXCEPT(mkn::kul::Exception, "Could not resolve " + o.host);
+  std::unique_ptr<addrinfo, decltype(&freeaddrinfo)> const resolved(ai, &freeaddrinfo);
+  void* ctx = nullptr;
+#ifdef _MKN_RAM_INCLUDE_HTTPS_
+  std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)> const tls(
+      o.tls ? SSL_CTX_new(TLS_client_method()) : nullptr, &SSL_CTX_free);
+  ctx = tls.get();
+#else
+  if (o.tls) KEXCEPT(mkn::kul::Exception, "--tls needs _MKN_RAM_INCLUDE_HTTPS_");
+#endif  //_MKN_RAM_INCLUDE_HTTPS_
+
+  auto const requests = o.requests();
+  Totals totals;
+  std::vector<std::unique_ptr<Connection>> cs;
+  for (size_t i = 0; i < o.connections; i++)
+    cs.emplace_back(std::make_unique<Connection>(i, o, requests, ai, ctx, totals));
+  auto const start = Clock::now() + std::chrono::milliseconds(10);
+  std::vector<std::thread> ts;
+  for (auto& c : cs) ts.emplace_back(std::ref(*c), start);
+  for (auto& t : ts) t.join();
+  double const seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  auto const snap = totals.latency.snapshot();
+  uint64_t const max = totals.max;
+  auto const us = [](uint64_t const& ns) { return std::to_string(double(ns) / 1e3); };
+  // bucket upper bounds, clamped to the exact maximum
+  auto const q = [&](double const& d) { return us(std::min(snap.quantile(d), max)); };
+  std::stringstream ss;
+  ss << "{\"server\":\"" << o.server << "\",\"host\":\"" << o.host << "\",\"port\":" << o.port
+     << ",\"tls\":" << (o.tls ? "true" : "false") << ",\"connections\":" << o.connections
+     << ",\"pipeline\":" << o.pipeline << ",\"keep_alive\":" << (o.keepAlive ? "true" : "false")
+     << ",\"rate\":" << o.rate << ",\"duration_ms\":" << o.duration << ",\"mix\":[";
+  for (size_t i = 0; i < o.mix.size(); i++) ss << (i ? "," : "") << "\"" << o.mix[i] << "\"";
+  ss << "],\"seconds\":" << seconds << ",\"requests\":" << totals.requests
+     << ",\"throughput\":" << (double(totals.requests) / seconds)
+     << ",\"errors\":" << totals.errors << ",\"timeouts\":" << totals.timeouts
+     << ",\"unsent\":" << totals.unsent << ",\"connects\":" << totals.connects
+     << ",\"bytes\":" << totals.bytes << ",\"status\":{";
+  for (size_t i = 0; i < 5; i++)
+    ss << (i ? "," : "") << "\"" << (i + 1) << "xx\":" << totals.status[i];
+  ss << "},\"latency_us\":{\"mean\":" << us(snap.count ? snap.sum / snap.count : 0)
+     << ",\"p50\":" << q(.5) << ",\"p90\":" << q(.9) << ",\"p99\":" << q(.99)
+     << ",\"p999\":" << q(.999) << ",\"max\":" << us(max) << "}}";
+  return ss.str();
+}
+
+template <class S>
+std::string SERVE(S& serv, Options const& o) {
+  mkn::kul::Thread t(std::ref(serv));
+  t.run();
+  mkn::kul::this_thread::sleep(333);
+  if (t.exception()) std::rethrow_exception(t.exception());
+  auto const json = RUN(o);
+  serv.stop();
+  mkn::kul::this_thread::sleep(100);
+  t.join();
+  return json;
+}
+
+}  // namespace bench
+}  // namespace ram
+}  // namespace mkn
+
+int main(int argc, char* argv[]) {
+  ::signal(SIGPIPE, SIG_IGN);  // OpenSSL writes without MSG_NOSIGNAL
+  try {
+    using namespace mkn::ram;
+    auto const o = bench::Options::PARSE(argc, argv);
+    std::string json;
+    if (o.server == "none") {
+      json = bench::RUN(o);
+    } else if (o.server == "single") {
+      TestHTTPServer serv;
+      json = bench::SERVE(serv, o);
+    } else if (o.server == "multi") {
+      TestMultiHTTPServer serv(1, o.threads);
+      json = bench::SERVE(serv, o);
+#ifdef _MKN_RAM_INCLUDE_HTTPS_
+    } else if (o.server == "https") {
+      TestHTTPSServer serv;
+      serv.init();
+      json = bench::SERVE(serv, o);
+    } else if (o.server == "multi-https") {
+      TestMultiHTTPSServer serv(1, o.threads);
+      serv.init();
+      json = bench::SERVE(serv, o);
+#endif  //_MKN_RAM_INCLUDE_HTTPS_
+    } else
+      KEXCEPT(mkn::kul::Exception, "Unknown server: " + o.server);
+    if (o.out.empty())
+      std::cout << json << std::endl;
+    else
+      std::ofstream(o.out) << json << std::endl;
+  } catch (mkn::kul::Exception const& e) {
+    KERR << e.stack();
+    return 1;
+  } catch (std::exception const& e) {
+    KERR << e.what();
+    return 2;
+  } catch (...) {
+    KERR << "UNKNOWN EXCEPTION CAUGHT";
+    return 3;
+  }
+  return 0;
+}
+
+#else
+
+int main(int argc, char* argv[]) {
+  KERR << "bench is not available on windows";
+  return 1;
+}
+
+#endif  // _WIN32
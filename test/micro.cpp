@@ -0,0 +1,262 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// microbenchmarks for the CPU bound paths, request parsing, response and request serialising,
+//  html rendering and escaping, reported as ns, allocations and bytes allocated per op
+//  allocations are counted by replacing the global operator new in this binary
+//
+//  --filter=substring  --time=200 (milliseconds per benchmark)  --json
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "mkn/ram/html4.hpp"
+#include "mkn/ram/http.hpp"
+
+namespace {
+std::atomic<uint64_t> ALLOCS{0}, BYTES{0};
+
+// every delete frees here, out of line so GCC doesn't see free paired with operator new
+#ifdef _MSC_VER
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+void RELEASE(void* p) noexcept {
+  std::free(p);
+}
+}  // namespace
+
+void* operator new(std::size_t size) {
+  ALLOCS.fetch_add(1, std::memory_order_relaxed);
+  BYTES.fetch_add(size, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return ::operator new(size); }
+void operator delete(void* p) noexcept { RELEASE(p); }
+void operator delete[](void* p) noexcept { RELEASE(p); }
+void operator delete(void* p, std::size_t) noexcept { RELEASE(p); }
+void operator delete[](void* p, std::size_t) noexcept { RELEASE(p); }
+
+namespace mkn {
+namespace ram {
+namespace micro {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string filter;
+  int64_t time = 200;
+  bool json = 0;
+};
+
+struct Result {
+  std::string name;
+  uint64_t ops;
+  double ns, allocs, bytes;
+};
+
+// results are summed here so the optimiser keeps the work
+size_t volatile SINK = 0;
+
+// runs f in doubling batches until a batch takes --time, the last batch is the measurement
+template <class F>
+Result RUN(std::string const& name, Options const& o, F&& f) {
+  SINK = SINK + f();
+  uint64_t n = 1;
+  while (true) {
+    auto const a0 = ALLOCS.load(), b0 = BYTES.load();
+    auto const begun = Clock::now();
+    for (uint64_t i = 0; i < n; i++) SINK = SINK + f();
+    auto const ns = std::chrono::duration<double, std::nano>(Clock::now() - begun).count();
+    if (ns >= o.time * 1e6 || n >= (uint64_t(1) << 40))
+      return {name, n, ns / n, double(ALLOCS.load() - a0) / n, double(BYTES.load() - b0) / n};
+    n *= 2;
+  }
+}
+
+std::string const BROWSER =
+    "GET /search?q=mkn+ram&lang=en HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+    "Chrome/124.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,"
+    "image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Referer: https://www.example.com/\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: en-GB,en-US;q=0.9,en;q=0.8\r\n";
+
+// 40 cookies of about 100 bytes, around the 4KB browsers allow per domain
+std::string COOKIES() {
+  std::string c;
+  for (size_t i = 0; i < 40; i++) {
+    if (i) c += "; ";
+    c += "_session_" + std::to_string(i) + "=";
+    for (size_t j = 0; j < 90; j++) c += "abcdefghijklmnopqrstuvwxyz0123456789"[(i * 7 + j) % 36];
+  }
+  return c;
+}
+
+// 2KB of markup and quotes, most characters need escaping
+std::string ESCAPES() {
+  std::string s;
+  while (s.size() < 2048) s += "<a href=\"/x?a=1&b='2'\">Tom & Jerry</a> / ";
+  return s;
+}
+
+class Parser : public mkn::ram::http::Server {
+ public:
+  Parser() : mkn::ram::http::Server(0) {}
+  std::shared_ptr<http::A1_1Request> parse(std::string const& s) {
+    std::string path;
+    return handleRequest(1, s, path);
+  }
+};
+
+class Page : public mkn::ram::html4::Page {
+ public:
+  // depth nested divs, each with attributes, a line of escaped text and a few siblings
+  Page(size_t const& depth, size_t const& width) {
+    using namespace mkn::ram::html4;
+    head(std::make_shared<tag::Named>("title", "microbenchmark"));
+    std::shared_ptr<Tag> parent = std::make_shared<tag::Named>("div");
+    body(parent);
+    for (size_t d = 0; d < depth; d++) {
+      for (size_t w = 0; w < width; w++) {
+        auto p = std::make_shared<tag::Named>("p");
+        p->attribute("class", "row r" + std::to_string(w)).attribute("data-depth", "d");
+        p->add(std::make_shared<esc::Text>("Row " + std::to_string(w) + " <b>&</b> \"quoted\""));
+        parent->add(p);
+      }
+      auto child = std::make_shared<tag::Named>("div");
+      child->attribute("id", "level" + std::to_string(d));
+      parent->add(child);
+      parent = child;
+    }
+  }
+};
+
+std::vector<Result> ALL(Options const& o) {
+  using namespace mkn::ram::http;
+  std::vector<Result> rs;
+  auto const run = [&](std::string const& name, auto&& f) {
+    if (name.find(o.filter) != std::string::npos) rs.emplace_back(RUN(name, o, f));
+  };
+
+  Parser parser;
+  std::string const cookies(COOKIES()), browser(BROWSER + "\r\n"),
+      cookied(BROWSER + "Cookie: " + cookies + "\r\n\r\n");
+  run("request.parse.browser", [&] { return parser.parse(browser)->headers().size(); });
+  run("request.parse.cookies", [&] { return parser.parse(cookied)->cookie("_session_39").size(); });
+
+  _1_1Response res;
+  res.withBody(std::string(1024, 'x')).withDefaultHeaders();
+  res.header("Cache-Control", "no-cache");
+  res.header("X-Request-Id", "7f3c2a1e-9b8d-4c6f-a5e4-3d2c1b0a9f8e");
+  res.cookie("session", Cookie("a3f8e2d1c4b5a6978899aabbccddeeff"));
+  res.cookie("prefs", Cookie("theme=dark"));
+  run("response.toString", [&] { return res.toString().size(); });
+  std::string const raw(res.toString());
+  run("response.FROM_STRING+copy", [&] {
+    std::string b(raw);
+    return _1_1Response::FROM_STRING(b).body().size();
+  });
+
+  _1_1GetRequest get("www.example.com", "search?q=mkn+ram&lang=en", 443);
+  for (auto const& h : {"Accept", "Accept-Encoding", "Accept-Language", "User-Agent", "Referer"})
+    get.header(h, "text/html,application/xhtml+xml,application/xml;q=0.9");
+  get.cookie("session", "a3f8e2d1c4b5a6978899aabbccddeeff");
+  get.cookie("prefs", "theme=dark");
+  run("request.toString", [&] { return get.toString().size(); });
+
+  Page deep(32, 4);
+  run("html.render.deep", [&] { return deep.render()->size(); });
+
+  std::string const escapes(ESCAPES());
+  run("html.ESC+copy", [&] {
+    std::string s(escapes);
+    return mkn::ram::HTML::ESC(s).size();
+  });
+  return rs;
+}
+
+}  // namespace micro
+}  // namespace ram
+}  // namespace mkn
+
+int main(int argc, char* argv[]) {
+  try {
+    mkn::ram::micro::Options o;
+    for (int i = 1; i < argc; i++) {
+      std::string const a(argv[i]);
+      if (a.rfind("--filter=", 0) == 0)
+        o.filter = a.substr(9);
+      else if (a.rfind("--time=", 0) == 0)
+        o.time = std::stoll(a.substr(7));
+      else if (a == "--json")
+        o.json = 1;
+      else
+        KEXCEPT(mkn::kul::Exception, "Unknown argument: " + a);
+    }
+    auto const rs = mkn::ram::micro::ALL(o);
+    if (o.json) std::printf("[");
+    for (size_t i = 0; i < rs.size(); i++) {
+      auto const& r = rs[i];
+      if (o.json)
+        std::printf("%s{\"name\":\"%s\",\"ops\":%llu,\"ns\":%.1f,\"allocs\":%.2f,\"bytes\":%.1f}",
+                    i ? "," : "", r.name.c_str(), (unsigned long long)r.ops, r.ns, r.allocs,
+                    r.bytes);
+      else
+        std::printf("%-28s %12.1f ns/op %8.2f allocs/op %10.1f B/op\n", r.name.c_str(), r.ns,
+                    r.allocs, r.bytes);
+    }
+    if (o.json) std::printf("]\n");
+  } catch (mkn::kul::Exception const& e) {
+    KERR << e.stack();
+    return 1;
+  } catch (std::exception const& e) {
+    KERR << e.what();
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,1251 @@
+/**
+Copyright (c) 2024, Philip Deegan.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+    * Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+copyright notice, this list of conditions and the following disclaimer
+in the documentation and/or other materials provided with the
+distribution.
+    * Neither the name of Philip Deegan nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "mkn/ram/dns.hpp"
+#include "mkn/ram/http.hpp"
+#include "mkn/ram/http/access.hpp"
+#include "mkn/ram/http/admission.hpp"
+#include "mkn/ram/http/cache.hpp"
+#include "mkn/ram/http/compress.hpp"
+#include "mkn/ram/http/date.hpp"
+#include "mkn/ram/http/h2.hpp"
+#include "mkn/ram/http/headers.hpp"
+#include "mkn/ram/http/hpack.hpp"
+#include "mkn/ram/tcp.hpp"
+
+#ifdef _MKN_RAM_INCLUDE_HTTPS_
+#include "mkn/ram/https.hpp"
+#endif  //_MKN_RAM_INCLUDE_HTTPS_
+
+namespace mkn {
+namespace ram {
+
+class Unit {
+  static void CHECK(bool const& ok, std::string const& what) {
+    if (!ok) KEXCEPT(mkn::kul::Exception, "FAILED: " + what);
+  }
+  // bytes from hex pairs, spaces ignored
+  static std::string HEX(std::string_view const& h) {
+    std::string out;
+    auto const nibble = [](char c) { return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10; };
+    for (size_t i = 0; i < h.size();) {
+      if (h[i] == ' ') {
+        i++;
+        continue;
+      }
+      auto const hi = nibble(h[i]), lo = nibble(h[i + 1]);
+      out.push_back(char(hi << 4 | lo));
+      i += 2;
+    }
+    return out;
+  }
+  template <typename F>
+  static void UNTIL(F const& f) {
+    for (size_t i = 0; i < 200 && !f(); i++) mkn::kul::this_thread::sleep(10);
+  }
+  template <typename F>
+  static int64_t TIMED(F const& f) {
+    auto const begin = mkn::ram::tcp::ASocket<char>::NOW();
+    f();
+    return mkn::ram::tcp::ASocket<char>::NOW() - begin;
+  }
+  template <typename F>
+  static bool THROWS_STD(F const& f) {
+    try {
+      f();
+    } catch (std::exception const& e) {
+      return true;
+    }
+    return false;
+  }
+  template <typename F>
+  static bool THROWS(F const& f) {
+    try {
+      f();
+    } catch (mkn::kul::Exception const& e) {
+      return true;
+    }
+    return false;
+  }
+
+  // a unique file in the temp directory, removed with its rotations however the test ends
+  class Temp {
+    std::string const _path;
+
+   public:
+    Temp(std::string const& name)
+        : _path((std::filesystem::temp_directory_path() /
+                 (name + "." +
+                  std::to_string(std::chrono::steady_clock::now().time_since_epoch().count())))
+                    .string()) {}
+    ~Temp() {
+      std::error_code ec;
+      std::filesystem::remove(_path, ec);
+      for (size_t i = 1; i < 10; i++) std::filesystem::remove(_path + "." + std::to_string(i), ec);
+    }
+    std::string const& path() const { return _path; }
+    bool exists(size_t const& i = 0) const {
+      return std::filesystem::exists(i ? _path + "." + std::to_string(i) : _path);
+    }
+    std::string read(size_t const& i = 0) const {
+      std::ifstream f(i ? _path + "." + std::to_string(i) : _path, std::ios::binary);
+      return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    }
+  };
+
+#ifndef _WIN32
+  // a loopback listener that never accepts, with full set its backlog is taken so connects hang
+  class Silent {
+    int _sck = -1, _held = -1;
+    uint16_t _port = 0;
+
+   public:
+    Silent(bool const& full) {
+      _sck = socket(AF_INET, SOCK_STREAM, 0);
+      struct sockaddr_in a;
+      memset(&a, 0, sizeof(a));
+      a.sin_family = AF_INET;
+      a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      socklen_t len = sizeof(a);
+      if (bind(_sck, (struct sockaddr*)&a, len) < 0 || listen(_sck, full ? 0 : 8) < 0 ||
+          getsockname(_sck, (struct sockaddr*)&a, &len) < 0)
+        KEXCEPT(mkn::kul::Exception, "Silent listener failed");
+      _port = ntohs(a.sin_port);
+      if (full) mkn::ram::tcp::Socket<char>::CONNECT(_held, "127.0.0.1", _port, 1000);
+    }
+    ~Silent() {
+      if (_held >= 0) ::close(_held);
+      ::close(_sck);
+    }
+    uint16_t const& port() const { return _port; }
+  };
+#endif  // _WIN32
+
+ public:
+  Unit() {
+#ifndef _WIN32
+    KOUT(NON) << "DNS Resolver";
+    dns();
+    KOUT(NON) << "Socket timeouts";
+    timeouts();
+#endif  // _WIN32
+    KOUT(NON) << "Response completion";
+    complete();
+    KOUT(NON) << "Headers";
+    headers();
+    KOUT(NON) << "Query strings";
+    query();
+    KOUT(NON) << "Request cookies";
+    cookies();
+    KOUT(NON) << "Date and default headers";
+    date();
+    KOUT(NON) << "Response cache";
+    cache();
+    KOUT(NON) << "Compression";
+    compress();
+    KOUT(NON) << "HPACK";
+    hpack();
+    KOUT(NON) << "HTTP/2 framing";
+    h2();
+    KOUT(NON) << "Admission";
+    admission();
+    KOUT(NON) << "Access log";
+    access();
+  }
+
+  void access() {
+    using mkn::ram::http::AccessLog;
+    auto const hour = 3600 * 1000;
+    {
+      Temp tmp("mkn.ram.access");
+      {
+        AccessLog log(tmp.path(), 1 << 20, 0, hour);
+        CHECK(log.push("GET", "/a\"b\\c\x01", "127.0.0.1", 80, 200, 5, {}), "access push");
+        log.flush();
+      }
+      auto const line = tmp.read();
+      CHECK(line.find("\"method\":\"GET\",\"path\":\"/a\\\"b\\\\c\\u0001\"") !=
+                    std::string::npos &&
+                line.find("\"status\":200,\"bytes\":5,") != std::string::npos &&
+                line.back() == '\n',
+            "access escapes JSON " + line);
+    }
+    {
+      Temp tmp("mkn.ram.access");
+      AccessLog log(tmp.path(), 64, 2, hour);  // every batch is over 64 bytes
+      for (size_t i = 0; i < 4; i++) {
+        log.push("GET", "/" + std::to_string(i), "127.0.0.1", 80, 200, 0, {});
+        log.flush();
+      }
+      CHECK(log.written() == 4, "access rotate written");
+      CHECK(tmp.exists() && tmp.exists(1) && tmp.exists(2) && !tmp.exists(3), "access keep");
+      CHECK(tmp.read().find("\"/3\"") != std::string::npos &&
+                tmp.read(1).find("\"/2\"") != std::string::npos &&
+                tmp.read(2).find("\"/1\"") != std::string::npos,
+            "access rotate order");
+    }
+    {
+      Temp tmp("mkn.ram.access");
+      AccessLog log(tmp.path(), 64, 0, hour);
+      log.push("GET", "/0", "127.0.0.1", 80, 200, 0, {});
+      log.flush();
+      log.push("GET", "/1", "127.0.0.1", 80, 200, 0, {});
+      log.flush();
+      CHECK(tmp.exists() && !tmp.exists(1), "access keep none");
+      CHECK(tmp.read().find("\"/0\"") == std::string::npos &&
+                tmp.read().find("\"/1\"") != std::string::npos,
+            "access keep none truncates");
+    }
+    {
+      Temp tmp("mkn.ram.access");
+      AccessLog log(tmp.path(), 1 << 20, 0, hour);
+      size_t pushed = 0;
+      for (size_t i = 0; i < _MKN_RAM_HTTP_ACCESS_RING_ + 10; i++)
+        pushed += log.push("GET", "/", "127.0.0.1", 80, 200, 0, {});
+      CHECK(pushed == _MKN_RAM_HTTP_ACCESS_RING_ && log.dropped() == 10, "access ring overflow");
+      log.flush();
+      CHECK(log.written() == pushed, "access ring drained");
+      auto const text = tmp.read();
+      CHECK(text.find("\"dropped\":10}\n") != std::string::npos, "access dropped line");
+      log.push("GET", "/", "127.0.0.1", 80, 200, 0, {});
+      log.flush();
+      CHECK(tmp.read().find("\"dropped\"", text.size()) == std::string::npos,
+            "access dropped reported once");
+    }
+  }
+
+  void admission() {
+    using mkn::ram::http::Admission;
+    {
+      Admission a(1, 5, 100, 7);
+      CHECK(a.admit("a") && a.inFlight() == 1, "admission admits under the limit");
+      CHECK(!a.admit("b") && a.inFlight() == 1 && a.shed() == 1, "admission in flight limit");
+      a.done();
+      CHECK(a.admit("b") && a.inFlight() == 1, "admission admits once done");
+      a.done();
+      CHECK(a.rejection() ==
+                "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 7\r\nContent-Length: 0\r\n"
+                "Connection: close\r\n\r\n",
+            "admission rejection");
+    }
+    {
+      Admission a(0);
+      a.perClient(1, 1);
+      CHECK(a.admit("a"), "admission first token");
+      a.done();
+      CHECK(!a.admit("a") && a.shed() == 1, "admission per client bucket empty");
+      CHECK(a.admit("b"), "admission per client buckets apart");
+      a.done();
+      mkn::kul::this_thread::sleep(1100);
+      CHECK(a.admit("a"), "admission per client refill");
+      a.done();
+      CHECK(a.inFlight() == 0, "admission per client in flight");
+    }
+    auto const ago = [](size_t const& ms) {
+      return Admission::Clock::now() - std::chrono::milliseconds(ms);
+    };
+    {
+      Admission a(0, 5, 100);
+      CHECK(!a.late(ago(0)), "admission fresh request kept");
+      CHECK(a.late(ago(200)) && a.shed() == 1, "admission shed past the interval");
+    }
+    {
+      Admission a(0, 5, 100);
+      CHECK(!a.late(ago(20)), "admission delay above target while not standing");
+      mkn::kul::this_thread::sleep(110);  // the last window's minimum delay was over target
+      CHECK(a.late(ago(20)), "admission standing queue sheds over twice target");
+      CHECK(!a.late(ago(0)), "admission standing queue keeps fresh requests");
+    }
+  }
+
+  void hpack() {
+    using namespace mkn::ram::http::hpack;
+    using mkn::ram::http::Exception;
+    auto const decodes = [](std::string const& in, uint8_t const& prefix) {
+      char const* p = in.data();
+      auto const v = INTEGER(p, in.data() + in.size(), prefix);
+      return p == in.data() + in.size() ? v : UINT64_MAX;
+    };
+    for (auto const& t : std::vector<std::tuple<uint64_t, uint8_t, std::string>>{
+             {10, 5, HEX("0a")},
+             {1337, 5, HEX("1f9a0a")},
+             {42, 8, HEX("2a")},
+             {31, 5, HEX("1f00")}}) {
+      std::string out;
+      INTEGER(out, std::get<0>(t), std::get<1>(t), 0);
+      CHECK(out == std::get<2>(t), "hpack integer " + std::to_string(std::get<0>(t)));
+      CHECK(decodes(out, std::get<1>(t)) == std::get<0>(t), "hpack integer decode");
+    }
+    CHECK(THROWS([&] { decodes(HEX("1f9a"), 5); }), "hpack truncated integer");
+    CHECK(THROWS([&] { decodes(HEX("1fffffffffffffffffff0f"), 5); }), "hpack integer overflow");
+
+    // RFC 7541 C.4
+    for (auto const& t : std::vector<std::pair<std::string, std::string>>{
+             {"www.example.com", "f1e3c2e5f23a6ba0ab90f4ff"},
+             {"no-cache", "a8eb10649cbf"},
+             {"custom-key", "25a849e95ba97d7f"},
+             {"custom-value", "25a849e95bb8e8b4bf"}}) {
+      std::string enc, dec;
+      HUFFMAN_ENCODE(enc, t.first);
+      CHECK(enc == HEX(t.second) && HUFFMAN_SIZE(t.first) == enc.size(), "huffman " + t.first);
+      HUFFMAN_DECODE(dec, enc);
+      CHECK(dec == t.first, "huffman decode " + t.first);
+    }
+    {
+      std::string all, enc, dec;
+      for (size_t i = 0; i < 256; i++) all.push_back(char(i));
+      HUFFMAN_ENCODE(enc, all);
+      HUFFMAN_DECODE(dec, enc);
+      CHECK(dec == all && HUFFMAN_SIZE(all) == enc.size(), "huffman every octet");
+    }
+    CHECK(THROWS([] {
+            std::string s;
+            HUFFMAN_DECODE(s, HEX("ffffffff"));
+          }),
+          "huffman EOS");
+    CHECK(THROWS([] {
+            std::string s;
+            HUFFMAN_DECODE(s, HEX("f1e3c2e5f23a6ba0ab90f4ffff"));
+          }),
+          "huffman padding longer than 7 bits");
+
+    {
+      Table t(100);
+      CHECK(t.at(0) == nullptr && t.at(1)->first == ":authority" &&
+                t.at(61)->first == "www-authenticate" && t.at(62) == nullptr,
+            "hpack static table");
+      t.insert("a", "b");
+      t.insert("c", "d");
+      t.insert("e", "f");
+      CHECK(t.count() == 2 && t.size() == 68 && t.at(62)->first == "e" && t.at(63)->first == "c",
+            "hpack dynamic table eviction");
+      bool full = 0;
+      CHECK(t.find("c", "d", full) == 63 && full, "hpack find");
+      CHECK(t.find(":method", "PUT", full) == 2 && !full, "hpack find name");
+      t.insert(std::string(70, 'x'), "");
+      CHECK(t.count() == 0 && t.size() == 0, "hpack oversized entry empties the table");
+    }
+
+    // RFC 7541 C.3 without and C.4 with huffman, one decoder and encoder per connection
+    std::vector<Fields> const requests{
+        {{":method", "GET"},
+         {":scheme", "http"},
+         {":path", "/"},
+         {":authority", "www.example.com"}},
+        {{":method", "GET"},
+         {":scheme", "http"},
+         {":path", "/"},
+         {":authority", "www.example.com"},
+         {"cache-control", "no-cache"}},
+        {{":method", "GET"},
+         {":scheme", "https"},
+         {":path", "/index.html"},
+         {":authority", "www.example.com"},
+         {"custom-key", "custom-value"}}};
+    std::vector<std::string> const plain{
+        HEX("828684410f7777772e6578616d706c652e636f6d"), HEX("828684be58086e6f2d6361636865"),
+        HEX("828785bf400a637573746f6d2d6b65790c637573746f6d2d76616c7565")};
+    std::vector<std::string> const huffman{
+        HEX("828684418cf1e3c2e5f23a6ba0ab90f4ff"), HEX("828684be5886a8eb10649cbf"),
+        HEX("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf")};
+    for (auto const* blocks : {&plain, &huffman}) {
+      Decoder d;
+      for (size_t i = 0; i < blocks->size(); i++) {
+        Fields out;
+        d.decode((*blocks)[i], out);
+        CHECK(out == requests[i], "hpack decode C." + std::to_string(blocks == &plain ? 3 : 4) +
+                                      "." + std::to_string(i + 1));
+      }
+      Fields out;
+      d.decode(HEX("bebfc0"), out);
+      CHECK(out.size() == 3 && out[0].first == "custom-key" && out[1].first == "cache-control" &&
+                out[2].first == ":authority",
+            "hpack dynamic table order");
+      d.decode(HEX("20"), out);
+      CHECK(THROWS([&] { d.decode(HEX("be"), out); }), "hpack table size update evicts");
+    }
+    {
+      Encoder e;
+      for (size_t i = 0; i < requests.size(); i++) {
+        std::string out;
+        e.encode(requests[i], out);
+        CHECK(out == huffman[i], "hpack encode C.4." + std::to_string(i + 1));
+      }
+      std::string out;
+      e.limit(0);
+      e.encode("x-a", "b", out);
+      e.encode("x-a", "b", out);
+      CHECK(out.substr(0, 3) == HEX("200003") && out.find(HEX("20"), 1) == std::string::npos,
+            "hpack encoder table size update once");
+      out.clear();
+      Encoder sensitive;
+      sensitive.encode("authorization", "secret", out);
+      CHECK(out.substr(0, 2) == HEX("1f08"), "hpack never indexed");
+      Decoder d;
+      Fields f;
+      d.decode(out, f);
+      CHECK(f.size() == 1 && f[0].second == "secret", "hpack never indexed decode");
+      CHECK(THROWS([&] { d.decode(HEX("be"), f); }), "hpack never indexed not stored");
+    }
+    {
+      Decoder d;
+      Fields f;
+      d.decode(HEX("3fe11f"), f);
+      CHECK(f.empty(), "hpack table size update to the limit");
+      CHECK(THROWS([&] { d.decode(HEX("3fe21f"), f); }), "hpack table size above limit");
+      CHECK(THROWS([&] { d.decode(HEX("8220"), f); }), "hpack table size after a field");
+      CHECK(THROWS([&] { d.decode(HEX("80"), f); }), "hpack index 0");
+      CHECK(THROWS([&] { d.decode(HEX("c0"), f); }), "hpack index past the table");
+      CHECK(THROWS([&] { d.decode(HEX("410f7777"), f); }), "hpack truncated string");
+      CHECK(THROWS([&] { d.decode(plain[0], f, 100); }), "hpack header list limit");
+    }
+  }
+
+  void h2() {
+    using namespace mkn::ram::http::h2;
+    auto const frame = [](Type const& type, uint8_t const& flags, uint32_t const& id,
+                          std::string const& p = "") {
+      std::string f;
+      for (auto const& b : {uint32_t(p.size()) >> 16, uint32_t(p.size()) >> 8, uint32_t(p.size()),
+                            uint32_t(type), uint32_t(flags), id >> 24, id >> 16, id >> 8, id})
+        f.push_back(char(b));
+      return f + p;
+    };
+    auto const goAway = [&](uint32_t const& last, Error const& e) {
+      return frame(Type::GoAway, 0, 0,
+                   HEX("00000000").replace(3, 1, 1, char(last)) +
+                       HEX("00000000").replace(3, 1, 1, char(e)));
+    };
+    std::string const get(HEX("828684410f7777772e6578616d706c652e636f6d"));  // RFC 7541 C.3.1
+    std::string const ok(HEX("88"));                                          // :status 200
+    std::vector<std::pair<std::string, std::string>> seen;
+    auto const hello = [&seen](Connection& c, Stream& s) {
+      seen.emplace_back(std::string(s.header(":authority")), s.body);
+      c.submit(s.id, {{":status", "200"}}, "hello");
+    };
+    // a server past the preface and SETTINGS exchange, with our settings then output cleared
+    auto const server = [&](std::string const& settings = "") {
+      auto c = std::make_unique<Connection>(Connection::Role::Server, hello);
+      std::string in(PREFACE);
+      in += frame(Type::Settings, 0, 0, settings);
+      c->receive(in.data(), in.size());
+      c->output().clear();
+      return c;
+    };
+    auto const feed = [](Connection& c, std::string const& in) {
+      c.receive(in.data(), in.size());
+      auto const out = c.output();
+      c.output().clear();
+      return out;
+    };
+
+    {
+      Connection c(Connection::Role::Server, hello);
+      CHECK(c.output() == HEX("000018040000000000"
+                              "000300000080000400100000000500004000000600010000"
+                              "000004080000000000000f0001"),
+            "h2 server settings and connection window");
+      std::string in(PREFACE);
+      in += frame(Type::Settings, 0, 0, HEX("000500004e20"));
+      c.output().clear();
+      CHECK(feed(c, in) == frame(Type::Settings, Flags::ACK, 0), "h2 settings ack");
+      CHECK(c.remote().maxFrameSize == 20000, "h2 settings applied");
+      Connection client(Connection::Role::Client, nullptr);
+      CHECK(client.output().substr(0, PREFACE.size() + 15) ==
+                std::string(PREFACE) + HEX("00001e040000000000000200000000"),
+            "h2 client preface and settings");
+    }
+    for (auto const& t : std::vector<std::tuple<std::string, std::string, Error>>{
+             {"settings first", frame(Type::Ping, 0, 0, HEX("0000000000000000")), Error::Protocol},
+             {"settings length", frame(Type::Settings, 0, 0, HEX("0000000000")), Error::FrameSize},
+             {"settings on a stream", frame(Type::Settings, 0, 1), Error::Protocol},
+             {"settings push", frame(Type::Settings, 0, 0, HEX("000200000002")), Error::Protocol},
+             {"settings window", frame(Type::Settings, 0, 0, HEX("000480000000")),
+              Error::FlowControl},
+             {"settings frame size", frame(Type::Settings, 0, 0, HEX("000500003fff")),
+              Error::Protocol}}) {
+      Connection c(Connection::Role::Server, hello);
+      c.output().clear();
+      std::string const in(std::string(PREFACE) + std::get<1>(t));
+      CHECK(!c.receive(in.data(), in.size()) && c.output() == goAway(0, std::get<2>(t)),
+            "h2 " + std::get<0>(t));
+    }
+    {
+      auto c = server();
+      CHECK(feed(*c, frame(Type::Settings, Flags::ACK, 0, "x")) == goAway(0, Error::FrameSize),
+            "h2 settings ack with payload");
+      c = server();
+      CHECK(feed(*c, frame(Type::Ping, 0, 0, HEX("0102030405060708"))) ==
+                frame(Type::Ping, Flags::ACK, 0, HEX("0102030405060708")),
+            "h2 ping");
+    }
+
+    auto const response = frame(Type::Headers, Flags::END_HEADERS, 1, ok) +
+                          frame(Type::Data, Flags::END_STREAM, 1, "hello");
+    {
+      seen.clear();
+      auto c = server();
+      CHECK(feed(*c, frame(Type::Headers, Flags::END_HEADERS | Flags::END_STREAM, 1, get)) ==
+                response,
+            "h2 request");
+      CHECK(seen.size() == 1 && seen[0].first == "www.example.com" && !c->streams(),
+            "h2 request handled");
+      c = server();
+      auto in = frame(Type::Headers, Flags::END_HEADERS, 1, get) +
+                frame(Type::Data, 0, 1, "ab") + frame(Type::Data, Flags::END_STREAM, 1, "c");
+      CHECK(feed(*c, in) == response && seen.back().second == "abc", "h2 request body");
+    }
+    {
+      seen.clear();
+      auto c = server();
+      auto const in = frame(Type::Headers, Flags::END_STREAM, 1, get.substr(0, 5)) +
+                      frame(Type::Continuation, 0, 1, get.substr(5, 5)) +
+                      frame(Type::Continuation, Flags::END_HEADERS, 1, get.substr(10));
+      CHECK(feed(*c, in) == response && seen.size() == 1, "h2 continuation");
+      c = server();
+      CHECK(feed(*c, frame(Type::Headers, Flags::END_STREAM, 1, get.substr(0, 5)) +
+                         frame(Type::Ping, 0, 0, HEX("0000000000000000"))) ==
+                goAway(0, Error::Protocol),
+            "h2 frame inside a header block");
+      c = server();
+      CHECK(feed(*c, frame(Type::Continuation, Flags::END_HEADERS, 1, get)) ==
+                goAway(0, Error::Protocol),
+            "h2 continuation without headers");
+      c = server();
+      CHECK(feed(*c, frame(Type::Headers, Flags::END_STREAM | Flags::END_HEADERS, 1, HEX("80"))) ==
+                goAway(0, Error::Compression),
+            "h2 bad header block");
+    }
+    {
+      auto c = server(HEX("000400000003"));  // INITIAL_WINDOW_SIZE 3
+      CHECK(feed(*c, frame(Type::Headers, Flags::END_HEADERS | Flags::END_STREAM, 1, get)) ==
+                frame(Type::Headers, Flags::END_HEADERS, 1, ok) + frame(Type::Data, 0, 1, "hel"),
+            "h2 stream window");
+      CHECK(feed(*c, frame(Type::WindowUpdate, 0, 1, HEX("00000002"))) ==
+                    frame(Type::Data, Flags::END_STREAM, 1, "lo") &&
+                !c->streams(),
+            "h2 stream window update");
+
+      std::string const big(70000, 'x');
+      auto const large = [&big](Connection& c, Stream& s) {
+        c.submit(s.id, {{":status", "200"}}, big);
+      };
+      Connection conn(Connection::Role::Server, large);
+      std::string in(PREFACE);
+      in += frame(Type::Settings, 0, 0, HEX("000400100000"));
+      in += frame(Type::Headers, Flags::END_HEADERS | Flags::END_STREAM, 1, get);
+      conn.output().clear();
+      auto const out = feed(conn, in);
+      auto const head = frame(Type::Settings, Flags::ACK, 0) +
+                        frame(Type::Headers, Flags::END_HEADERS, 1, ok);
+      size_t data = 0, frames = 0;
+      for (size_t p = head.size(); p + 9 <= out.size(); frames++) {
+        size_t const len = uint8_t(out[p + 1]) << 8 | uint8_t(out[p + 2]);
+        CHECK(out[p + 3] == char(Type::Data) && out[p + 4] == 0, "h2 connection window frames");
+        data += len;
+        p += 9 + len;
+      }
+      CHECK(out.substr(0, head.size()) == head && data == 65535 && frames == 4,
+            "h2 connection window");
+      CHECK(feed(conn, frame(Type::WindowUpdate, 0, 0, HEX("00001171"))) ==
+                frame(Type::Data, Flags::END_STREAM, 1, big.substr(65535)),
+            "h2 connection window update");
+
+      c = server();
+      CHECK(feed(*c, frame(Type::WindowUpdate, 0, 0, HEX("7fffffff"))) ==
+                goAway(0, Error::FlowControl),
+            "h2 connection window overflow");
+      c = server();
+      feed(*c, frame(Type::Headers, Flags::END_HEADERS, 1, get));
+      CHECK(feed(*c, frame(Type::WindowUpdate, 0, 1, HEX("00000000"))) ==
+                frame(Type::RstStream, 0, 1, HEX("00000001")),
+            "h2 zero window update");
+    }
+    {
+      auto c = server();
+      CHECK(feed(*c, frame(Type::Headers, Flags::END_HEADERS, 1, get)).empty() && c->streams() == 1,
+            "h2 stream open");
+      CHECK(feed(*c, frame(Type::RstStream, 0, 1, HEX("00000008"))).empty() && !c->streams(),
+            "h2 rst_stream");
+      CHECK(feed(*c, frame(Type::Data, Flags::END_STREAM, 1, "x")) ==
+                frame(Type::RstStream, 0, 1, HEX("00000005")),
+            "h2 data after rst_stream");
+      CHECK(feed(*c, frame(Type::RstStream, 0, 5, HEX("00000008"))) == goAway(1, Error::Protocol),
+            "h2 rst_stream on an idle stream");
+      c = server();
+      feed(*c, frame(Type::Headers, Flags::END_HEADERS, 1, get));
+      CHECK(feed(*c, frame(Type::RstStream, 0, 1, HEX("000008"))) == goAway(1, Error::FrameSize),
+            "h2 rst_stream length");
+    }
+    {
+      std::map<uint32_t, std::pair<std::string, size_t>> got;
+      std::string const body(3 << 20, 'y');
+      Connection client(Connection::Role::Client, [&got](Connection&, Stream& s) {
+        got[s.id] = {std::string(s.header(":status")), s.body.size()};
+      });
+      Connection srv(Connection::Role::Server, [&body](Connection& c, Stream& s) {
+        c.submit(s.id, {{":status", "200"}}, body);
+      });
+      mkn::ram::http::hpack::Fields const fields{
+          {":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "x"}};
+      for (size_t i = 0; i < 3; i++) client.request(fields, "");
+      for (size_t i = 0; i < 1000 && (!client.output().empty() || !srv.output().empty()); i++) {
+        std::string a, b;
+        a.swap(client.output());
+        srv.receive(a.data(), a.size());
+        b.swap(srv.output());
+        client.receive(b.data(), b.size());
+      }
+      CHECK(got.size() == 3 && got[1] == std::make_pair(std::string("200"), body.size()) &&
+                got[3] == got[1] && got[5] == got[1],
+            "h2 client and server over flow control");
+    }
+  }
+
+  void compress() {
+    using namespace mkn::ram::http;
+    auto const zstd = Encoder::AVAILABLE(Encoding::Zstd);
+    auto const best = zstd ? Encoding::Zstd : Encoding::Gzip;
+    for (auto const& t : std::vector<std::pair<std::string, Encoding>>{
+             {"", Encoding::Identity},
+             {"br", Encoding::Identity},
+             {"gzip", Encoding::Gzip},
+             {"x-gzip", Encoding::Gzip},
+             {" GZIP ; q=1", Encoding::Gzip},
+             {"deflate, gzip", Encoding::Gzip},
+             {"gzip;q=0.5, deflate;q=0.8", Encoding::Deflate},
+             {"gzip;q=0", Encoding::Identity},
+             {"*", best},
+             {"*;q=0", Encoding::Identity},
+             {"*;q=0.3, gzip;q=0", zstd ? Encoding::Zstd : Encoding::Deflate},
+             {"identity;q=0, gzip", Encoding::Gzip},
+             {"identity;q=0", Encoding::Identity},
+             {"gzip;q=0.5, identity", Encoding::Identity},
+             {"gzip, identity;q=0.5", Encoding::Gzip},
+         }) {
+      if (!Encoder::AVAILABLE(Encoding::Gzip) && t.second != Encoding::Identity) continue;
+      CHECK(Compressor::NEGOTIATE(t.first) == t.second, "negotiate '" + t.first + "'");
+    }
+
+    std::string body;
+    for (size_t i = 0; i < 200; i++) body += "line " + std::to_string(i) + " of some text\n";
+    auto const text = [&body](std::string const& type = "text/plain") {
+      _1_1Response r(body);
+      r.header("Content-Type", type);
+      return r;
+    };
+    Compressor const c(6, 64);
+    {
+      auto r = text();
+      CHECK(!c.apply(Encoding::Identity, r) && r.body() == body, "compress identity as is");
+      CHECK(r.headers().get(HeaderID::Vary) == "Accept-Encoding" ||
+                !Encoder::AVAILABLE(Encoding::Gzip),
+            "compress identity varies");
+    }
+    {
+      auto r = text("image/png"), small = text();
+      small.body("tiny");
+      CHECK(!c.apply(Encoding::Gzip, r) && !r.header(HeaderID::Vary), "compress binary");
+      CHECK(!c.apply(Encoding::Gzip, small) && !small.header(HeaderID::Vary), "compress small");
+      auto keep = text();
+      keep.header("Cache-Control", "public, No-Transform");
+      CHECK(!c.apply(Encoding::Gzip, keep) && keep.body() == body &&
+                !keep.header(HeaderID::Vary) && !keep.header(HeaderID::ContentEncoding),
+            "compress no-transform");
+    }
+#ifdef _MKN_RAM_INCLUDE_ZLIB_
+    auto const inflated = [](std::string const& in, int const& bits) {
+      z_stream zs{};
+      inflateInit2(&zs, bits);
+      std::string out(1 << 16, '\0');
+      zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+      zs.avail_in = uInt(in.size());
+      zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+      zs.avail_out = uInt(out.size());
+      auto const rc = inflate(&zs, Z_FINISH);
+      out.resize(rc == Z_STREAM_END ? zs.total_out : 0);
+      inflateEnd(&zs);
+      return out;
+    };
+    for (auto const& e :
+         {std::make_pair(Encoding::Gzip, 31), std::make_pair(Encoding::Deflate, 15)}) {
+      auto r = text();
+      r.header("Vary", "Origin");
+      r.header("Content-Length", std::to_string(body.size()));
+      CHECK(c.apply(e.first, r), "compress applied");
+      CHECK(r.body().size() < body.size() && inflated(r.body(), e.second) == body,
+            "compress round trip " + std::string(Encoder::NAME(e.first)));
+      CHECK(r.headers().get(HeaderID::ContentEncoding) == Encoder::NAME(e.first) &&
+                r.headers().get(HeaderID::ContentLength) == std::to_string(r.body().size()) &&
+                r.headers().get(HeaderID::Vary) == "Origin, Accept-Encoding",
+            "compress headers");
+      CHECK(!c.apply(e.first, r), "compress once");
+    }
+    {
+      auto r = text();
+      r.header("Vary", "accept-encoding");
+      _1_1GetRequest req("localhost", "/");
+      req.header("Accept-Encoding", "identity;q=0, gzip");
+      CHECK(c.apply(req, r) && r.headers().get(HeaderID::Vary) == "accept-encoding",
+            "compress negotiated, vary kept");
+      CHECK(inflated(r.body(), 31) == body, "compress negotiated round trip");
+    }
+    {
+      Encoder enc(Encoding::Gzip);
+      std::string out;
+      for (size_t i = 0; i < body.size(); i += 1000)
+        enc.update(std::string_view(body).substr(i, 1000), out, true);
+      enc.finish(out);
+      CHECK(inflated(out, 31) == body, "compress streamed round trip");
+    }
+#endif  //_MKN_RAM_INCLUDE_ZLIB_
+#ifdef _MKN_RAM_INCLUDE_ZSTD_
+    {
+      auto const unzstd = [](std::string const& in) {
+        std::string out(1 << 16, '\0');
+        ZSTD_DCtx* const dc = ZSTD_createDCtx();
+        ZSTD_inBuffer ib{in.data(), in.size(), 0};
+        ZSTD_outBuffer ob{&out[0], out.size(), 0};
+        size_t rc = 1;
+        while (rc && ib.pos < ib.size && !ZSTD_isError(rc))
+          rc = ZSTD_decompressStream(dc, &ob, &ib);
+        ZSTD_freeDCtx(dc);
+        out.resize(rc == 0 ? ob.pos : 0);
+        return out;
+      };
+      auto r = text();
+      CHECK(c.apply(Encoding::Zstd, r) && r.body().size() < body.size() && unzstd(r.body()) == body,
+            "compress round trip zstd");
+      Encoder enc(Encoding::Zstd);
+      std::string out;
+      for (size_t i = 0; i < body.size(); i += 1000)
+        enc.update(std::string_view(body).substr(i, 1000), out, true);
+      enc.finish(out);
+      CHECK(unzstd(out) == body, "compress streamed round trip zstd");
+    }
+#endif  //_MKN_RAM_INCLUDE_ZSTD_
+  }
+
+  void cache() {
+    using namespace mkn::ram::http;
+    std::atomic<size_t> calls(0);
+    // n concurrent gets of one key while the response function takes 200ms, bodies returned
+    auto const concurrently = [&](Cache& cache, A1_1Request const& req, size_t const n,
+                                  std::function<void(_1_1Response&, size_t)> const& make) {
+      std::vector<std::string> bodies(n);
+      std::vector<std::thread> ts;
+      calls = 0;
+      for (size_t i = 0; i < n; i++)
+        ts.emplace_back([&, i]() {
+          bodies[i] = cache
+                          .get(req,
+                               [&](A1_1Request const&) {
+                                 auto const c = calls++;
+                                 mkn::kul::this_thread::sleep(200);
+                                 _1_1Response r("call " + std::to_string(c));
+                                 make(r, c);
+                                 return r;
+                               })
+                          .body();
+        });
+      for (auto& t : ts) t.join();
+      return std::set<std::string>(bodies.begin(), bodies.end());
+    };
+    auto const fresh = [](_1_1Response& r, size_t) { r.header("Cache-Control", "max-age=60"); };
+
+    {
+      Cache cache;
+      _1_1GetRequest req("localhost", "/shared");
+      auto const bodies = concurrently(cache, req, 4, fresh);
+      CHECK(calls == 1 && bodies.size() == 1, "cache coalesces concurrent misses");
+      concurrently(cache, req, 2, fresh);
+      CHECK(calls == 0, "cache hit");
+    }
+    {
+      Cache cache;
+      _1_1GetRequest req("localhost", "/nostore");
+      auto const bodies = concurrently(cache, req, 4, [](_1_1Response& r, size_t) {
+        r.header("Cache-Control", "no-store");
+      });
+      CHECK(calls == 4 && bodies.size() == 4, "cache no-store not shared with waiters");
+      concurrently(cache, req, 1, fresh);
+      CHECK(calls == 1, "cache no-store not stored");
+    }
+    {
+      Cache cache;
+      _1_1GetRequest req("localhost", "/setcookie");
+      auto const bodies = concurrently(cache, req, 4, [](_1_1Response& r, size_t c) {
+        r.header("Cache-Control", "max-age=60");
+        r.cookie("session", mkn::ram::http::Cookie(std::to_string(c)));
+      });
+      CHECK(calls == 4 && bodies.size() == 4, "cache Set-Cookie not shared with waiters");
+      concurrently(cache, req, 4, [](_1_1Response& r, size_t c) {
+        r.header("Cache-Control", "public, max-age=60");
+        r.header("Set-Cookie", "session=" + std::to_string(c));
+      });
+      CHECK(calls == 4, "cache Set-Cookie header not shared with waiters");
+    }
+    {
+      Cache cache;
+      _1_1GetRequest auth("localhost", "/private"), cookie("localhost", "/private");
+      auth.header("Authorization", "Bearer x");
+      cookie.cookie("session", "x");
+      for (auto const* req : {&auth, &cookie}) {
+        concurrently(cache, *req, 3, fresh);
+        CHECK(calls == 3, "cache bypassed for credentials");
+        concurrently(cache, *req, 1, fresh);
+        CHECK(calls == 1, "cache credentials not stored");
+      }
+      _1_1GetRequest anon("localhost", "/private");
+      concurrently(cache, anon, 1, fresh);
+      CHECK(calls == 1, "cache credentialed response not served anonymously");
+    }
+  }
+
+  void date() {
+    using mkn::ram::http::Date;
+    auto const format = [](std::time_t const& t) {
+      std::string s(Date::SIZE, ' ');
+      Date::FORMAT(t, &s[0]);
+      return s;
+    };
+    CHECK(format(784111777) == "Sun, 06 Nov 1994 08:49:37 GMT", "date rfc example");
+    CHECK(format(0) == "Thu, 01 Jan 1970 00:00:00 GMT", "date epoch");
+    CHECK(format(951782400) == "Tue, 29 Feb 2000 00:00:00 GMT", "date leap day");
+    CHECK(format(2000000000) == "Wed, 18 May 2033 03:33:20 GMT", "date 2033");
+    CHECK(format(1735689599) == "Tue, 31 Dec 2024 23:59:59 GMT", "date year end");
+
+    auto const a = Date::NOW(), b = Date::NOW();
+    CHECK(a.data() == b.data() && a.size() == Date::SIZE, "date cached per thread");
+    auto const now = std::time(0);
+    CHECK(a == format(now) || a == format(now - 1), "date now " + std::string(a));
+    std::string const before(a);
+    mkn::kul::this_thread::sleep(1100);
+    CHECK(std::string(Date::NOW()) != before, "date refreshed each second");
+    char const* other = nullptr;
+    std::thread([&]() { other = Date::NOW().data(); }).join();
+    CHECK(other && other != a.data(), "date per thread");
+
+    // the cached block and the per line fallback must write what explicit headers would
+    using mkn::ram::http::_1_1Response;
+    for (size_t tries = 0;; tries++) {
+      auto const date = std::string(Date::NOW());
+      _1_1Response block, lines, custom, explicitBlock, explicitLines;
+      block.withBody("hi").withDefaultHeaders();
+      explicitBlock.withBody("hi");
+      explicitBlock.header("Date", date);
+      explicitBlock.header("Connection", "close");
+      explicitBlock.header("Content-Type", "text/html");
+      explicitBlock.header("Content-Length", "2");
+      lines.withBody("hello").withDefaultHeaders();
+      lines.header("Content-Type", "application/json");
+      explicitLines.withBody("hello");
+      explicitLines.header("Content-Type", "application/json");
+      explicitLines.header("Date", date);
+      explicitLines.header("Connection", "close");
+      explicitLines.header("Content-Length", "5");
+      custom.withBody("x").withDefaultHeaders();
+      custom.header("Content-Length", "1");
+      custom.header("Connection", "keep-alive");
+      auto const s = custom.toString(), b = block.toString(), l = lines.toString();
+      if (date != Date::NOW() && tries < 3) continue;  // a second passed
+      CHECK(b == explicitBlock.toString(), "default header block");
+      CHECK(l == explicitLines.toString(), "default header lines");
+      CHECK(s.find("Connection: close") == std::string::npos &&
+                s.find("Content-Length: 1") != std::string::npos &&
+                s.find("Content-Length", s.find("Content-Length") + 1) == std::string::npos,
+            "default headers not repeated");
+      break;
+    }
+  }
+
+  void headers() {
+    using mkn::ram::http::HeaderID;
+    using mkn::ram::http::HeaderIDs;
+    CHECK(HeaderIDs::ID("content-TYPE") == HeaderID::ContentType, "header id");
+    CHECK(HeaderIDs::ID("X-Custom") == HeaderID::Other, "header id other");
+    CHECK(HeaderIDs::ID("") == HeaderID::Other && HeaderIDs::ID("1x") == HeaderID::Other,
+          "header id invalid");
+    for (size_t i = 1; i < size_t(HeaderID::MAX); i++)
+      CHECK(HeaderIDs::ID(HeaderIDs::NAME(HeaderID(i))) == HeaderID(i),
+            "header id " + std::string(HeaderIDs::NAME(HeaderID(i))));
+
+    mkn::ram::http::Headers hs{{"Content-Type", "text/html"}, {"X-Custom", "a"}};
+    CHECK(hs.size() == 2 && hs.begin().id() == HeaderID::ContentType, "headers interned");
+    CHECK(hs.get("content-type") == "text/html" && hs.get(HeaderID::ContentType) == "text/html",
+          "headers case insensitive");
+    CHECK(hs.get("x-custom") == "a" && hs.has("X-CUSTOM") && !hs.has("x-other"),
+          "headers custom lookup");
+    hs.set("CONTENT-TYPE", "json");  // shorter, written in place
+    hs.set("x-custom", "a longer value than before");
+    CHECK(hs.size() == 2 && hs.get("Content-Type") == "json" &&
+              hs.get("X-Custom") == "a longer value than before",
+          "headers overwrite");
+    auto const first = *hs.begin();
+    CHECK(first.first == "Content-Type" && first.second == "json", "headers order");
+    CHECK(!hs.insert("x-custom", "b") && hs.get("X-Custom") != "b", "headers insert keeps");
+    hs.append("Set-Cookie", "a=1");
+    hs.append("Set-Cookie", "b=2");
+    size_t cookies = 0;
+    for (auto const& p : hs) cookies += p.first == "Set-Cookie";
+    CHECK(cookies == 2 && hs.size() == 4, "headers append");
+    CHECK(hs.erase("set-cookie") && hs.size() == 3 && hs.erase(HeaderID::SetCookie) &&
+              !hs.erase(HeaderID::SetCookie),
+          "headers erase");
+
+    // values and names may view the arena itself, growing it must not free them first
+    mkn::ram::http::Headers self;
+    self.set("X-A", std::string(_MKN_RAM_HTTP_HEADERS_ARENA_ - 8, 'a'));
+    for (size_t i = 0; i < 4; i++) self.set("X-B" + std::to_string(i), self.get("X-A"));
+    self.set("X-A", self.get("X-B3").substr(1));
+    self.set("X-C", self.get("X-A"));
+    self.append(self.get("X-B0").substr(0, 4), self.get("x-b1"));
+    std::string const a(_MKN_RAM_HTTP_HEADERS_ARENA_ - 8, 'a');
+    CHECK(self.get("X-B3") == a && self.get("X-A") == a.substr(1) && self.get("X-C") == a.substr(1),
+          "headers self aliasing");
+    CHECK(self.get("aaaa") == a, "headers self aliasing name");
+
+    mkn::ram::http::Headers churn;
+    churn.set("X-Keep", "k");
+    for (size_t i = 0; i < 1000; i++) {
+      churn.set("X-Grow", std::string(i % 64 + 1, char('a' + i % 26)));
+      churn.append("X-Gone" + std::to_string(i), "v");
+      churn.erase("x-gone" + std::to_string(i));
+    }
+    CHECK(churn.size() == 2 && churn.get("X-Keep") == "k" &&
+              churn.get("x-grow") == std::string(999 % 64 + 1, char('a' + 999 % 26)),
+          "headers compacted values");
+    CHECK(churn.bytes() <= 2 * (1 + 6 + 6 + 64), "headers arena compacted");
+    CHECK(THROWS_STD([&]() { churn.set(std::string(1 << 16, 'x'), "v"); }) &&
+              churn.size() == 2,
+          "headers name too long");
+    churn.set(std::string((1 << 16) - 1, 'x'), "v");
+    CHECK(churn.size() == 3 && churn.get(std::string((1 << 16) - 1, 'x')) == "v",
+          "headers longest name");
+
+    mkn::ram::http::Headers copy(self), moved(std::move(copy));
+    CHECK(moved.size() == self.size() && moved.get("x-c") == self.get("x-c"), "headers copy");
+
+    mkn::ram::http::Headers map;
+    map["X-Map"] = "1";
+    map["X-Map"] = std::string("2");
+    CHECK(map.insert(std::make_pair(std::string("Host"), std::string("h"))) &&
+              map.emplace("Accept", "*/*") && !map.emplace("accept", "x"),
+          "headers map insert");
+    std::string const v = map["x-map"];
+    CHECK(v == "2" && map.count("HOST") == 1 && map.at("accept") == "*/*", "headers map get");
+    CHECK(map.find("host")->second == "h" && map.find("nope") == map.end(), "headers map find");
+    CHECK(THROWS_STD([&]() { map.at("nope"); }), "headers map at");
+  }
+
+  void query() {
+    using mkn::ram::http::Query;
+    namespace detail = mkn::ram::http::detail;
+    CHECK(Query::DECODE("%zz") == "%zz" && Query::DECODE("a%") == "a%" &&
+              Query::DECODE("%4") == "%4" && Query::DECODE("%4g") == "%4g",
+          "query malformed escapes kept");
+    CHECK(Query::DECODE("%%41") == "%A" && Query::DECODE("%4%41") == "%4A",
+          "query escape after a malformed one");
+    CHECK(Query::DECODE("a+b") == "a b" && Query::DECODE("%2B") == "+" &&
+              Query::DECODE("a+%2b+b") == "a + b" && Query::DECODE("++") == "  ",
+          "query plus");
+    CHECK(Query::DECODE("%C3%A9%20") == "\xC3\xA9 ", "query escapes");
+    for (size_t o = 0; o + 3 <= 20; o++) {  // across and either side of each 8 byte word
+      std::string raw(20, 'x'), plain(18, 'x');
+      raw.replace(o, 3, "%41");
+      plain[o] = 'A';
+      CHECK(Query::DECODE(raw) == plain, "query escape at " + std::to_string(o));
+      raw.replace(o, 3, "xx+");
+      CHECK(Query::DECODE(raw) == std::string(o + 2, 'x') + " " + std::string(17 - o, 'x'),
+            "query plus at " + std::to_string(o));
+      raw.replace(o, 3, "x%4");
+      CHECK(Query::DECODE(raw) == raw, "query malformed at " + std::to_string(o));
+    }
+
+    Query const q("?a=1&&b=&=v&c&a=2");
+    std::vector<std::pair<std::string_view, std::string_view>> const all(q.begin(), q.end());
+    CHECK(all.size() == 5 && all[0].first == "a" && all[1].first == "b" && all[1].second.empty() &&
+              all[2].first.empty() && all[2].second == "v" && all[3].first == "c" &&
+              all[3].second.empty() && all[4].second == "2",
+          "query pairs");
+    CHECK(q["a"] == "1", "query repeated key first");
+    CHECK(q.has("b") && q["b"].empty() && q.has("c") && q.get("c", "x").empty(),
+          "query empty values");
+    CHECK(q.has("") && q[""] == "v", "query empty key");
+    CHECK(!q.has("d") && q.get("d", "x") == "x", "query absent");
+    CHECK(Query().empty() && Query("?").empty() && Query("&&").empty() && !q.empty(),
+          "query empty");
+
+    CHECK(detail::QUERY_EQUAL("a%20b", "a b") && detail::QUERY_EQUAL("a+b", "a b") &&
+              detail::QUERY_EQUAL("a%2Bb", "a+b") && detail::QUERY_EQUAL("%41", "A"),
+          "query equal encoded");
+    CHECK(!detail::QUERY_EQUAL("a+b", "a+b") && !detail::QUERY_EQUAL("%41", "%41"),
+          "query equal decodes raw only");
+    CHECK(detail::QUERY_EQUAL("%zz", "%zz") && detail::QUERY_EQUAL("%4", "%4") &&
+              detail::QUERY_EQUAL("a%", "a%"),
+          "query equal malformed");
+    CHECK(!detail::QUERY_EQUAL("ab", "a") && !detail::QUERY_EQUAL("a", "ab") &&
+              !detail::QUERY_EQUAL("%4", "%41") && detail::QUERY_EQUAL("", ""),
+          "query equal lengths");
+    CHECK(Query("na%6De=x&first+name=J%C3%A9+D")["name"] == "x" &&
+              Query("first+name=J%C3%A9+D").get("first name") == "J\xC3\xA9 D",
+          "query encoded keys");
+  }
+
+  void cookies() {
+    using namespace mkn::ram::http;
+    class Parser : public Server {
+     public:
+      Parser() : Server(0) {}
+      std::shared_ptr<A1_1Request> parse(std::string const& cookies) {
+        std::string path;
+        return handleRequest(1, "GET / HTTP/1.1\r\nHost: x\r\n" + cookies + "\r\n", path);
+      }
+    } parser;
+
+    auto req = parser.parse("Cookie: a=\"x=y\"; b=2; a=3\r\n");
+    CHECK(req && req->hasCookies(), "cookies received");
+    CHECK(req->cookie("a") == "\"x=y\"" && req->cookie("b") == "2", "cookie quoted value");
+    CHECK(req->cookie("c").empty(), "cookie absent");
+    auto const& all = req->cookies();
+    CHECK(all.size() == 2 && all.at("a") == "\"x=y\"" && all.at("b") == "2",
+          "cookies first of repeated names");
+    CHECK(req->cookie("a") == "\"x=y\"" && req->cookie("b") == "2", "cookie after copying");
+    auto const copy = *std::dynamic_pointer_cast<_1_1GetRequest>(req);
+    req.reset();
+    CHECK(copy.cookie("a") == "\"x=y\"", "cookie from a copied request");
+
+    req = parser.parse("Cookie: ;; a=1; ; =x; novalue; e=; \t b = 2 \t;\r\n");
+    CHECK(req->cookie("a") == "1" && req->cookie("e").empty() && req->cookie("novalue").empty() &&
+              req->cookie("").empty(),
+          "cookie empty pairs");
+    CHECK(req->cookie("b ") == " 2", "cookie pair trimmed only at its ends");
+    CHECK(req->cookies().size() == 2 && req->cookies().count("a") && !req->cookies().count("e"),
+          "cookies skip empty values");
+
+    req = parser.parse("Cookie: a=1\r\nCookie: b=2\r\n");
+    CHECK(req->cookie("a") == "1" && req->cookie("b") == "2", "cookie headers joined");
+
+    req = parser.parse("");
+    CHECK(!req->hasCookies() && req->cookies().empty() && req->cookie("a").empty(), "no cookies");
+
+    _1_1GetRequest get("localhost", "/");
+    get.cookie("k", "v");
+    CHECK(get.hasCookies() && get.cookie("k") == "v", "cookie set on a request");
+  }
+
+  void complete() {
+    auto const done = [](std::string const& s) {
+      return mkn::ram::http::A1_1Request::COMPLETE(s.c_str(), s.size());
+    };
+    CHECK(done("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nhi"), "complete crlf");
+    CHECK(done("HTTP/1.1 200 OK\nContent-Length: 2\n\nhi"), "complete lf");
+    CHECK(done("HTTP/1.1 200 OK\nServer: x\ncontent-length:0\n\n"), "complete lf empty");
+    CHECK(done("HTTP/1.1 200 OK\r\nServer: x\nContent-Length: 2\n\r\nhi"), "complete mixed");
+    CHECK(!done("HTTP/1.1 200 OK\nContent-Length: 3\n\nhi"), "complete short body");
+    CHECK(!done("HTTP/1.1 200 OK\nContent-Length: 2\n"), "complete no end of headers");
+    CHECK(!done("HTTP/1.1 200 OK\nServer: x\n\nhi"), "complete no length");
+
+    for (std::string const s : {"HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nhi",
+                                "HTTP/1.1 200 OK\nContent-Length: 2\n\nhi"}) {
+      mkn::ram::http::A1_1Request::Completion c;
+      size_t n = 1;
+      while (n < s.size() && !mkn::ram::http::A1_1Request::COMPLETE(s.c_str(), n, c)) n++;
+      CHECK(n == s.size() && c.sized && c.length == 2, "complete resumed byte by byte");
+    }
+  }
+
+#ifndef _WIN32
+  void timeouts() {
+    Silent full(1), quiet(0);
+    {
+      mkn::ram::tcp::Socket<char> sock;
+      sock.timeouts(200, 200);
+      bool ok = 1;
+      auto const took = TIMED([&]() { ok = sock.connect("127.0.0.1", full.port()); });
+      CHECK(!ok && took < 1000, "connect timeout " + std::to_string(took));
+    }
+    {
+      mkn::ram::tcp::Socket<char> sock;
+      sock.timeouts(0, 0, 200);
+      bool ok = 1;
+      auto const took = TIMED([&]() { ok = sock.connect("127.0.0.1", full.port()); });
+      CHECK(!ok && took < 1000, "total timeout while connecting " + std::to_string(took));
+    }
+    {
+      mkn::ram::tcp::Socket<char> sock;
+      sock.timeouts(200, 200);
+      CHECK(sock.connect("127.0.0.1", quiet.port()), "connect to backlog");
+      sock.write("GET / HTTP/1.1\r\n\r\n", 18);
+      char buf[16];
+      bool thrown = 0;
+      auto const took = TIMED([&]() { thrown = THROWS([&]() { sock.read(buf, sizeof(buf)); }); });
+      CHECK(thrown && took >= 150 && took < 1000, "read timeout " + std::to_string(took));
+    }
+    {
+      mkn::ram::tcp::Socket<char> sock;
+      sock.timeouts(0, 0, 300);
+      CHECK(sock.connect("127.0.0.1", quiet.port()), "connect to backlog");
+      char buf[16];
+      bool thrown = 0;
+      auto const took = TIMED([&]() { thrown = THROWS([&]() { sock.read(buf, sizeof(buf)); }); });
+      CHECK(thrown && took >= 250 && took < 1000, "total timeout " + std::to_string(took));
+    }
+    for (auto const port : {full.port(), quiet.port()}) {
+      bool thrown = 0;
+      auto took = TIMED([&]() {
+        thrown = THROWS([&]() {
+          mkn::ram::http::_1_1GetRequest("127.0.0.1", "", port).withTimeouts(0, 0, 300).send();
+        });
+      });
+      CHECK(thrown && took < 1000, "http total timeout " + std::to_string(took));
+#ifdef _MKN_RAM_INCLUDE_HTTPS_
+      took = TIMED([&]() {
+        thrown = THROWS([&]() {
+          mkn::ram::https::_1_1GetRequest("127.0.0.1", "", port).withTimeouts(0, 0, 300).send();
+        });
+      });
+      CHECK(thrown && took < 1000, "https total timeout " + std::to_string(took));
+#endif  //_MKN_RAM_INCLUDE_HTTPS_
+    }
+  }
+#endif  // _WIN32
+
+#ifndef _WIN32
+  void dns() {
+    std::atomic<size_t> lookups{0};
+    std::atomic<bool> fail{0};
+    mkn::ram::dns::Resolver r([&](std::string const&, mkn::ram::dns::Addresses& addrs) {
+      lookups++;
+      if (fail) return EAI_NONAME;
+      mkn::ram::dns::Address a;
+      memset(&a.addr, 0, sizeof(a.addr));
+      auto& in = reinterpret_cast<struct sockaddr_in&>(a.addr);
+      in.sin_family = AF_INET;
+      in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      a.len = sizeof(in);
+      addrs = {a};
+      return 0;
+    });
+    auto const port = [](mkn::ram::dns::Addresses const& addrs) {
+      return ntohs(reinterpret_cast<struct sockaddr_in const&>(addrs[0].addr).sin_port);
+    };
+    mkn::ram::dns::Addresses addrs;
+    r.ttl(2, 1, 0);
+    CHECK(r.get("a", 80, addrs) == 0 && addrs.size() == 1 && port(addrs) == 80, "dns lookup");
+    CHECK(r.get("a", 81, addrs) == 0 && port(addrs) == 81 && lookups == 1, "dns ttl");
+
+    fail = 1;
+    CHECK(r.get("b", 80, addrs) == EAI_NONAME && addrs.empty() && lookups == 2, "dns failure");
+    CHECK(r.get("b", 80, addrs) == EAI_NONAME && lookups == 2, "dns negative cache");
+
+    mkn::kul::this_thread::sleep(2100);
+    CHECK(r.get("a", 82, addrs) == 0 && addrs.size() == 1 && port(addrs) == 82 && lookups == 3,
+          "dns stale answer while failing");
+    fail = 0;
+    CHECK(r.get("b", 80, addrs) == 0 && addrs.size() == 1 && lookups == 4, "dns negative expiry");
+
+    r.ttl(2, 1, 2);
+    CHECK(!r.peek("c", 80, addrs), "dns peek miss");
+    UNTIL([&]() { return r.peek("c", 80, addrs); });
+    CHECK(lookups == 5 && port(addrs) == 80, "dns peek lookup");
+    r.prefetch("d");
+    UNTIL([&]() { return r.peek("d", 80, addrs); });
+    CHECK(lookups == 6, "dns prefetch");
+    CHECK(r.get("d", 80, addrs) == 0, "dns hit");  // within the refresh window
+    UNTIL([&]() { return lookups == 7; });
+    CHECK(lookups == 7, "dns background refresh");
+
+    std::atomic<int> done{-1};
+    r.async("e", 80, [&](int const& error, mkn::ram::dns::Addresses const& a) {
+      done = error || a.empty() ? 1 : 0;
+    });
+    UNTIL([&]() { return done >= 0; });
+    CHECK(done == 0, "dns async");
+
+    for (size_t i = 0; i < _MKN_RAM_DNS_MAX_ + 16; i++)
+      r.get("host" + std::to_string(i), 80, addrs);
+    CHECK(r.size() <= _MKN_RAM_DNS_MAX_, "dns eviction " + std::to_string(r.size()));
+
+    // an async callback clears the cache as the lookup lands, before blocked waiters wake
+    mkn::ram::dns::Addresses one;
+    CHECK(r.get("a", 80, one) == 0 && one.size() == 1, "dns lookup for the slow resolver");
+    mkn::ram::dns::Resolver slow([&](std::string const&, mkn::ram::dns::Addresses& a) {
+      mkn::kul::this_thread::sleep(50);
+      a = one;
+      return 0;
+    });
+    for (size_t round = 0; round < 4; round++) {
+      std::string const host("s" + std::to_string(round));
+      std::atomic<size_t> good{0};
+      std::vector<std::thread> ts;
+      for (size_t i = 0; i < 4; i++)
+        ts.emplace_back([&]() {
+          mkn::ram::dns::Addresses a;
+          if (slow.get(host, 80, a) == 0 && a.size() == 1) good++;
+        });
+      mkn::kul::this_thread::sleep(10);
+      slow.async(host, 80, [&](int const&, mkn::ram::dns::Addresses const&) { slow.clear(); });
+      for (auto& t : ts) t.join();
+      CHECK(good == ts.size(), "dns waiters pinned " + std::to_string(good));
+    }
+  }
+#endif  // _WIN32
+};
+
+}  // namespace ram
+}  // namespace mkn
+
+int main() {
+  try {
+    mkn::ram::Unit();
+  } catch (mkn::kul::Exception const& e) {
+    KERR << e.stack();
+    return 1;
+  } catch (std::exception const& e) {
+    KERR << e.what();
+    return 2;
+  } catch (...) {
+    KERR << "UNKNOWN EXCEPTION CAUGHT";
+    return 3;
+  }
+  return 0;
+}
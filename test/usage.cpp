@@ -28,10 +28,21 @@ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
+#include <csignal>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
 
 #include "mkn/kul/signal.hpp"
 #include "mkn/ram/http.hpp"
+#include "mkn/ram/http/access.hpp"
+#include "mkn/ram/http/admission.hpp"
+#include "mkn/ram/http/co.hpp"
+#include "mkn/ram/http/form.hpp"
+#include "mkn/ram/http/router.hpp"
+#include "mkn/ram/http/sse.hpp"
+#include "mkn/ram/http/ws.hpp"
 #include "mkn/ram/tcp.hpp"
 
 #ifdef _MKN_RAM_INCLUDE_HTTPS_
@@ -51,6 +62,18 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 namespace mkn {
 namespace ram {
 
+// a file in the temp directory, removed however the test using it ends
+struct TempFile {
+  std::string const path;
+  TempFile(std::string const& name)
+      : path((std::filesystem::temp_directory_path() / name).string()) {}
+  ~TempFile() { std::remove(path.c_str()); }
+  std::string read() const {
+    std::ifstream f(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+  }
+};
+
 class TestHTTPServer : public mkn::ram::http::Server {
  private:
   void operator()() { start(); }
@@ -64,6 +87,24 @@ class TestHTTPServer : public mkn::ram::http::Server {
   friend class mkn::kul::Thread;
 };
 
+// "/big" is far larger than the socket buffers, so most of it waits in the output queue
+class TestLargeHTTPServer : public mkn::ram::http::Server {
+ private:
+  void operator()() { start(); }
+
+ public:
+  std::string big;
+  mkn::ram::http::_1_1Response respond(mkn::ram::http::A1_1Request const& req) {
+    return mkn::ram::http::_1_1Response()
+        .withBody(req.path() == "/big" ? big : "small")
+        .withDefaultHeaders();
+  }
+  TestLargeHTTPServer() : mkn::ram::http::Server(_MKN_RAM_HTTP_TEST_PORT_), big(32 << 20, 0) {
+    for (size_t i = 0; i < big.size(); i++) big[i] = char('a' + i % 26);
+  }
+  friend class mkn::kul::Thread;
+};
+
 class TestMultiHTTPServer : public mkn::ram::http::MultiServer {
  private:
   void operator()() { start(); }
@@ -73,7 +114,31 @@ class TestMultiHTTPServer : public mkn::ram::http::MultiServer {
     mkn::ram::http::_1_1Response r;
     return r.withBody("MULTI HTTP PROVIDED BY KUL").withDefaultHeaders();
   }
-  TestMultiHTTPServer() : mkn::ram::http::MultiServer(_MKN_RAM_HTTP_TEST_PORT_, 3) {}
+  TestMultiHTTPServer(uint8_t const& acceptThreads = 3, uint8_t const& workerThreads = 1)
+      : mkn::ram::http::MultiServer(_MKN_RAM_HTTP_TEST_PORT_, acceptThreads, workerThreads) {}
+  friend class mkn::kul::Thread;
+};
+
+class TestRouterHTTPServer : public mkn::ram::http::Server {
+ private:
+  mkn::ram::http::Router router;
+  void operator()() { start(); }
+
+ public:
+  TestRouterHTTPServer() : mkn::ram::http::Server(_MKN_RAM_HTTP_TEST_PORT_) {
+    using namespace mkn::ram::http;
+    router.get("/users/:id", [](A1_1Request const& req, Params const& ps) {
+      auto const name = req.queryView().get("name", "anon");
+      return _1_1Response()
+          .withBody("USER " + std::string(ps["id"]) + " " + name)
+          .withDefaultHeaders();
+    });
+    router.get("/static/*file", [](A1_1Request const& req, Params const& ps) {
+      return _1_1Response().withBody("FILE " + std::string(ps["file"])).withDefaultHeaders();
+    });
+    withResponse(std::ref(router));
+    withStatic("GET", "/health", _1_1Response().withBody("OK").withDefaultHeaders());
+  }
   friend class mkn::kul::Thread;
 };
 
@@ -84,8 +149,11 @@ class TestHTTPSServer : public mkn::ram::https::Server {
 
  public:
   mkn::ram::http::_1_1Response respond(mkn::ram::http::A1_1Request const& req) {
+    if (req.path() == "/slow") mkn::kul::this_thread::sleep(1000);
     mkn::ram::http::_1_1Response r;
-    return r.withBody("HTTPS PROVIDED BY KUL: " + req.method()).withDefaultHeaders();
+    r.withBody("HTTPS PROVIDED BY KUL: " + req.method()).withDefaultHeaders();
+    r.header("X-Client-Port", std::to_string(req.port()));  // tells connections apart
+    return r;
   }
   TestHTTPSServer()
       : mkn::ram::https::Server(_MKN_RAM_HTTP_TEST_PORT_, mkn::kul::File("res/test/server.crt"),
@@ -99,6 +167,7 @@ class TestMultiHTTPSServer : public mkn::ram::https::MultiServer {
 
  public:
   mkn::ram::http::_1_1Response respond(mkn::ram::http::A1_1Request const& req) {
+    if (req.path() == "/slow") mkn::kul::this_thread::sleep(500);
     mkn::ram::http::_1_1Response r;
     return r.withBody("MULTI HTTPS PROVIDED BY KUL: " + req.method()).withDefaultHeaders();
   }
@@ -109,6 +178,67 @@ class TestMultiHTTPSServer : public mkn::ram::https::MultiServer {
   friend class mkn::kul::Thread;
 };
 
+class TestFormHTTPSServer : public mkn::ram::https::Server {
+ private:
+  void operator()() { start(); }
+
+ public:
+  std::string file;
+  bool last = 0;
+  mkn::ram::http::_1_1Response respond(mkn::ram::http::A1_1Request const& req) {
+    auto const it = req.attributes().find("title");
+    std::string const title(it == req.attributes().end() ? "" : it->second);
+    return mkn::ram::http::_1_1Response()
+        .withBody("FORM " + title + " " + std::to_string(file.size()))
+        .withDefaultHeaders();
+  }
+  TestFormHTTPSServer()
+      : mkn::ram::https::Server(_MKN_RAM_HTTP_TEST_PORT_, mkn::kul::File("res/test/server.crt"),
+                                mkn::kul::File("res/test/server.key")) {
+    withForm("/upload", [this](mkn::ram::http::A1_1Request const&,
+                               mkn::ram::http::form::Part const& part,
+                               std::string_view const& chunk, bool const& end) {
+      if (part.filename == "a.bin") file.append(chunk);
+      last = end;
+    });
+  }
+  friend class mkn::kul::Thread;
+};
+
+#ifndef _WIN32
+// blocking TLS over a tcp::Socket, to control how a request is split across writes
+class TLSSocket : public mkn::ram::tcp::Socket<char> {
+ private:
+  SSL_CTX* ctx = SSL_CTX_new(_MKN_RAM_HTTPS_CLIENT_METHOD_());
+  SSL* ssl = nullptr;
+
+ public:
+  ~TLSSocket() {
+    if (ssl) SSL_free(ssl);
+    SSL_CTX_free(ctx);
+  }
+  bool connect(std::string const& host, int16_t const& port) override {
+    if (!mkn::ram::tcp::Socket<char>::connect(host, port)) return false;
+    fcntl(sck, F_SETFL, fcntl(sck, F_GETFL, 0) & ~O_NONBLOCK);
+    timeval tv{5, 0};
+    setsockopt(sck, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, sck);
+    return SSL_connect(ssl) == 1;
+  }
+  bool send(std::string const& s) {
+    return SSL_write(ssl, s.data(), int(s.size())) == int(s.size());
+  }
+  // until the peer closes
+  std::string readAll() {
+    std::string s;
+    char buf[4096];
+    for (int r; (r = SSL_read(ssl, buf, sizeof(buf))) > 0;) s.append(buf, r);
+    return s;
+  }
+};
+#endif  // _WIN32
+
 class HTTPS_Get : public mkn::ram::https::_1_1GetRequest {
  public:
   HTTPS_Get(std::string const& host, std::string const& path = "", uint16_t const& port = 80)
@@ -140,6 +270,7 @@ class TestSocketServer : public mkn::ram::tcp::SocketServer<char> {
     return true;
   }
   TestSocketServer() : mkn::ram::tcp::SocketServer<char>(_MKN_RAM_HTTP_TEST_PORT_) {}
+  TestSocketServer(std::string const& path) : mkn::ram::tcp::SocketServer<char>(path) {}
   friend class mkn::kul::Thread;
 };
 
@@ -168,6 +299,7 @@ class Test {
     KOUT(NON) << "Single HTTPS SERVER";
     {
       TestHTTPSServer serv;
+      serv.withHttp2();
       serv.init();
       mkn::kul::Thread t(std::ref(serv));
       t.run();
@@ -182,15 +314,112 @@ class Test {
         if (t.exception()) std::rethrow_exception(t.exception());
         HTTPS_Get("localhost", "index.html", _MKN_RAM_HTTP_TEST_PORT_).send();
         if (t.exception()) std::rethrow_exception(t.exception());
+#ifndef _WIN32
+        mkn::ram::https::_1_1GetRequest g1("localhost", "index.html", _MKN_RAM_HTTP_TEST_PORT_),
+            g2("localhost", "h2.html", _MKN_RAM_HTTP_TEST_PORT_);
+        mkn::ram::https::_1_1PostRequest p2("localhost", "index.html", _MKN_RAM_HTTP_TEST_PORT_);
+        p2.body("tsop");
+        std::vector<mkn::ram::http::_1_1Response> rs(3);
+        std::vector<mkn::ram::http::A1_1Request*> const reqs{&g1, &p2, &g2};
+        for (size_t i = 0; i < reqs.size(); i++)
+          reqs[i]->withResponse([&rs, i](mkn::ram::http::_1_1Response const& r) { rs[i] = r; });
+        mkn::ram::https::Http2Client("localhost", _MKN_RAM_HTTP_TEST_PORT_).send(reqs);
+        if (t.exception()) std::rethrow_exception(t.exception());
+        auto const port = rs[0].headers().get("X-Client-Port");
+        for (size_t i = 0; i < rs.size(); i++) {
+          std::string const body("HTTPS PROVIDED BY KUL: " + reqs[i]->method());
+          if (rs[i].status() != 200 || rs[i].body().find(body) != 0)
+            KEXCEPT(mkn::ram::http::Exception, "Http2Client response " + std::to_string(i) +
+                                                   ": " + std::to_string(rs[i].status()) + " " +
+                                                   rs[i].body());
+          if (port.empty() || rs[i].headers().get("X-Client-Port") != port)
+            KEXCEPT(mkn::ram::http::Exception, "Http2Client used more than one connection");
+        }
+#endif  // _WIN32
+        {
+          std::string body;
+          auto const now = mkn::ram::tcp::ASocket<char>::NOW();
+          mkn::ram::https::_1_1GetRequest("localhost", "index.html", _MKN_RAM_HTTP_TEST_PORT_)
+              .withTimeouts(0, 3000)
+              .withResponse([&](mkn::ram::http::_1_1Response const& r) { body = r.body(); })
+              .send();
+          if (body.find("HTTPS PROVIDED BY KUL") != 0 ||
+              mkn::ram::tcp::ASocket<char>::NOW() - now > 2000)
+            KEXCEPT(mkn::ram::http::Exception, "HTTPS read past a complete response: " + body);
+          bool threw = 0;
+          try {
+            mkn::ram::https::_1_1GetRequest("localhost", "slow", _MKN_RAM_HTTP_TEST_PORT_)
+                .withTimeouts(0, 300)
+                .withResponse([](mkn::ram::http::_1_1Response const&) {})
+                .send();
+          } catch (mkn::ram::https::Exception const& e) {
+            threw = 1;
+          }
+          if (!threw) KEXCEPT(mkn::ram::http::Exception, "HTTPS read timeout taken as a response");
+          mkn::kul::this_thread::sleep(1000);  // lets the server finish the slow request
+        }
       }
       mkn::kul::this_thread::sleep(100);
       serv.stop();
       t.join();
       mkn::kul::this_thread::sleep(100);
     }
+#ifndef _WIN32
+    KOUT(NON) << "Form HTTPS SERVER";
+    {
+      TestFormHTTPSServer serv;
+      serv.init();
+      mkn::kul::Thread t(std::ref(serv));
+      t.run();
+      mkn::kul::this_thread::sleep(333);
+      if (t.exception()) std::rethrow_exception(t.exception());
+      std::string const boundary("XyZbound");
+      std::string file;
+      for (size_t i = 0; i < 3000; i++) file.push_back(char(i * 7));  // NULs, CRs and LFs
+      file += "\r\n--XyZbou";  // most of a delimiter
+      std::string const body =
+          "--" + boundary +
+          "\r\nContent-Disposition: form-data; name=\"title\"\r\n\r\nhello\r\n--" + boundary +
+          "\r\nContent-Disposition: form-data; name=\"f\"; filename=\"a.bin\"\r\n"
+          "Content-Type: application/octet-stream\r\n\r\n" +
+          file + "\r\n--" + boundary + "--\r\n";
+      // headers alone, then the body cut through the middle of every boundary
+      std::vector<std::string> writes{
+          "POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Type: multipart/form-data; "
+          "boundary=" +
+          boundary + "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n"};
+      size_t from = 0;
+      for (size_t p = body.find(boundary); p != std::string::npos; p = body.find(boundary, p + 1)) {
+        writes.push_back(body.substr(from, p + 4 - from));
+        from = p + 4;
+      }
+      writes.push_back(body.substr(from));
+      std::string res;
+      {
+        TLSSocket sock;
+        if (!sock.connect("localhost", _MKN_RAM_HTTP_TEST_PORT_))
+          KEXCEPT(mkn::ram::tcp::Exception, "TLS FAILED TO CONNECT!");
+        for (auto const& w : writes) {
+          if (!sock.send(w)) KEXCEPT(mkn::ram::tcp::Exception, "TLS write failed");
+          mkn::kul::this_thread::sleep(50);
+        }
+        res = sock.readAll();
+      }
+      if (t.exception()) std::rethrow_exception(t.exception());
+      if (res.find("HTTP/1.1 200") != 0 || res.find("FORM hello 3010") == std::string::npos)
+        KEXCEPT(mkn::ram::http::Exception, "HTTPS form failed: " + res);
+      if (serv.file != file || !serv.last)
+        KEXCEPT(mkn::ram::http::Exception, "HTTPS form file mismatch");
+      serv.stop();
+      mkn::kul::this_thread::sleep(100);
+      t.join();
+    }
+#endif  // _WIN32
     KOUT(NON) << "Multi HTTPS SERVER";
     {
+      auto const admission = std::make_shared<mkn::ram::http::Admission>();
       TestMultiHTTPSServer serv(1, 5);
+      serv.withAdmission(admission);
       serv.init();
       mkn::kul::Thread t(std::ref(serv));
       t.run();
@@ -210,17 +439,62 @@ class Test {
       ctp.finish(1000000000);
 
       mkn::kul::this_thread::sleep(100);
+      if (admission->inFlight())
+        KEXCEPT(mkn::ram::http::Exception, "Admission still counts requests in flight");
+      serv.stop();
+      mkn::kul::this_thread::sleep(100);
+      serv.join();
+      t.join();
+    }
+#ifndef _WIN32
+    {
+      TempFile const tmp("mkn.ram.access.log");
+      auto const admission = std::make_shared<mkn::ram::http::Admission>(1);
+      auto const access = std::make_shared<mkn::ram::http::AccessLog>(tmp.path, 1 << 20, 0);
+      TestMultiHTTPSServer serv(1, 2);
+      serv.withAdmission(admission);
+      serv.withAccessLog(access);
+      serv.init();
+      mkn::kul::Thread t(std::ref(serv));
+      t.run();
+      mkn::kul::this_thread::sleep(333);
+      std::thread slow([]() { HTTPS_Get("localhost", "slow", _MKN_RAM_HTTP_TEST_PORT_).send(); });
+      mkn::kul::this_thread::sleep(200);
+      {
+        TLSSocket sock;
+        if (!sock.connect("localhost", _MKN_RAM_HTTP_TEST_PORT_) ||
+            !sock.send("GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n"))
+          KEXCEPT(mkn::ram::tcp::Exception, "TLS FAILED TO CONNECT!");
+        auto const got = sock.readAll();  // until the server closes
+        if (got != admission->rejection())
+          KEXCEPT(mkn::ram::http::Exception, "Admission over the limit got: " + got);
+      }
+      slow.join();
+      mkn::kul::this_thread::sleep(100);
+      if (admission->shed() != 1 || admission->inFlight())
+        KEXCEPT(mkn::ram::http::Exception, "Admission shed " + std::to_string(admission->shed()));
+      access->flush();
+      if (tmp.read().find("\"method\":\"GET\",\"path\":\"/index.html\",\"status\":503,") ==
+          std::string::npos)
+        KEXCEPT(mkn::ram::http::Exception, "Access log missing the 503: " + tmp.read());
       serv.stop();
       mkn::kul::this_thread::sleep(100);
       serv.join();
       t.join();
     }
+#endif  // _WIN32
 
 #endif  // _MKN_RAM_HTTPS_
 
     KOUT(NON) << "Single HTTP SERVER";
     {
+      TempFile const tmp("mkn.ram.access.log");  // outlives the server holding it open
       TestHTTPServer serv;
+      serv.withMetrics(std::make_shared<mkn::ram::metrics::Registry>());
+      auto access = std::make_shared<mkn::ram::http::AccessLog>(tmp.path, 1 << 20, 0);
+      serv.withAccessLog(access);
+      serv.withStatic("GET", "/health",
+                      mkn::ram::http::_1_1Response().withBody("OK").withDefaultHeaders());
       mkn::kul::Thread t(std::ref(serv));
       t.run();
       mkn::kul::this_thread::sleep(333);
@@ -233,8 +507,226 @@ class Test {
         p.body("tsop");
         p.send();
         if (t.exception()) std::rethrow_exception(t.exception());
+        std::string metrics;
+        mkn::ram::http::_1_1GetRequest("localhost", "metrics", _MKN_RAM_HTTP_TEST_PORT_)
+            .withResponse([&](mkn::ram::http::_1_1Response const& r) { metrics = r.body(); })
+            .send();
+        if (metrics.find("mkn_ram_requests_total{code=\"2xx\"} 3\n") == std::string::npos)
+          KEXCEPT(mkn::ram::http::Exception, "Metrics missing requests: " + metrics);
+        Get("localhost", "health", _MKN_RAM_HTTP_TEST_PORT_).send();
+        access->flush();
+        if (access->written() != 5)
+          KEXCEPT(mkn::ram::http::Exception, "Access log missing records");
+        auto const log = tmp.read();
+        if (log.find("\"method\":\"POST\",\"path\":\"/index.html\",\"status\":200") ==
+                std::string::npos ||
+            log.find("\"method\":\"GET\",\"path\":\"/health\",\"status\":200,\"bytes\":2,") ==
+                std::string::npos)
+          KEXCEPT(mkn::ram::http::Exception, "Access log records wrong: " + log);
+      }
+      mkn::kul::this_thread::sleep(100);
+      serv.stop();
+      mkn::kul::this_thread::sleep(100);
+      t.join();
+    }
+#ifdef _MKN_RAM_HTTP_CO_
+    KOUT(NON) << "Coroutine HTTP SERVER";
+    {
+      namespace co = mkn::ram::http::co;
+      auto tasks = std::make_shared<co::Tasks>();
+      tasks->route("/co", [](mkn::ram::http::A1_1Request const&)
+                              -> co::Task<mkn::ram::http::_1_1Response> {
+        co_await co::SLEEP(std::chrono::milliseconds(10));
+        auto const n = co_await co::OFFLOAD([]() { return 42; });
+        // the loop running this handler also answers its request to the same server
+        std::string got;
+        int const fd = co_await co::CONNECT("localhost", _MKN_RAM_HTTP_TEST_PORT_, 1000);
+        if (fd >= 0) {
+          std::string const out("GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n");
+          if (co_await co::WRITE(fd, out.data(), out.size(), 1000) > 0) {
+            char buf[1024];
+            int r = 0;
+            while ((r = co_await co::READ(fd, buf, sizeof(buf), 1000)) > 0) got.append(buf, r);
+          }
+          ::close(fd);
+        }
+        if (got.find("HTTP PROVIDED BY KUL") == std::string::npos) got.clear();
+        mkn::ram::http::_1_1Response res;
+        co_return res.withBody("CO " + std::to_string(n) + (got.empty() ? "" : " OUT"))
+            .withDefaultHeaders();
+      });
+      TestHTTPServer serv;
+      serv.withTasks(tasks);
+      mkn::kul::Thread t(std::ref(serv));
+      t.run();
+      mkn::kul::this_thread::sleep(333);
+      if (t.exception()) std::rethrow_exception(t.exception());
+      std::string body;
+      mkn::ram::http::_1_1GetRequest("localhost", "co", _MKN_RAM_HTTP_TEST_PORT_)
+          .withResponse([&](mkn::ram::http::_1_1Response const& r) { body = r.body(); })
+          .send();
+      if (body.find("CO 42 OUT") == std::string::npos)
+        KEXCEPT(mkn::ram::http::Exception, "Coroutine failed: " + body);
+      if (tasks->active()) KEXCEPT(mkn::ram::http::Exception, "Coroutine still active");
+      mkn::kul::this_thread::sleep(100);
+      serv.stop();
+      mkn::kul::this_thread::sleep(100);
+      t.join();
+    }
+#endif  // _MKN_RAM_HTTP_CO_
+    KOUT(NON) << "Router HTTP SERVER";
+    {
+      TestRouterHTTPServer serv;
+      mkn::kul::Thread t(std::ref(serv));
+      t.run();
+      mkn::kul::this_thread::sleep(333);
+      if (t.exception()) std::rethrow_exception(t.exception());
+      std::vector<std::tuple<std::string, uint16_t, std::string>> const expect{
+          {"users/42", 200, "USER 42 anon"},
+          {"users/7?x&name=J%C3%B6rg+B", 200, "USER 7 J\xC3\xB6rg B"},
+          {"static/css/a.css", 200, "FILE css/a.css"},
+          {"nope", 404, "Not Found"},
+          {"health", 200, "OK"}};
+      for (auto const& [path, status, body] : expect) {
+        uint16_t got = 0;
+        std::string res;
+        mkn::ram::http::_1_1GetRequest("localhost", path, _MKN_RAM_HTTP_TEST_PORT_)
+            .withResponse([&](mkn::ram::http::_1_1Response const& r) {
+              got = r.status();
+              res = r.body();
+            })
+            .send();
+        if (t.exception()) std::rethrow_exception(t.exception());
+        if (got != status || res.find(body) != 0)
+          KEXCEPT(mkn::ram::http::Exception,
+                  "Router " + path + ": " + std::to_string(got) + " " + res);
+      }
+      {
+        auto const before = "Date: " + std::string(mkn::ram::http::Date::NOW());
+        mkn::ram::tcp::Socket<char> sock;
+        if (!sock.connect("localhost", _MKN_RAM_HTTP_TEST_PORT_))
+          KEXCEPT(mkn::ram::tcp::Exception, "TCP FAILED TO CONNECT!");
+        std::string const get("GET /health HTTP/1.1\r\nConnection: close\r\n\r\n");
+        sock.write(get.c_str(), get.size());
+        std::string got;
+        char buf[_MKN_RAM_TCP_REQUEST_BUFFER_];
+        for (size_t n; (n = sock.read(buf, sizeof(buf)));) got.append(buf, n);
+        sock.close();
+        auto const now = "Date: " + std::string(mkn::ram::http::Date::NOW());
+        if ((got.find(before) == std::string::npos && got.find(now) == std::string::npos) ||
+            got.find("OK") == std::string::npos)
+          KEXCEPT(mkn::ram::http::Exception, "Static response date: " + got);
       }
+      {
+        mkn::ram::http::Router router;
+        auto const h = [](mkn::ram::http::A1_1Request const&, mkn::ram::http::Params const&) {
+          return mkn::ram::http::_1_1Response();
+        };
+        bool threw = 0;
+        try {
+          router.get("/files/*path/x", h);
+        } catch (mkn::ram::http::Exception const& e) {
+          threw = 1;
+        }
+        if (!threw) KEXCEPT(mkn::ram::http::Exception, "Router took a wildcard before '/'");
+        router.get("/files/*path", h);  // conflicts if the bad route left its node behind
+      }
+      serv.stop();
       mkn::kul::this_thread::sleep(100);
+      t.join();
+    }
+    KOUT(NON) << "Large response HTTP SERVER";
+    {
+      TestLargeHTTPServer serv;
+      mkn::kul::Thread t(std::ref(serv));
+      t.run();
+      mkn::kul::this_thread::sleep(333);
+      if (t.exception()) std::rethrow_exception(t.exception());
+      {
+        mkn::ram::tcp::Socket<char> sock;
+        if (!sock.connect("localhost", _MKN_RAM_HTTP_TEST_PORT_))
+          KEXCEPT(mkn::ram::tcp::Exception, "TCP FAILED TO CONNECT!");
+        std::string const get("GET /big HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+        sock.write(get.c_str(), get.size());
+        mkn::kul::this_thread::sleep(300);  // not reading, the server's socket fills up
+        std::string small;
+        mkn::ram::http::_1_1GetRequest("localhost", "small", _MKN_RAM_HTTP_TEST_PORT_)
+            .withResponse([&](mkn::ram::http::_1_1Response const& r) { small = r.body(); })
+            .send();
+        if (small.find("small") != 0)
+          KEXCEPT(mkn::ram::http::Exception, "Server blocked behind a queued response");
+        std::string got;
+        std::vector<char> buf(1 << 16);
+        for (size_t n; (n = sock.read(buf.data(), buf.size()));) got.append(buf.data(), n);
+        sock.close();
+        if (got.find(serv.big) == std::string::npos)
+          KEXCEPT(mkn::ram::http::Exception,
+                  "Large response lost bytes, got " + std::to_string(got.size()));
+      }
+      serv.stop();
+      mkn::kul::this_thread::sleep(100);
+      t.join();
+    }
+    KOUT(NON) << "WebSocket HTTP SERVER";
+    {
+      TestHTTPServer serv;
+      serv.withWebSocket("/ws", [](mkn::ram::http::ws::Connection& c, std::string_view const& m,
+                                   bool const& binary) { c.send(m, binary); });
+      mkn::kul::Thread t(std::ref(serv));
+      t.run();
+      mkn::kul::this_thread::sleep(333);
+      if (t.exception()) std::rethrow_exception(t.exception());
+      {
+        mkn::ram::tcp::Socket<char> sock;
+        if (!sock.connect("localhost", _MKN_RAM_HTTP_TEST_PORT_))
+          KEXCEPT(mkn::ram::tcp::Exception, "TCP FAILED TO CONNECT!");
+        std::string const up(
+            "GET /ws HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade"
+            "\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+        sock.write(up.c_str(), up.size());
+        char buf[_MKN_RAM_TCP_REQUEST_BUFFER_] = {0};
+        sock.read(buf, _MKN_RAM_TCP_REQUEST_BUFFER_ - 1);
+        if (!std::strstr(buf, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo="))
+          KEXCEPT(mkn::ram::tcp::Exception, "WebSocket upgrade failed: " + std::string(buf));
+        char const hi[] = {char(0x81), char(0x82), 1, 2, 3, 4, 'h' ^ 1, 'i' ^ 2};
+        sock.write(hi, sizeof(hi));
+        bzero(buf, _MKN_RAM_TCP_REQUEST_BUFFER_);
+        sock.read(buf, _MKN_RAM_TCP_REQUEST_BUFFER_ - 1);
+        if (std::string(buf, 4) != "\x81\x02hi")
+          KEXCEPT(mkn::ram::tcp::Exception, "WebSocket echo failed");
+        sock.close();
+      }
+      serv.stop();
+      mkn::kul::this_thread::sleep(100);
+      t.join();
+    }
+    KOUT(NON) << "SSE HTTP SERVER";
+    {
+      TestHTTPServer serv;
+      serv.withEvents("/sse", [](std::shared_ptr<mkn::ram::http::sse::Sink> const& s,
+                                 mkn::ram::http::A1_1Request const&) {
+        s->send("hi", "greet", "1");
+        s->close();
+      });
+      mkn::kul::Thread t(std::ref(serv));
+      t.run();
+      mkn::kul::this_thread::sleep(333);
+      if (t.exception()) std::rethrow_exception(t.exception());
+      {
+        mkn::ram::tcp::Socket<char> sock;
+        if (!sock.connect("localhost", _MKN_RAM_HTTP_TEST_PORT_))
+          KEXCEPT(mkn::ram::tcp::Exception, "TCP FAILED TO CONNECT!");
+        std::string const get("GET /sse HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        sock.write(get.c_str(), get.size());
+        std::string res;
+        char buf[_MKN_RAM_TCP_REQUEST_BUFFER_] = {0};
+        std::string const ev("event: greet\nid: 1\ndata: hi\n\n");
+        for (size_t i = 0; i < 3 && res.find(ev) == std::string::npos; i++)
+          res.append(buf, sock.read(buf, _MKN_RAM_TCP_REQUEST_BUFFER_ - 1));
+        if (res.find("text/event-stream") == std::string::npos || res.find(ev) == std::string::npos)
+          KEXCEPT(mkn::ram::tcp::Exception, "SSE stream failed: " + res);
+        sock.close();
+      }
       serv.stop();
       mkn::kul::this_thread::sleep(100);
       t.join();
@@ -269,9 +761,10 @@ class Test {
       mkn::kul::this_thread::sleep(333);
       if (t.exception()) std::rethrow_exception(t.exception());
 
+      std::vector<std::string> const hosts{"localhost", "127.0.0.1", "::1"};
       for (size_t i = 0; i < 5; i++) {
         mkn::ram::tcp::Socket<char> sock;
-        if (!sock.connect("localhost", _MKN_RAM_HTTP_TEST_PORT_))
+        if (!sock.connect(hosts[i % hosts.size()], _MKN_RAM_HTTP_TEST_PORT_))
           KEXCEPT(mkn::ram::tcp::Exception, "TCP FAILED TO CONNECT!");
 
         char const* c = "socketserver";
@@ -287,6 +780,30 @@ class Test {
       serv.stop();
       t.join();
     }
+#ifndef _WIN32
+    KOUT(NON) << "UNIX Socket SERVER";
+    for (std::string const path : {"mkn.ram.test.sock", "@mkn.ram.test.sock"}) {
+      TestSocketServer serv(path);
+      mkn::kul::Thread t(std::ref(serv));
+      t.run();
+      mkn::kul::this_thread::sleep(333);
+      if (t.exception()) std::rethrow_exception(t.exception());
+      {
+        mkn::ram::tcp::Socket<char> sock;
+        if (!sock.connect(path)) KEXCEPT(mkn::ram::tcp::Exception, "UNIX FAILED TO CONNECT!");
+        char const* c = "socketserver";
+        sock.write(c, strlen(c));
+        char buf[_MKN_RAM_TCP_REQUEST_BUFFER_];
+        bzero(buf, _MKN_RAM_TCP_REQUEST_BUFFER_);
+        sock.read(buf, _MKN_RAM_TCP_REQUEST_BUFFER_);
+        if (std::string(buf) != "TCP PROVIDED BY KUL")
+          KEXCEPT(mkn::ram::tcp::Exception, "UNIX socket read failed: " + std::string(buf));
+        sock.close();
+      }
+      serv.stop();
+      t.join();
+    }
+#endif  // _WIN32
     //     mkn::kul::this_thread::sleep(100);
     //     {
     //         TestMultiHTTPServer serv;
@@ -311,6 +828,9 @@ class Test {
 #ifndef __MKN_RAM_NOMAIN__
 int main(int argc, char* argv[]) {
   mkn::kul::Signal s;
+#ifndef _WIN32
+  ::signal(SIGPIPE, SIG_IGN);  // OpenSSL writes without MSG_NOSIGNAL
+#endif
   try {
     mkn::ram::Test();
 